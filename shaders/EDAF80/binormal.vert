@@ -1,19 +1,33 @@
 #version 410
 
 layout (location = 0) in vec3 vertex;
+layout (location = 1) in vec3 normal;
+layout (location = 3) in vec3 tangent;
 layout (location = 4) in vec3 binormal;
 
 uniform mat4 vertex_model_to_world;
 uniform mat4 vertex_world_to_clip;
+uniform bool binormal_is_sign;
 
 out VS_OUT {
 	vec3 binormal;
 } vs_out;
 
 
+vec3 decode_octahedral(vec2 encoded)
+{
+	vec3 direction = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+	if (direction.z < 0.0)
+		direction.xy = (1.0 - abs(encoded.yx)) * vec2(encoded.x >= 0.0 ? 1.0 : -1.0, encoded.y >= 0.0 ? 1.0 : -1.0);
+	return normalize(direction);
+}
+
 void main()
 {
-	vs_out.binormal = binormal;
+	if (binormal_is_sign)
+		vs_out.binormal = binormal.x * cross(decode_octahedral(normal.xy), decode_octahedral(tangent.xy));
+	else
+		vs_out.binormal = binormal;
 
 	gl_Position = vertex_world_to_clip * vertex_model_to_world * vec4(vertex, 1.0);
 }
@@ -9,6 +9,8 @@ layout (location = 4) in vec3 binormal;
 uniform mat4 vertex_model_to_world;
 uniform mat4 normal_model_to_world;
 uniform mat4 vertex_world_to_clip;
+uniform bool has_quantised_attributes;
+uniform bool binormal_is_sign;
 
 uniform vec3 light_position;
 uniform vec3 camera_position;
@@ -22,12 +24,27 @@ out VS_OUT {
 	vec3 camera_vector;
 } vs_out;
 
+vec3 decode_octahedral(vec2 encoded)
+{
+	vec3 direction = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+	if (direction.z < 0.0)
+		direction.xy = (1.0 - abs(encoded.yx)) * vec2(encoded.x >= 0.0 ? 1.0 : -1.0, encoded.y >= 0.0 ? 1.0 : -1.0);
+	return normalize(direction);
+}
+
 void main()
 {
 	vec3 vertex_in_world = vec3(vertex_model_to_world * vec4(vertex, 1.0));
-	vs_out.normal = vec3(normal_model_to_world * vec4(normal, 0.0));
-	vs_out.tangent = vec3(normal_model_to_world * vec4(tangent, 0.0));
-	vs_out.binormal = vec3(normal_model_to_world * vec4(binormal, 0.0));
+	vec3 model_normal = normal, model_tangent = tangent, model_binormal = binormal;
+	if (has_quantised_attributes) {
+		model_normal = decode_octahedral(normal.xy);
+		model_tangent = decode_octahedral(tangent.xy);
+		if (binormal_is_sign)
+			model_binormal = binormal.x * cross(model_normal, model_tangent);
+	}
+	vs_out.normal = vec3(normal_model_to_world * vec4(model_normal, 0.0));
+	vs_out.tangent = vec3(normal_model_to_world * vec4(model_tangent, 0.0));
+	vs_out.binormal = vec3(normal_model_to_world * vec4(model_binormal, 0.0));
 	vs_out.texcoord = vec2(texcoord.x, texcoord.y);
 	vs_out.light_vector = light_position - vertex_in_world;
 	vs_out.camera_vector = camera_position - vertex_in_world;
@@ -6,13 +6,23 @@ layout (location = 1) in vec3 normal;
 uniform mat4 vertex_model_to_world;
 uniform mat4 normal_model_to_world;
 uniform mat4 vertex_world_to_clip;
+uniform bool has_quantised_attributes;
 
 out VS_OUT {
 	vec3 normal;
 } vs_out;
 
+vec3 decode_octahedral(vec2 encoded)
+{
+	vec3 direction = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+	if (direction.z < 0.0)
+		direction.xy = (1.0 - abs(encoded.yx)) * vec2(encoded.x >= 0.0 ? 1.0 : -1.0, encoded.y >= 0.0 ? 1.0 : -1.0);
+	return normalize(direction);
+}
+
 void main()
 {
-	vs_out.normal = vec3(normal_model_to_world * vec4(normal, 0.0));
+	vec3 model_normal = has_quantised_attributes ? decode_octahedral(normal.xy) : normal;
+	vs_out.normal = vec3(normal_model_to_world * vec4(model_normal, 0.0));
 	gl_Position = vertex_world_to_clip * vertex_model_to_world * vec4(vertex, 1.0);
 }
@@ -7,6 +7,7 @@ layout (location = 2) in vec3 texcoord;
 uniform mat4 vertex_model_to_world;
 uniform mat4 normal_model_to_world;
 uniform mat4 vertex_world_to_clip;
+uniform bool has_quantised_attributes;
 
 uniform vec3 light_position;
 uniform vec3 camera_position;
@@ -18,10 +19,19 @@ out VS_OUT {
 	vec2 texcoord;
 } vs_out;
 
+vec3 decode_octahedral(vec2 encoded)
+{
+	vec3 direction = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+	if (direction.z < 0.0)
+		direction.xy = (1.0 - abs(encoded.yx)) * vec2(encoded.x >= 0.0 ? 1.0 : -1.0, encoded.y >= 0.0 ? 1.0 : -1.0);
+	return normalize(direction);
+}
+
 void main()
 {
 	vec3 vertex_in_world = vec3(vertex_model_to_world * vec4(vertex, 1.0));
-	vs_out.normal = vec3(normal_model_to_world * vec4(normal, 0.0));
+	vec3 model_normal = has_quantised_attributes ? decode_octahedral(normal.xy) : normal;
+	vs_out.normal = vec3(normal_model_to_world * vec4(model_normal, 0.0));
 	vs_out.light_vector = light_position - vertex_in_world;
 	vs_out.camera_vector = camera_position - vertex_in_world;
 	vs_out.texcoord = vec2(texcoord.x, texcoord.y);
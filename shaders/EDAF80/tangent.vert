@@ -5,15 +5,24 @@ layout (location = 3) in vec3 tangent;
 
 uniform mat4 vertex_model_to_world;
 uniform mat4 vertex_world_to_clip;
+uniform bool has_quantised_attributes;
 
 out VS_OUT {
 	vec3 tangent;
 } vs_out;
 
 
+vec3 decode_octahedral(vec2 encoded)
+{
+	vec3 direction = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+	if (direction.z < 0.0)
+		direction.xy = (1.0 - abs(encoded.yx)) * vec2(encoded.x >= 0.0 ? 1.0 : -1.0, encoded.y >= 0.0 ? 1.0 : -1.0);
+	return normalize(direction);
+}
+
 void main()
 {
-	vs_out.tangent = normalize(tangent);
+	vs_out.tangent = has_quantised_attributes ? decode_octahedral(tangent.xy) : normalize(tangent);
 
 	gl_Position = vertex_world_to_clip * vertex_model_to_world * vec4(vertex, 1.0);
 }
@@ -27,6 +27,12 @@ uniform float k_2;
 
 uniform float t;
 
+// Set when drawing a grid from parametric_shapes::createImplicitGrid(),
+// in which case the vertex attributes are not provided.
+uniform bool use_implicit_grid;
+uniform ivec2 grid_resolution; // vertices along x and z
+uniform vec2 grid_size;
+
 out VS_OUT {
 	vec3 normal;
 	vec2 texcoord;
@@ -38,8 +44,18 @@ out VS_OUT {
 
 void main()
 {
+	vec3 model_vertex = vertex;
+	vec2 model_texcoord = texcoord.xy;
+	if (use_implicit_grid) {
+		// Instances are rows of cells, each drawn as a strip alternating
+		// between the next row of vertices and the current one.
+		ivec2 grid_vertex = ivec2(gl_VertexID / 2, gl_InstanceID + 1 - gl_VertexID % 2);
+		model_texcoord = vec2(grid_vertex) / vec2(grid_resolution - 1);
+		model_vertex = vec3(model_texcoord.x * grid_size.x, 0.0, model_texcoord.y * grid_size.y);
+	}
+
 	// --- WAVE ONE ---
-	vec4 G_1 = vertex_model_to_world * vec4(vertex, 1.0);
+	vec4 G_1 = vertex_model_to_world * vec4(model_vertex, 1.0);
 	float dPos1 = D_1.x * G_1.x + D_1.z * G_1.z;
 	float dSin1 = sin(dPos1 * f_1 + t * p_1) * 0.5 + 0.5;
 	float y1 = A_1 * pow(dSin1, k_1);
@@ -50,7 +66,7 @@ void main()
 	float dG_1dz = dG_1 * D_1.z;
 
 	// --- WAVE TWO ---
-	vec4 G_2 = vertex_model_to_world * vec4(vertex, 1.0);
+	vec4 G_2 = vertex_model_to_world * vec4(model_vertex, 1.0);
 	float dPos2 = D_2.x * G_2.x + D_2.z * G_2.z;
 	float dSin2 = sin(dPos2 * f_2 + t * p_2) * 0.5 + 0.5;
 	float y2 = A_2 * pow(dSin2, k_2);
@@ -70,7 +86,7 @@ void main()
 	vs_out.tangent = vec3(0.0, dHdz, 1.0);
 	vs_out.light_vector = light_position - H.xyz;
 	vs_out.camera_vector = camera_position - H.xyz;
-	vs_out.texcoord = texcoord.xy;
+	vs_out.texcoord = model_texcoord;
 
 	gl_Position = vertex_world_to_clip * H;
 }
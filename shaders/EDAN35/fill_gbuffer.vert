@@ -2,6 +2,8 @@
 
 uniform mat4 vertex_model_to_world;
 uniform mat4 vertex_world_to_clip;
+uniform bool has_quantised_attributes;
+uniform bool binormal_is_sign;
 
 layout (location = 0) in vec3 vertex;
 layout (location = 1) in vec3 normal;
@@ -17,11 +19,27 @@ out VS_OUT {
 } vs_out;
 
 
+vec3 decode_octahedral(vec2 encoded)
+{
+	vec3 direction = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+	if (direction.z < 0.0)
+		direction.xy = (1.0 - abs(encoded.yx)) * vec2(encoded.x >= 0.0 ? 1.0 : -1.0, encoded.y >= 0.0 ? 1.0 : -1.0);
+	return normalize(direction);
+}
+
 void main() {
-	vs_out.normal   = normalize(normal);
+	if (has_quantised_attributes) {
+		vs_out.normal   = decode_octahedral(normal.xy);
+		vs_out.tangent  = decode_octahedral(tangent.xy);
+	} else {
+		vs_out.normal   = normalize(normal);
+		vs_out.tangent  = normalize(tangent);
+	}
+	if (binormal_is_sign)
+		vs_out.binormal = binormal.x * cross(vs_out.normal, vs_out.tangent);
+	else
+		vs_out.binormal = normalize(binormal);
 	vs_out.texcoord = texcoord.xy;
-	vs_out.tangent  = normalize(tangent);
-	vs_out.binormal = normalize(binormal);
 
 	gl_Position = vertex_world_to_clip * vertex_model_to_world * vec4(vertex, 1.0);
 }
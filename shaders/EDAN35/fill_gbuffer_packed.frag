@@ -0,0 +1,40 @@
+#version 410
+
+// Same as fill_gbuffer.frag, for materials packed into texture arrays.
+uniform sampler2DArray diffuse_texture;
+uniform sampler2DArray specular_texture;
+uniform sampler2DArray normals_texture;
+uniform sampler2DArray opacity_texture;
+uniform int diffuse_texture_layer;
+uniform int specular_texture_layer;
+uniform int normals_texture_layer;
+uniform int opacity_texture_layer;
+uniform bool has_opacity_texture;
+uniform mat4 normal_model_to_world;
+
+in VS_OUT {
+	vec3 normal;
+	vec2 texcoord;
+	vec3 tangent;
+	vec3 binormal;
+} fs_in;
+
+layout (location = 0) out vec4 geometry_diffuse;
+layout (location = 1) out vec4 geometry_specular;
+layout (location = 2) out vec4 geometry_normal;
+
+
+void main()
+{
+	if (has_opacity_texture && texture(opacity_texture, vec3(fs_in.texcoord, opacity_texture_layer)).r < 1.0)
+		discard;
+
+	// Diffuse color
+	geometry_diffuse = texture(diffuse_texture, vec3(fs_in.texcoord, diffuse_texture_layer));
+
+	// Specular color
+	geometry_specular = texture(specular_texture, vec3(fs_in.texcoord, specular_texture_layer));
+
+	// Worldspace normal
+	geometry_normal.xyz = vec3(0.0, 0.0, 0.0);
+}
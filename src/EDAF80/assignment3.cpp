@@ -1,6 +1,7 @@
 #include "assignment3.hpp"
 #include "interpolation.hpp"
 #include "parametric_shapes.hpp"
+#include "shape_cache.hpp"
 
 #include "config.hpp"
 #include "external/glad/glad.h"
@@ -65,9 +66,10 @@ void
 edaf80::Assignment3::run()
 {
 	// Load the sphere geometry
-	auto sphere_shape = parametric_shapes::createSphere(100u, 100u, 2.0f);
-	auto cube_map_shape = parametric_shapes::createSphere(100u, 100u, 100.0f);
-	if (cube_map_shape.vao == 0u || sphere_shape.vao == 0u) {
+	// Both spheres share the same unit mesh, scaled by their nodes.
+	auto const sphere_shape = shape_cache::getSphere(100u, 100u, 1.0f);
+	auto const cube_map_shape = shape_cache::getSphere(100u, 100u, 1.0f);
+	if (cube_map_shape == nullptr || sphere_shape == nullptr) {
 		LogError("Failed to retrieve the sphere mesh");
 		return;
 	}
@@ -131,8 +133,9 @@ edaf80::Assignment3::run()
 	auto polygon_mode = polygon_mode_t::fill;
 
 	auto node = Node();
-	node.set_geometry(sphere_shape);
+	node.set_geometry(*sphere_shape);
 	node.set_program(phong_shader, phong_set_uniforms);
+	node.set_scaling(glm::vec3(2.0f));
 
 	std::string texture_name = "fieldstone";
 	auto texture_diffuse = bonobo::loadTexture2D(texture_name + "_diffuse.png");
@@ -141,8 +144,9 @@ edaf80::Assignment3::run()
 	node.add_texture("bump_texture", texture_bump, GL_TEXTURE_2D);
 
 	auto skybox = Node();
-	skybox.set_geometry(cube_map_shape);
+	skybox.set_geometry(*cube_map_shape);
 	skybox.set_program(cube_shader, set_uniforms);
+	skybox.set_scaling(glm::vec3(100.0f));
 
 	std::string cubemap = "cloudyhills";
 	auto texture_cubemap = bonobo::loadTextureCubeMap(cubemap + "/posx.png", cubemap + "/negx.png", cubemap + "/posy.png", cubemap + "/negy.png", cubemap + "/posz.png", cubemap + "/negz.png");
@@ -254,6 +258,8 @@ edaf80::Assignment3::run()
 	cube_shader = 0u;
 	glDeleteProgram(phong_shader);
 	phong_shader = 0u;
+
+	shape_cache::logStatistics();
 }
 
 int main()
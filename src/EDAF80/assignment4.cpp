@@ -131,12 +131,19 @@ edaf80::Assignment4::run()
 	// Todo: Load your geometry
 	//
 	int size = 100;
-	auto quad_shape = parametric_shapes::createQuad(size, size, size, size);
+	// The water shader computes its vertices itself, so the water does not
+	// need any vertex buffer.
+	auto water_shape = parametric_shapes::createImplicitGrid(size, size);
 	auto cube_map_shape = parametric_shapes::createSphere(100u, 100u, 100.0f);
 
+	auto const water_set_uniforms = [&set_uniforms,size](GLuint program){
+		set_uniforms(program);
+		parametric_shapes::setImplicitGridUniforms(program, size, size, size, size);
+	};
+
 	auto node = Node();
-	node.set_geometry(quad_shape);
-	node.set_program(water_shader, set_uniforms);
+	node.set_geometry(water_shape);
+	node.set_program(water_shader, water_set_uniforms);
 	node.set_translation(glm::vec3(-size/2.0, 0, -size/2.0));
 
 	auto water_texture = bonobo::loadTexture2D("waves.png");
@@ -1,11 +1,13 @@
 #include "assignment5.hpp"
 #include "parametric_shapes.hpp"
+#include "shape_cache.hpp"
 
 #include "config.hpp"
 #include "external/glad/glad.h"
 #include "core/Bonobo.h"
 #include "core/FPSCamera.h"
 #include "core/helpers.hpp"
+#include "core/resource_registry.hpp"
 #include "core/InputHandler.h"
 #include "core/Log.h"
 #include "core/LogView.h"
@@ -23,6 +25,7 @@
 
 #include <stdexcept>
 #include <stack>
+#include <vector>
 
 edaf80::Assignment5::Assignment5()
 {
@@ -53,11 +56,13 @@ void
 edaf80::Assignment5::run()
 {
 	// Load the sphere geometry
+	bonobo::resource_registry::pushOwner("Game objects");
 	auto const ship_obj = bonobo::loadObjects("spaceship.obj");
 	auto const heart_obj = bonobo::loadObjects("heart.obj");
-	auto sphere_shape = parametric_shapes::createSphere(100u, 100u, 1.0f);
+	auto const sphere_shape = shape_cache::getSphere(100u, 100u, 1.0f);
 	auto coin_shape = parametric_shapes::createCircleRing(100u, 100u, 0.0f, 3.0f);
-	if (ship_obj.empty() || heart_obj.empty() || sphere_shape.vao == 0u || coin_shape.vao == 0u) {
+	bonobo::resource_registry::popOwner();
+	if (ship_obj.empty() || heart_obj.empty() || sphere_shape == nullptr || coin_shape.vao == 0u) {
 		LogError("Failed to retrieve the objects");
 		return;
 	}
@@ -189,12 +194,22 @@ edaf80::Assignment5::run()
 	auto game = Node();
 
 	int size = 100;
+	bonobo::resource_registry::pushOwner("Environment");
 	auto quad_shape = parametric_shapes::createQuad(size, size, size, size);
-	auto cube_map_shape = parametric_shapes::createSphere(100u, 100u, size/2.0f);
+	// The water shader computes its vertices itself, so the water does not
+	// need any vertex buffer.
+	auto water_shape = parametric_shapes::createImplicitGrid(size, size);
+	// Same unit sphere as the rocks and coins, scaled by the skybox node.
+	auto const cube_map_shape = shape_cache::getSphere(100u, 100u, 1.0f);
+
+	auto const water_set_uniforms = [&set_uniforms,size](GLuint program){
+		set_uniforms(program);
+		parametric_shapes::setImplicitGridUniforms(program, size, size, size, size);
+	};
 
 	auto water = Node();
-	water.set_geometry(quad_shape);
-	water.set_program(water_shader, set_uniforms);
+	water.set_geometry(water_shape);
+	water.set_program(water_shader, water_set_uniforms);
 	water.set_translation(glm::vec3(-size/2.0, 0, -size/2.0));
 
 	auto water_texture = bonobo::loadTexture2D("waves.png");
@@ -203,11 +218,17 @@ edaf80::Assignment5::run()
 	game.add_child(&water);
 
 	auto skybox = Node();
-	skybox.set_geometry(cube_map_shape);
+	skybox.set_geometry(*cube_map_shape);
 	skybox.set_program(cube_shader, set_uniforms);
+	skybox.set_scaling(glm::vec3(size / 2.0f));
 
 	std::string cubemap = "blue_sky";
-	auto texture_cubemap = bonobo::loadTextureCubeMap(cubemap + "/posx.png", cubemap + "/negx.png", cubemap + "/posy.png", cubemap + "/negy.png", cubemap + "/posz.png", cubemap + "/negz.png");
+	// A single equirectangular image, when shipped, is preferred over six
+	// separate faces.
+	auto texture_cubemap = bonobo::loadEquirectangularCubeMap(cubemap + ".png");
+	if (texture_cubemap == 0u)
+		texture_cubemap = bonobo::loadTextureCubeMap(cubemap + "/posx.png", cubemap + "/negx.png", cubemap + "/posy.png", cubemap + "/negy.png", cubemap + "/posz.png", cubemap + "/negz.png");
+	bonobo::resource_registry::popOwner();
 	water.add_texture("cube_map_texture", texture_cubemap, GL_TEXTURE_CUBE_MAP);
 	skybox.add_texture("cube_map_texture", texture_cubemap, GL_TEXTURE_CUBE_MAP);
 	
@@ -234,7 +255,7 @@ edaf80::Assignment5::run()
 	int max_radius = 3;
 	float res = 10;
 	for (int i = 0; i < rocks.size(); i++) {
-		rocks[i].set_geometry(sphere_shape);
+		rocks[i].set_geometry(*sphere_shape);
 		rocks[i].set_program(phong_shader, phong_set_uniforms);
 		rocks[i].set_translation(glm::vec3(rand() % size / 4 - size / 8, 0, - size - max_radius - rand() % size));
 		rocks[i].set_scaling(glm::vec3((rand() % (max_radius - 1) * res) / res + 1));
@@ -246,7 +267,7 @@ edaf80::Assignment5::run()
 	std::vector<Node> coins(2);
 	
 	for (int i = 0; i < coins.size(); i++) {
-		coins[i].set_geometry(sphere_shape);
+		coins[i].set_geometry(*sphere_shape);
 		coins[i].set_program(phong_shader, phong_set_uniforms);
 		coins[i].set_translation(glm::vec3(rand() % size / 4 - size / 8, 1.5f, - size - max_radius - rand() % size));
 		coins[i].set_scaling(glm::vec3(1, 1, 0.1f));
@@ -290,6 +311,18 @@ edaf80::Assignment5::run()
 
 	auto velocity = glm::vec3(0, 0, 0);
 
+	// Nodes drawn with the level of detail matching their size on screen.
+	auto lod_nodes = std::vector<Node*>{ &ship };
+	for (auto& rock : rocks)
+		lod_nodes.push_back(&rock);
+	for (auto& coin : coins)
+		lod_nodes.push_back(&coin);
+	for (auto& life : lives)
+		lod_nodes.push_back(&life);
+	bool use_lods = true;
+	bool show_resources = false;
+	float lod_pixel_error = 1.0f;
+
 	f64 ddeltatime;
 	size_t fpsSamples = 0;
 	double nowTime, lastTime = GetTimeMilliseconds();
@@ -413,6 +446,17 @@ edaf80::Assignment5::run()
 		//
 		// Todo: Render all your geometry here.
 		//
+		size_t lod_triangles_nb = 0u, full_triangles_nb = 0u;
+		for (auto node : lod_nodes) {
+			if (use_lods)
+				node->select_lod(mCamera.mWorld.GetTranslation(), mCamera.GetFov(),
+				                 static_cast<float>(window_size.y), lod_pixel_error);
+			else
+				node->set_lod(0u);
+			lod_triangles_nb += node->get_lod_indices_nb(node->get_lod()) / 3u;
+			full_triangles_nb += node->get_lod_indices_nb(0u) / 3u;
+		}
+
 		auto node_stack = std::stack<Node const*>();
 		node_stack.push(&game);
 		
@@ -447,6 +491,19 @@ edaf80::Assignment5::run()
 			ImGui::End();
 		}
 
+		if (ImGui::Begin("Levels of detail", &opened, ImVec2(300, 100), -1.0f, 0)) {
+			ImGui::Checkbox("Select by screen size", &use_lods);
+			ImGui::SliderFloat("Max error (px)", &lod_pixel_error, 0.1f, 10.0f);
+			ImGui::Checkbox("Show resources", &show_resources);
+			if (full_triangles_nb != 0u)
+				ImGui::Text("Triangles: %u / %u (%.1f%% saved)", static_cast<unsigned int>(lod_triangles_nb),
+				            static_cast<unsigned int>(full_triangles_nb),
+				            100.0 * (full_triangles_nb - lod_triangles_nb) / full_triangles_nb);
+		}
+		ImGui::End();
+		if (show_resources)
+			bonobo::resource_registry::renderView(&show_resources);
+
 		ImGui::Render();
 
 		window->Swap();
@@ -467,6 +524,8 @@ edaf80::Assignment5::run()
 	texture_shader = 0u;
 	glDeleteProgram(phong_shader);
 	phong_shader = 0u;
+
+	shape_cache::logStatistics();
 }
 
 int main()
@@ -1,15 +1,266 @@
 #include "parametric_shapes.hpp"
 #include "core/Log.h"
+#include "core/thread_pool.hpp"
 #include "core/utils.h"
 
 #include <glm/glm.hpp>
 
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <cmath>
+#include <cstring>
+#include <future>
 #include <iostream>
 #include <vector>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	include <emmintrin.h>
+#	define BONOBO_PARAMETRIC_SHAPES_SSE2 1
+#endif
+
+namespace
+{
+	using parametric_shapes::cpu_mesh;
+
+	u64 const splitting_threshold = 128u * 128u; // vertices under which a shape is generated on the calling thread
+	size_t const task_vertices = 32u * 1024u;    // vertices generated per task, roughly
+
+	//! \brief Four floats processed at once, one per grid column.
+#ifdef BONOBO_PARAMETRIC_SHAPES_SSE2
+	struct float4 {
+		__m128 v;
+	};
+
+	inline float4 load4(float const* values) { return { _mm_loadu_ps(values) }; }
+	inline float4 splat4(float value) { return { _mm_set1_ps(value) }; }
+	inline float4 operator+(float4 a, float4 b) { return { _mm_add_ps(a.v, b.v) }; }
+	inline float4 operator-(float4 a, float4 b) { return { _mm_sub_ps(a.v, b.v) }; }
+	inline float4 operator*(float4 a, float4 b) { return { _mm_mul_ps(a.v, b.v) }; }
+	inline void store4(float* values, float4 a) { _mm_storeu_ps(values, a.v); }
+#else
+	struct float4 {
+		float v[4];
+	};
+
+	inline float4 load4(float const* values) { return { { values[0], values[1], values[2], values[3] } }; }
+	inline float4 splat4(float value) { return { { value, value, value, value } }; }
+	inline float4 operator+(float4 a, float4 b) { return { { a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3] } }; }
+	inline float4 operator-(float4 a, float4 b) { return { { a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], a.v[3] - b.v[3] } }; }
+	inline float4 operator*(float4 a, float4 b) { return { { a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3] } }; }
+	inline void store4(float* values, float4 a) { std::memcpy(values, a.v, sizeof(a.v)); }
+#endif
+	inline float4 operator-(float4 a) { return splat4(0.0f) - a; }
+
+	static_assert(sizeof(glm::vec3) == 3u * sizeof(float), "glm::vec3 is expected to be tightly packed");
+
+	//! \brief Write `count` (at most 4) consecutive vectors, given as
+	//!        their x, y and z components.
+	inline void store(glm::vec3* output, size_t count, float4 x, float4 y, float4 z)
+	{
+#ifdef BONOBO_PARAMETRIC_SHAPES_SSE2
+		if (count == 4u) {
+			// Transpose into x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3.
+			auto const xy_low = _mm_unpacklo_ps(x.v, y.v);                        // x0 y0 x1 y1
+			auto const xy_high = _mm_unpackhi_ps(x.v, y.v);                       // x2 y2 x3 y3
+			auto const z0x1 = _mm_shuffle_ps(z.v, x.v, _MM_SHUFFLE(1, 1, 0, 0));  // z0 z0 x1 x1
+			auto const y1z1 = _mm_shuffle_ps(y.v, z.v, _MM_SHUFFLE(2, 1, 2, 1));  // y1 y2 z1 z2
+			auto const z2x3 = _mm_shuffle_ps(z.v, xy_high, _MM_SHUFFLE(2, 2, 2, 2)); // z2 z2 x3 x3
+			auto const y3z3 = _mm_shuffle_ps(xy_high, z.v, _MM_SHUFFLE(3, 3, 3, 3)); // y3 y3 z3 z3
+			auto const values = reinterpret_cast<float*>(output);
+			_mm_storeu_ps(values,      _mm_shuffle_ps(xy_low, z0x1, _MM_SHUFFLE(2, 0, 1, 0)));
+			_mm_storeu_ps(values + 4,  _mm_shuffle_ps(y1z1, xy_high, _MM_SHUFFLE(1, 0, 2, 0)));
+			_mm_storeu_ps(values + 8,  _mm_shuffle_ps(z2x3, y3z3, _MM_SHUFFLE(2, 0, 2, 0)));
+			return;
+		}
+#endif
+		float xs[4], ys[4], zs[4];
+		store4(xs, x);
+		store4(ys, y);
+		store4(zs, z);
+		for (size_t i = 0u; i < count; ++i)
+			output[i] = glm::vec3(xs[i], ys[i], zs[i]);
+	}
+
+	//! \brief Values of `first + i * step` for all rows or columns of a
+	//!        grid, padded so that groups of four can always be loaded.
+	std::vector<float> computeSteps(unsigned int count, float first, float step)
+	{
+		auto values = std::vector<float>((count + 3u) & ~3u, 0.0f);
+		for (unsigned int i = 0u; i < count; ++i)
+			values[i] = first + static_cast<float>(i) * step;
+		return values;
+	}
+
+	//! \brief Texture coordinates spanning [0, 1] over `count` rows or
+	//!        columns of a grid, padded as `computeSteps()`.
+	std::vector<float> computeTexcoords(unsigned int count)
+	{
+		auto values = std::vector<float>((count + 3u) & ~3u, 0.0f);
+		for (unsigned int i = 0u; i < count; ++i)
+			values[i] = static_cast<float>(i) / (static_cast<float>(count) - 1.0f);
+		return values;
+	}
+
+	//! \brief Cosine and sine of the angles of all rows or columns of a
+	//!        grid, computed once rather than for each vertex, and padded
+	//!        as `computeSteps()`.
+	struct angle_table {
+		std::vector<float> cos;
+		std::vector<float> sin;
+	};
+
+	angle_table computeAngles(unsigned int count, float step)
+	{
+		angle_table table;
+		table.cos = computeSteps(count, 0.0f, step);
+		table.sin = table.cos;
+		for (unsigned int i = 0u; i < count; ++i) {
+			table.cos[i] = std::cos(table.cos[i]);
+			table.sin[i] = std::sin(table.sin[i]);
+		}
+		return table;
+	}
+
+	struct bounds {
+		glm::vec3 min;
+		glm::vec3 max;
+	};
+
+	//! \brief How the cells of a grid are split into triangles, given
+	//!        the number of vertices per row.
+	struct grid_topology {
+		std::array<GLuint, 6> cell; //!< offsets from the first vertex of a cell to the corners of its two triangles, as a list
+		GLuint strip_first;         //!< offset from the first vertex of a cell to the one starting it in a strip, keeping the same winding and diagonal
+		bool strips;                //!< whether each row of cells is one strip, rather than a list
+	};
+
+	//! \brief Cells split along the diagonal from their first vertex, with
+	//!        triangles wound as the vertices of the next row come after
+	//!        those of the current one.
+	grid_topology getTopology(unsigned int columns_nb, GLenum drawing_mode)
+	{
+		return { { { 0u, 1u, columns_nb + 1u, 0u, columns_nb + 1u, columns_nb } }, columns_nb, drawing_mode == GL_TRIANGLE_STRIP };
+	}
+
+	//! \brief Cells split along their other diagonal, with triangles wound
+	//!        the other way round.
+	grid_topology getFlippedTopology(unsigned int columns_nb, GLenum drawing_mode)
+	{
+		return { { { columns_nb, 1u, 0u, 1u, columns_nb, columns_nb + 1u } }, 0u, drawing_mode == GL_TRIANGLE_STRIP };
+	}
+
+	//! \brief Number of indices used by the cells starting on a row:
+	//!        two triangles per cell in a list, or a strip covering all
+	//!        cells followed by a restart.
+	size_t getRowIndicesNb(grid_topology const& topology, unsigned int columns_nb)
+	{
+		return topology.strips ? 2u * static_cast<size_t>(columns_nb) + 1u : 6u * static_cast<size_t>(columns_nb - 1u);
+	}
+
+	//! \brief Generate rows [first_row, last_row) of a grid, and the
+	//!        triangles of the cells starting on them.
+	//!
+	//! @param [in] topology how to split the cells into triangles
+	//! @param [in] generate_columns fills in up to four vertices of a row of
+	//!             the mesh, given the row, the first column, how many
+	//!             columns and the index of the first vertex
+	//! @return the bounds of the generated vertices
+	template<typename Columns>
+	bounds generateRows(cpu_mesh& mesh, unsigned int columns_nb, unsigned int rows_nb, grid_topology const& topology,
+	                    unsigned int first_row, unsigned int last_row, Columns const& generate_columns)
+	{
+		auto const row_indices_nb = getRowIndicesNb(topology, columns_nb);
+		for (unsigned int i = first_row; i < last_row; ++i) {
+			auto const row_start = static_cast<size_t>(i) * columns_nb;
+			for (unsigned int j = 0u; j < columns_nb; j += 4u)
+				generate_columns(mesh, i, j, std::min(4u, columns_nb - j), row_start + j);
+
+			if (i + 1u == rows_nb)
+				continue;
+			auto indices = mesh.indices.data() + static_cast<size_t>(i) * row_indices_nb;
+			if (topology.strips) {
+				auto const other = columns_nb - topology.strip_first;
+				for (unsigned int j = 0u; j < columns_nb; ++j, indices += 2) {
+					auto const base = static_cast<GLuint>(row_start + j);
+					indices[0] = base + topology.strip_first;
+					indices[1] = base + other;
+				}
+				// The last strip is not followed by a restart.
+				if (i + 2u < rows_nb)
+					indices[0] = bonobo::primitive_restart_index;
+				continue;
+			}
+			for (unsigned int j = 0u; j < columns_nb - 1u; ++j, indices += 6) {
+				auto const base = static_cast<GLuint>(row_start + j);
+				for (size_t k = 0u; k < 6u; ++k)
+					indices[k] = base + topology.cell[k];
+			}
+		}
+
+		auto const first = mesh.vertices.data() + static_cast<size_t>(first_row) * columns_nb;
+		auto const last = mesh.vertices.data() + static_cast<size_t>(last_row) * columns_nb;
+		bounds box = { first != last ? *first : glm::vec3(0.0f), first != last ? *first : glm::vec3(0.0f) };
+		for (auto vertex = first; vertex != last; ++vertex) {
+			box.min = glm::min(box.min, *vertex);
+			box.max = glm::max(box.max, *vertex);
+		}
+		return box;
+	}
+
+	//! \brief Allocate a mesh for a grid of vertices and generate it,
+	//!        spreading its rows over the pool if it is large enough.
+	//!
+	//! @param [in] pool if not nullptr, groups of rows are generated by
+	//!             its workers in parallel
+	//! @param [in] topology, generate_columns see `generateRows()`
+	template<typename Columns>
+	cpu_mesh generateGrid(unsigned int columns_nb, unsigned int rows_nb, grid_topology const& topology,
+	                      bonobo::thread_pool* pool, Columns const& generate_columns)
+	{
+		cpu_mesh mesh;
+		// Without at least one cell, there is nothing to generate.
+		if (columns_nb < 2u || rows_nb < 2u)
+			return mesh;
+
+		auto const vertices_nb = static_cast<size_t>(columns_nb) * rows_nb;
+		mesh.vertices.resize(vertices_nb);
+		mesh.normals.resize(vertices_nb);
+		mesh.texcoords.resize(vertices_nb);
+		mesh.tangents.resize(vertices_nb);
+		mesh.binormals.resize(vertices_nb);
+		mesh.drawing_mode = topology.strips ? GL_TRIANGLE_STRIP : GL_TRIANGLES;
+		auto const row_indices_nb = getRowIndicesNb(topology, columns_nb);
+		mesh.indices.resize(row_indices_nb * (rows_nb - 1u) - (topology.strips ? 1u : 0u));
+
+		if (pool == nullptr || pool->size() < 2u || vertices_nb < splitting_threshold) {
+			auto const box = generateRows(mesh, columns_nb, rows_nb, topology, 0u, rows_nb, generate_columns);
+			mesh.min_bounds = box.min;
+			mesh.max_bounds = box.max;
+			return mesh;
+		}
+
+		auto const rows_per_task = std::max(1u, static_cast<unsigned int>(task_vertices / columns_nb));
+		std::vector<std::future<bounds>> tasks;
+		tasks.reserve((rows_nb + rows_per_task - 1u) / rows_per_task);
+		for (unsigned int first_row = 0u; first_row < rows_nb; first_row += rows_per_task) {
+			auto const last_row = std::min(first_row + rows_per_task, rows_nb);
+			tasks.push_back(pool->submit([=, &mesh, &topology, &generate_columns](){
+				return generateRows(mesh, columns_nb, rows_nb, topology, first_row, last_row, generate_columns);
+			}));
+		}
+		auto box = tasks.front().get();
+		for (size_t i = 1u; i < tasks.size(); ++i) {
+			auto const task_box = tasks[i].get();
+			box.min = glm::min(box.min, task_box.min);
+			box.max = glm::max(box.max, task_box.max);
+		}
+		mesh.min_bounds = box.min;
+		mesh.max_bounds = box.max;
+		return mesh;
+	}
+}
+
 bonobo::mesh_data
 parametric_shapes::createQuad(unsigned int width, unsigned int height)
 {
@@ -119,423 +370,223 @@ parametric_shapes::createQuad(unsigned int width, unsigned int height)
 	return data;
 }
 
+bonobo::vertex_streams
+parametric_shapes::getStreams(cpu_mesh const& mesh)
+{
+	bonobo::vertex_streams streams;
+	streams.vertices_nb = mesh.vertices.size();
+	streams.vertices    = mesh.vertices.data();
+	streams.normals     = mesh.normals.empty() ? nullptr : mesh.normals.data();
+	streams.texcoords   = mesh.texcoords.empty() ? nullptr : mesh.texcoords.data();
+	streams.tangents    = mesh.tangents.empty() ? nullptr : mesh.tangents.data();
+	streams.binormals   = mesh.binormals.empty() ? nullptr : mesh.binormals.data();
+	return streams;
+}
+
 bonobo::mesh_data
-parametric_shapes::createQuad(unsigned int res_width, unsigned int res_depth, unsigned int width, unsigned int depth)
+parametric_shapes::upload(cpu_mesh const& mesh, bonobo::vertex_layout layout, bool build_lods)
 {
-	auto const vertices_nb = res_width * res_depth;
-
-	auto vertices = std::vector<glm::vec3>(vertices_nb);
-	auto normals = std::vector<glm::vec3>(vertices_nb);
-	auto texcoords = std::vector<glm::vec3>(vertices_nb);
-	auto tangents = std::vector<glm::vec3>(vertices_nb);
-	auto binormals = std::vector<glm::vec3>(vertices_nb);
-
-	float w = 0.0f,
-		dw = width / (static_cast<float>(res_width) - 1.0f);
-	float d = 0.0f,
-		dd = depth / (static_cast<float>(res_depth) - 1.0f);
-
-	size_t index = 0u;
-	for (unsigned int i = 0; i < res_depth; i++) {
-		w = 0.0f;
-		for (unsigned int j = 0; j < res_width; j++) {
-			// vertex
-			vertices[index] = glm::vec3(w, 0, d);
-
-			//texture coordinates
-			texcoords[index] = glm::vec3(static_cast<float>(j) / (static_cast<float>(res_width) - 1.0f),
-				static_cast<float>(i) / (static_cast<float>(res_depth) - 1.0f),
-				0.0f);
-
-			// tangent
-			auto t = glm::vec3(0.0f, 0.0f, 1.0f);
-			t = glm::normalize(t);
-			tangents[index] = t;
-
-			// binormal
-			auto b = glm::vec3(1.0f, 0.0f, 0.0f);
-			b = glm::normalize(b);
-			binormals[index] = b;
-
-			// normal
-			auto const n = glm::cross(t, b);
-			normals[index] = n;
-
-			++index;
-			w += dw;
-		}
-		d += dd;
+	if (mesh.vertices.empty())
+		return bonobo::mesh_data();
+
+	auto const streams = getStreams(mesh);
+	// Meshlets and levels of detail are built from triangle lists only.
+	if (mesh.drawing_mode != GL_TRIANGLES)
+		return bonobo::createMesh(streams, mesh.indices.data(), mesh.indices.size(), layout, mesh.drawing_mode);
+
+	auto const meshlets = bonobo::createMeshlets(streams, mesh.indices.data(), mesh.indices.size());
+	if (!build_lods) {
+		auto data = bonobo::createMesh(streams, mesh.indices.data(), mesh.indices.size(), layout);
+		data.meshlets = meshlets;
+		return data;
 	}
 
-	auto indices = std::vector<glm::uvec3>(2u * (res_width - 1u) * (res_depth - 1u));
+	// The coarser levels of detail get appended to the indices.
+	auto indices = mesh.indices;
+	auto const lods = bonobo::createLodChain(streams, indices);
 
-	index = 0u;
-	for (unsigned int i = 0u; i < res_depth - 1u; ++i) {
-		for (unsigned int j = 0u; j < res_width - 1u; ++j) {
-			indices[index] = glm::uvec3(res_width * i + j,
-				res_width * i + j + 1u,
-				res_width * i + j + 1u + res_width);
-			++index;
+	auto data = bonobo::createMesh(streams, indices.data(), indices.size(), layout);
+	data.meshlets = meshlets;
+	data.lods = lods;
+	if (lods != nullptr)
+		data.indices_nb = lods->levels.front().indices_nb;
+	return data;
+}
 
-			indices[index] = glm::uvec3(res_width * i + j,
-				res_width * i + j + res_width + 1u,
-				res_width * i + j + res_width);
-			++index;
-		}
-	}
+bonobo::mesh_data
+parametric_shapes::createQuad(unsigned int res_width, unsigned int res_depth, unsigned int width, unsigned int depth,
+                              bonobo::vertex_layout layout, GLenum drawing_mode)
+{
+	return upload(generateQuad(res_width, res_depth, width, depth, drawing_mode, &bonobo::thread_pool::shared()), layout, false);
+}
 
+bonobo::mesh_data
+parametric_shapes::createImplicitGrid(unsigned int res_width, unsigned int res_depth)
+{
 	bonobo::mesh_data data;
+	if (res_width < 2u || res_depth < 2u)
+		return data;
 
+	// Core profiles cannot draw without a Vertex Array Object, even one
+	// without any attribute enabled.
 	glGenVertexArrays(1, &data.vao);
-	assert(data.vao != 0u);
-	glBindVertexArray(data.vao);
-
-	glGenBuffers(1, &data.bo);
-	assert(data.bo != 0u);
-	glBindBuffer(GL_ARRAY_BUFFER, data.bo);
-
-	auto const vertices_offset = 0u;
-	auto const vertices_size = static_cast<GLsizeiptr>(vertices.size() * sizeof(glm::vec3));
-	auto const normals_offset = vertices_size;
-	auto const normals_size = static_cast<GLsizeiptr>(normals.size() * sizeof(glm::vec3));
-	auto const texcoords_offset = normals_offset + normals_size;
-	auto const texcoords_size = static_cast<GLsizeiptr>(texcoords.size() * sizeof(glm::vec3));
-	auto const tangents_offset = texcoords_offset + texcoords_size;
-	auto const tangents_size = static_cast<GLsizeiptr>(tangents.size() * sizeof(glm::vec3));
-	auto const binormals_offset = tangents_offset + tangents_size;
-	auto const binormals_size = static_cast<GLsizeiptr>(binormals.size() * sizeof(glm::vec3));
-	auto const bo_size = static_cast<GLsizeiptr>(vertices_size
-		+ normals_size
-		+ texcoords_size
-		+ tangents_size
-		+ binormals_size
-		);
-
-	glBufferData(GL_ARRAY_BUFFER, bo_size, nullptr, GL_STATIC_DRAW);
-
-	glBufferSubData(GL_ARRAY_BUFFER, vertices_offset, vertices_size, static_cast<GLvoid const*>(vertices.data()));
-	glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::vertices));
-	glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::vertices), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(0x0));
-
-	glBufferSubData(GL_ARRAY_BUFFER, normals_offset, normals_size, static_cast<GLvoid const*>(normals.data()));
-	glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::normals));
-	glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::normals), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(normals_offset));
-
-	glBufferSubData(GL_ARRAY_BUFFER, texcoords_offset, texcoords_size, static_cast<GLvoid const*>(texcoords.data()));
-	glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::texcoords));
-	glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::texcoords), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(texcoords_offset));
-
-	glBufferSubData(GL_ARRAY_BUFFER, tangents_offset, tangents_size, static_cast<GLvoid const*>(tangents.data()));
-	glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::tangents));
-	glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::tangents), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(tangents_offset));
-
-	glBufferSubData(GL_ARRAY_BUFFER, binormals_offset, binormals_size, static_cast<GLvoid const*>(binormals.data()));
-	glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::binormals));
-	glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::binormals), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(binormals_offset));
-
-	glBindBuffer(GL_ARRAY_BUFFER, 0u);
-
-	data.indices_nb = indices.size() * 3u;
-	glGenBuffers(1, &data.ibo);
-	assert(data.ibo != 0u);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, data.ibo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(indices.size() * sizeof(glm::uvec3)), reinterpret_cast<GLvoid const*>(indices.data()), GL_STATIC_DRAW);
-
-	glBindVertexArray(0u);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0u);
 
+	// Each row of cells is a strip zigzagging between its two rows of
+	// vertices.
+	data.drawing_mode = GL_TRIANGLE_STRIP;
+	data.vertices_nb = 2u * res_width;
+	data.instances_nb = res_depth - 1u;
 	return data;
 }
 
+void
+parametric_shapes::setImplicitGridUniforms(GLuint program, unsigned int res_width, unsigned int res_depth, unsigned int width, unsigned int depth)
+{
+	glUniform1i(glGetUniformLocation(program, "use_implicit_grid"), 1);
+	glUniform2i(glGetUniformLocation(program, "grid_resolution"), static_cast<GLint>(res_width), static_cast<GLint>(res_depth));
+	glUniform2f(glGetUniformLocation(program, "grid_size"), static_cast<float>(width), static_cast<float>(depth));
+}
+
 bonobo::mesh_data
 parametric_shapes::createSphere(unsigned int const res_theta,
-                                unsigned int const res_phi, float const radius)
+                                unsigned int const res_phi, float const radius,
+                                bonobo::vertex_layout layout, GLenum drawing_mode)
 {
-
-	//! \todo (Optional) Implement this function
-	auto const vertices_nb = res_theta * res_phi;
-	
-	auto vertices  = std::vector<glm::vec3>(vertices_nb);
-	auto normals   = std::vector<glm::vec3>(vertices_nb);
-	auto texcoords = std::vector<glm::vec3>(vertices_nb);
-	auto tangents  = std::vector<glm::vec3>(vertices_nb);
-	auto binormals = std::vector<glm::vec3>(vertices_nb);
-	
-	float theta = 0.0f,                                                  // 'stepping'-variable for theta: will go 0 - 2PI
-	dtheta = 2.0f * bonobo::pi / (static_cast<float>(res_theta) - 1.0f); // step size, depending on the resolution
-	
-	// Added phi!
-	float phi = 0.0f,                                                    // 'stepping'-variable for phi: will go 0 - PI
-	dphi = bonobo::pi / (static_cast<float>(res_phi) - 1.0f);            // step size, depending on the resolution
-	
-	// generate vertices iteratively
-	size_t index = 0u;
-    for (unsigned int i = 0u; i < res_phi; ++i) {
-        float cos_phi = std::cos(phi),
-        sin_phi = std::sin(phi);
-		theta = 0.0f;
-
-        for (unsigned int j = 0u; j < res_theta; ++j) {
-            float cos_theta = std::cos(theta),
-            sin_theta = std::sin(theta);
-
-			// vertex
-			vertices[index] = glm::vec3(radius * sin_theta * sin_phi,
-										- radius * cos_phi,
-										radius * cos_theta * sin_phi);
-            
-			// texture coordinates
-			texcoords[index] = glm::vec3(static_cast<float>(j) / (static_cast<float>(res_theta) - 1.0f),
-										 static_cast<float>(i) / (static_cast<float>(res_phi)  - 1.0f),
-										 0.0f);
-
-			// tangent
-			auto t = glm::vec3(radius * cos_theta, 0, - radius * sin_theta);
-			t = glm::normalize(t);
-			tangents[index] = t;
-
-			// binormal
-			auto b = glm::vec3(radius * sin_theta * cos_phi, radius * sin_phi, radius * cos_theta * cos_phi);
-			b = glm::normalize(b);
-			binormals[index] = b;
-			
-			// normal
-			auto const n = glm::cross(t, b);
-			normals[index] = glm::normalize(n);
-			
-            theta += dtheta;
-			++index;
-		}
-
-        phi += dphi;
-	}
-	
-	// create index array
-	auto indices = std::vector<glm::uvec3>(2u * (res_theta - 1u) * (res_phi - 1u));
-	
-	// generate indices iteratively
-	index = 0u;
-    for (unsigned int i = 0u; i < res_phi - 1u; ++i) {
-        for (unsigned int j = 0u; j < res_theta - 1u; ++j) {
-			indices[index] = glm::uvec3(res_theta * i + j + res_theta,
-										res_theta * i + j + 1u,
-										res_theta * i + j);
-			++index;
-
-			indices[index] = glm::uvec3(res_theta * i + j + 1u,
-										res_theta * i + j + res_theta,
-										res_theta * i + j + 1u + res_theta);
-			++index;
-		}
-	}
-	
-	bonobo::mesh_data data;
-	glGenVertexArrays(1, &data.vao);
-	assert(data.vao != 0u);
-	glBindVertexArray(data.vao);
-	
-	auto const vertices_offset = 0u;
-	auto const vertices_size = static_cast<GLsizeiptr>(vertices.size() * sizeof(glm::vec3));
-	auto const normals_offset = vertices_size;
-	auto const normals_size = static_cast<GLsizeiptr>(normals.size() * sizeof(glm::vec3));
-	auto const texcoords_offset = normals_offset + normals_size;
-	auto const texcoords_size = static_cast<GLsizeiptr>(texcoords.size() * sizeof(glm::vec3));
-	auto const tangents_offset = texcoords_offset + texcoords_size;
-	auto const tangents_size = static_cast<GLsizeiptr>(tangents.size() * sizeof(glm::vec3));
-	auto const binormals_offset = tangents_offset + tangents_size;
-	auto const binormals_size = static_cast<GLsizeiptr>(binormals.size() * sizeof(glm::vec3));
-	auto const bo_size = static_cast<GLsizeiptr>(vertices_size
-												 +normals_size
-												 +texcoords_size
-												 +tangents_size
-												 +binormals_size
-												 );
-	glGenBuffers(1, &data.bo);
-	assert(data.bo != 0u);
-	glBindBuffer(GL_ARRAY_BUFFER, data.bo);
-	glBufferData(GL_ARRAY_BUFFER, bo_size, nullptr, GL_STATIC_DRAW);
-	
-	glBufferSubData(GL_ARRAY_BUFFER, vertices_offset, vertices_size, static_cast<GLvoid const*>(vertices.data()));
-	glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::vertices));
-	glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::vertices), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(0x0));
-	
-	glBufferSubData(GL_ARRAY_BUFFER, normals_offset, normals_size, static_cast<GLvoid const*>(normals.data()));
-	glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::normals));
-	glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::normals), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(normals_offset));
-	
-	glBufferSubData(GL_ARRAY_BUFFER, texcoords_offset, texcoords_size, static_cast<GLvoid const*>(texcoords.data()));
-	glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::texcoords));
-	glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::texcoords), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(texcoords_offset));
-	
-	glBufferSubData(GL_ARRAY_BUFFER, tangents_offset, tangents_size, static_cast<GLvoid const*>(tangents.data()));
-	glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::tangents));
-	glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::tangents), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(tangents_offset));
-	
-	glBufferSubData(GL_ARRAY_BUFFER, binormals_offset, binormals_size, static_cast<GLvoid const*>(binormals.data()));
-	glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::binormals));
-	glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::binormals), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(binormals_offset));
-	
-	glBindBuffer(GL_ARRAY_BUFFER, 0u);
-	
-	data.indices_nb = indices.size() * 3u;
-	glGenBuffers(1, &data.ibo);
-	assert(data.ibo != 0u);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, data.ibo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(indices.size() * sizeof(glm::uvec3)), reinterpret_cast<GLvoid const*>(indices.data()), GL_STATIC_DRAW);
-	
-	glBindVertexArray(0u);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0u);
-	
-	return data;
-	/*return bonobo::mesh_data();*/
+	return upload(generateSphere(res_theta, res_phi, radius, drawing_mode, &bonobo::thread_pool::shared()), layout);
 }
 
 bonobo::mesh_data
 parametric_shapes::createTorus(unsigned int const res_theta,
                                unsigned int const res_phi, float const rA,
-                               float const rB)
+                               float const rB,
+                               bonobo::vertex_layout layout, GLenum drawing_mode)
 {
-	//! \todo (Optional) Implement this function
-	return bonobo::mesh_data();
+	return upload(generateTorus(res_theta, res_phi, rA, rB, drawing_mode, &bonobo::thread_pool::shared()), layout);
 }
 
 bonobo::mesh_data
 parametric_shapes::createCircleRing(unsigned int const res_radius,
                                     unsigned int const res_theta,
                                     float const inner_radius,
-                                    float const outer_radius)
+                                    float const outer_radius,
+                                    bonobo::vertex_layout layout, GLenum drawing_mode)
 {
-	auto const vertices_nb = res_radius * res_theta;
-
-	auto vertices  = std::vector<glm::vec3>(vertices_nb);
-	auto normals   = std::vector<glm::vec3>(vertices_nb);
-	auto texcoords = std::vector<glm::vec3>(vertices_nb);
-	auto tangents  = std::vector<glm::vec3>(vertices_nb);
-	auto binormals = std::vector<glm::vec3>(vertices_nb);
-
-	float theta = 0.0f,                                                        // 'stepping'-variable for theta: will go 0 - 2PI
-	      dtheta = 2.0f * bonobo::pi / (static_cast<float>(res_theta) - 1.0f); // step size, depending on the resolution
-
-	float radius = 0.0f,                                                                     // 'stepping'-variable for radius: will go inner_radius - outer_radius
-	      dradius = (outer_radius - inner_radius) / (static_cast<float>(res_radius) - 1.0f); // step size, depending on the resolution
-
-	// generate vertices iteratively
-	size_t index = 0u;
-	for (unsigned int i = 0u; i < res_theta; ++i) {
-		float cos_theta = std::cos(theta),
-		      sin_theta = std::sin(theta);
-
-		radius = inner_radius;
-
-		for (unsigned int j = 0u; j < res_radius; ++j) {
-			// vertex
-			vertices[index] = glm::vec3(radius * cos_theta,
-			                            radius * sin_theta,
-			                            0.0f);
-
-			// texture coordinates
-			texcoords[index] = glm::vec3(static_cast<float>(j) / (static_cast<float>(res_radius) - 1.0f),
-			                             static_cast<float>(i) / (static_cast<float>(res_theta)  - 1.0f),
-			                             0.0f);
-
-			// tangent
-			auto t = glm::vec3(cos_theta, sin_theta, 0.0f);
-			t = glm::normalize(t);
-			tangents[index] = t;
-
-			// binormal
-			auto b = glm::vec3(-sin_theta, cos_theta, 0.0f);
-			b = glm::normalize(b);
-			binormals[index] = b;
-
-			// normal
-			auto const n = glm::cross(t, b);
-			normals[index] = n;
-
-			radius += dradius;
-			++index;
-		}
-
-		theta += dtheta;
-	}
-
-	// create index array
-	auto indices = std::vector<glm::uvec3>(2u * (res_theta - 1u) * (res_radius - 1u));
-
-	// generate indices iteratively
-	index = 0u;
-	for (unsigned int i = 0u; i < res_theta - 1u; ++i)
-	{
-		for (unsigned int j = 0u; j < res_radius - 1u; ++j)
-		{
-			indices[index] = glm::uvec3(res_radius * i + j,
-			                            res_radius * i + j + 1u,
-			                            res_radius * i + j + 1u + res_radius);
-			++index;
-
-			indices[index] = glm::uvec3(res_radius * i + j,
-			                            res_radius * i + j + res_radius + 1u,
-										res_radius * i + j + res_radius);
-			++index;
-		}
-	}
-
-	bonobo::mesh_data data;
-	glGenVertexArrays(1, &data.vao);
-	assert(data.vao != 0u);
-	glBindVertexArray(data.vao);
-
-	auto const vertices_offset = 0u;
-	auto const vertices_size = static_cast<GLsizeiptr>(vertices.size() * sizeof(glm::vec3));
-	auto const normals_offset = vertices_size;
-	auto const normals_size = static_cast<GLsizeiptr>(normals.size() * sizeof(glm::vec3));
-	auto const texcoords_offset = normals_offset + normals_size;
-	auto const texcoords_size = static_cast<GLsizeiptr>(texcoords.size() * sizeof(glm::vec3));
-	auto const tangents_offset = texcoords_offset + texcoords_size;
-	auto const tangents_size = static_cast<GLsizeiptr>(tangents.size() * sizeof(glm::vec3));
-	auto const binormals_offset = tangents_offset + tangents_size;
-	auto const binormals_size = static_cast<GLsizeiptr>(binormals.size() * sizeof(glm::vec3));
-	auto const bo_size = static_cast<GLsizeiptr>(vertices_size
-	                                            +normals_size
-	                                            +texcoords_size
-	                                            +tangents_size
-	                                            +binormals_size
-	                                            );
-	glGenBuffers(1, &data.bo);
-	assert(data.bo != 0u);
-	glBindBuffer(GL_ARRAY_BUFFER, data.bo);
-	glBufferData(GL_ARRAY_BUFFER, bo_size, nullptr, GL_STATIC_DRAW);
-
-	glBufferSubData(GL_ARRAY_BUFFER, vertices_offset, vertices_size, static_cast<GLvoid const*>(vertices.data()));
-	glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::vertices));
-	glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::vertices), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(0x0));
-
-	glBufferSubData(GL_ARRAY_BUFFER, normals_offset, normals_size, static_cast<GLvoid const*>(normals.data()));
-	glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::normals));
-	glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::normals), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(normals_offset));
-
-	glBufferSubData(GL_ARRAY_BUFFER, texcoords_offset, texcoords_size, static_cast<GLvoid const*>(texcoords.data()));
-	glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::texcoords));
-	glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::texcoords), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(texcoords_offset));
-
-	glBufferSubData(GL_ARRAY_BUFFER, tangents_offset, tangents_size, static_cast<GLvoid const*>(tangents.data()));
-	glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::tangents));
-	glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::tangents), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(tangents_offset));
-
-	glBufferSubData(GL_ARRAY_BUFFER, binormals_offset, binormals_size, static_cast<GLvoid const*>(binormals.data()));
-	glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::binormals));
-	glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::binormals), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(binormals_offset));
+	return upload(generateCircleRing(res_radius, res_theta, inner_radius, outer_radius, drawing_mode, &bonobo::thread_pool::shared()), layout);
+}
 
-	glBindBuffer(GL_ARRAY_BUFFER, 0u);
+parametric_shapes::cpu_mesh
+parametric_shapes::generateQuad(unsigned int res_width, unsigned int res_depth, unsigned int width, unsigned int depth,
+                                GLenum drawing_mode, bonobo::thread_pool* pool)
+{
+	auto const xs = computeSteps(res_width, 0.0f, width / (static_cast<float>(res_width) - 1.0f));
+	auto const zs = computeSteps(res_depth, 0.0f, depth / (static_cast<float>(res_depth) - 1.0f));
+	auto const us = computeTexcoords(res_width);
+	auto const vs = computeTexcoords(res_depth);
+
+	return generateGrid(res_width, res_depth, getTopology(res_width, drawing_mode), pool,
+	                    [&](cpu_mesh& mesh, unsigned int i, unsigned int j, size_t count, size_t index) {
+		auto const zero = splat4(0.0f), one = splat4(1.0f);
+
+		store(&mesh.vertices[index],  count, load4(&xs[j]), zero, splat4(zs[i]));
+		store(&mesh.texcoords[index], count, load4(&us[j]), splat4(vs[i]), zero);
+		store(&mesh.tangents[index],  count, zero, zero, one);
+		store(&mesh.binormals[index], count, one, zero, zero);
+		// cross(tangent, binormal)
+		store(&mesh.normals[index],   count, zero, one, zero);
+	});
+}
 
-	data.indices_nb = indices.size() * 3u;
-	glGenBuffers(1, &data.ibo);
-	assert(data.ibo != 0u);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, data.ibo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(indices.size() * sizeof(glm::uvec3)), reinterpret_cast<GLvoid const*>(indices.data()), GL_STATIC_DRAW);
+parametric_shapes::cpu_mesh
+parametric_shapes::generateSphere(unsigned int const res_theta,
+                                  unsigned int const res_phi, float const radius,
+                                  GLenum drawing_mode, bonobo::thread_pool* pool)
+{
+	// Theta goes 0 - 2PI along the columns, phi 0 - PI along the rows.
+	auto const thetas = computeAngles(res_theta, 2.0f * bonobo::pi / (static_cast<float>(res_theta) - 1.0f));
+	auto const phis = computeAngles(res_phi, bonobo::pi / (static_cast<float>(res_phi) - 1.0f));
+	auto const us = computeTexcoords(res_theta);
+	auto const vs = computeTexcoords(res_phi);
+
+	// Normalising the tangent and binormal only leaves the sign of the
+	// radius.
+	auto const sign = radius < 0.0f ? -1.0f : 1.0f;
+
+	return generateGrid(res_theta, res_phi, getFlippedTopology(res_theta, drawing_mode), pool,
+	                    [&](cpu_mesh& mesh, unsigned int i, unsigned int j, size_t count, size_t index) {
+		auto const cos_theta = load4(&thetas.cos[j]), sin_theta = load4(&thetas.sin[j]);
+		auto const cos_phi = splat4(phis.cos[i]), sin_phi = splat4(phis.sin[i]);
+		auto const r = splat4(radius), s = splat4(sign), zero = splat4(0.0f);
+
+		// The normal, i.e. cross(tangent, binormal), is the direction of
+		// the vertex from the centre.
+		auto const nx = sin_theta * sin_phi, ny = -cos_phi, nz = cos_theta * sin_phi;
+
+		store(&mesh.vertices[index],  count, r * nx, r * ny, r * nz);
+		store(&mesh.texcoords[index], count, load4(&us[j]), splat4(vs[i]), zero);
+		store(&mesh.tangents[index],  count, s * cos_theta, zero, -(s * sin_theta));
+		store(&mesh.binormals[index], count, s * sin_theta * cos_phi, s * sin_phi, s * cos_theta * cos_phi);
+		store(&mesh.normals[index],   count, nx, ny, nz);
+	});
+}
 
-	glBindVertexArray(0u);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0u);
+parametric_shapes::cpu_mesh
+parametric_shapes::generateTorus(unsigned int const res_theta,
+                                 unsigned int const res_phi, float const rA,
+                                 float const rB,
+                                 GLenum drawing_mode, bonobo::thread_pool* pool)
+{
+	// The tube is centred between both borders.
+	float const radius = (rA + rB) / 2.0f,      // distance from the centre of the torus to the centre of the tube
+	            tube_radius = (rB - rA) / 2.0f; // radius of the tube
+
+	// Theta goes 0 - 2PI around the tube, along the columns; phi 0 - 2PI
+	// around the torus, along the rows.
+	auto const thetas = computeAngles(res_theta, 2.0f * bonobo::pi / (static_cast<float>(res_theta) - 1.0f));
+	auto const phis = computeAngles(res_phi, 2.0f * bonobo::pi / (static_cast<float>(res_phi) - 1.0f));
+	auto const us = computeTexcoords(res_theta);
+	auto const vs = computeTexcoords(res_phi);
+
+	return generateGrid(res_theta, res_phi, getTopology(res_theta, drawing_mode), pool,
+	                    [&](cpu_mesh& mesh, unsigned int i, unsigned int j, size_t count, size_t index) {
+		auto const cos_theta = load4(&thetas.cos[j]), sin_theta = load4(&thetas.sin[j]);
+		auto const cos_phi = splat4(phis.cos[i]), sin_phi = splat4(phis.sin[i]);
+		auto const zero = splat4(0.0f);
+
+		auto const ring = splat4(radius) + splat4(tube_radius) * cos_theta;
+
+		store(&mesh.vertices[index],  count, ring * cos_phi, splat4(tube_radius) * sin_theta, ring * sin_phi);
+		store(&mesh.texcoords[index], count, load4(&us[j]), splat4(vs[i]), zero);
+		store(&mesh.tangents[index],  count, -(sin_theta * cos_phi), cos_theta, -(sin_theta * sin_phi));
+		store(&mesh.binormals[index], count, -sin_phi, zero, cos_phi);
+		// cross(tangent, binormal), already of unit length
+		store(&mesh.normals[index],   count, cos_theta * cos_phi, sin_theta, cos_theta * sin_phi);
+	});
+}
 
-	return data;
+parametric_shapes::cpu_mesh
+parametric_shapes::generateCircleRing(unsigned int const res_radius,
+                                      unsigned int const res_theta,
+                                      float const inner_radius,
+                                      float const outer_radius,
+                                      GLenum drawing_mode, bonobo::thread_pool* pool)
+{
+	// The radius goes inner_radius - outer_radius along the columns, theta
+	// 0 - 2PI along the rows.
+	auto const radii = computeSteps(res_radius, inner_radius, (outer_radius - inner_radius) / (static_cast<float>(res_radius) - 1.0f));
+	auto const thetas = computeAngles(res_theta, 2.0f * bonobo::pi / (static_cast<float>(res_theta) - 1.0f));
+	auto const us = computeTexcoords(res_radius);
+	auto const vs = computeTexcoords(res_theta);
+
+	return generateGrid(res_radius, res_theta, getTopology(res_radius, drawing_mode), pool,
+	                    [&](cpu_mesh& mesh, unsigned int i, unsigned int j, size_t count, size_t index) {
+		auto const cos_theta = splat4(thetas.cos[i]), sin_theta = splat4(thetas.sin[i]);
+		auto const r = load4(&radii[j]), zero = splat4(0.0f);
+
+		store(&mesh.vertices[index],  count, r * cos_theta, r * sin_theta, zero);
+		store(&mesh.texcoords[index], count, load4(&us[j]), splat4(vs[i]), zero);
+		store(&mesh.tangents[index],  count, cos_theta, sin_theta, zero);
+		store(&mesh.binormals[index], count, -sin_theta, cos_theta, zero);
+		// cross(tangent, binormal)
+		store(&mesh.normals[index],   count, zero, zero, splat4(1.0f));
+	});
 }
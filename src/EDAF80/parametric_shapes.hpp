@@ -2,8 +2,106 @@
 
 #include "core/helpers.hpp"
 
+#include <glm/glm.hpp>
+
+#include <vector>
+
+namespace bonobo
+{
+	class thread_pool;
+}
+
 namespace parametric_shapes
 {
+	//! \brief A triangle mesh as generated on the CPU, before it gets
+	//!        uploaded to OpenGL.
+	//!
+	//! All attribute streams have one element per vertex, and texcoords
+	//! use the first two components only. Indices form either a triangle
+	//! list, or triangle strips separated by
+	//! `bonobo::primitive_restart_index`.
+	struct cpu_mesh {
+		std::vector<glm::vec3> vertices;
+		std::vector<glm::vec3> normals;
+		std::vector<glm::vec3> texcoords;
+		std::vector<glm::vec3> tangents;
+		std::vector<glm::vec3> binormals;
+		std::vector<GLuint> indices;
+		GLenum drawing_mode;  //!< GL_TRIANGLES or GL_TRIANGLE_STRIP
+		glm::vec3 min_bounds; //!< corner of the axis-aligned bounding box of the vertices
+		glm::vec3 max_bounds; //!< opposite corner of the same box
+
+		cpu_mesh() : vertices(), normals(), texcoords(), tangents(), binormals(), indices(), drawing_mode(GL_TRIANGLES), min_bounds(0.0f), max_bounds(0.0f)
+		{
+		}
+	};
+
+	//! \brief Get a view over the attribute streams of a mesh, valid for
+	//!        as long as the mesh is neither modified nor destroyed.
+	bonobo::vertex_streams getStreams(cpu_mesh const& mesh);
+
+	//! \brief Make a generated mesh available to OpenGL, along with its
+	//!        meshlets, and optionally its levels of detail.
+	//!
+	//! Meshes made of strips get neither meshlets nor levels of detail,
+	//! as both are built from triangle lists.
+	//!
+	//! Must be called from the thread owning the OpenGL context, unlike
+	//! the `generate*()` functions.
+	//!
+	//! @param [in] mesh a mesh generated by one of the `generate*()`
+	//!             functions
+	//! @param [in] layout how to lay out the vertex attributes in the
+	//!             buffer object
+	//! @param [in] build_lods whether to simplify the mesh into levels of
+	//!             detail, appended to its indices
+	//! @return wrapper around OpenGL objects' name containing the geometry
+	//!         data
+	bonobo::mesh_data upload(cpu_mesh const& mesh, bonobo::vertex_layout layout = bonobo::vertex_layout::planar,
+	                         bool build_lods = true);
+
+	//! \brief Generate a quad with specified resolution, lying in the XZ
+	//!        plane, without requiring an OpenGL context.
+	//!
+	//! Like all `generate*()` functions, the trigonometry is computed
+	//! once per row and column rather than per vertex, vertices are
+	//! computed four at a time with SIMD when available, and rows can be
+	//! spread over a thread pool. Resolutions below 2 in either direction
+	//! make for an empty mesh, which `upload()` turns into an empty
+	//! `mesh_data`.
+	//!
+	//! @param [in] drawing_mode GL_TRIANGLES for a list of two triangles
+	//!             per grid cell, or GL_TRIANGLE_STRIP for one strip per
+	//!             row of cells, using about a third of the indices
+	//! @param [in] pool if not nullptr, large meshes get their rows
+	//!             generated in parallel by its workers; must not be
+	//!             called from one of those workers
+	//!
+	//! See `createQuad()` for the other parameters.
+	cpu_mesh generateQuad(unsigned int res_width, unsigned int res_depth, unsigned int width, unsigned int depth,
+	                      GLenum drawing_mode = GL_TRIANGLES, bonobo::thread_pool* pool = nullptr);
+
+	//! \brief Generate a sphere without requiring an OpenGL context.
+	//!
+	//! See `generateQuad()` for `drawing_mode` and `pool`, and
+	//! `createSphere()` for the other parameters.
+	cpu_mesh generateSphere(unsigned int const res_theta, unsigned int const res_phi, float const radius,
+	                        GLenum drawing_mode = GL_TRIANGLES, bonobo::thread_pool* pool = nullptr);
+
+	//! \brief Generate a torus without requiring an OpenGL context.
+	//!
+	//! See `generateQuad()` for `drawing_mode` and `pool`, and
+	//! `createTorus()` for the other parameters.
+	cpu_mesh generateTorus(unsigned int const res_theta, unsigned int const res_phi, float const rA, float const rB,
+	                       GLenum drawing_mode = GL_TRIANGLES, bonobo::thread_pool* pool = nullptr);
+
+	//! \brief Generate a circle ring without requiring an OpenGL context.
+	//!
+	//! See `generateQuad()` for `drawing_mode` and `pool`, and
+	//! `createCircleRing()` for the other parameters.
+	cpu_mesh generateCircleRing(unsigned int const radius_res, unsigned int const theta_res, float const inner_radius, float const outer_radius,
+	                            GLenum drawing_mode = GL_TRIANGLES, bonobo::thread_pool* pool = nullptr);
+
 	//! \brief Create a quad consisting of two triangles and make it
 	//!        available to OpenGL.
 	//!
@@ -19,9 +117,40 @@ namespace parametric_shapes
 	//! @param res_depth the resolution of the depth
 	//! @param width the width of the quad
 	//! @param depth the depth of the quad
+	//! @param layout how to lay out the vertex attributes in the buffer
+	//!        object
+	//! @param drawing_mode GL_TRIANGLES, or GL_TRIANGLE_STRIP for strips
+	//!        separated by primitive restarts, see `generateQuad()`
 	//! @return wrapper around OpenGL objects' name containing the geometry
 	//!         data
-	bonobo::mesh_data createQuad(unsigned int res_width, unsigned int res_depth, unsigned int width, unsigned int depth);
+	bonobo::mesh_data createQuad(unsigned int res_width, unsigned int res_depth, unsigned int width, unsigned int depth,
+	                             bonobo::vertex_layout layout = bonobo::vertex_layout::planar,
+	                             GLenum drawing_mode = GL_TRIANGLES);
+
+	//! \brief Create a flat grid, as `createQuad()` with a resolution, but
+	//!        without any vertex nor index buffer.
+	//!
+	//! The grid is drawn as one triangle strip per row of cells, through
+	//! instancing; the vertex shader computes positions and texture
+	//! coordinates from `gl_VertexID` and `gl_InstanceID`, given the
+	//! uniforms set by `setImplicitGridUniforms()`. Normals, tangents and
+	//! binormals are left to the shader, e.g. `water.vert` derives them
+	//! from its waves.
+	//!
+	//! @param res_width the resolution of the width
+	//! @param res_depth the resolution of the depth
+	//! @return wrapper around an empty Vertex Array Object, and the
+	//!         counts to draw
+	bonobo::mesh_data createImplicitGrid(unsigned int res_width, unsigned int res_depth);
+
+	//! \brief Set the uniforms describing an implicit grid, created by
+	//!        `createImplicitGrid()`, in the current program.
+	//!
+	//! @param program the program the grid is drawn with
+	//! @param res_width, res_depth as given to `createImplicitGrid()`
+	//! @param width the width of the grid
+	//! @param depth the depth of the grid
+	void setImplicitGridUniforms(GLuint program, unsigned int res_width, unsigned int res_depth, unsigned int width, unsigned int depth);
 
 	//! \brief Create a sphere for some tesselation level and make it
 	//!        available to OpenGL.
@@ -29,9 +158,15 @@ namespace parametric_shapes
 	//! @param res_theta tessellation resolution (nbr of vertices) in the latitude direction ( 0 < theta < PI/2 )
 	//! @param res_phi tessellation resolution (nbr of vertices) in the longitude direction ( 0 < phi < 2PI )
 	//! @param radius radius of the sphere
+	//! @param layout how to lay out the vertex attributes in the buffer
+	//!        object
+	//! @param drawing_mode GL_TRIANGLES, or GL_TRIANGLE_STRIP for strips
+	//!        separated by primitive restarts, see `generateQuad()`
 	//! @return wrapper around OpenGL objects' name containing the geometry
 	//!         data
-	bonobo::mesh_data createSphere(unsigned int const res_theta, unsigned int const res_phi, float const radius);
+	bonobo::mesh_data createSphere(unsigned int const res_theta, unsigned int const res_phi, float const radius,
+	                               bonobo::vertex_layout layout = bonobo::vertex_layout::planar,
+	                               GLenum drawing_mode = GL_TRIANGLES);
 
 	//! \brief Create a torus for some tesselation level and make it
 	//!        available to OpenGL.
@@ -40,9 +175,15 @@ namespace parametric_shapes
 	//! @param res_phi tessellation resolution (nbr of vertices) in the longitude direction ( 0 < phi < 2PI )
 	//! @param rA radius of the innermost border of the torus
 	//! @param rB radius of the outermost border of the torus
+	//! @param layout how to lay out the vertex attributes in the buffer
+	//!        object
+	//! @param drawing_mode GL_TRIANGLES, or GL_TRIANGLE_STRIP for strips
+	//!        separated by primitive restarts, see `generateQuad()`
 	//! @return wrapper around OpenGL objects' name containing the geometry
 	//!         data
-	bonobo::mesh_data createTorus(unsigned int const res_theta, unsigned int const res_phi, float const rA, float const rB);
+	bonobo::mesh_data createTorus(unsigned int const res_theta, unsigned int const res_phi, float const rA, float const rB,
+	                              bonobo::vertex_layout layout = bonobo::vertex_layout::planar,
+	                              GLenum drawing_mode = GL_TRIANGLES);
 
 	//! \brief Create a circle ring for some tesselation level and make it
 	//!        available to OpenGL.
@@ -51,7 +192,13 @@ namespace parametric_shapes
 	//! @param theta_res tessellation resolution (nbr of vertices) in the angular direction ( 0 < theta < 2PI )
 	//! @param inner_radius radius of the innermost border of the ring
 	//! @param outer_radius radius of the outermost border of the ring
+	//! @param layout how to lay out the vertex attributes in the buffer
+	//!        object
+	//! @param drawing_mode GL_TRIANGLES, or GL_TRIANGLE_STRIP for strips
+	//!        separated by primitive restarts, see `generateQuad()`
 	//! @return wrapper around OpenGL objects' name containing the geometry
 	//!         data
-	bonobo::mesh_data createCircleRing(unsigned int const radius_res, unsigned int const theta_res, float const inner_radius, float const outer_radius);
+	bonobo::mesh_data createCircleRing(unsigned int const radius_res, unsigned int const theta_res, float const inner_radius, float const outer_radius,
+	                                   bonobo::vertex_layout layout = bonobo::vertex_layout::planar,
+	                                   GLenum drawing_mode = GL_TRIANGLES);
 }
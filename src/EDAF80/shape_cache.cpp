@@ -0,0 +1,148 @@
+#include "shape_cache.hpp"
+#include "parametric_shapes.hpp"
+
+#include "core/Log.h"
+#include "core/resource_registry.hpp"
+
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+namespace
+{
+	struct entry {
+		std::weak_ptr<bonobo::mesh_data const> mesh;
+		u64 bytes;
+	};
+
+	struct cache {
+		std::unordered_map<std::string, entry> entries;
+		shape_cache::statistics stats = {};
+	};
+
+	// Meshes are created and deleted on the thread owning the GL context
+	// only, so the cache does not need any locking.
+	cache& get()
+	{
+		static cache instance;
+		return instance;
+	}
+
+	//! \brief Build the key identifying a shape; floats are printed with
+	//!        enough digits to tell any two of them apart.
+	std::string makeKey(char const* kind, unsigned int a, unsigned int b, float c, float d, bonobo::vertex_layout layout, GLenum drawing_mode)
+	{
+		char key[128];
+		std::snprintf(key, sizeof(key), "%s:%u:%u:%.9g:%.9g:%u:%u", kind, a, b, c, d, static_cast<unsigned int>(layout),
+		              static_cast<unsigned int>(drawing_mode));
+		return key;
+	}
+
+	u64 getBufferSize(GLuint buffer)
+	{
+		if (buffer == 0u)
+			return 0u;
+		GLint size = 0;
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		glGetBufferParameteriv(GL_ARRAY_BUFFER, GL_BUFFER_SIZE, &size);
+		glBindBuffer(GL_ARRAY_BUFFER, 0u);
+		return static_cast<u64>(size);
+	}
+
+	void destroy(std::string const& key, bonobo::mesh_data const* mesh)
+	{
+		auto& c = get();
+		auto const it = c.entries.find(key);
+		if (it != c.entries.end() && it->second.mesh.expired()) {
+			c.stats.resident_bytes -= it->second.bytes;
+			--c.stats.meshes_nb;
+			c.entries.erase(it);
+		}
+
+		bonobo::resource_registry::untrack(bonobo::resource_registry::kind::buffer, mesh->bo);
+		bonobo::resource_registry::untrack(bonobo::resource_registry::kind::buffer, mesh->ibo);
+		glDeleteBuffers(1, &mesh->bo);
+		glDeleteBuffers(1, &mesh->ibo);
+		glDeleteVertexArrays(1, &mesh->vao);
+		delete mesh;
+	}
+
+	shape_cache::shared_mesh acquire(std::string const& key, std::function<bonobo::mesh_data ()> const& create)
+	{
+		auto& c = get();
+		auto const it = c.entries.find(key);
+		if (it != c.entries.end()) {
+			if (auto mesh = it->second.mesh.lock()) {
+				++c.stats.hits;
+				c.stats.saved_bytes += it->second.bytes;
+				return mesh;
+			}
+		}
+
+		++c.stats.misses;
+		auto data = create();
+		if (data.vao == 0u)
+			return nullptr;
+
+		auto const bytes = getBufferSize(data.bo) + getBufferSize(data.ibo);
+		auto mesh = shape_cache::shared_mesh(new bonobo::mesh_data(std::move(data)),
+		                                     [key](bonobo::mesh_data const* mesh){ destroy(key, mesh); });
+		c.entries[key] = entry{ mesh, bytes };
+		++c.stats.meshes_nb;
+		c.stats.resident_bytes += bytes;
+		return mesh;
+	}
+}
+
+shape_cache::shared_mesh
+shape_cache::getQuad(unsigned int res_width, unsigned int res_depth, unsigned int width, unsigned int depth,
+                     bonobo::vertex_layout layout, GLenum drawing_mode)
+{
+	return acquire(makeKey("quad", res_width, res_depth, static_cast<float>(width), static_cast<float>(depth), layout, drawing_mode), [=](){
+		return parametric_shapes::createQuad(res_width, res_depth, width, depth, layout, drawing_mode);
+	});
+}
+
+shape_cache::shared_mesh
+shape_cache::getSphere(unsigned int const res_theta, unsigned int const res_phi, float const radius,
+                       bonobo::vertex_layout layout, GLenum drawing_mode)
+{
+	return acquire(makeKey("sphere", res_theta, res_phi, radius, 0.0f, layout, drawing_mode), [=](){
+		return parametric_shapes::createSphere(res_theta, res_phi, radius, layout, drawing_mode);
+	});
+}
+
+shape_cache::shared_mesh
+shape_cache::getTorus(unsigned int const res_theta, unsigned int const res_phi, float const rA, float const rB,
+                      bonobo::vertex_layout layout, GLenum drawing_mode)
+{
+	return acquire(makeKey("torus", res_theta, res_phi, rA, rB, layout, drawing_mode), [=](){
+		return parametric_shapes::createTorus(res_theta, res_phi, rA, rB, layout, drawing_mode);
+	});
+}
+
+shape_cache::shared_mesh
+shape_cache::getCircleRing(unsigned int const radius_res, unsigned int const theta_res, float const inner_radius, float const outer_radius,
+                           bonobo::vertex_layout layout, GLenum drawing_mode)
+{
+	return acquire(makeKey("circle_ring", radius_res, theta_res, inner_radius, outer_radius, layout, drawing_mode), [=](){
+		return parametric_shapes::createCircleRing(radius_res, theta_res, inner_radius, outer_radius, layout, drawing_mode);
+	});
+}
+
+shape_cache::statistics
+shape_cache::getStatistics()
+{
+	return get().stats;
+}
+
+void
+shape_cache::logStatistics()
+{
+	auto const stats = getStatistics();
+	LogInfo("Shape cache: %u meshes using %.2f MiB, %u hits, %u misses, %.2f MiB saved",
+	        static_cast<unsigned int>(stats.meshes_nb), stats.resident_bytes / (1024.0 * 1024.0),
+	        static_cast<unsigned int>(stats.hits), static_cast<unsigned int>(stats.misses),
+	        stats.saved_bytes / (1024.0 * 1024.0));
+}
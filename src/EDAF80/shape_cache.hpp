@@ -0,0 +1,61 @@
+#pragma once
+
+#include "core/helpers.hpp"
+#include "core/Types.h"
+
+#include <memory>
+
+namespace shape_cache
+{
+	//! \brief A mesh shared by everyone who asked for the same shape; its
+	//!        OpenGL objects are deleted along with its last reference.
+	using shared_mesh = std::shared_ptr<bonobo::mesh_data const>;
+
+	//! \brief Counters describing the cache activity.
+	struct statistics {
+		size_t hits;          //!< lookups served by an existing mesh
+		size_t misses;        //!< lookups that required generating a mesh
+		size_t meshes_nb;     //!< meshes currently alive
+		u64 resident_bytes;   //!< size of the buffers of all alive meshes
+		u64 saved_bytes;      //!< buffer memory not allocated thanks to hits
+	};
+
+	//! \brief Get the quad with these parameters, generating and
+	//!        uploading it unless it is still alive from a previous call.
+	//!
+	//! Like all `get*()` functions, shapes are keyed by their kind and all
+	//! their parameters, layout and drawing mode included; shapes only
+	//! differing by their size can share the same mesh by asking for a
+	//! unit shape, and scaling the nodes using it instead. Meshes must be
+	//! released from the thread owning the OpenGL context.
+	//!
+	//! See `parametric_shapes::createQuad()` for the parameters.
+	shared_mesh getQuad(unsigned int res_width, unsigned int res_depth, unsigned int width, unsigned int depth,
+	                    bonobo::vertex_layout layout = bonobo::vertex_layout::planar,
+	                    GLenum drawing_mode = GL_TRIANGLES);
+
+	//! \brief Get the sphere with these parameters; see `getQuad()`, and
+	//!        `parametric_shapes::createSphere()` for the parameters.
+	shared_mesh getSphere(unsigned int const res_theta, unsigned int const res_phi, float const radius,
+	                      bonobo::vertex_layout layout = bonobo::vertex_layout::planar,
+	                      GLenum drawing_mode = GL_TRIANGLES);
+
+	//! \brief Get the torus with these parameters; see `getQuad()`, and
+	//!        `parametric_shapes::createTorus()` for the parameters.
+	shared_mesh getTorus(unsigned int const res_theta, unsigned int const res_phi, float const rA, float const rB,
+	                     bonobo::vertex_layout layout = bonobo::vertex_layout::planar,
+	                     GLenum drawing_mode = GL_TRIANGLES);
+
+	//! \brief Get the circle ring with these parameters; see `getQuad()`,
+	//!        and `parametric_shapes::createCircleRing()` for the
+	//!        parameters.
+	shared_mesh getCircleRing(unsigned int const radius_res, unsigned int const theta_res, float const inner_radius, float const outer_radius,
+	                          bonobo::vertex_layout layout = bonobo::vertex_layout::planar,
+	                          GLenum drawing_mode = GL_TRIANGLES);
+
+	//! \brief Get the current statistics.
+	statistics getStatistics();
+
+	//! \brief Log the current statistics.
+	void logStatistics();
+}
@@ -2,16 +2,21 @@
 
 #include "config.hpp"
 #include "external/glad/glad.h"
+#include "core/asset_streamer.hpp"
 #include "core/Bonobo.h"
 #include "core/FPSCamera.h"
 #include "core/GLStateInspection.h"
 #include "core/GLStateInspectionView.h"
+#include "core/geometry_pool.hpp"
 #include "core/helpers.hpp"
 #include "core/InputHandler.h"
 #include "core/Log.h"
 #include "core/LogView.h"
 #include "core/Misc.h"
+#include "core/staging_ring.hpp"
 #include "core/node.hpp"
+#include "core/resource_registry.hpp"
+#include "core/texture_arrays.hpp"
 #include "core/utils.h"
 #include "core/Window.h"
 #include <imgui.h>
@@ -23,8 +28,11 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <algorithm>
 #include <array>
 #include <cstdlib>
+#include <limits>
+#include <numeric>
 #include <stdexcept>
 
 enum class polygon_mode_t : unsigned int {
@@ -50,6 +58,7 @@ namespace constant
 }
 
 static bonobo::mesh_data loadCone();
+static void benchmarkMeshletCulling(std::vector<Node> const& elements, glm::mat4 const& view_to_clip);
 
 edan35::Assignment2::Assignment2()
 {
@@ -89,19 +98,81 @@ edan35::Assignment2::~Assignment2()
 void
 edan35::Assignment2::run()
 {
-	// Load the geometry of Sponza
-	auto const sponza_geometry = bonobo::loadObjects("../crysponza/sponza.obj");
-	if (sponza_geometry.empty()) {
-		LogError("Failed to load the Sponza model");
-		return;
-	}
-	std::vector<Node> sponza_elements;
-	sponza_elements.reserve(sponza_geometry.size());
-	for (auto const& shape : sponza_geometry) {
-		Node node;
-		node.set_geometry(shape);
-		sponza_elements.push_back(node);
-	}
+	// Stream Sponza in four setups, with planar vertices, interleaved
+	// vertices, all meshes packed into a single geometry pool, and
+	// quantised vertices, to compare the vertex fetch and state change
+	// costs of each setup; the mesh cache and the texture registry make
+	// the extra setups cheap. The scene is drawn from the first frame on,
+	// with placeholders for whatever is not uploaded yet.
+	bonobo::geometry_pool sponza_pool;
+	bonobo::asset_streamer streamer;
+	std::array<bonobo::asset_streamer::handle, 4> const sponza_handles = { {
+		streamer.request_objects("../crysponza/sponza.obj"),
+		streamer.request_objects("../crysponza/sponza.obj", bonobo::vertex_layout::interleaved),
+		streamer.request_objects("../crysponza/sponza.obj", bonobo::vertex_layout::interleaved, &sponza_pool),
+		streamer.request_objects("../crysponza/sponza.obj", bonobo::vertex_layout::quantised_positions)
+	} };
+	auto const create_nodes = [](std::vector<bonobo::mesh_data> const& geometry){
+		std::vector<Node> elements;
+		elements.reserve(geometry.size());
+		for (auto const& shape : geometry) {
+			Node node;
+			node.set_geometry(shape);
+			elements.push_back(node);
+		}
+		return elements;
+	};
+	std::array<std::vector<Node>, 4> sponza_setups;
+	std::array<u32, 4> sponza_revisions = { { 0u, 0u, 0u, 0u } }; // of the objects the nodes were created from
+
+	// Once a setup is fully streamed in, its material textures get packed
+	// into texture arrays, shared by all setups, and its nodes sorted by
+	// the arrays they use, so that the passes drawing them can skip most
+	// texture binds.
+	bonobo::texture_arrays sponza_arrays;
+	auto const create_packed_nodes = [&sponza_arrays](std::vector<bonobo::mesh_data> const& geometry){
+		bonobo::resource_registry::scoped_owner owner("Texture arrays");
+		auto const layers = sponza_arrays.pack(geometry);
+		auto const get_arrays = [&layers](size_t i){
+			std::vector<GLuint> arrays;
+			for (auto const& binding : layers[i])
+				arrays.push_back(binding.texture);
+			return arrays;
+		};
+		std::vector<size_t> order(geometry.size());
+		std::iota(order.begin(), order.end(), size_t(0u));
+		std::stable_sort(order.begin(), order.end(), [&get_arrays](size_t a, size_t b){
+			return get_arrays(a) < get_arrays(b);
+		});
+
+		std::vector<Node> elements;
+		elements.reserve(geometry.size());
+		for (auto const i : order) {
+			auto shape = geometry[i];
+			shape.bindings.clear();
+			Node node;
+			node.set_geometry(shape);
+			for (auto const& binding : layers[i])
+				node.add_texture_layer(binding.name, binding.texture, binding.layer);
+			elements.push_back(node);
+		}
+		return elements;
+	};
+	std::array<std::vector<Node>, 4> packed_sponza_setups;
+	std::array<u32, 4> packed_sponza_revisions = { { 0u, 0u, 0u, 0u } };
+	bool pack_materials = true;
+	bool show_resources = false;
+	Node::texture_bind_statistics gbuffer_binds = {};
+	std::array<char const*, 4> const sponza_setup_names = { "planar", "interleaved", "pooled", "quantised" };
+	size_t sponza_setup = 0u;
+	int upload_budget_mib = static_cast<int>(streamer.get_upload_budget() / (1024u * 1024u));
+
+	// Meshlets of the g-buffer pass are culled on the CPU against the
+	// camera; the shadow passes still draw whole meshes.
+	bool cull_meshlets = true;
+	std::vector<bonobo::meshlets::draw_ranges> meshlet_ranges;
+	bonobo::meshlets::cull_statistics cull_stats = {};
+	double cull_time_ms = 0.0;
 
 	auto const cone_geometry = loadCone();
 	Node cone;
@@ -138,13 +209,14 @@ edan35::Assignment2::run()
 			program = fallback_shader;
 		}
 	};
-	GLuint fill_gbuffer_shader = 0u, fill_shadowmap_shader = 0u, accumulate_lights_shader = 0u, resolve_deferred_shader = 0u;
-	auto const reload_shaders = [&reload_shader,&fill_gbuffer_shader,&fill_shadowmap_shader,&accumulate_lights_shader,&resolve_deferred_shader](){
+	GLuint fill_gbuffer_shader = 0u, fill_gbuffer_packed_shader = 0u, fill_shadowmap_shader = 0u, accumulate_lights_shader = 0u, resolve_deferred_shader = 0u;
+	auto const reload_shaders = [&reload_shader,&fill_gbuffer_shader,&fill_gbuffer_packed_shader,&fill_shadowmap_shader,&accumulate_lights_shader,&resolve_deferred_shader](){
 		LogInfo("Reloading shaders");
-		reload_shader("fill_gbuffer.vert",      "fill_gbuffer.frag",      fill_gbuffer_shader);
-		reload_shader("fill_shadowmap.vert",    "fill_shadowmap.frag",    fill_shadowmap_shader);
-		reload_shader("accumulate_lights.vert", "accumulate_lights.frag", accumulate_lights_shader);
-		reload_shader("resolve_deferred.vert",  "resolve_deferred.frag",  resolve_deferred_shader);
+		reload_shader("fill_gbuffer.vert",      "fill_gbuffer.frag",        fill_gbuffer_shader);
+		reload_shader("fill_gbuffer.vert",      "fill_gbuffer_packed.frag", fill_gbuffer_packed_shader);
+		reload_shader("fill_shadowmap.vert",    "fill_shadowmap.frag",      fill_shadowmap_shader);
+		reload_shader("accumulate_lights.vert", "accumulate_lights.frag",   accumulate_lights_shader);
+		reload_shader("resolve_deferred.vert",  "resolve_deferred.frag",    resolve_deferred_shader);
 	};
 	reload_shaders();
 
@@ -154,6 +226,7 @@ edan35::Assignment2::run()
 	//
 	// Setup textures
 	//
+	bonobo::resource_registry::pushOwner("Render targets");
 	auto const diffuse_texture                     = bonobo::createTexture(window_size.x, window_size.y);
 	auto const specular_texture                    = bonobo::createTexture(window_size.x, window_size.y);
 	auto const normal_texture                      = bonobo::createTexture(window_size.x, window_size.y);
@@ -169,6 +242,7 @@ edan35::Assignment2::run()
 	auto const deferred_fbo  = bonobo::createFBO({diffuse_texture, specular_texture, normal_texture}, depth_texture);
 	auto const shadowmap_fbo = bonobo::createFBO({}, shadowmap_texture);
 	auto const light_fbo     = bonobo::createFBO({light_diffuse_contribution_texture, light_specular_contribution_texture}, depth_texture);
+	bonobo::resource_registry::popOwner();
 
 	//
 	// Setup samplers
@@ -234,6 +308,13 @@ edan35::Assignment2::run()
 	glEnable(GL_CULL_FACE);
 
 
+	// Time the g-buffer pass on the GPU; the result of a query is only
+	// read back once available, to avoid stalling the pipeline.
+	GLuint gbuffer_time_query = 0u;
+	glGenQueries(1, &gbuffer_time_query);
+	bool gbuffer_time_query_pending = false;
+	double gbuffer_time_ms = 0.0;
+
 	double ddeltatime;
 	size_t fpsSamples = 0;
 	double nowTime, lastTime = GetTimeMilliseconds();
@@ -261,6 +342,35 @@ edan35::Assignment2::run()
 		if (inputHandler->GetKeycodeState(GLFW_KEY_R) & JUST_PRESSED) {
 			reload_shaders();
 		}
+		if (inputHandler->GetKeycodeState(GLFW_KEY_L) & JUST_PRESSED) {
+			sponza_setup = (sponza_setup + 1u) % sponza_setups.size();
+			LogInfo("Rendering Sponza with %s vertices", sponza_setup_names[sponza_setup]);
+		}
+		if (inputHandler->GetKeycodeState(GLFW_KEY_B) & JUST_PRESSED) {
+			benchmarkMeshletCulling(sponza_setups[sponza_setup], mCamera.GetViewToClipMatrix());
+		}
+
+		streamer.update();
+		for (size_t i = 0u; i < sponza_setups.size(); ++i) {
+			auto const revision = streamer.get_revision(sponza_handles[i]);
+			if (revision == sponza_revisions[i])
+				continue;
+			sponza_setups[i] = create_nodes(streamer.get_objects(sponza_handles[i]));
+			sponza_revisions[i] = revision;
+		}
+		auto const streaming_stats = streamer.get_statistics();
+		if (streaming_stats.loading_nb == 0u && streaming_stats.uploads_nb == 0u) {
+			for (size_t i = 0u; i < sponza_setups.size(); ++i) {
+				if (packed_sponza_revisions[i] == sponza_revisions[i] || !streamer.is_resident(sponza_handles[i]))
+					continue;
+				packed_sponza_setups[i] = create_packed_nodes(streamer.get_objects(sponza_handles[i]));
+				packed_sponza_revisions[i] = sponza_revisions[i];
+			}
+		}
+		auto const use_packed_materials = pack_materials && !packed_sponza_setups[sponza_setup].empty()
+		                               && packed_sponza_revisions[sponza_setup] == sponza_revisions[sponza_setup];
+		auto const& active_sponza_elements = use_packed_materials ? packed_sponza_setups[sponza_setup] : sponza_setups[sponza_setup];
+		auto const gbuffer_shader = use_packed_materials ? fill_gbuffer_packed_shader : fill_gbuffer_shader;
 
 
 
@@ -280,8 +390,45 @@ edan35::Assignment2::run()
 
 		GLStateInspection::CaptureSnapshot("Filling Pass");
 
-		for (auto const& element : sponza_elements)
-			element.render(mCamera.GetWorldToClipMatrix(), element.get_transform(), fill_gbuffer_shader, set_uniforms);
+		if (gbuffer_time_query_pending) {
+			GLint available = GL_FALSE;
+			glGetQueryObjectiv(gbuffer_time_query, GL_QUERY_RESULT_AVAILABLE, &available);
+			if (available == GL_TRUE) {
+				GLuint64 elapsed_ns = 0u;
+				glGetQueryObjectui64v(gbuffer_time_query, GL_QUERY_RESULT, &elapsed_ns);
+				gbuffer_time_ms = static_cast<double>(elapsed_ns) / 1000000.0;
+				gbuffer_time_query_pending = false;
+			}
+		}
+		if (!gbuffer_time_query_pending)
+			glBeginQuery(GL_TIME_ELAPSED, gbuffer_time_query);
+
+		auto const cull_start = StartTimer();
+		auto const camera_view = bonobo::meshlets::makeView(mCamera.GetWorldToClipMatrix(), mCamera.mWorld.GetTranslation());
+		cull_stats = {};
+		meshlet_ranges.resize(active_sponza_elements.size());
+		for (size_t i = 0u; i < active_sponza_elements.size(); ++i) {
+			auto const& element = active_sponza_elements[i];
+			if (cull_meshlets && element.get_meshlets() != nullptr)
+				bonobo::meshlets::cull(*element.get_meshlets(), element.get_transform(), camera_view, meshlet_ranges[i], &cull_stats);
+		}
+		cull_time_ms = EndTimerSeconds(cull_start) * 1000.0;
+
+		Node::reset_texture_bind_statistics();
+		Node::begin_texture_batch();
+		for (size_t i = 0u; i < active_sponza_elements.size(); ++i) {
+			auto const& element = active_sponza_elements[i];
+			auto const culled = cull_meshlets && element.get_meshlets() != nullptr;
+			element.render(mCamera.GetWorldToClipMatrix(), element.get_transform(), gbuffer_shader, set_uniforms,
+			               culled ? &meshlet_ranges[i] : nullptr);
+		}
+		Node::end_texture_batch();
+		gbuffer_binds = Node::get_texture_bind_statistics();
+
+		if (!gbuffer_time_query_pending) {
+			glEndQuery(GL_TIME_ELAPSED);
+			gbuffer_time_query_pending = true;
+		}
 
 
 
@@ -309,8 +456,10 @@ edan35::Assignment2::run()
 
 			GLStateInspection::CaptureSnapshot("Shadow Map Generation");
 
-			for (auto const& element : sponza_elements)
-				element.render(light_matrix, glm::mat4(), fill_gbuffer_shader, set_uniforms);
+			Node::begin_texture_batch();
+			for (auto const& element : active_sponza_elements)
+				element.render(light_matrix, glm::mat4(), gbuffer_shader, set_uniforms);
+			Node::end_texture_batch();
 
 
 			glEnable(GL_BLEND);
@@ -421,10 +570,46 @@ edan35::Assignment2::run()
 
 		GLStateInspection::View::Render();
 		Log::View::Render();
+		if (show_resources)
+			bonobo::resource_registry::renderView(&show_resources);
 
-		bool opened = ImGui::Begin("Render Time", nullptr, ImVec2(120, 50), -1.0f, 0);
-		if (opened)
+		bool opened = ImGui::Begin("Render Time", nullptr, ImVec2(320, 290), -1.0f, 0);
+		if (opened) {
 			ImGui::Text("%.3f ms", ddeltatime);
+			ImGui::Text("G-buffer: %.3f ms (%s%s)", gbuffer_time_ms, sponza_setup_names[sponza_setup],
+			            streamer.is_resident(sponza_handles[sponza_setup]) ? "" : ", streaming");
+			auto const streaming = streamer.get_statistics();
+			ImGui::Text("Streaming: %u loading, %u to upload", static_cast<unsigned int>(streaming.loading_nb),
+			            static_cast<unsigned int>(streaming.uploads_nb));
+			ImGui::Text("Uploaded: %.2f MiB (%.2f MiB total)", streaming.frame_bytes / (1024.0 * 1024.0),
+			            streaming.total_bytes / (1024.0 * 1024.0));
+			ImGui::Text("Update: %.3f ms (%.3f ms max)", streaming.last_update_ms, streaming.max_update_ms);
+			ImGui::Text("Stalled frames: %u / %u", static_cast<unsigned int>(streaming.stalled_frames_nb),
+			            static_cast<unsigned int>(streaming.frames_nb));
+			if (ImGui::SliderInt("Budget (MiB)", &upload_budget_mib, 1, 64))
+				streamer.set_upload_budget(static_cast<u64>(upload_budget_mib) * 1024u * 1024u);
+			auto const staging = bonobo::staging_ring::shared().get_statistics();
+			ImGui::Text("Staging: %.2f / %.2f MiB in flight (%.2f MiB peak)", staging.bytes_in_flight / (1024.0 * 1024.0),
+			            staging.capacity / (1024.0 * 1024.0), staging.peak_bytes_in_flight / (1024.0 * 1024.0));
+			ImGui::Text("Staging waits: %u (%.3f ms max), %u fallbacks", static_cast<unsigned int>(staging.waits_nb),
+			            staging.max_wait_ms, static_cast<unsigned int>(staging.fallbacks_nb));
+			ImGui::Checkbox("Show resources", &show_resources);
+			ImGui::Checkbox("Pack materials into texture arrays", &pack_materials);
+			auto const arrays = sponza_arrays.get_statistics();
+			ImGui::Text("Arrays: %u textures in %u arrays, %.2f MiB", static_cast<unsigned int>(arrays.layers_nb),
+			            static_cast<unsigned int>(arrays.arrays_nb), arrays.bytes / (1024.0 * 1024.0));
+			ImGui::Text("G-buffer texture binds: %u (%u skipped)%s", static_cast<unsigned int>(gbuffer_binds.binds_nb),
+			            static_cast<unsigned int>(gbuffer_binds.skipped_nb), use_packed_materials ? ", packed" : "");
+			ImGui::Checkbox("Cull meshlets (B: benchmark)", &cull_meshlets);
+			if (cull_meshlets && cull_stats.triangles_nb != 0u) {
+				ImGui::Text("Meshlets: %u / %u visible, %u draw ranges, %.3f ms",
+				            static_cast<unsigned int>(cull_stats.visible_meshlets_nb), static_cast<unsigned int>(cull_stats.meshlets_nb),
+				            static_cast<unsigned int>(cull_stats.ranges_nb), cull_time_ms);
+				ImGui::Text("Triangles: %.1f%% visible (%u frustum, %u cone culled)",
+				            100.0 * cull_stats.visible_triangles_nb / cull_stats.triangles_nb,
+				            static_cast<unsigned int>(cull_stats.frustum_culled_nb), static_cast<unsigned int>(cull_stats.cone_culled_nb));
+			}
+		}
 		ImGui::End();
 
 		ImGui::Render();
@@ -433,12 +618,19 @@ edan35::Assignment2::run()
 		lastTime = nowTime;
 	}
 
+	streamer.log_statistics();
+
+	glDeleteQueries(1, &gbuffer_time_query);
+	gbuffer_time_query = 0u;
+
 	glDeleteProgram(resolve_deferred_shader);
 	resolve_deferred_shader = 0u;
 	glDeleteProgram(accumulate_lights_shader);
 	accumulate_lights_shader = 0u;
 	glDeleteProgram(fill_shadowmap_shader);
 	fill_shadowmap_shader = 0u;
+	glDeleteProgram(fill_gbuffer_packed_shader);
+	fill_gbuffer_packed_shader = 0u;
 	glDeleteProgram(fill_gbuffer_shader);
 	fill_gbuffer_shader = 0u;
 	glDeleteProgram(fallback_shader);
@@ -550,3 +742,76 @@ loadCone()
 
 	return cone;
 }
+
+//! \brief Cull the meshlets of a scene from a fixed set of viewpoints
+//!        spread over its bounds, and log how much each test removes.
+void
+benchmarkMeshletCulling(std::vector<Node> const& elements, glm::mat4 const& view_to_clip)
+{
+	auto lower = glm::vec3(std::numeric_limits<float>::max());
+	auto upper = glm::vec3(std::numeric_limits<float>::lowest());
+	for (auto const& element : elements) {
+		if (element.get_meshlets() == nullptr)
+			continue;
+		auto const transform = element.get_transform();
+		for (auto const& cluster : *element.get_meshlets()) {
+			for (auto const& corner : { cluster.lower, cluster.upper }) {
+				auto const world_corner = glm::vec3(transform * glm::vec4(corner, 1.0f));
+				lower = glm::min(lower, world_corner);
+				upper = glm::max(upper, world_corner);
+			}
+		}
+	}
+	if (lower.x > upper.x) {
+		LogWarning("No meshlets to benchmark: the scene is still streaming or has no triangles");
+		return;
+	}
+
+	auto const at = [&lower,&upper](float x, float y, float z){
+		return lower + glm::vec3(x, y, z) * (upper - lower);
+	};
+	struct viewpoint {
+		char const* name;
+		glm::vec3 eye, target, up;
+	};
+	auto const y_up = glm::vec3(0.0f, 1.0f, 0.0f);
+	std::array<viewpoint, 8> const viewpoints = { {
+		{ "centre, towards +x",  at(0.5f, 0.2f, 0.5f),  at(1.0f, 0.2f, 0.5f), y_up },
+		{ "centre, towards -x",  at(0.5f, 0.2f, 0.5f),  at(0.0f, 0.2f, 0.5f), y_up },
+		{ "centre, towards +z",  at(0.5f, 0.2f, 0.5f),  at(0.5f, 0.2f, 1.0f), y_up },
+		{ "centre, towards -z",  at(0.5f, 0.2f, 0.5f),  at(0.5f, 0.2f, 0.0f), y_up },
+		{ "corner, upper floor", at(0.9f, 0.6f, 0.9f),  at(0.5f, 0.3f, 0.5f), y_up },
+		{ "gallery, looking up", at(0.2f, 0.3f, 0.5f),  at(0.5f, 1.0f, 0.5f), y_up },
+		{ "above, looking down", at(0.5f, 1.5f, 0.5f),  at(0.5f, 0.0f, 0.5f), glm::vec3(0.0f, 0.0f, -1.0f) },
+		{ "outside, far away",   at(0.5f, 0.5f, 3.0f),  at(0.5f, 0.5f, 0.5f), y_up }
+	} };
+
+	LogInfo("Meshlet culling benchmark over %u viewpoints", static_cast<unsigned int>(viewpoints.size()));
+	unsigned int const repetitions_nb = 10u;
+	auto ranges = bonobo::meshlets::draw_ranges();
+	double total_visible_ratio = 0.0, total_time_ms = 0.0;
+	for (auto const& viewpoint : viewpoints) {
+		auto const world_to_clip = view_to_clip * glm::lookAt(viewpoint.eye, viewpoint.target, viewpoint.up);
+		auto const camera = bonobo::meshlets::makeView(world_to_clip, viewpoint.eye);
+
+		auto stats = bonobo::meshlets::cull_statistics();
+		auto const start = StartTimer();
+		for (unsigned int repetition = 0u; repetition < repetitions_nb; ++repetition) {
+			stats = {};
+			for (auto const& element : elements)
+				if (element.get_meshlets() != nullptr)
+					bonobo::meshlets::cull(*element.get_meshlets(), element.get_transform(), camera, ranges, &stats);
+		}
+		auto const time_ms = EndTimerSeconds(start) * 1000.0 / repetitions_nb;
+
+		auto const visible_ratio = static_cast<double>(stats.visible_triangles_nb) / static_cast<double>(stats.triangles_nb);
+		auto const meshlets_nb = static_cast<double>(stats.meshlets_nb);
+		LogInfo("\t%-20s %5.1f%% triangles visible; meshlets: %5.1f%% frustum culled, %5.1f%% cone culled, %u draw ranges; %.3f ms",
+		        viewpoint.name, 100.0 * visible_ratio, 100.0 * stats.frustum_culled_nb / meshlets_nb,
+		        100.0 * stats.cone_culled_nb / meshlets_nb, static_cast<unsigned int>(stats.ranges_nb), time_ms);
+		total_visible_ratio += visible_ratio;
+		total_time_ms += time_ms;
+	}
+	LogInfo("\taverage: %.1f%% triangles visible, %.3f ms per cull",
+	        100.0 * total_visible_ratio / viewpoints.size(), total_time_ms / viewpoints.size());
+}
@@ -1,6 +1,9 @@
 #include "Misc.h"
 #ifdef _WIN32
 #include <Windows.h>
+#include <Psapi.h>
+#else
+#include <sys/resource.h>
 #endif
 #include <cstring>
 #include <random>
@@ -112,3 +115,22 @@ std::thread::id GetThreadID()
 {
 	return std::this_thread::get_id();
 }
+
+u64 GetPeakResidentBytes()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return 0u;
+	return static_cast<u64>(counters.PeakWorkingSetSize);
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0u;
+#	ifdef __APPLE__
+	return static_cast<u64>(usage.ru_maxrss); // already in bytes
+#	else
+	return static_cast<u64>(usage.ru_maxrss) * 1024u; // in kilobytes
+#	endif
+#endif
+}
@@ -34,3 +34,7 @@ template<typename T> T Exchange(T &a, T &b)
 
 std::thread::id GetThreadID();
 
+//! \brief Peak resident set size of the process so far, in bytes; 0 if
+//!        it can not be queried on this platform.
+u64 GetPeakResidentBytes();
+
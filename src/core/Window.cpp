@@ -1,3 +1,4 @@
+#include <cstring>
 #include <unordered_map>
 
 #include "external/glad/glad.h"
@@ -7,6 +8,7 @@
 #include "InputHandler.h"
 #include "Log.h"
 #include "opengl.hpp"
+#include "staging_ring.hpp"
 #include "Window.h"
 
 #include "external/imgui_impl_glfw_gl3.h"
@@ -15,6 +17,26 @@ static std::unordered_map<std::string, Window *> *windowMap = nullptr;
 static int default_opengl_major_version = 4;
 static int default_opengl_minor_version = 1;
 
+// Stage the vertices and indices of an ImGui draw list back to back in the
+// shared staging ring, for ImGui to draw straight from it.
+static bool StageImGuiDrawList(void const* vertices, size_t vertices_size, void const* indices, size_t indices_size,
+                               unsigned int* buffer, size_t* vertices_offset, size_t* indices_offset)
+{
+	auto const indices_start = (vertices_size + 15u) / 16u * 16u;
+	GLintptr offset = 0;
+	auto& ring = bonobo::staging_ring::shared();
+	if (!ring.stage(indices_start + indices_size, [=](u8* destination){
+		std::memcpy(destination, vertices, vertices_size);
+		std::memcpy(destination + indices_start, indices, indices_size);
+	}, offset))
+		return false;
+
+	*buffer = ring.get_buffer();
+	*vertices_offset = static_cast<size_t>(offset);
+	*indices_offset = static_cast<size_t>(offset) + indices_start;
+	return true;
+}
+
 void Window::ErrorCallback(int error, char const* description)
 {
   if (error == 65545 || error == 65543)
@@ -155,6 +177,7 @@ bool Window::Show()
 	}
 
 	ImGui_ImplGlfwGL3_Init(mWindowGLFW, false);
+	ImGui_ImplGlfwGL3_SetStageFunction(StageImGuiDrawList);
 
 	glfwSetKeyCallback(mWindowGLFW, Window::KeyCallback);
 	glfwSetInputMode(mWindowGLFW, GLFW_STICKY_KEYS, 1);
@@ -240,6 +263,7 @@ void Window::Destroy()
 void Window::Swap() const
 {
 	glfwSwapBuffers(mWindowGLFW);
+	bonobo::staging_ring::shared().fence();
 }
 
 glm::ivec2 Window::GetDimensions() const
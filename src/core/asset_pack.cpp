@@ -0,0 +1,271 @@
+#include "asset_pack.hpp"
+
+#include "core/lz4.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+namespace
+{
+	u32 const magic = 0x4b415042u; // "BPAK" when read as little-endian bytes
+	u32 const version = 1u;
+	size_t const data_alignment = 64u;
+
+	u32 const entry_compressed = 1u << 0;
+
+	struct header {
+		u32 magic;
+		u32 version;
+		u32 entries_nb;
+		u32 reserved;
+		u64 index_offset;
+		u64 index_size;
+		u64 file_size;
+	};
+
+	size_t align(size_t offset)
+	{
+		return (offset + data_alignment - 1u) & ~(data_alignment - 1u);
+	}
+
+	bool readFile(std::string const& path, std::vector<u8>& content)
+	{
+		std::ifstream file(path, std::ios::binary);
+		if (!file.is_open())
+			return false;
+		content.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		return !file.bad();
+	}
+
+	class table_writer
+	{
+	public:
+		void put(void const* data, size_t size)
+		{
+			auto const bytes = static_cast<u8 const*>(data);
+			_content.insert(_content.end(), bytes, bytes + size);
+		}
+		void put_u32(u32 value) { put(&value, sizeof(value)); }
+		void put_u64(u64 value) { put(&value, sizeof(value)); }
+		void put_string(std::string const& value)
+		{
+			put_u32(static_cast<u32>(value.size()));
+			put(value.data(), value.size());
+		}
+		std::vector<u8> const& content() const { return _content; }
+
+	private:
+		std::vector<u8> _content;
+	};
+
+	class table_reader
+	{
+	public:
+		table_reader(u8 const* data, size_t size, size_t offset) : _data(data), _size(size), _offset(offset), _valid(true)
+		{
+		}
+		bool get(void* data, size_t size)
+		{
+			if (!_valid || size > _size - _offset) {
+				_valid = false;
+				return false;
+			}
+			std::memcpy(data, _data + _offset, size);
+			_offset += size;
+			return true;
+		}
+		u32 get_u32() { u32 value = 0u; get(&value, sizeof(value)); return value; }
+		u64 get_u64() { u64 value = 0u; get(&value, sizeof(value)); return value; }
+		std::string get_string()
+		{
+			auto const length = get_u32();
+			if (!_valid || length > _size - _offset) {
+				_valid = false;
+				return std::string();
+			}
+			auto const value = std::string(reinterpret_cast<char const*>(_data + _offset), length);
+			_offset += length;
+			return value;
+		}
+		bool valid() const { return _valid; }
+
+	private:
+		u8 const* _data;
+		size_t _size;
+		size_t _offset;
+		bool _valid;
+	};
+}
+
+bool
+bonobo::asset_pack::reader::open(std::string const& pack_path)
+{
+	close();
+	if (!_file.open(pack_path))
+		return false;
+
+	auto const data = _file.data();
+	auto const size = _file.size();
+
+	header file_header;
+	if (size < sizeof(file_header)) {
+		close();
+		return false;
+	}
+	std::memcpy(&file_header, data, sizeof(file_header));
+	if (file_header.magic != magic
+	 || file_header.version != version
+	 || file_header.file_size != size
+	 || file_header.index_offset > size
+	 || file_header.index_size > size - file_header.index_offset) {
+		close();
+		return false;
+	}
+
+	table_reader table(data, static_cast<size_t>(file_header.index_offset + file_header.index_size),
+	                   static_cast<size_t>(file_header.index_offset));
+	_entries.reserve(file_header.entries_nb);
+	for (u32 i = 0u; i < file_header.entries_nb; ++i) {
+		entry file;
+		file.offset      = table.get_u64();
+		file.stored_size = table.get_u64();
+		file.size        = table.get_u64();
+		file.compressed  = (table.get_u32() & entry_compressed) != 0u;
+		auto path = table.get_string();
+		if (!table.valid()
+		 || file.offset % data_alignment != 0u || file.offset > file_header.index_offset
+		 || file.stored_size > file_header.index_offset - file.offset
+		 || (!file.compressed && file.stored_size != file.size)) {
+			close();
+			return false;
+		}
+		_entries.emplace(std::move(path), file);
+	}
+
+	return true;
+}
+
+void
+bonobo::asset_pack::reader::close()
+{
+	_file.close();
+	_entries.clear();
+}
+
+bonobo::asset_pack::entry const*
+bonobo::asset_pack::reader::find(std::string const& virtual_path) const
+{
+	auto const it = _entries.find(virtual_path);
+	return it != _entries.end() ? &it->second : nullptr;
+}
+
+bool
+bonobo::asset_pack::reader::extract(entry const& file, u8* destination) const
+{
+	if (!file.compressed) {
+		std::memcpy(destination, data(file), static_cast<size_t>(file.size));
+		return true;
+	}
+	return lz4::decompress(data(file), static_cast<size_t>(file.stored_size),
+	                       destination, static_cast<size_t>(file.size));
+}
+
+std::vector<std::string>
+bonobo::asset_pack::reader::get_paths() const
+{
+	std::vector<std::string> paths;
+	paths.reserve(_entries.size());
+	for (auto const& file : _entries)
+		paths.push_back(file.first);
+	return paths;
+}
+
+bool
+bonobo::asset_pack::write(std::string const& pack_path, std::vector<source_file> const& files, bool compress,
+                          write_statistics* stats)
+{
+	write_statistics outcome = {};
+
+	// Files are streamed to the pack one at a time, and the index, which
+	// needs all their offsets, comes last.
+	auto const temporary_path = pack_path + ".tmp";
+	table_writer index;
+	header file_header = {};
+	{
+		std::ofstream pack(temporary_path, std::ios::binary | std::ios::trunc);
+		if (!pack.is_open())
+			return false;
+
+		size_t written = 0u;
+		auto const put = [&pack, &written](void const* data, size_t size) {
+			pack.write(static_cast<char const*>(data), static_cast<std::streamsize>(size));
+			written += size;
+		};
+		auto const pad_to = [&put, &written](size_t offset) {
+			static u8 const zeroes[data_alignment] = {};
+			put(zeroes, offset - written);
+		};
+
+		put(&file_header, sizeof(file_header));
+
+		std::vector<u8> content;
+		for (auto const& file : files) {
+			if (!readFile(file.path, content)) {
+				pack.close();
+				std::remove(temporary_path.c_str());
+				return false;
+			}
+
+			// Keeping files uncompressed lets them be read straight from
+			// the mapping, which is worth more than saving a few bytes.
+			auto block = compress && !content.empty() ? lz4::compress(content.data(), content.size()) : std::vector<u8>();
+			auto const is_compressed = !block.empty() && block.size() <= content.size() - content.size() / 8u;
+			auto const& stored = is_compressed ? block : content;
+
+			pad_to(align(written));
+			index.put_u64(written);
+			index.put_u64(stored.size());
+			index.put_u64(content.size());
+			index.put_u32(is_compressed ? entry_compressed : 0u);
+			index.put_string(file.virtual_path);
+			put(stored.data(), stored.size());
+
+			++outcome.files_nb;
+			outcome.compressed_nb += is_compressed ? 1u : 0u;
+			outcome.source_bytes += content.size();
+		}
+
+		pad_to(align(written));
+		file_header.magic = magic;
+		file_header.version = version;
+		file_header.entries_nb = static_cast<u32>(files.size());
+		file_header.reserved = 0u;
+		file_header.index_offset = written;
+		file_header.index_size = index.content().size();
+		put(index.content().data(), index.content().size());
+		file_header.file_size = written;
+		outcome.pack_bytes = written;
+
+		pack.seekp(0);
+		pack.write(reinterpret_cast<char const*>(&file_header), sizeof(file_header));
+
+		if (!pack.good()) {
+			pack.close();
+			std::remove(temporary_path.c_str());
+			return false;
+		}
+	}
+
+	// std::rename() does not replace existing files on every platform.
+	std::remove(pack_path.c_str());
+	if (std::rename(temporary_path.c_str(), pack_path.c_str()) != 0) {
+		std::remove(temporary_path.c_str());
+		return false;
+	}
+
+	if (stats != nullptr)
+		*stats = outcome;
+	return true;
+}
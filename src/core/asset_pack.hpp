@@ -0,0 +1,109 @@
+#pragma once
+
+#include "core/mapped_file.hpp"
+#include "core/Types.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace bonobo
+{
+	//! \brief Archive gathering many asset files into a single one.
+	//!
+	//! A pack starts with a header, followed by the content of every
+	//! file, each one aligned on 64 bytes, and ends with an index mapping
+	//! virtual paths, e.g. `res/textures/waves.png`, to their location.
+	//! The whole pack gets memory mapped when opened, so that files stored
+	//! as is are handed out as spans of that mapping, without any copy.
+	//! Files can optionally be compressed with LZ4, in which case they
+	//! need decoding into a buffer of their own.
+	//!
+	//! Packs are built offline by the `asset_packer` tool, and mounted
+	//! through `bonobo::vfs::mountPack()`.
+	//!
+	//! The functions only operate on CPU data and neither use OpenGL nor
+	//! the `Log*()` macros, so they can run on worker threads.
+	namespace asset_pack
+	{
+		//! \brief Where a file is stored within a pack.
+		struct entry {
+			u64 offset;      //!< from the start of the pack
+			u64 stored_size; //!< bytes taken in the pack
+			u64 size;        //!< bytes once decoded
+			bool compressed; //!< whether stored as an LZ4 block
+		};
+
+		//! \brief A file to add to a pack.
+		struct source_file {
+			std::string path;         //!< on disk
+			std::string virtual_path; //!< within the pack
+		};
+
+		//! \brief Outcome of writing a pack.
+		struct write_statistics {
+			size_t files_nb;      //!< files written
+			size_t compressed_nb; //!< of which stored compressed
+			u64 source_bytes;     //!< total size of the files
+			u64 pack_bytes;       //!< size of the pack
+		};
+
+		//! \brief Read access to a pack.
+		class reader
+		{
+		public:
+			//! \brief Map a pack and read its index.
+			//!
+			//! @param [in] pack_path path to the pack on disk
+			//! @return whether the pack exists and is well-formed
+			bool open(std::string const& pack_path);
+
+			//! \brief Unmap the pack, if any.
+			void close();
+
+			//! \brief Look a file up.
+			//!
+			//! @param [in] virtual_path normalised path of the file
+			//! @return where the file is stored, or nullptr if the
+			//!         pack does not contain it
+			entry const* find(std::string const& virtual_path) const;
+
+			//! \brief Stored bytes of a file, which are the file content
+			//!        itself unless compressed.
+			u8 const* data(entry const& file) const { return _file.data() + file.offset; }
+
+			//! \brief Decode a file.
+			//!
+			//! @param [in] file where the file is stored
+			//! @param [out] destination at least `file.size` bytes long
+			//! @return whether the file could be decoded
+			bool extract(entry const& file, u8* destination) const;
+
+			//! \brief Virtual paths of all files in the pack.
+			std::vector<std::string> get_paths() const;
+
+			//! \brief Size of the pack itself.
+			size_t size() const { return _file.size(); }
+
+		private:
+			mapped_file _file;
+			std::unordered_map<std::string, entry> _entries;
+		};
+
+		//! \brief Write a pack.
+		//!
+		//! The file is first written under a temporary name and then
+		//! renamed, so that readers never see a partially written pack.
+		//!
+		//! @param [in] pack_path path to the pack
+		//! @param [in] files files to store, whose virtual paths must be
+		//!             normalised and unique
+		//! @param [in] compress whether to try compressing each file;
+		//!             files which would not shrink by at least an eighth
+		//!             are stored as is anyway, to be read without copy
+		//! @param [out] stats outcome of the writing, optional
+		//! @return whether all files could be read and the pack written
+		bool write(std::string const& pack_path, std::vector<source_file> const& files, bool compress,
+		           write_statistics* stats = nullptr);
+	}
+}
@@ -0,0 +1,398 @@
+#include "asset_streamer.hpp"
+
+#include "config.hpp"
+#include "core/geometry_pool.hpp"
+#include "core/Log.h"
+#include "core/Misc.h"
+#include "core/resource_registry.hpp"
+#include "core/staging_ring.hpp"
+#include "core/texture_registry.hpp"
+#include "core/vfs.hpp"
+#include "external/lodepng.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+
+namespace
+{
+	bonobo::mesh_data createPlaceholderMesh()
+	{
+		// Four vertices per face, so that each face gets a flat normal.
+		std::vector<glm::vec3> vertices, normals;
+		std::vector<GLuint> indices;
+		for (int axis = 0; axis < 3; ++axis) {
+			for (float side : { -1.0f, 1.0f }) {
+				auto normal = glm::vec3(0.0f);
+				normal[axis] = side;
+				auto u = glm::vec3(0.0f), v = glm::vec3(0.0f);
+				u[(axis + 1) % 3] = 1.0f;
+				v[(axis + 2) % 3] = side;
+				auto const first = static_cast<GLuint>(vertices.size());
+				for (auto const corner : { glm::vec2(-1.0f, -1.0f), glm::vec2(1.0f, -1.0f), glm::vec2(1.0f, 1.0f), glm::vec2(-1.0f, 1.0f) }) {
+					vertices.push_back(normal + corner.x * u + corner.y * v);
+					normals.push_back(normal);
+				}
+				for (auto const corner : { 0u, 1u, 2u, 0u, 2u, 3u })
+					indices.push_back(first + corner);
+			}
+		}
+
+		bonobo::vertex_streams streams = {};
+		streams.vertices_nb = vertices.size();
+		streams.vertices = vertices.data();
+		streams.normals = normals.data();
+		return bonobo::createMesh(streams, indices.data(), indices.size());
+	}
+
+	//! \brief Transform from the placeholder mesh to the bounds of a mesh.
+	glm::mat4 computeBounds(bonobo::mesh_cache::mesh_view const& mesh)
+	{
+		if (mesh.vertices_nb == 0u)
+			return glm::scale(glm::mat4(1.0f), glm::vec3(0.0f));
+
+		auto const positions = reinterpret_cast<glm::vec3 const*>(mesh.vertices);
+		auto lower = positions[0], upper = positions[0];
+		for (u32 i = 1u; i < mesh.vertices_nb; ++i) {
+			lower = glm::min(lower, positions[i]);
+			upper = glm::max(upper, positions[i]);
+		}
+		return glm::scale(glm::translate(glm::mat4(1.0f), (lower + upper) * 0.5f), (upper - lower) * 0.5f);
+	}
+
+	u64 getUploadedBytes(bonobo::mesh_cache::mesh_view const& mesh)
+	{
+		size_t streams_nb = 0u;
+		for (auto const stream : { mesh.vertices, mesh.normals, mesh.texcoords, mesh.tangents, mesh.binormals })
+			streams_nb += stream != nullptr ? 1u : 0u;
+		return static_cast<u64>(mesh.vertices_nb) * streams_nb * 3u * sizeof(f32) + static_cast<u64>(mesh.indices_nb) * sizeof(u32);
+	}
+}
+
+bonobo::asset_streamer::asset_streamer(u64 upload_budget) : _upload_budget(upload_budget), _placeholder_mesh(createPlaceholderMesh()), _scenes(), _loading_scenes(), _loading(), _loaded_textures(), _loaded_scenes(), _texture_uploads(), _scene_uploads(), _stats()
+{
+}
+
+bonobo::asset_streamer::~asset_streamer()
+{
+	for (auto& task : _loading)
+		task.wait();
+
+	// Textures left behind keep whatever levels they already got; only
+	// the reference held while streaming them in is dropped.
+	texture_upload texture;
+	while (_loaded_textures.try_pop(texture))
+		texture_registry::release(texture.texture);
+	for (auto const& upload : _texture_uploads)
+		texture_registry::release(upload.texture);
+
+	glDeleteVertexArrays(1, &_placeholder_mesh.vao);
+	glDeleteBuffers(1, &_placeholder_mesh.bo);
+	glDeleteBuffers(1, &_placeholder_mesh.ibo);
+	resource_registry::untrack(resource_registry::kind::buffer, _placeholder_mesh.bo);
+	resource_registry::untrack(resource_registry::kind::buffer, _placeholder_mesh.ibo);
+}
+
+GLuint
+bonobo::asset_streamer::request_texture2D(std::string const& filename, bool generate_mipmap)
+{
+	auto const key = texture_registry::makeKey(GL_TEXTURE_2D, filename, generate_mipmap);
+	auto const registered_texture = texture_registry::acquire(key);
+	if (registered_texture != 0u)
+		return registered_texture;
+
+	u8 const grey[4] = { 128u, 128u, 128u, 255u };
+	auto const texture = createTexture(1u, 1u, GL_TEXTURE_2D, GL_RGBA, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+	texture_registry::insert(key, texture, sizeof(grey));
+	// Hold an extra reference until the texture is fully streamed in, so
+	// that it can not get evicted in the meantime.
+	texture_registry::acquire(key);
+
+	// Queried here, as it needs the GL context.
+	auto const compress = isTextureCompressionSupported();
+	auto const path = config::resources_path("textures/" + filename);
+	_loading.push_back(thread_pool::shared().submit([this, texture, filename, path, generate_mipmap, compress](){
+		texture_upload upload;
+		upload.texture = texture;
+		upload.filename = filename;
+		upload.generate_mipmap = generate_mipmap;
+		upload.error = texture_cache::load(path, true, compress, nullptr, upload.image);
+		upload.next_level = upload.error != 0u ? 0u : generate_mipmap ? upload.image.levels().size() : 1u;
+		upload.bytes = 0u;
+		_loaded_textures.push(std::move(upload));
+	}));
+
+	return texture;
+}
+
+bonobo::asset_streamer::handle
+bonobo::asset_streamer::request_objects(std::string const& filename, vertex_layout layout, geometry_pool* pool)
+{
+	auto const id = static_cast<handle>(_scenes.size() + 1u);
+	_scenes.emplace_back(new scene_request{ filename, layout, pool, std::vector<mesh_data>(), 0u, false });
+
+	// The CPU data does not depend on the layout nor the pool, so it is
+	// loaded once for all the requests made while it is in flight.
+	auto& waiting = _loading_scenes[filename];
+	waiting.push_back(id);
+	if (waiting.size() > 1u)
+		return id;
+
+	auto const scene_filepath = config::resources_path("scenes/" + filename);
+	auto const import_flags = getImportFlags();
+	_loading.push_back(thread_pool::shared().submit([this, filename, scene_filepath, import_flags](){
+		using level = imported_scene::message::level;
+		auto source = std::make_shared<scene_source>();
+		u64 source_hash = 0u;
+		auto const is_readable = mesh_cache::hashSource(scene_filepath, source_hash);
+		auto const cache_filepath = mesh_cache::getCachePath(scene_filepath);
+		source->cache.reset(new mesh_cache::reader);
+		if (!is_readable || !source->cache->open(cache_filepath, source_hash, import_flags)) {
+			source->cache.reset();
+			source->imported.reset(new imported_scene);
+			auto& imported = *source->imported;
+			// Prepared on this worker alone: waiting on other workers of
+			// the same pool could deadlock it.
+			if (!is_readable) {
+				imported.messages.push_back({ level::error, "Failed to open \"" + scene_filepath + "\"" });
+			} else if (importScene(scene_filepath, nullptr, imported)) {
+				if (vfs::isPacked(scene_filepath))
+					imported.messages.push_back({ level::info, "\t* no mesh cache written, as \"" + scene_filepath + "\" comes from a pack" });
+				else if (!mesh_cache::write(cache_filepath, source_hash, import_flags, imported.scene))
+					imported.messages.push_back({ level::warning, "Failed to write the mesh cache \"" + cache_filepath + "\"" });
+			}
+		}
+		source->bounds.reserve(source->scene().meshes.size());
+		for (auto const& mesh : source->scene().meshes)
+			source->bounds.push_back(computeBounds(mesh));
+		_loaded_scenes.push(loaded_scene{ filename, std::move(source) });
+	}));
+
+	return id;
+}
+
+bool
+bonobo::asset_streamer::is_resident(handle scene) const
+{
+	assert(scene != 0u && scene <= _scenes.size());
+	return _scenes[scene - 1u]->resident;
+}
+
+std::vector<bonobo::mesh_data> const&
+bonobo::asset_streamer::get_objects(handle scene) const
+{
+	assert(scene != 0u && scene <= _scenes.size());
+	return _scenes[scene - 1u]->objects;
+}
+
+u32
+bonobo::asset_streamer::get_revision(handle scene) const
+{
+	assert(scene != 0u && scene <= _scenes.size());
+	return _scenes[scene - 1u]->revision;
+}
+
+void
+bonobo::asset_streamer::start_scene_upload(handle id, std::shared_ptr<scene_source const> const& source)
+{
+	auto& request = *_scenes[id - 1u];
+	auto const& cached_scene = source->scene();
+	scene_upload upload;
+	upload.id = id;
+	upload.next_mesh = 0u;
+	upload.materials_bindings.reserve(cached_scene.materials.size());
+	for (auto const& material : cached_scene.materials) {
+		texture_bindings bindings;
+		for (auto const& reference : material)
+			bindings.emplace(reference.binding, request_texture2D(reference.path, reference.generate_mipmap));
+		upload.materials_bindings.push_back(std::move(bindings));
+	}
+
+	request.objects.reserve(cached_scene.meshes.size());
+	for (auto const& bounds : source->bounds) {
+		auto placeholder = _placeholder_mesh;
+		placeholder.vertex_dequantisation = bounds;
+		request.objects.push_back(placeholder);
+	}
+	request.resident = cached_scene.meshes.empty();
+	++request.revision;
+
+	upload.source = source;
+	if (!request.resident)
+		_scene_uploads.push_back(std::move(upload));
+}
+
+u64
+bonobo::asset_streamer::upload_next_mesh()
+{
+	auto& upload = _scene_uploads.front();
+	auto& request = *_scenes[upload.id - 1u];
+	auto const& scene = upload.source->scene();
+	auto const& mesh = scene.meshes[upload.next_mesh];
+
+	auto const stream = [](f32 const* values){
+		return reinterpret_cast<glm::vec3 const*>(values);
+	};
+	vertex_streams streams;
+	streams.vertices_nb = mesh.vertices_nb;
+	streams.vertices    = stream(mesh.vertices);
+	streams.normals     = stream(mesh.normals);
+	streams.texcoords   = stream(mesh.texcoords);
+	streams.tangents    = stream(mesh.tangents);
+	streams.binormals   = stream(mesh.binormals);
+	resource_registry::scoped_owner owner(request.filename.c_str());
+	auto object = request.pool != nullptr
+	            ? request.pool->get_mesh(request.pool->allocate(streams, mesh.indices, mesh.indices_nb), mesh.drawing_mode)
+	            : createMesh(streams, mesh.indices, mesh.indices_nb, request.layout, mesh.drawing_mode);
+	if (mesh.material_id >= upload.materials_bindings.size())
+		LogError("Object \"%s\" has a material index of %u, but only %u materials were retrieved.", mesh.name.c_str(), mesh.material_id, upload.materials_bindings.size());
+	else
+		object.bindings = upload.materials_bindings[mesh.material_id];
+	if (mesh.meshlets != nullptr)
+		object.meshlets = std::make_shared<std::vector<meshlets::meshlet> const>(mesh.meshlets, mesh.meshlets + mesh.meshlets_nb);
+	if (mesh.lods != nullptr) {
+		object.lods = std::make_shared<mesh_simplifier::lod_chain const>(mesh_cache::getLodChain(mesh));
+		object.indices_nb = mesh.lods[0].indices_nb;
+	}
+
+	request.objects[upload.next_mesh] = object;
+	++request.revision;
+	++_stats.meshes_nb;
+	auto const bytes = getUploadedBytes(mesh);
+
+	if (++upload.next_mesh == scene.meshes.size()) {
+		request.resident = true;
+		LogInfo("\"%s\" is resident: %u meshes", request.filename.c_str(), static_cast<unsigned int>(scene.meshes.size()));
+		if (request.pool != nullptr)
+			request.pool->log_statistics();
+		_scene_uploads.pop_front();
+	}
+
+	return bytes;
+}
+
+// Levels are staged through the shared staging ring, which only waits on
+// the GPU once it wraps around onto uploads still in flight.
+u64
+bonobo::asset_streamer::upload_next_level()
+{
+	auto& upload = _texture_uploads.front();
+	auto const levels_nb = upload.next_level;
+	auto const level_id = --upload.next_level;
+	auto const& level = upload.image.levels()[level_id];
+	auto const pixels = upload.image.data() + level.offset;
+
+	glBindTexture(GL_TEXTURE_2D, upload.texture);
+	auto const fmt = upload.image.format();
+	auto const width = static_cast<GLsizei>(level.width), height = static_cast<GLsizei>(level.height);
+	staging_ring::shared().upload_pixels(pixels, level.size, [&](GLvoid const* source){
+		if (fmt == block_compression::format::rgba8)
+			glTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(level_id), GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, source);
+		else
+			glCompressedTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(level_id), getCompressedInternalFormat(fmt), width, height, 0,
+			                       static_cast<GLsizei>(level.size), source);
+	});
+
+	// Only sample the levels uploaded so far, which form a complete chain
+	// on their own; the placeholder level 0 is left out until replaced.
+	auto const total_levels_nb = upload.generate_mipmap ? upload.image.levels().size() : 1u;
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, static_cast<GLint>(level_id));
+	if (levels_nb == total_levels_nb) {
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(total_levels_nb) - 1);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, upload.generate_mipmap ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0u);
+
+	upload.bytes += level.size;
+	texture_registry::updateBytes(upload.texture, upload.bytes);
+
+	if (upload.next_level == 0u) {
+		LogTrivia("\t\t%s (%ux%u) streamed in: %.2f MiB, %s", upload.filename.c_str(), upload.image.width, upload.image.height,
+		          upload.bytes / (1024.0 * 1024.0), upload.image.from_cache ? "from cache" : "baked");
+		if (!upload.image.from_cache && upload.image.cache_writable && !upload.image.cache_written)
+			LogWarning("Failed to write the texture cache of \"%s\"", upload.filename.c_str());
+		texture_registry::release(upload.texture);
+		++_stats.textures_nb;
+		_texture_uploads.pop_front();
+	}
+
+	return level.size;
+}
+
+void
+bonobo::asset_streamer::update()
+{
+	auto const start_time = StartTimer();
+
+	loaded_scene scene;
+	while (_loaded_scenes.try_pop(scene)) {
+		if (scene.source->imported != nullptr) {
+			LogInfo("Imported \"%s\" in the background", scene.filename.c_str());
+			logImportMessages(*scene.source->imported);
+		}
+		auto const waiting = _loading_scenes.find(scene.filename);
+		assert(waiting != _loading_scenes.end());
+		auto const ids = std::move(waiting->second);
+		_loading_scenes.erase(waiting);
+		for (auto const id : ids)
+			start_scene_upload(id, scene.source);
+	}
+
+	texture_upload texture;
+	while (_loaded_textures.try_pop(texture)) {
+		if (texture.error != 0u) {
+			LogWarning("Couldn't load or decode image file %s: %s", texture.filename.c_str(), lodepng_error_text(texture.error));
+			texture_registry::release(texture.texture);
+			continue;
+		}
+		_texture_uploads.push_back(std::move(texture));
+	}
+
+	_loading.erase(std::remove_if(_loading.begin(), _loading.end(), [](std::future<void> const& task){
+		return task.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+	}), _loading.end());
+
+	// Meshes go first, as their placeholders stand out more than the
+	// placeholder textures do.
+	u64 frame_bytes = 0u;
+	for (bool first_unit = true; first_unit || frame_bytes < _upload_budget; first_unit = false) {
+		if (!_scene_uploads.empty())
+			frame_bytes += upload_next_mesh();
+		else if (!_texture_uploads.empty())
+			frame_bytes += upload_next_level();
+		else
+			break;
+	}
+
+	auto const update_ms = EndTimerSeconds(start_time) * 1000.0;
+	++_stats.frames_nb;
+	if (!_scene_uploads.empty() || !_texture_uploads.empty())
+		++_stats.stalled_frames_nb;
+	_stats.frame_bytes = frame_bytes;
+	_stats.total_bytes += frame_bytes;
+	_stats.last_update_ms = update_ms;
+	_stats.max_update_ms = std::max(_stats.max_update_ms, update_ms);
+}
+
+bonobo::asset_streamer::statistics
+bonobo::asset_streamer::get_statistics() const
+{
+	auto stats = _stats;
+	stats.loading_nb = _loading.size();
+	stats.uploads_nb = _loaded_textures.size() + _loaded_scenes.size() + _texture_uploads.size() + _scene_uploads.size();
+	return stats;
+}
+
+void
+bonobo::asset_streamer::log_statistics() const
+{
+	auto const stats = get_statistics();
+	LogInfo("Asset streamer: %u loading, %u to upload, %u textures and %u meshes streamed in, %.2f MiB over %u frames (%u stalled), update %.2f ms max",
+	        static_cast<unsigned int>(stats.loading_nb), static_cast<unsigned int>(stats.uploads_nb),
+	        static_cast<unsigned int>(stats.textures_nb), static_cast<unsigned int>(stats.meshes_nb),
+	        stats.total_bytes / (1024.0 * 1024.0), static_cast<unsigned int>(stats.frames_nb),
+	        static_cast<unsigned int>(stats.stalled_frames_nb), stats.max_update_ms);
+}
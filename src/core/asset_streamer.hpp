@@ -0,0 +1,183 @@
+#pragma once
+
+#include "core/helpers.hpp"
+#include "core/mesh_cache.hpp"
+#include "core/texture_cache.hpp"
+#include "core/thread_pool.hpp"
+#include "core/Types.h"
+
+#include <deque>
+#include <future>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace bonobo
+{
+	class geometry_pool;
+
+	//! \brief Loads textures and scenes in the background, and uploads
+	//!        them to OpenGL a bit at a time, within a per-frame budget.
+	//!
+	//! Requests return right away. Textures can be bound immediately: they
+	//! show a grey placeholder until their levels get streamed in,
+	//! smallest first. Scenes can be drawn immediately through
+	//! `get_objects()`: meshes not uploaded yet are stood in for by a cube
+	//! spanning their bounds.
+	//!
+	//! Reading, decoding and baking files happens on the shared thread
+	//! pool, while `update()`, called once per frame from the thread
+	//! owning the GL context, performs the uploads: one unit at a time,
+	//! i.e. a texture level or a mesh, until the bytes uploaded during the
+	//! frame exceed the budget. At least one unit is uploaded per frame,
+	//! however large, so that streaming always progresses.
+	class asset_streamer
+	{
+	public:
+		//! \brief Identifies a scene request; 0 is never a valid handle.
+		using handle = u32;
+
+		//! \brief Counters describing the streaming activity.
+		struct statistics {
+			size_t loading_nb;        //!< requests being read or decoded by workers
+			size_t uploads_nb;        //!< loaded requests waiting for, or in the middle of, their upload
+			size_t textures_nb;       //!< textures fully streamed in
+			size_t meshes_nb;         //!< meshes uploaded
+			u64 frame_bytes;          //!< uploaded during the last `update()`
+			u64 total_bytes;          //!< uploaded since creation
+			size_t frames_nb;         //!< calls to `update()`
+			size_t stalled_frames_nb; //!< frames which ran out of budget with uploads left
+			double last_update_ms;    //!< time spent in the last `update()`
+			double max_update_ms;     //!< longest time spent in an `update()`
+		};
+
+		//! \brief Create the placeholder mesh.
+		//!
+		//! @param [in] upload_budget how many bytes to upload per frame
+		explicit asset_streamer(u64 upload_budget = 4ull * 1024ull * 1024ull);
+
+		//! \brief Wait for the workers to be done with all requests, and
+		//!        drop the uploads left.
+		//!
+		//! Textures and meshes already handed out stay valid.
+		~asset_streamer();
+
+		asset_streamer(asset_streamer const&) = delete;
+		asset_streamer& operator=(asset_streamer const&) = delete;
+
+		//! \brief Set how many bytes to upload per frame.
+		void set_upload_budget(u64 bytes) { _upload_budget = bytes; }
+		u64 get_upload_budget() const { return _upload_budget; }
+
+		//! \brief Stream a PNG image into an OpenGL 2D-texture.
+		//!
+		//! The texture is shared through `bonobo::texture_registry` with
+		//! `loadTexture2D()`, and is to be released the same way.
+		//!
+		//! @param [in] filename of the PNG image, relative to the
+		//!             `textures` folder within the `resources` folder
+		//! @param [in] generate_mipmap whether or not to stream in a
+		//!             mipmap hierarchy
+		//! @return the name of the OpenGL 2D-texture, usable right away
+		GLuint request_texture2D(std::string const& filename, bool generate_mipmap = true);
+
+		//! \brief Stream the objects found in an object/scene file.
+		//!
+		//! Scenes are read from their mesh cache when it is up to date, and
+		//! imported otherwise, both on a worker; imports then write the
+		//! cache. Requests for a file which is still being loaded share
+		//! that load.
+		//!
+		//! @param [in] filename, layout, pool see `loadObjects()`
+		//! @return a handle to query the objects with
+		handle request_objects(std::string const& filename,
+		                       vertex_layout layout = vertex_layout::planar,
+		                       geometry_pool* pool = nullptr);
+
+		//! \brief Whether all meshes of a scene have been uploaded; their
+		//!        textures may still be streaming in.
+		bool is_resident(handle scene) const;
+
+		//! \brief Get the objects of a scene, placeholders included.
+		//!
+		//! Empty until the scene file has been read by a worker.
+		std::vector<mesh_data> const& get_objects(handle scene) const;
+
+		//! \brief Number incremented whenever `get_objects()` changes.
+		u32 get_revision(handle scene) const;
+
+		//! \brief Cube spanning [-1, 1] along each axis, standing in for
+		//!        meshes not uploaded yet.
+		mesh_data const& get_placeholder_mesh() const { return _placeholder_mesh; }
+
+		//! \brief Hand loaded requests over to the upload queue and
+		//!        upload as much of it as the budget allows.
+		//!
+		//! To be called once per frame.
+		void update();
+
+		//! \brief Get the current statistics.
+		statistics get_statistics() const;
+
+		//! \brief Log the current statistics.
+		void log_statistics() const;
+
+	private:
+		struct texture_upload {
+			GLuint texture;
+			std::string filename;
+			bool generate_mipmap;
+			texture_cache::loaded_image image;
+			unsigned int error;
+			size_t next_level; //!< levels [0, next_level) are still to be uploaded
+			u64 bytes;         //!< uploaded so far
+		};
+
+		//! \brief CPU data of a scene file, shared by all the requests
+		//!        for it.
+		struct scene_source {
+			std::unique_ptr<mesh_cache::reader> cache; //!< nullptr if missing or stale
+			std::unique_ptr<imported_scene> imported;  //!< used instead of the cache, if nullptr
+			std::vector<glm::mat4> bounds;             //!< transform from the placeholder mesh to each mesh bounds
+
+			mesh_cache::scene_view const& scene() const { return cache != nullptr ? cache->scene() : imported->scene; }
+		};
+
+		struct loaded_scene {
+			std::string filename;
+			std::shared_ptr<scene_source const> source;
+		};
+
+		struct scene_upload {
+			handle id;
+			std::shared_ptr<scene_source const> source;
+			std::vector<texture_bindings> materials_bindings;
+			size_t next_mesh;
+		};
+
+		struct scene_request {
+			std::string filename;
+			vertex_layout layout;
+			geometry_pool* pool;
+			std::vector<mesh_data> objects;
+			u32 revision;
+			bool resident;
+		};
+
+		void start_scene_upload(handle id, std::shared_ptr<scene_source const> const& source);
+		u64 upload_next_mesh();
+		u64 upload_next_level();
+
+		u64 _upload_budget;
+		mesh_data _placeholder_mesh;
+		std::vector<std::unique_ptr<scene_request>> _scenes; // indexed by handle - 1
+		std::unordered_map<std::string, std::vector<handle>> _loading_scenes; // scene file -> requests waiting for it
+		std::deque<std::future<void>> _loading;
+		completion_queue<texture_upload> _loaded_textures;
+		completion_queue<loaded_scene> _loaded_scenes;
+		std::deque<texture_upload> _texture_uploads;
+		std::deque<scene_upload> _scene_uploads;
+		statistics _stats;
+	};
+}
@@ -0,0 +1,565 @@
+#include "block_compression.hpp"
+
+#include "core/thread_pool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <future>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	include <emmintrin.h>
+#	define BONOBO_BLOCK_COMPRESSION_SSE2 1
+#endif
+
+namespace
+{
+	using bonobo::block_compression::format;
+
+	u32 blocksCount(u32 size)
+	{
+		return (size + 3u) / 4u;
+	}
+
+	//! \brief Quantise the projections of 16 points on a segment.
+	//!
+	//! Computes, for every point p, round(dot(p - origin, direction) *
+	//! steps) clamped to [0, steps]; `direction` is expected to be
+	//! divided by the squared length of the segment.
+	void quantizeProjections(float const* const* channels, int channels_nb, float const* origin,
+	                         float const* direction, float steps, int* steps_out)
+	{
+#ifdef BONOBO_BLOCK_COMPRESSION_SSE2
+		auto const zero = _mm_setzero_ps();
+		auto const maximum = _mm_set1_ps(steps);
+		for (int i = 0; i < 16; i += 4) {
+			auto t = _mm_setzero_ps();
+			for (int c = 0; c < channels_nb; ++c) {
+				auto const delta = _mm_sub_ps(_mm_loadu_ps(channels[c] + i), _mm_set1_ps(origin[c]));
+				t = _mm_add_ps(t, _mm_mul_ps(delta, _mm_set1_ps(direction[c])));
+			}
+			t = _mm_min_ps(_mm_max_ps(_mm_mul_ps(t, maximum), zero), maximum);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(steps_out + i), _mm_cvtps_epi32(t));
+		}
+#else
+		for (int i = 0; i < 16; ++i) {
+			float t = 0.0f;
+			for (int c = 0; c < channels_nb; ++c)
+				t += (channels[c][i] - origin[c]) * direction[c];
+			steps_out[i] = static_cast<int>(std::lround(std::min(std::max(t * steps, 0.0f), steps)));
+		}
+#endif
+	}
+
+	//! \brief Gather a 4x4 block, repeating the border texels of the
+	//!        image where the block goes past it.
+	void fetchBlock(u8 const* rgba, u32 width, u32 height, std::ptrdiff_t row_stride, u32 block_x, u32 block_y, u8* texels)
+	{
+		for (u32 y = 0u; y < 4u; ++y) {
+			auto const row = rgba + static_cast<std::ptrdiff_t>(std::min(block_y * 4u + y, height - 1u)) * row_stride;
+			for (u32 x = 0u; x < 4u; ++x)
+				std::memcpy(texels + (y * 4u + x) * 4u, row + std::min(block_x * 4u + x, width - 1u) * 4u, 4u);
+		}
+	}
+
+	u16 packRGB565(float const* color)
+	{
+		auto const quantize = [](float value, float max) {
+			return static_cast<u16>(std::lround(std::min(std::max(value, 0.0f), 255.0f) * max / 255.0f));
+		};
+		return static_cast<u16>((quantize(color[0], 31.0f) << 11) | (quantize(color[1], 63.0f) << 5) | quantize(color[2], 31.0f));
+	}
+
+	void unpackRGB565(u16 color, int* rgb)
+	{
+		auto const r = (color >> 11) & 31, g = (color >> 5) & 63, b = color & 31;
+		rgb[0] = (r << 3) | (r >> 2);
+		rgb[1] = (g << 2) | (g >> 4);
+		rgb[2] = (b << 3) | (b >> 2);
+	}
+
+	// Palette entries, in quantisation step order, of a 4-colour block:
+	// step s is stored as index steps_to_index[s].
+	int const bc1_steps_to_index[4] = { 0, 2, 3, 1 };
+
+	//! \brief Choose indices for the given endpoints.
+	//!
+	//! @return the squared error of the block
+	float selectColorIndices(float const* const* channels, u16 c0, u16 c1, u32& indices)
+	{
+		int p0[3], p1[3];
+		unpackRGB565(c0, p0);
+		unpackRGB565(c1, p1);
+		int palette[4][3];
+		for (int c = 0; c < 3; ++c) {
+			palette[0][c] = p0[c];
+			palette[1][c] = p1[c];
+			palette[2][c] = (2 * p0[c] + p1[c]) / 3;
+			palette[3][c] = (p0[c] + 2 * p1[c]) / 3;
+		}
+
+		float origin[3], direction[3];
+		float length2 = 0.0f;
+		for (int c = 0; c < 3; ++c) {
+			origin[c] = static_cast<float>(p0[c]);
+			direction[c] = static_cast<float>(p1[c] - p0[c]);
+			length2 += direction[c] * direction[c];
+		}
+		int steps[16] = {};
+		if (length2 > 0.0f) {
+			for (int c = 0; c < 3; ++c)
+				direction[c] /= length2;
+			quantizeProjections(channels, 3, origin, direction, 3.0f, steps);
+		}
+
+		indices = 0u;
+		float error = 0.0f;
+		for (int i = 0; i < 16; ++i) {
+			auto const index = bc1_steps_to_index[steps[i]];
+			indices |= static_cast<u32>(index) << (2 * i);
+			for (int c = 0; c < 3; ++c) {
+				auto const delta = channels[c][i] - static_cast<float>(palette[index][c]);
+				error += delta * delta;
+			}
+		}
+		return error;
+	}
+
+	//! \brief Quantise two endpoints, in 4-colour mode, and pick the
+	//!        indices for them.
+	float fitColorEndpoints(float const* const* channels, float const* e0, float const* e1, u16& c0, u16& c1, u32& indices)
+	{
+		c0 = packRGB565(e0);
+		c1 = packRGB565(e1);
+		// 4-colour mode requires c0 > c1, which also holds for BC3.
+		if (c0 < c1)
+			std::swap(c0, c1);
+		if (c0 == c1) {
+			indices = 0u;
+			int p[3];
+			unpackRGB565(c0, p);
+			float error = 0.0f;
+			for (int c = 0; c < 3; ++c)
+				for (int i = 0; i < 16; ++i)
+					error += (channels[c][i] - p[c]) * (channels[c][i] - p[c]);
+			return error;
+		}
+		return selectColorIndices(channels, c0, c1, indices);
+	}
+
+	//! \brief Encode the colour part of a BC1 or BC3 block.
+	//!
+	//! The endpoints are first placed at the extremities of the colours
+	//! along their principal axis, slightly inset, and then refined once
+	//! by a least-squares fit to the chosen indices.
+	void encodeColorBlock(u8 const* rgba, u8* block)
+	{
+		float r[16], g[16], b[16];
+		float mean[3] = { 0.0f, 0.0f, 0.0f };
+		for (int i = 0; i < 16; ++i) {
+			r[i] = rgba[i * 4 + 0];
+			g[i] = rgba[i * 4 + 1];
+			b[i] = rgba[i * 4 + 2];
+			mean[0] += r[i];
+			mean[1] += g[i];
+			mean[2] += b[i];
+		}
+		float const* const channels[3] = { r, g, b };
+		for (auto& m : mean)
+			m /= 16.0f;
+
+		float covariance[6] = {}; // rr, rg, rb, gg, gb, bb
+		float minimum[3] = { 255.0f, 255.0f, 255.0f }, maximum[3] = { 0.0f, 0.0f, 0.0f };
+		for (int i = 0; i < 16; ++i) {
+			float const d[3] = { r[i] - mean[0], g[i] - mean[1], b[i] - mean[2] };
+			covariance[0] += d[0] * d[0];
+			covariance[1] += d[0] * d[1];
+			covariance[2] += d[0] * d[2];
+			covariance[3] += d[1] * d[1];
+			covariance[4] += d[1] * d[2];
+			covariance[5] += d[2] * d[2];
+			for (int c = 0; c < 3; ++c) {
+				minimum[c] = std::min(minimum[c], channels[c][i]);
+				maximum[c] = std::max(maximum[c], channels[c][i]);
+			}
+		}
+
+		// Principal axis through power iterations, starting from the
+		// diagonal of the bounding box.
+		float axis[3] = { maximum[0] - minimum[0], maximum[1] - minimum[1], maximum[2] - minimum[2] };
+		for (int iteration = 0; iteration < 4; ++iteration) {
+			float const next[3] = {
+				covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2],
+				covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2],
+				covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2]
+			};
+			auto const largest = std::max(std::fabs(next[0]), std::max(std::fabs(next[1]), std::fabs(next[2])));
+			if (largest <= 0.0f)
+				break;
+			for (int c = 0; c < 3; ++c)
+				axis[c] = next[c] / largest;
+		}
+		auto const axis_length = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+
+		float e0[3], e1[3];
+		if (axis_length <= 0.0f) {
+			std::copy(mean, mean + 3, e0);
+			std::copy(mean, mean + 3, e1);
+		} else {
+			for (auto& a : axis)
+				a /= axis_length;
+			float low = 0.0f, high = 0.0f;
+			for (int i = 0; i < 16; ++i) {
+				auto const t = (r[i] - mean[0]) * axis[0] + (g[i] - mean[1]) * axis[1] + (b[i] - mean[2]) * axis[2];
+				low = std::min(low, t);
+				high = std::max(high, t);
+			}
+			auto const inset = (high - low) / 16.0f;
+			for (int c = 0; c < 3; ++c) {
+				e0[c] = mean[c] + axis[c] * (high - inset);
+				e1[c] = mean[c] + axis[c] * (low + inset);
+			}
+		}
+
+		u16 c0, c1;
+		u32 indices;
+		auto error = fitColorEndpoints(channels, e0, e1, c0, c1, indices);
+
+		// Least-squares refit: each texel is a known blend of the two
+		// endpoints, solve the 2x2 normal equations for them.
+		if (c0 != c1 && error > 0.0f) {
+			float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+			float ax[3] = {}, bx[3] = {};
+			for (int i = 0; i < 16; ++i) {
+				auto const index = (indices >> (2 * i)) & 3u;
+				static float const weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+				auto const alpha = weights[index], beta = 1.0f - alpha;
+				aa += alpha * alpha;
+				ab += alpha * beta;
+				bb += beta * beta;
+				for (int c = 0; c < 3; ++c) {
+					ax[c] += alpha * channels[c][i];
+					bx[c] += beta * channels[c][i];
+				}
+			}
+			auto const determinant = aa * bb - ab * ab;
+			if (std::fabs(determinant) > 1e-6f) {
+				float f0[3], f1[3];
+				for (int c = 0; c < 3; ++c) {
+					f0[c] = (ax[c] * bb - bx[c] * ab) / determinant;
+					f1[c] = (bx[c] * aa - ax[c] * ab) / determinant;
+				}
+				u16 d0, d1;
+				u32 refit_indices;
+				auto const refit_error = fitColorEndpoints(channels, f0, f1, d0, d1, refit_indices);
+				if (refit_error < error) {
+					c0 = d0;
+					c1 = d1;
+					indices = refit_indices;
+					error = refit_error;
+				}
+			}
+		}
+
+		std::memcpy(block + 0, &c0, 2u);
+		std::memcpy(block + 2, &c1, 2u);
+		std::memcpy(block + 4, &indices, 4u);
+	}
+
+	//! \brief Encode one channel as a BC4 block, as used for the alpha of
+	//!        BC3 and for both channels of BC5.
+	void encodeChannelBlock(u8 const* rgba, int channel, u8* block)
+	{
+		float values[16];
+		float low = 255.0f, high = 0.0f;
+		for (int i = 0; i < 16; ++i) {
+			values[i] = rgba[i * 4 + channel];
+			low = std::min(low, values[i]);
+			high = std::max(high, values[i]);
+		}
+
+		// 8-value mode, with a0 > a1: step s in [0, 7] going from a0 to
+		// a1 is stored as index 0 for s = 0, 1 for s = 7 and s + 1 otherwise.
+		block[0] = static_cast<u8>(high);
+		block[1] = static_cast<u8>(low);
+		int steps[16] = {};
+		if (high > low) {
+			float const* const channels[1] = { values };
+			float const direction = -1.0f / (high - low);
+			quantizeProjections(channels, 1, &high, &direction, 7.0f, steps);
+		}
+
+		u64 indices = 0u;
+		for (int i = 0; i < 16; ++i) {
+			auto const index = steps[i] == 0 ? 0 : steps[i] == 7 ? 1 : steps[i] + 1;
+			indices |= static_cast<u64>(index) << (3 * i);
+		}
+		for (int i = 0; i < 6; ++i)
+			block[2 + i] = static_cast<u8>(indices >> (8 * i));
+	}
+
+	void decodeColorBlock(u8 const* block, u8* rgba, bool allow_three_colors)
+	{
+		u16 c0, c1;
+		u32 indices;
+		std::memcpy(&c0, block + 0, 2u);
+		std::memcpy(&c1, block + 2, 2u);
+		std::memcpy(&indices, block + 4, 4u);
+
+		int p0[3], p1[3];
+		unpackRGB565(c0, p0);
+		unpackRGB565(c1, p1);
+		int palette[4][4];
+		for (int c = 0; c < 3; ++c) {
+			palette[0][c] = p0[c];
+			palette[1][c] = p1[c];
+			if (c0 > c1 || !allow_three_colors) {
+				palette[2][c] = (2 * p0[c] + p1[c]) / 3;
+				palette[3][c] = (p0[c] + 2 * p1[c]) / 3;
+			} else {
+				palette[2][c] = (p0[c] + p1[c]) / 2;
+				palette[3][c] = 0;
+			}
+		}
+		for (int i = 0; i < 4; ++i)
+			palette[i][3] = 255;
+		if (c0 <= c1 && allow_three_colors)
+			palette[3][3] = 0;
+
+		for (int i = 0; i < 16; ++i) {
+			auto const index = (indices >> (2 * i)) & 3u;
+			for (int c = 0; c < 4; ++c)
+				rgba[i * 4 + c] = static_cast<u8>(palette[index][c]);
+		}
+	}
+
+	void decodeChannelBlock(u8 const* block, u8* rgba, int channel)
+	{
+		int const a0 = block[0], a1 = block[1];
+		int palette[8] = { a0, a1 };
+		if (a0 > a1) {
+			for (int i = 1; i < 7; ++i)
+				palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+		} else {
+			for (int i = 1; i < 5; ++i)
+				palette[i + 1] = ((5 - i) * a0 + i * a1) / 5;
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+
+		u64 indices = 0u;
+		for (int i = 0; i < 6; ++i)
+			indices |= static_cast<u64>(block[2 + i]) << (8 * i);
+		for (int i = 0; i < 16; ++i)
+			rgba[i * 4 + channel] = static_cast<u8>(palette[(indices >> (3 * i)) & 7u]);
+	}
+
+	void encodeBlockRows(format fmt, u8 const* rgba, u32 width, u32 height, std::ptrdiff_t row_stride,
+	                     u8* blocks, u32 first_row, u32 last_row)
+	{
+		auto const block_size = bonobo::block_compression::getBlockSize(fmt);
+		auto const blocks_per_row = blocksCount(width);
+		u8 texels[64];
+		for (u32 y = first_row; y < last_row; ++y)
+			for (u32 x = 0u; x < blocks_per_row; ++x) {
+				fetchBlock(rgba, width, height, row_stride, x, y, texels);
+				bonobo::block_compression::encodeBlock(fmt, texels, blocks + (static_cast<size_t>(y) * blocks_per_row + x) * block_size);
+			}
+	}
+
+}
+
+size_t
+bonobo::block_compression::getBlockSize(format fmt)
+{
+	return fmt == format::bc1 ? 8u : fmt == format::rgba8 ? 64u : 16u;
+}
+
+size_t
+bonobo::block_compression::getLevelSize(format fmt, u32 width, u32 height)
+{
+	if (fmt == format::rgba8)
+		return static_cast<size_t>(width) * height * 4u;
+	return static_cast<size_t>(blocksCount(width)) * blocksCount(height) * getBlockSize(fmt);
+}
+
+bonobo::block_compression::format
+bonobo::block_compression::chooseFormat(u8 const* rgba, u32 width, u32 height)
+{
+	auto const texels_nb = static_cast<size_t>(width) * height;
+	for (size_t i = 0u; i < texels_nb; ++i)
+		if (rgba[i * 4u + 3u] != 255u)
+			return format::bc3;
+	return format::bc1;
+}
+
+void
+bonobo::block_compression::encodeBlock(format fmt, u8 const* rgba, u8* block)
+{
+	switch (fmt) {
+	case format::bc1:
+		encodeColorBlock(rgba, block);
+		break;
+	case format::bc3:
+		encodeChannelBlock(rgba, 3, block);
+		encodeColorBlock(rgba, block + 8);
+		break;
+	case format::bc5:
+		encodeChannelBlock(rgba, 0, block);
+		encodeChannelBlock(rgba, 1, block + 8);
+		break;
+	case format::rgba8:
+		std::memcpy(block, rgba, 64u);
+		break;
+	}
+}
+
+void
+bonobo::block_compression::decodeBlock(format fmt, u8 const* block, u8* rgba)
+{
+	switch (fmt) {
+	case format::bc1:
+		decodeColorBlock(block, rgba, true);
+		break;
+	case format::bc3:
+		decodeColorBlock(block + 8, rgba, false);
+		decodeChannelBlock(block, rgba, 3);
+		break;
+	case format::bc5:
+		for (int i = 0; i < 16; ++i) {
+			rgba[i * 4 + 2] = 0u;
+			rgba[i * 4 + 3] = 255u;
+		}
+		decodeChannelBlock(block, rgba, 0);
+		decodeChannelBlock(block + 8, rgba, 1);
+		break;
+	case format::rgba8:
+		std::memcpy(rgba, block, 64u);
+		break;
+	}
+}
+
+void
+bonobo::block_compression::encodeImage(format fmt, u8 const* rgba, u32 width, u32 height, std::ptrdiff_t row_stride,
+                                       u8* blocks, thread_pool* pool)
+{
+	if (fmt == format::rgba8) {
+		auto const row_size = static_cast<size_t>(width) * 4u;
+		for (u32 y = 0u; y < height; ++y)
+			std::memcpy(blocks + y * row_size, rgba + static_cast<std::ptrdiff_t>(y) * row_stride, row_size);
+		return;
+	}
+
+	auto const block_rows = blocksCount(height);
+	if (pool == nullptr || pool->size() < 2u || block_rows < 2u) {
+		encodeBlockRows(fmt, rgba, width, height, row_stride, blocks, 0u, block_rows);
+		return;
+	}
+
+	// A few chunks per worker, to balance the load between them.
+	auto const chunks_nb = std::min(block_rows, static_cast<u32>(pool->size()) * 4u);
+	std::vector<std::future<void>> chunks;
+	chunks.reserve(chunks_nb);
+	for (u32 i = 0u; i < chunks_nb; ++i) {
+		auto const first_row = static_cast<u32>(static_cast<u64>(block_rows) * i / chunks_nb);
+		auto const last_row = static_cast<u32>(static_cast<u64>(block_rows) * (i + 1u) / chunks_nb);
+		chunks.push_back(pool->submit([=](){
+			encodeBlockRows(fmt, rgba, width, height, row_stride, blocks, first_row, last_row);
+		}));
+	}
+	for (auto& chunk : chunks)
+		chunk.wait();
+}
+
+void
+bonobo::block_compression::decodeImage(format fmt, u8 const* blocks, u32 width, u32 height, u8* rgba)
+{
+	if (fmt == format::rgba8) {
+		std::memcpy(rgba, blocks, getLevelSize(fmt, width, height));
+		return;
+	}
+
+	auto const block_size = getBlockSize(fmt);
+	auto const blocks_per_row = blocksCount(width);
+	u8 texels[64];
+	for (u32 y = 0u; y < blocksCount(height); ++y)
+		for (u32 x = 0u; x < blocks_per_row; ++x) {
+			decodeBlock(fmt, blocks + (static_cast<size_t>(y) * blocks_per_row + x) * block_size, texels);
+			for (u32 row = 0u; row < 4u && y * 4u + row < height; ++row) {
+				auto const columns = std::min(4u, width - x * 4u);
+				std::memcpy(rgba + ((static_cast<size_t>(y) * 4u + row) * width + x * 4u) * 4u, texels + row * 16u, columns * 4u);
+			}
+		}
+}
+
+double
+bonobo::block_compression::computePSNR(format fmt, u8 const* reference, std::ptrdiff_t reference_row_stride,
+                                       u8 const* decoded, u32 width, u32 height)
+{
+	auto const channels_nb = fmt == format::bc1 ? 3u : fmt == format::bc5 ? 2u : 4u;
+	double squared_error = 0.0;
+	for (u32 y = 0u; y < height; ++y) {
+		auto const reference_row = reference + static_cast<std::ptrdiff_t>(y) * reference_row_stride;
+		auto const decoded_row = decoded + static_cast<size_t>(y) * width * 4u;
+		for (u32 x = 0u; x < width; ++x)
+			for (u32 c = 0u; c < channels_nb; ++c) {
+				auto const delta = static_cast<double>(reference_row[x * 4u + c]) - static_cast<double>(decoded_row[x * 4u + c]);
+				squared_error += delta * delta;
+			}
+	}
+	auto const mse = squared_error / (static_cast<double>(width) * height * channels_nb);
+	if (mse <= 0.0)
+		return 999.0;
+	return 10.0 * std::log10(255.0 * 255.0 / mse);
+}
+
+bonobo::block_compression::compressed_image
+bonobo::block_compression::compress(u8 const* rgba, u32 width, u32 height, std::ptrdiff_t row_stride,
+                                    format fmt, mipmaps::options const& mip_options, thread_pool* pool, double* psnr)
+{
+	compressed_image image;
+	image.fmt = fmt;
+	image.width = width;
+	image.height = height;
+
+	size_t data_size = 0u;
+	for (u32 w = width, h = height;; w = mipmaps::getNextSize(w), h = mipmaps::getNextSize(h)) {
+		level_layout const level = { w, h, data_size, getLevelSize(fmt, w, h) };
+		image.levels.push_back(level);
+		data_size += level.size;
+		if (w == 1u && h == 1u)
+			break;
+	}
+	image.data.resize(data_size);
+
+	encodeImage(fmt, rgba, width, height, row_stride, image.data.data(), pool);
+	if (psnr != nullptr) {
+		std::vector<u8> decoded(static_cast<size_t>(width) * height * 4u);
+		decodeImage(fmt, image.data.data(), width, height, decoded.data());
+		*psnr = computePSNR(fmt, rgba, row_stride, decoded.data(), width, height);
+	}
+
+	// Uncompressed levels are generated straight into the image; others
+	// go through a scratch buffer, kept as source for the next level.
+	std::vector<u8> previous_pixels, pixels;
+	auto source = rgba;
+	auto source_stride = row_stride;
+	for (size_t i = 1u; i < image.levels.size(); ++i) {
+		auto const& previous = image.levels[i - 1u];
+		auto const& level = image.levels[i];
+		u8* destination = image.data.data() + level.offset;
+		if (fmt != format::rgba8) {
+			pixels.resize(static_cast<size_t>(level.width) * level.height * 4u);
+			destination = pixels.data();
+		}
+		mipmaps::generateLevel(source, previous.width, previous.height, source_stride, destination, mip_options, pool);
+		source = destination;
+		source_stride = static_cast<std::ptrdiff_t>(level.width) * 4;
+		if (fmt != format::rgba8) {
+			encodeImage(fmt, source, level.width, level.height, source_stride, image.data.data() + level.offset, pool);
+			previous_pixels.swap(pixels); // `source` now points into `previous_pixels`
+		}
+	}
+
+	return image;
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "core/mipmap_generator.hpp"
+#include "core/Types.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace bonobo
+{
+	class thread_pool;
+
+	//! \brief CPU encoder and decoder for the BC1, BC3 and BC5 block
+	//!        compression formats, also known as DXT1, DXT5 and RGTC2.
+	//!
+	//! All formats encode blocks of 4x4 texels: BC1 stores RGB on 8 bytes
+	//! per block, BC3 adds an 8-byte alpha block to it, and BC5 stores two
+	//! independent channels, red and green, on 16 bytes per block. Images
+	//! whose dimensions are not multiples of 4 have their border texels
+	//! repeated to fill in the last blocks. Plain RGBA8 is also handled,
+	//! so that uncompressed mipmap chains go through the same code.
+	//!
+	//! The functions only operate on CPU data and neither use OpenGL nor
+	//! the `Log*()` macros, so they can run on worker threads.
+	namespace block_compression
+	{
+		enum class format : u32 {
+			bc1 = 0u, //!< opaque RGB, 4 bits per texel
+			bc3,      //!< RGBA, 8 bits per texel
+			bc5,      //!< two channels, e.g. tangent-space normals, 8 bits per texel
+			rgba8     //!< uncompressed RGBA, 32 bits per texel
+		};
+
+		//! \brief Location of a mipmap level inside `compressed_image::data`.
+		struct level_layout {
+			u32 width;
+			u32 height;
+			size_t offset; //!< in bytes, from the start of the data
+			size_t size;   //!< in bytes
+		};
+
+		//! \brief Mipmap chain, block-compressed unless stored as RGBA8.
+		struct compressed_image {
+			format fmt;
+			u32 width;
+			u32 height;
+			std::vector<level_layout> levels; //!< from the base level down
+			std::vector<u8> data;
+		};
+
+		//! \brief Size in bytes of one 4x4 block; 64 for RGBA8.
+		size_t getBlockSize(format fmt);
+
+		//! \brief Size in bytes of an image of the given dimensions.
+		size_t getLevelSize(format fmt, u32 width, u32 height);
+
+		//! \brief Pick BC3 if any texel is not fully opaque, BC1 otherwise.
+		//!
+		//! BC5 is never picked, as it can not be told apart from the
+		//! content alone whether an image holds normals.
+		format chooseFormat(u8 const* rgba, u32 width, u32 height);
+
+		//! \brief Encode one block.
+		//!
+		//! @param [in] fmt format to encode to
+		//! @param [in] rgba 16 RGBA texels, row by row
+		//! @param [out] block `getBlockSize(fmt)` bytes
+		void encodeBlock(format fmt, u8 const* rgba, u8* block);
+
+		//! \brief Decode one block.
+		//!
+		//! @param [in] fmt format of the block
+		//! @param [in] block `getBlockSize(fmt)` bytes
+		//! @param [out] rgba 16 RGBA texels, row by row; missing channels
+		//!             are set to 0, or 255 for alpha
+		void decodeBlock(format fmt, u8 const* block, u8* rgba);
+
+		//! \brief Encode a whole image.
+		//!
+		//! @param [in] fmt format to encode to
+		//! @param [in] rgba first row of RGBA texels
+		//! @param [in] width of the image in texels
+		//! @param [in] height of the image in texels
+		//! @param [in] row_stride distance in bytes from one row to the
+		//!             next; can be negative to flip the image
+		//! @param [out] blocks `getLevelSize(fmt, width, height)` bytes
+		//! @param [in] pool if not nullptr, rows of blocks are spread
+		//!             over its workers; must then not be called from one
+		//!             of those workers
+		void encodeImage(format fmt, u8 const* rgba, u32 width, u32 height, std::ptrdiff_t row_stride,
+		                 u8* blocks, thread_pool* pool = nullptr);
+
+		//! \brief Decode a whole image into tightly packed RGBA rows.
+		void decodeImage(format fmt, u8 const* blocks, u32 width, u32 height, u8* rgba);
+
+		//! \brief Peak signal-to-noise ratio, in dB, between two images,
+		//!        over the channels stored by `fmt`.
+		//!
+		//! @return the PSNR, or 999 for identical images
+		double computePSNR(format fmt, u8 const* reference, std::ptrdiff_t reference_row_stride,
+		                   u8 const* decoded, u32 width, u32 height);
+
+		//! \brief Encode an image along with its full mipmap chain.
+		//!
+		//! Each level is generated from the uncompressed previous one.
+		//!
+		//! @param [in] rgba, width, height, row_stride see `encodeImage()`
+		//! @param [in] fmt format to encode to
+		//! @param [in] mip_options how to generate the levels
+		//! @param [in] pool see `encodeImage()`, also used to generate the
+		//!             levels
+		//! @param [out] psnr if not nullptr, receives the PSNR of the base
+		//!              level
+		compressed_image compress(u8 const* rgba, u32 width, u32 height, std::ptrdiff_t row_stride,
+		                          format fmt, mipmaps::options const& mip_options,
+		                          thread_pool* pool = nullptr, double* psnr = nullptr);
+	}
+}
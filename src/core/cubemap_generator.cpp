@@ -0,0 +1,106 @@
+#include "cubemap_generator.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	include <emmintrin.h>
+#	define BONOBO_CUBEMAP_GENERATOR_SSE2 1
+#endif
+
+namespace
+{
+	float const pi = 3.14159265358979323846f;
+
+	//! \brief Direction of the texel (s, t) of a face, both in [-1, 1],
+	//!        as `major + s * s_axis + t * t_axis`.
+	struct face_axes {
+		float major[3];
+		float s_axis[3];
+		float t_axis[3];
+	};
+
+	// From the table of the OpenGL specification selecting the face and
+	// its (sc, tc) coordinates out of a direction; t grows downwards.
+	face_axes const axes[bonobo::cubemaps::faces_nb] = {
+		{ {  1.0f,  0.0f,  0.0f }, {  0.0f, 0.0f, -1.0f }, { 0.0f, -1.0f,  0.0f } }, // +x
+		{ { -1.0f,  0.0f,  0.0f }, {  0.0f, 0.0f,  1.0f }, { 0.0f, -1.0f,  0.0f } }, // -x
+		{ {  0.0f,  1.0f,  0.0f }, {  1.0f, 0.0f,  0.0f }, { 0.0f,  0.0f,  1.0f } }, // +y
+		{ {  0.0f, -1.0f,  0.0f }, {  1.0f, 0.0f,  0.0f }, { 0.0f,  0.0f, -1.0f } }, // -y
+		{ {  0.0f,  0.0f,  1.0f }, {  1.0f, 0.0f,  0.0f }, { 0.0f, -1.0f,  0.0f } }, // +z
+		{ {  0.0f,  0.0f, -1.0f }, { -1.0f, 0.0f,  0.0f }, { 0.0f, -1.0f,  0.0f } }  // -z
+	};
+
+	//! \brief Bilinear fetch at (x, y), in texels, wrapping around
+	//!        horizontally and clamping vertically.
+	void sampleBilinear(u8 const* rgba, u32 width, u32 height, std::ptrdiff_t row_stride, float x, float y, u8* output)
+	{
+		x -= 0.5f;
+		y -= 0.5f;
+		auto const fx = std::floor(x), fy = std::floor(y);
+		auto const tx = x - fx, ty = y - fy;
+		auto const w = static_cast<int>(width), h = static_cast<int>(height);
+		auto const x0 = ((static_cast<int>(fx) % w) + w) % w, x1 = (x0 + 1) % w;
+		auto const y0 = std::min(std::max(static_cast<int>(fy), 0), h - 1), y1 = std::min(static_cast<int>(fy) + 1, h - 1);
+		auto const row0 = rgba + static_cast<std::ptrdiff_t>(std::max(y0, 0)) * row_stride;
+		auto const row1 = rgba + static_cast<std::ptrdiff_t>(std::max(y1, 0)) * row_stride;
+		u8 const* const texels[4] = { row0 + x0 * 4, row0 + x1 * 4, row1 + x0 * 4, row1 + x1 * 4 };
+		float const weights[4] = { (1.0f - tx) * (1.0f - ty), tx * (1.0f - ty), (1.0f - tx) * ty, tx * ty };
+
+#ifdef BONOBO_CUBEMAP_GENERATOR_SSE2
+		// One RGBA texel per register, widened to 32-bit floats.
+		auto const zero = _mm_setzero_si128();
+		auto sum = _mm_set1_ps(0.5f); // rounding
+		for (int i = 0; i < 4; ++i) {
+			int packed;
+			std::copy(texels[i], texels[i] + 4, reinterpret_cast<u8*>(&packed));
+			auto const widened = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero), zero);
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_cvtepi32_ps(widened), _mm_set1_ps(weights[i])));
+		}
+		auto const rounded = _mm_cvttps_epi32(sum);
+		auto const narrowed = _mm_packus_epi16(_mm_packs_epi32(rounded, rounded), zero);
+		auto const result = _mm_cvtsi128_si32(narrowed);
+		std::copy(reinterpret_cast<u8 const*>(&result), reinterpret_cast<u8 const*>(&result) + 4, output);
+#else
+		for (int c = 0; c < 4; ++c) {
+			auto const value = texels[0][c] * weights[0] + texels[1][c] * weights[1]
+			                 + texels[2][c] * weights[2] + texels[3][c] * weights[3];
+			output[c] = static_cast<u8>(std::min(value + 0.5f, 255.0f));
+		}
+#endif
+	}
+}
+
+u32
+bonobo::cubemaps::getFaceSize(u32 equirectangular_width)
+{
+	return std::max(equirectangular_width / 4u, 1u);
+}
+
+void
+bonobo::cubemaps::generateFace(u8 const* rgba, u32 width, u32 height, std::ptrdiff_t row_stride,
+                               u32 face, u32 face_size, u8* output)
+{
+	auto const& a = axes[face];
+	auto const to_u = static_cast<float>(width) / (2.0f * pi), to_v = static_cast<float>(height) / pi;
+	for (u32 y = 0u; y < face_size; ++y) {
+		auto const t = 2.0f * (static_cast<float>(y) + 0.5f) / static_cast<float>(face_size) - 1.0f;
+		float row_origin[3];
+		for (int c = 0; c < 3; ++c)
+			row_origin[c] = a.major[c] + t * a.t_axis[c];
+
+		for (u32 x = 0u; x < face_size; ++x, output += 4) {
+			auto const s = 2.0f * (static_cast<float>(x) + 0.5f) / static_cast<float>(face_size) - 1.0f;
+			auto const dx = row_origin[0] + s * a.s_axis[0];
+			auto const dy = row_origin[1] + s * a.s_axis[1];
+			auto const dz = row_origin[2] + s * a.s_axis[2];
+
+			// Longitude is 0 at the centre of the image, along -z, and
+			// latitude is measured from the equator.
+			auto const longitude = std::atan2(dx, -dz);
+			auto const latitude = std::atan2(dy, std::sqrt(dx * dx + dz * dz));
+			sampleBilinear(rgba, width, height, row_stride,
+			               (longitude + pi) * to_u, (0.5f * pi - latitude) * to_v, output);
+		}
+	}
+}
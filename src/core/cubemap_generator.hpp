@@ -0,0 +1,44 @@
+#pragma once
+
+#include "core/Types.h"
+
+#include <cstddef>
+
+namespace bonobo
+{
+	//! \brief CPU resampling of equirectangular RGBA8 images into the
+	//!        faces of a cube map, so that a skybox can be shipped as a
+	//!        single image rather than as six.
+	//!
+	//! The functions only operate on CPU data and neither use OpenGL nor
+	//! the `Log*()` macros, so they can run on worker threads.
+	namespace cubemaps
+	{
+		//! \brief Number of faces of a cube map.
+		u32 const faces_nb = 6u;
+
+		//! \brief Face size matching the resolution of an image around
+		//!        its equator, where a face spans a quarter of its width.
+		u32 getFaceSize(u32 equirectangular_width);
+
+		//! \brief Resample an equirectangular image into one face.
+		//!
+		//! The image spans longitudes from left to right, the -z axis
+		//! being at its centre, and latitudes from +y at the top row to
+		//! -y at the bottom one. Texels are filtered bilinearly, wrapping
+		//! around horizontally.
+		//!
+		//! @param [in] rgba first row of RGBA texels of the image
+		//! @param [in] width of the image
+		//! @param [in] height of the image
+		//! @param [in] row_stride distance in bytes from one row to the
+		//!             next; can be negative to flip the image
+		//! @param [in] face which face to generate, in the order of the
+		//!             GL_TEXTURE_CUBE_MAP_* targets: +x, -x, +y, -y, +z, -z
+		//! @param [in] face_size width and height of the face
+		//! @param [out] output tightly packed RGBA texels of the face,
+		//!              rows ordered as expected by OpenGL for cube maps
+		void generateFace(u8 const* rgba, u32 width, u32 height, std::ptrdiff_t row_stride,
+		                  u32 face, u32 face_size, u8* output);
+	}
+}
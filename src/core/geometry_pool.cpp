@@ -0,0 +1,431 @@
+#include "geometry_pool.hpp"
+
+#include "core/Log.h"
+#include "core/resource_registry.hpp"
+#include "core/staging_ring.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <numeric>
+
+namespace
+{
+	size_t const vertex_components_nb[] = { 3u, 3u, 2u, 3u, 3u }; // vertices, normals, texcoords, tangents, binormals
+
+	size_t components_nb(u32 attributes)
+	{
+		size_t count = vertex_components_nb[0];
+		for (unsigned int i = 0u; i < 4u; ++i)
+			if ((attributes & (1u << i)) != 0u)
+				count += vertex_components_nb[i + 1u];
+		return count;
+	}
+
+	float fragmentation(size_t largest_free_block, size_t free_size)
+	{
+		return free_size == 0u ? 0.0f : 1.0f - static_cast<float>(largest_free_block) / static_cast<float>(free_size);
+	}
+}
+
+void
+bonobo::geometry_pool::range_allocator::reset(size_t capacity, size_t used)
+{
+	_capacity = capacity;
+	_free_blocks.clear();
+	if (used < capacity)
+		_free_blocks.emplace(used, capacity - used);
+}
+
+size_t
+bonobo::geometry_pool::range_allocator::allocate(size_t size)
+{
+	for (auto it = _free_blocks.begin(); it != _free_blocks.end(); ++it) {
+		if (it->second < size)
+			continue;
+		auto const offset = it->first;
+		auto const remaining = it->second - size;
+		_free_blocks.erase(it);
+		if (remaining != 0u)
+			_free_blocks.emplace(offset + size, remaining);
+		return offset;
+	}
+	return invalid_offset;
+}
+
+void
+bonobo::geometry_pool::range_allocator::free(size_t offset, size_t size)
+{
+	if (size == 0u)
+		return;
+
+	auto next = _free_blocks.lower_bound(offset);
+	if (next != _free_blocks.begin()) {
+		auto previous = std::prev(next);
+		if (previous->first + previous->second == offset) {
+			offset = previous->first;
+			size += previous->second;
+			_free_blocks.erase(previous);
+		}
+	}
+	if (next != _free_blocks.end() && offset + size == next->first) {
+		size += next->second;
+		_free_blocks.erase(next);
+	}
+	_free_blocks.emplace(offset, size);
+}
+
+void
+bonobo::geometry_pool::range_allocator::grow(size_t capacity)
+{
+	assert(capacity >= _capacity);
+	auto const old_capacity = _capacity;
+	_capacity = capacity;
+	free(old_capacity, capacity - old_capacity);
+}
+
+size_t
+bonobo::geometry_pool::range_allocator::free_size() const
+{
+	return std::accumulate(_free_blocks.begin(), _free_blocks.end(), size_t(0u),
+	                       [](size_t sum, std::pair<size_t const, size_t> const& block){ return sum + block.second; });
+}
+
+size_t
+bonobo::geometry_pool::range_allocator::largest_free_block() const
+{
+	size_t largest = 0u;
+	for (auto const& block : _free_blocks)
+		largest = std::max(largest, block.second);
+	return largest;
+}
+
+bonobo::geometry_pool::geometry_pool(u32 attributes, size_t vertices_capacity, size_t indices_capacity)
+	: _attributes(attributes & all_attributes)
+	, _stride(static_cast<GLsizei>(components_nb(attributes & all_attributes) * sizeof(f32)))
+	, _vao(0u), _vbo(0u), _ibo(0u), _vertices(), _indices(), _allocations(), _unused_handles()
+{
+	glGenVertexArrays(1, &_vao);
+	assert(_vao != 0u);
+
+	vertices_capacity = std::max(vertices_capacity, size_t(1u));
+	indices_capacity = std::max(indices_capacity, size_t(1u));
+	_vertices.reset(vertices_capacity, 0u);
+	_indices.reset(indices_capacity, 0u);
+	resize_buffers(vertices_capacity, indices_capacity, false);
+}
+
+bonobo::geometry_pool::~geometry_pool()
+{
+	glDeleteBuffers(1, &_ibo);
+	glDeleteBuffers(1, &_vbo);
+	glDeleteVertexArrays(1, &_vao);
+	resource_registry::untrack(resource_registry::kind::buffer, _ibo);
+	resource_registry::untrack(resource_registry::kind::buffer, _vbo);
+}
+
+bonobo::geometry_pool::handle
+bonobo::geometry_pool::allocate(vertex_streams const& streams, GLuint const* indices, size_t indices_nb)
+{
+	std::vector<GLuint> sequential_indices;
+	if (indices == nullptr || indices_nb == 0u) {
+		sequential_indices.resize(streams.vertices_nb);
+		std::iota(sequential_indices.begin(), sequential_indices.end(), 0u);
+		indices = sequential_indices.data();
+		indices_nb = sequential_indices.size();
+	}
+
+	// Grow the buffers rather than moving existing allocations, so that
+	// meshes handed out earlier stay valid.
+	auto base_vertex = _vertices.allocate(streams.vertices_nb);
+	auto first_index = _indices.allocate(indices_nb);
+	if (base_vertex == range_allocator::invalid_offset || first_index == range_allocator::invalid_offset) {
+		if (base_vertex != range_allocator::invalid_offset)
+			_vertices.free(base_vertex, streams.vertices_nb);
+		if (first_index != range_allocator::invalid_offset)
+			_indices.free(first_index, indices_nb);
+
+		if (base_vertex == range_allocator::invalid_offset)
+			_vertices.grow(std::max(_vertices.capacity() * 2u, _vertices.capacity() + streams.vertices_nb));
+		if (first_index == range_allocator::invalid_offset)
+			_indices.grow(std::max(_indices.capacity() * 2u, _indices.capacity() + indices_nb));
+		resize_buffers(_vertices.capacity(), _indices.capacity(), true);
+
+		base_vertex = _vertices.allocate(streams.vertices_nb);
+		first_index = _indices.allocate(indices_nb);
+		assert(base_vertex != range_allocator::invalid_offset && first_index != range_allocator::invalid_offset);
+	}
+
+	// Interleave the attributes provided by the mesh straight into the
+	// staging ring, leaving the missing ones to zero.
+	glm::vec3 const* const attribute_values[] = { streams.vertices, streams.normals, streams.texcoords, streams.tangents, streams.binormals };
+	auto const floats_per_vertex = static_cast<size_t>(_stride) / sizeof(f32);
+	auto const vertices_size = streams.vertices_nb * floats_per_vertex * sizeof(f32);
+	auto const attributes = _attributes;
+	auto& ring = bonobo::staging_ring::shared();
+	glBindBuffer(GL_COPY_WRITE_BUFFER, _vbo);
+	ring.upload_buffer(GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(base_vertex * static_cast<size_t>(_stride)), vertices_size,
+	                   [&attribute_values, &streams, floats_per_vertex, vertices_size, attributes](u8* destination){
+		auto const interleaved = reinterpret_cast<f32*>(destination);
+		std::memset(destination, 0, vertices_size);
+		size_t first_component = 0u;
+		for (unsigned int a = 0u; a < 5u; ++a) {
+			if (a != 0u && (attributes & (1u << (a - 1u))) == 0u)
+				continue;
+			auto const values = attribute_values[a];
+			if (values != nullptr)
+				for (size_t i = 0u; i < streams.vertices_nb; ++i)
+					for (size_t c = 0u; c < vertex_components_nb[a]; ++c)
+						interleaved[i * floats_per_vertex + first_component + c] = values[i][static_cast<int>(c)];
+			first_component += vertex_components_nb[a];
+		}
+	});
+	glBindBuffer(GL_COPY_WRITE_BUFFER, _ibo);
+	ring.upload_buffer(GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(first_index * sizeof(GLuint)),
+	                   static_cast<void const*>(indices), indices_nb * sizeof(GLuint));
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0u);
+
+	allocation_data allocation;
+	allocation.location.base_vertex = static_cast<GLint>(base_vertex);
+	allocation.location.vertices_nb = streams.vertices_nb;
+	allocation.location.first_index = first_index;
+	allocation.location.indices_nb = indices_nb;
+	allocation.used = true;
+
+	if (!_unused_handles.empty()) {
+		auto const h = _unused_handles.back();
+		_unused_handles.pop_back();
+		_allocations[h - 1u] = allocation;
+		return h;
+	}
+	_allocations.push_back(allocation);
+	return static_cast<handle>(_allocations.size());
+}
+
+void
+bonobo::geometry_pool::free(handle allocation)
+{
+	auto const data = find(allocation);
+	if (data == nullptr) {
+		LogWarning("Geometry pool allocation %u freed but not allocated", allocation);
+		return;
+	}
+
+	_vertices.free(static_cast<size_t>(data->location.base_vertex), data->location.vertices_nb);
+	_indices.free(data->location.first_index, data->location.indices_nb);
+	_allocations[allocation - 1u].used = false;
+	_unused_handles.push_back(allocation);
+}
+
+void
+bonobo::geometry_pool::defragment()
+{
+	auto const old_vbo = _vbo, old_ibo = _ibo;
+	_vbo = 0u;
+	_ibo = 0u;
+	resize_buffers(_vertices.capacity(), _indices.capacity(), false);
+
+	// Move the allocations in the order they sit in the vertex buffer, so
+	// that meshes allocated together stay next to each other. Indices are
+	// relative to the base vertex and need no patching.
+	std::vector<size_t> order;
+	for (size_t i = 0u; i < _allocations.size(); ++i)
+		if (_allocations[i].used)
+			order.push_back(i);
+	std::sort(order.begin(), order.end(), [this](size_t a, size_t b){
+		return _allocations[a].location.base_vertex < _allocations[b].location.base_vertex;
+	});
+
+	size_t vertices_used = 0u, indices_used = 0u;
+	for (auto const i : order) {
+		auto& location = _allocations[i].location;
+
+		glBindBuffer(GL_COPY_READ_BUFFER, old_vbo);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, _vbo);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+		                    static_cast<GLintptr>(static_cast<size_t>(location.base_vertex) * static_cast<size_t>(_stride)),
+		                    static_cast<GLintptr>(vertices_used * static_cast<size_t>(_stride)),
+		                    static_cast<GLsizeiptr>(location.vertices_nb * static_cast<size_t>(_stride)));
+		glBindBuffer(GL_COPY_READ_BUFFER, old_ibo);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, _ibo);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+		                    static_cast<GLintptr>(location.first_index * sizeof(GLuint)),
+		                    static_cast<GLintptr>(indices_used * sizeof(GLuint)),
+		                    static_cast<GLsizeiptr>(location.indices_nb * sizeof(GLuint)));
+
+		location.base_vertex = static_cast<GLint>(vertices_used);
+		location.first_index = indices_used;
+		vertices_used += location.vertices_nb;
+		indices_used += location.indices_nb;
+	}
+	glBindBuffer(GL_COPY_READ_BUFFER, 0u);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0u);
+
+	glDeleteBuffers(1, &old_ibo);
+	glDeleteBuffers(1, &old_vbo);
+
+	_vertices.reset(_vertices.capacity(), vertices_used);
+	_indices.reset(_indices.capacity(), indices_used);
+}
+
+bonobo::geometry_pool::range
+bonobo::geometry_pool::get_range(handle allocation) const
+{
+	auto const data = find(allocation);
+	if (data == nullptr) {
+		LogError("Unknown geometry pool allocation %u", allocation);
+		return range();
+	}
+	return data->location;
+}
+
+bonobo::mesh_data
+bonobo::geometry_pool::get_mesh(handle allocation, GLenum drawing_mode) const
+{
+	bonobo::mesh_data mesh;
+	if (find(allocation) == nullptr) {
+		LogError("Unknown geometry pool allocation %u", allocation);
+		return mesh;
+	}
+
+	mesh.vao = _vao;
+	mesh.bo = _vbo;
+	mesh.ibo = _ibo;
+	mesh.indices_type = GL_UNSIGNED_INT;
+	mesh.drawing_mode = drawing_mode;
+	mesh.layout = vertex_layout::interleaved;
+	mesh.pool_allocation = allocation;
+	refresh(mesh);
+	return mesh;
+}
+
+void
+bonobo::geometry_pool::refresh(mesh_data& mesh) const
+{
+	auto const data = find(mesh.pool_allocation);
+	if (data == nullptr || mesh.vao != _vao) {
+		LogError("Mesh does not come from this geometry pool");
+		return;
+	}
+
+	mesh.bo = _vbo;
+	mesh.ibo = _ibo;
+	mesh.vertices_nb = data->location.vertices_nb;
+	mesh.base_vertex = data->location.base_vertex;
+	mesh.first_index = data->location.first_index;
+	mesh.indices_nb = mesh.lods != nullptr ? mesh.lods->levels.front().indices_nb : data->location.indices_nb;
+}
+
+void
+bonobo::geometry_pool::draw(handle allocation, GLenum drawing_mode) const
+{
+	auto const data = find(allocation);
+	if (data == nullptr)
+		return;
+
+	glDrawElementsBaseVertex(drawing_mode, static_cast<GLsizei>(data->location.indices_nb), GL_UNSIGNED_INT,
+	                         reinterpret_cast<GLvoid const*>(data->location.first_index * sizeof(GLuint)),
+	                         data->location.base_vertex);
+}
+
+bonobo::geometry_pool::statistics
+bonobo::geometry_pool::get_statistics() const
+{
+	statistics stats;
+	stats.allocations_nb = _allocations.size() - _unused_handles.size();
+	stats.vertices_capacity = _vertices.capacity();
+	stats.vertices_used = _vertices.capacity() - _vertices.free_size();
+	stats.indices_capacity = _indices.capacity();
+	stats.indices_used = _indices.capacity() - _indices.free_size();
+	stats.vertex_free_blocks_nb = _vertices.free_blocks_nb();
+	stats.index_free_blocks_nb = _indices.free_blocks_nb();
+	stats.vertex_fragmentation = fragmentation(_vertices.largest_free_block(), _vertices.free_size());
+	stats.index_fragmentation = fragmentation(_indices.largest_free_block(), _indices.free_size());
+	stats.total_bytes = static_cast<u64>(stats.vertices_capacity) * static_cast<u64>(_stride)
+	                  + static_cast<u64>(stats.indices_capacity) * sizeof(GLuint);
+	stats.used_bytes = static_cast<u64>(stats.vertices_used) * static_cast<u64>(_stride)
+	                 + static_cast<u64>(stats.indices_used) * sizeof(GLuint);
+	return stats;
+}
+
+void
+bonobo::geometry_pool::log_statistics() const
+{
+	auto const stats = get_statistics();
+	LogInfo("Geometry pool: %u meshes, %.2f/%.2f MiB used, vertices %u/%u (%u holes, %.0f%% fragmented), indices %u/%u (%u holes, %.0f%% fragmented)",
+	        static_cast<unsigned int>(stats.allocations_nb),
+	        stats.used_bytes / (1024.0 * 1024.0), stats.total_bytes / (1024.0 * 1024.0),
+	        static_cast<unsigned int>(stats.vertices_used), static_cast<unsigned int>(stats.vertices_capacity),
+	        static_cast<unsigned int>(stats.vertex_free_blocks_nb), stats.vertex_fragmentation * 100.0f,
+	        static_cast<unsigned int>(stats.indices_used), static_cast<unsigned int>(stats.indices_capacity),
+	        static_cast<unsigned int>(stats.index_free_blocks_nb), stats.index_fragmentation * 100.0f);
+}
+
+bonobo::geometry_pool::allocation_data const*
+bonobo::geometry_pool::find(handle allocation) const
+{
+	if (allocation == 0u || allocation > _allocations.size() || !_allocations[allocation - 1u].used)
+		return nullptr;
+	return &_allocations[allocation - 1u];
+}
+
+void
+bonobo::geometry_pool::resize_buffers(size_t vertices_capacity, size_t indices_capacity, bool keep_content)
+{
+	auto const resize = [keep_content](GLuint& buffer, GLsizeiptr size, char const* format, char const* label){
+		GLint old_size = 0;
+		if (buffer != 0u) {
+			glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+			glGetBufferParameteriv(GL_COPY_READ_BUFFER, GL_BUFFER_SIZE, &old_size);
+			glBindBuffer(GL_COPY_READ_BUFFER, 0u);
+			if (keep_content && static_cast<GLsizeiptr>(old_size) == size)
+				return;
+		}
+
+		GLuint resized = 0u;
+		glGenBuffers(1, &resized);
+		assert(resized != 0u);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, resized);
+		glBufferData(GL_COPY_WRITE_BUFFER, size, nullptr, GL_STATIC_DRAW);
+		if (buffer != 0u) {
+			if (keep_content) {
+				glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+				glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, std::min(static_cast<GLsizeiptr>(old_size), size));
+				glBindBuffer(GL_COPY_READ_BUFFER, 0u);
+			}
+			glDeleteBuffers(1, &buffer);
+			resource_registry::untrack(resource_registry::kind::buffer, buffer);
+		}
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0u);
+		buffer = resized;
+		resource_registry::track(resource_registry::kind::buffer, buffer, static_cast<u64>(size), format, label, RESOURCE_SITE);
+	};
+	resize(_vbo, static_cast<GLsizeiptr>(vertices_capacity * static_cast<size_t>(_stride)), "interleaved", "geometry pool vertices");
+	resize(_ibo, static_cast<GLsizeiptr>(indices_capacity * sizeof(GLuint)), "u32", "geometry pool indices");
+
+	setup_vao();
+}
+
+void
+bonobo::geometry_pool::setup_vao()
+{
+	glBindVertexArray(_vao);
+	glBindBuffer(GL_ARRAY_BUFFER, _vbo);
+
+	size_t offset = 0u;
+	for (unsigned int a = 0u; a < 5u; ++a) {
+		auto const location = static_cast<GLuint>(a); // matches bonobo::shader_bindings
+		if (a != 0u && (_attributes & (1u << (a - 1u))) == 0u) {
+			glDisableVertexAttribArray(location);
+			continue;
+		}
+		glEnableVertexAttribArray(location);
+		glVertexAttribPointer(location, static_cast<GLint>(vertex_components_nb[a]), GL_FLOAT, GL_FALSE, _stride, reinterpret_cast<GLvoid const*>(offset));
+		offset += vertex_components_nb[a] * sizeof(f32);
+	}
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _ibo);
+	glBindVertexArray(0u);
+	glBindBuffer(GL_ARRAY_BUFFER, 0u);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0u);
+}
@@ -0,0 +1,166 @@
+#pragma once
+
+#include "core/helpers.hpp"
+#include "core/Types.h"
+
+#include <map>
+#include <vector>
+
+namespace bonobo
+{
+	//! \brief Sub-allocates many meshes sharing one vertex format from a
+	//!        single vertex buffer and a single index buffer.
+	//!
+	//! All meshes of a pool are drawn through the same VAO: each mesh is
+	//! identified by a (base vertex, first index, count) range, and its
+	//! indices are relative to its base vertex, so whole passes can be
+	//! issued with `glDrawElementsBaseVertex()` without switching VAOs.
+	//!
+	//! Vertices are interleaved; attributes enabled for the pool but not
+	//! provided by a mesh are filled with zeroes, and indices are always
+	//! stored on 32 bits. Both buffers grow as needed, which keeps the
+	//! ranges of existing meshes unchanged; `defragment()` on the other
+	//! hand moves them, and meshes must then be refreshed.
+	class geometry_pool
+	{
+	public:
+		//! \brief Identifies an allocation; 0 is never a valid handle.
+		using handle = u32;
+
+		//! \brief Optional vertex attributes stored by a pool, besides
+		//!        the positions which are always present.
+		enum attribute : u32 {
+			normals        = 1u << 0,
+			texcoords      = 1u << 1,
+			tangents       = 1u << 2,
+			binormals      = 1u << 3,
+			all_attributes = normals | texcoords | tangents | binormals
+		};
+
+		//! \brief Location of a mesh inside the pool buffers.
+		struct range {
+			GLint base_vertex;  //!< index of the first vertex of the mesh
+			size_t vertices_nb; //!< number of vertices of the mesh
+			size_t first_index; //!< index of the first index of the mesh
+			size_t indices_nb;  //!< number of indices of the mesh
+		};
+
+		//! \brief Usage of the pool buffers.
+		struct statistics {
+			size_t allocations_nb;          //!< meshes currently allocated
+			size_t vertices_capacity;       //!< vertices the vertex buffer can hold
+			size_t vertices_used;           //!< of which are allocated
+			size_t indices_capacity;        //!< indices the index buffer can hold
+			size_t indices_used;            //!< of which are allocated
+			size_t vertex_free_blocks_nb;   //!< holes in the vertex buffer
+			size_t index_free_blocks_nb;    //!< holes in the index buffer
+			float vertex_fragmentation;     //!< 1 - largest free block / free space, in the vertex buffer
+			float index_fragmentation;      //!< 1 - largest free block / free space, in the index buffer
+			u64 total_bytes;                //!< memory used by both buffers
+			u64 used_bytes;                 //!< of which is allocated
+		};
+
+		//! \brief Create the pool buffers and VAO.
+		//!
+		//! @param [in] attributes which `attribute`s to store
+		//! @param [in] vertices_capacity initial number of vertices
+		//! @param [in] indices_capacity initial number of indices
+		explicit geometry_pool(u32 attributes = all_attributes,
+		                       size_t vertices_capacity = 1u << 16,
+		                       size_t indices_capacity = 1u << 18);
+
+		//! \brief Delete the pool buffers and VAO; all meshes allocated
+		//!        from it become invalid.
+		~geometry_pool();
+
+		geometry_pool(geometry_pool const&) = delete;
+		geometry_pool& operator=(geometry_pool const&) = delete;
+
+		//! \brief Copy a mesh into the pool.
+		//!
+		//! @param [in] streams the vertex attributes of the mesh
+		//! @param [in] indices the indices of the mesh, or nullptr if the
+		//!             mesh is not indexed, in which case sequential
+		//!             indices are generated
+		//! @param [in] indices_nb how many indices there are
+		//! @return a handle to the allocation
+		handle allocate(vertex_streams const& streams, GLuint const* indices, size_t indices_nb);
+
+		//! \brief Give back the space used by a mesh.
+		void free(handle allocation);
+
+		//! \brief Pack all allocations at the beginning of the buffers.
+		//!
+		//! Ranges of all allocations change; `mesh_data` obtained from
+		//! `get_mesh()` must be updated through `refresh()`.
+		void defragment();
+
+		//! \brief Get where an allocation currently lives.
+		range get_range(handle allocation) const;
+
+		//! \brief Build a `mesh_data` drawing an allocation through the
+		//!        pool VAO.
+		//!
+		//! @param [in] allocation as returned by `allocate()`
+		//! @param [in] drawing_mode OpenGL drawing mode, i.e.
+		//!             GL_TRIANGLES, GL_LINES, etc.
+		mesh_data get_mesh(handle allocation, GLenum drawing_mode = GL_TRIANGLES) const;
+
+		//! \brief Update the range of a `mesh_data` obtained from
+		//!        `get_mesh()`, e.g. after a defragmentation.
+		void refresh(mesh_data& mesh) const;
+
+		//! \brief OpenGL name of the VAO shared by all allocations.
+		GLuint get_vao() const { return _vao; }
+
+		//! \brief Draw an allocation; the pool VAO must be bound.
+		void draw(handle allocation, GLenum drawing_mode = GL_TRIANGLES) const;
+
+		//! \brief Get the current usage of the pool.
+		statistics get_statistics() const;
+
+		//! \brief Log the current usage of the pool.
+		void log_statistics() const;
+
+	private:
+		//! \brief First-fit allocator over a range of elements, merging
+		//!        neighbouring free blocks.
+		class range_allocator
+		{
+		public:
+			static size_t const invalid_offset = ~size_t(0u);
+
+			void reset(size_t capacity, size_t used);
+			size_t allocate(size_t size);
+			void free(size_t offset, size_t size);
+			void grow(size_t capacity);
+			size_t capacity() const { return _capacity; }
+			size_t free_size() const;
+			size_t largest_free_block() const;
+			size_t free_blocks_nb() const { return _free_blocks.size(); }
+
+		private:
+			std::map<size_t, size_t> _free_blocks; // offset -> size
+			size_t _capacity = 0u;
+		};
+
+		struct allocation_data {
+			range location;
+			bool used;
+		};
+
+		allocation_data const* find(handle allocation) const;
+		void resize_buffers(size_t vertices_capacity, size_t indices_capacity, bool keep_content);
+		void setup_vao();
+
+		u32 _attributes;
+		GLsizei _stride;
+		GLuint _vao;
+		GLuint _vbo;
+		GLuint _ibo;
+		range_allocator _vertices;
+		range_allocator _indices;
+		std::vector<allocation_data> _allocations;
+		std::vector<handle> _unused_handles;
+	};
+}
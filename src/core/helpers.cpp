@@ -1,28 +1,56 @@
 #include "config.hpp"
 #include "helpers.hpp"
 
+#include "core/asset_pack.hpp"
+#include "core/geometry_pool.hpp"
 #include "core/Log.h"
+#include "core/mapped_file.hpp"
+#include "core/mesh_cache.hpp"
+#include "core/mesh_optimizer.hpp"
 #include "core/Misc.h"
 #include "core/opengl.hpp"
+#include "core/resource_registry.hpp"
+#include "core/staging_ring.hpp"
+#include "core/texture_cache.hpp"
+#include "core/texture_registry.hpp"
+#include "core/thread_pool.hpp"
 #include "core/various.hpp"
+#include "core/vfs.hpp"
 #include "external/lodepng.h"
 
+#include <assimp/DefaultIOSystem.h>
 #include <assimp/Importer.hpp>
+#include <assimp/IOStream.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <array>
 #include <cassert>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <limits>
+#include <memory>
 
 namespace local
 {
 	static GLuint fullscreen_shader;
 	static GLuint display_vao;
+
+	static unsigned int const import_flags = aiProcess_Triangulate | aiProcess_SortByPType | aiProcess_CalcTangentSpace;
 }
 
 void
 bonobo::init()
 {
+	bonobo::vfs::mountDefaults();
+	bonobo::vfs::logStatistics();
+
 	glGenVertexArrays(1, &local::display_vao);
 	assert(local::display_vao != 0u);
 	local::fullscreen_shader = bonobo::createProgram("fullscreen.vert", "fullscreen.frag");
@@ -33,65 +61,447 @@ bonobo::init()
 void
 bonobo::deinit()
 {
+	bonobo::texture_registry::logStatistics();
+	bonobo::texture_registry::clear();
 	glDeleteVertexArrays(1, &local::display_vao);
+	bonobo::staging_ring::shared().log_statistics();
+	bonobo::staging_ring::shared().release();
+	bonobo::vfs::logStatistics();
+	bonobo::resource_registry::logStatistics();
 }
 
-static std::vector<u8>
-getTextureData(std::string const& filename, u32& width, u32& height, bool flip)
+namespace
+{
+	struct free_deleter {
+		void operator()(u8* pointer) const { std::free(pointer); }
+	};
+
+	//! \brief RGBA pixels, row by row from the top of the image, as
+	//!        decoded by lodepng which allocates them with malloc().
+	using image_pixels = std::unique_ptr<u8, free_deleter>;
+}
+
+// The file is decoded straight from its memory mapping into a single
+// buffer: lodepng's C++ helpers would first read the file into a vector,
+// then copy the decoded pixels into another one.
+static unsigned int
+decodeTextureData(std::string const& path, image_pixels& pixels, u32& width, u32& height)
+{
+	pixels.reset();
+	bonobo::mapped_file file;
+	if (!file.open(path))
+		return 78u; // lodepng's "failed to open file for reading"
+
+	unsigned char* decoded = nullptr;
+	unsigned int w = 0u, h = 0u;
+	auto const error = lodepng_decode_memory(&decoded, &w, &h, file.data(), file.size(), LCT_RGBA, 8u);
+	pixels.reset(decoded);
+	if (error != 0u) {
+		pixels.reset();
+		return error;
+	}
+	width = w;
+	height = h;
+
+	return 0u;
+}
+
+namespace
+{
+	struct decoded_image {
+		std::string path;
+		image_pixels pixels;
+		u32 width = 0u;
+		u32 height = 0u;
+		unsigned int error = 0u;
+	};
+}
+
+//! \brief Start decoding an image file on the shared thread pool.
+static std::future<decoded_image>
+decodeTextureDataAsync(std::string const& filename)
 {
 	auto const path = config::resources_path(filename);
-	std::vector<unsigned char> image;
-	if (lodepng::decode(image, width, height, path, LCT_RGBA) != 0) {
-		LogWarning("Couldn't load or decode image file %s", path.c_str());
+	return bonobo::thread_pool::shared().submit([path](){
+		decoded_image image;
+		image.path = path;
+		image.error = decodeTextureData(path, image.pixels, image.width, image.height);
 		return image;
+	});
+}
+
+//! \brief Wait for an image file to be decoded, logging any error.
+static image_pixels
+getTextureData(std::future<decoded_image>& decoding, u32& width, u32& height)
+{
+	auto image = decoding.get();
+	if (image.error != 0u)
+		LogWarning("Couldn't load or decode image file %s: %s", image.path.c_str(), lodepng_error_text(image.error));
+	width = image.width;
+	height = image.height;
+	return std::move(image.pixels);
+}
+
+static u64
+estimateTextureBytes(u32 width, u32 height, u32 faces_nb, bool generate_mipmap)
+{
+	auto const base_level_bytes = static_cast<u64>(width) * static_cast<u64>(height) * 4u * faces_nb;
+	// A full mipmap hierarchy adds about a third of the base level.
+	return generate_mipmap ? base_level_bytes + base_level_bytes / 3u : base_level_bytes;
+}
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#	define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#	define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+bool
+bonobo::isTextureCompressionSupported()
+{
+	static int supported = -1;
+	if (supported < 0) {
+		supported = 0;
+		GLint extensions_nb = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &extensions_nb);
+		for (GLint i = 0; i < extensions_nb; ++i) {
+			auto const name = reinterpret_cast<char const*>(glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(i)));
+			if (name != nullptr && std::strcmp(name, "GL_EXT_texture_compression_s3tc") == 0) {
+				supported = 1;
+				break;
+			}
+		}
+		if (supported == 0)
+			LogInfo("EXT_texture_compression_s3tc is not available: textures will be uploaded uncompressed");
 	}
-	if (!flip)
-		return image;
+	return supported == 1;
+}
+
+GLenum
+bonobo::getCompressedInternalFormat(bonobo::block_compression::format fmt)
+{
+	switch (fmt) {
+	case bonobo::block_compression::format::bc1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	case bonobo::block_compression::format::bc3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	case bonobo::block_compression::format::bc5: return GL_COMPRESSED_RG_RGTC2;
+	case bonobo::block_compression::format::rgba8: return GL_RGBA;
+	}
+	return GL_NONE;
+}
 
-	auto const channels_nb = 4u;
-	auto flipBuffer = std::vector<u8>(width * height * channels_nb);
-	for (u32 y = 0; y < height; y++)
-		memcpy(flipBuffer.data() + (height - 1 - y) * width * channels_nb, &image[y * width * channels_nb], width * channels_nb);
+static char const*
+getCompressedFormatName(bonobo::block_compression::format fmt)
+{
+	switch (fmt) {
+	case bonobo::block_compression::format::bc1: return "BC1";
+	case bonobo::block_compression::format::bc3: return "BC3";
+	case bonobo::block_compression::format::bc5: return "BC5";
+	case bonobo::block_compression::format::rgba8: return "RGBA8";
+	}
+	return "?";
+}
 
-	return flipBuffer;
+//! \brief Fill in the levels of the texture currently bound to `target`
+//!        from a source, staged through the shared staging ring.
+//!
+//! @return how many bytes were uploaded
+static u64
+uploadLevels(GLenum target, bonobo::texture_cache::loaded_image const& source, bool generate_mipmap)
+{
+	auto const fmt = source.format();
+	auto const internal_format = bonobo::getCompressedInternalFormat(fmt);
+	auto const& levels = source.levels();
+	auto const levels_nb = generate_mipmap ? levels.size() : 1u;
+	u64 bytes = 0u;
+	for (size_t i = 0u; i < levels_nb; ++i) {
+		auto const level = static_cast<GLint>(i);
+		auto const width = static_cast<GLsizei>(levels[i].width), height = static_cast<GLsizei>(levels[i].height);
+		bonobo::staging_ring::shared().upload_pixels(source.data() + levels[i].offset, levels[i].size, [&](GLvoid const* pixels){
+			if (fmt == bonobo::block_compression::format::rgba8)
+				glTexImage2D(target, level, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+			else
+				glCompressedTexImage2D(target, level, internal_format, width, height, 0, static_cast<GLsizei>(levels[i].size), pixels);
+		});
+		bytes += levels[i].size;
+	}
+	return bytes;
 }
 
-std::vector<bonobo::mesh_data>
-bonobo::loadObjects(std::string const& filename)
+//! \brief Create a 2D-texture out of a source.
+//!
+//! All levels are uploaded explicitly, rather than generated by
+//! `glGenerateMipmap()`.
+//!
+//! @param [in] label name of the texture, for resource accounting
+//! @param [out] bytes how much memory the texture uses
+static GLuint
+uploadTextureSource2D(bonobo::texture_cache::loaded_image const& source, std::string const& label, bool generate_mipmap, u64& bytes)
 {
-	std::vector<bonobo::mesh_data> objects;
+	GLuint texture = 0u;
+	glGenTextures(1, &texture);
+	assert(texture != 0u);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	bytes = uploadLevels(GL_TEXTURE_2D, source, generate_mipmap);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, generate_mipmap ? static_cast<GLint>(source.levels().size()) - 1 : 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, generate_mipmap ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glBindTexture(GL_TEXTURE_2D, 0u);
+	bonobo::resource_registry::track(bonobo::resource_registry::kind::texture, texture, bytes,
+	                                 getCompressedFormatName(source.format()), label, RESOURCE_SITE);
+
+	return texture;
+}
+
+//! \brief Log how a texture source was obtained.
+static void
+logTextureSource(std::string const& name, bonobo::texture_cache::loaded_image const& source, u64 upload_ns)
+{
+	auto const megapixels = static_cast<double>(source.width) * static_cast<double>(source.height) * 0.000001;
+	if (source.from_cache) {
+		LogTrivia("\t\t%s (%ux%u): %s from cache, upload %.2f ms", name.c_str(), source.width, source.height,
+		          getCompressedFormatName(source.format()), upload_ns * 0.000001);
+		return;
+	}
+
+	char quality[32] = "";
+	if (source.format() != bonobo::block_compression::format::rgba8)
+		std::snprintf(quality, sizeof(quality), ", PSNR %.2f dB", source.psnr);
+	LogTrivia("\t\t%s (%ux%u): decode %.2f ms (%.2f ms/MP), %s bake %.2f ms (%.1f MP/s)%s, upload %.2f ms",
+	          name.c_str(), source.width, source.height, source.decode_ns * 0.000001, source.decode_ns * 0.000001 / megapixels,
+	          getCompressedFormatName(source.format()), source.encode_ns * 0.000001,
+	          source.encode_ns > 0u ? megapixels / (source.encode_ns * 0.000000001) : 0.0, quality, upload_ns * 0.000001);
+	if (source.cache_writable && !source.cache_written)
+		LogWarning("Failed to write the texture cache of \"%s\"", name.c_str());
+}
+
+//! \brief Load the textures referenced by a set of materials.
+//!
+//! Textures already known to the texture registry are reused; the others
+//! are loaded once each, even if referenced by several materials. Loading
+//! a texture, i.e. mapping its block-compressed cache or else decoding
+//! the PNG and baking the cache, is fanned out over the shared thread
+//! pool, while the uploads happen on the calling thread, which owns the
+//! GL context, as soon as each texture is loaded.
+static std::vector<bonobo::texture_bindings>
+loadMaterials(std::vector<bonobo::mesh_cache::material_reference> const& materials)
+{
+	struct loaded_texture {
+		size_t request_id;
+		bonobo::texture_cache::loaded_image source;
+		unsigned int error;
+	};
+	struct texture_request {
+		std::string key;
+		bonobo::mesh_cache::texture_reference const* reference;
+		std::vector<std::pair<size_t, std::string>> users; // (material, binding)
+	};
+
+	auto const start_time = StartTimer();
+	auto const peak_resident_bytes_before = static_cast<double>(GetPeakResidentBytes());
+
+	std::vector<bonobo::texture_bindings> materials_bindings(materials.size());
+	std::vector<texture_request> requests;
+	std::unordered_map<std::string, size_t> requests_by_key;
+	for (size_t i = 0u; i < materials.size(); ++i) {
+		for (auto const& reference : materials[i]) {
+			auto const key = bonobo::texture_registry::makeKey(GL_TEXTURE_2D, reference.path, reference.generate_mipmap);
+			auto const request = requests_by_key.find(key);
+			if (request != requests_by_key.end()) {
+				requests[request->second].users.emplace_back(i, reference.binding);
+				continue;
+			}
+			auto const id = bonobo::texture_registry::acquire(key);
+			if (id != 0u) {
+				materials_bindings[i].emplace(reference.binding, id);
+				continue;
+			}
+			requests_by_key.emplace(key, requests.size());
+			requests.push_back({ key, &reference, { std::make_pair(i, reference.binding) } });
+		}
+	}
+
+	// Each texture is encoded on a single worker: there are enough
+	// textures to keep all of them busy.
+	auto const compress = bonobo::isTextureCompressionSupported();
+	auto& pool = bonobo::thread_pool::shared();
+	bonobo::completion_queue<loaded_texture> loaded;
+	for (size_t i = 0u; i < requests.size(); ++i) {
+		auto const path = config::resources_path("textures/" + requests[i].reference->path);
+		pool.submit([&loaded, path, i, compress](){
+			loaded_texture texture;
+			texture.request_id = i;
+			texture.error = bonobo::texture_cache::load(path, true, compress, nullptr, texture.source);
+			loaded.push(std::move(texture));
+		});
+	}
+
+	u64 total_decode_ns = 0u, total_encode_ns = 0u, total_upload_ns = 0u;
+	u64 total_bytes = 0u, total_uncompressed_bytes = 0u;
+	double total_megapixels = 0.0;
+	size_t cached_nb = 0u;
+	for (size_t i = 0u; i < requests.size(); ++i) {
+		auto const texture = loaded.pop();
+		auto const& request = requests[texture.request_id];
+		auto const& reference = *request.reference;
+		if (texture.error != 0u) {
+			LogWarning("Couldn't load or decode image file %s: %s", reference.path.c_str(), lodepng_error_text(texture.error));
+			continue;
+		}
+
+		auto const upload_start = StartTimer();
+		u64 bytes = 0u;
+		auto const id = uploadTextureSource2D(texture.source, reference.path, reference.generate_mipmap, bytes);
+		auto const upload_ns = EndTimerNanoseconds(upload_start);
+		if (id == 0u)
+			continue;
+
+		// The first user gets the reference taken by `insert()`, the
+		// others each acquire their own.
+		bonobo::texture_registry::insert(request.key, id, bytes);
+		for (size_t j = 0u; j < request.users.size(); ++j) {
+			if (j > 0u)
+				bonobo::texture_registry::acquire(request.key);
+			materials_bindings[request.users[j].first].emplace(request.users[j].second, id);
+		}
+
+		logTextureSource(reference.path, texture.source, upload_ns);
+		total_decode_ns += texture.source.decode_ns;
+		total_encode_ns += texture.source.encode_ns;
+		total_upload_ns += upload_ns;
+		total_bytes += bytes;
+		total_uncompressed_bytes += estimateTextureBytes(texture.source.width, texture.source.height, 1u, reference.generate_mipmap);
+		total_megapixels += static_cast<double>(texture.source.width) * static_cast<double>(texture.source.height) * 0.000001;
+		cached_nb += texture.source.from_cache ? 1u : 0u;
+	}
+
+	LogInfo("\t\t%u textures (%u from cache) on %u threads in %.2f ms: decode %.2f ms, encode %.2f ms (summed over threads, %.2f ms/MP), upload %.2f ms",
+	        static_cast<unsigned int>(requests.size()), static_cast<unsigned int>(cached_nb), static_cast<unsigned int>(pool.size()),
+	        EndTimerSeconds(start_time) * 1000.0, total_decode_ns * 0.000001, total_encode_ns * 0.000001,
+	        total_megapixels > 0.0 ? (total_decode_ns + total_encode_ns) * 0.000001 / total_megapixels : 0.0, total_upload_ns * 0.000001);
+	LogInfo("\t\ttexture memory: %.2f MiB, %.2f MiB uncompressed", total_bytes / (1024.0 * 1024.0), total_uncompressed_bytes / (1024.0 * 1024.0));
+	LogInfo("\t\tpeak resident memory: %.2f MiB before, %.2f MiB after",
+	        peak_resident_bytes_before / (1024.0 * 1024.0), GetPeakResidentBytes() / (1024.0 * 1024.0));
+	bonobo::texture_registry::logStatistics();
+
+	return materials_bindings;
+}
+
+namespace
+{
+	//! \brief Assimp stream over a mapped file, which may live in a pack.
+	class mapped_stream : public Assimp::IOStream
+	{
+	public:
+		explicit mapped_stream(bonobo::mapped_file&& file) : _file(std::move(file)), _position(0u)
+		{
+		}
+		size_t Read(void* buffer, size_t size, size_t count) override
+		{
+			if (size == 0u)
+				return 0u;
+			auto const available = (_file.size() - _position) / size;
+			auto const read_nb = count < available ? count : available;
+			std::memcpy(buffer, _file.data() + _position, read_nb * size);
+			_position += read_nb * size;
+			return read_nb;
+		}
+		size_t Write(void const* /*buffer*/, size_t /*size*/, size_t /*count*/) override
+		{
+			return 0u;
+		}
+		aiReturn Seek(size_t offset, aiOrigin origin) override
+		{
+			auto const base = origin == aiOrigin_SET ? 0u : origin == aiOrigin_CUR ? _position : _file.size();
+			if (offset > _file.size() - base)
+				return aiReturn_FAILURE;
+			_position = base + offset;
+			return aiReturn_SUCCESS;
+		}
+		size_t Tell() const override { return _position; }
+		size_t FileSize() const override { return _file.size(); }
+		void Flush() override {}
+
+	private:
+		bonobo::mapped_file _file;
+		size_t _position;
+	};
+
+	//! \brief Assimp file system reading through `bonobo::mapped_file`,
+	//!        so that scenes, and the files they reference such as
+	//!        material libraries, can be imported from asset packs.
+	//!
+	//! Anything which cannot be mapped, e.g. empty files, or files
+	//! opened for writing, goes through the default implementation.
+	class mapped_io_system : public Assimp::DefaultIOSystem
+	{
+	public:
+		bool Exists(char const* path) const override
+		{
+			std::string entry_path;
+			auto const pack = bonobo::vfs::findPack(path, entry_path);
+			if (pack != nullptr)
+				return pack->find(entry_path) != nullptr;
+			return Assimp::DefaultIOSystem::Exists(path);
+		}
+		Assimp::IOStream* Open(char const* path, char const* mode) override
+		{
+			if (std::strchr(mode, 'w') == nullptr && std::strchr(mode, 'a') == nullptr) {
+				bonobo::mapped_file file;
+				if (file.open(path))
+					return new mapped_stream(std::move(file));
+			}
+			return Assimp::DefaultIOSystem::Open(path, mode);
+		}
+	};
+
+	//! \brief Record a message, to be logged later on from the main
+	//!        thread by `bonobo::logImportMessages()`.
+	void report(bonobo::imported_scene& imported, bonobo::imported_scene::message::level type, char const* format, ...)
+	{
+		char text[1024];
+		va_list arguments;
+		va_start(arguments, format);
+		std::vsnprintf(text, sizeof(text), format, arguments);
+		va_end(arguments);
+		imported.messages.push_back({ type, text });
+	}
+}
+
+bool
+bonobo::importScene(std::string const& scene_filepath, thread_pool* pool, imported_scene& imported)
+{
+	using level = imported_scene::message::level;
+	auto& scene = imported.scene;
+	auto& meshes_storage = imported.meshes;
+	auto& meshlets_storage = imported.meshlets;
+	auto& lods_storage = imported.lods;
 
-	auto const scene_filepath = config::resources_path("scenes/" + filename);
-	LogInfo("Loading \"%s\"", scene_filepath.c_str());
 	Assimp::Importer importer;
-	auto const assimp_scene = importer.ReadFile(scene_filepath, aiProcess_Triangulate | aiProcess_SortByPType | aiProcess_CalcTangentSpace);
+	importer.SetIOHandler(new mapped_io_system);
+	auto const assimp_scene = importer.ReadFile(scene_filepath, local::import_flags);
 	if (assimp_scene == nullptr || assimp_scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || assimp_scene->mRootNode == nullptr) {
-		LogError("Assimp failed to load \"%s\": %s", scene_filepath.c_str(), importer.GetErrorString());
-		return objects;
+		report(imported, level::error, "Assimp failed to load \"%s\": %s", scene_filepath.c_str(), importer.GetErrorString());
+		return false;
 	}
 
 	if (assimp_scene->mNumMeshes == 0u) {
-		LogError("No mesh available; loading \"%s\" must have had issues", scene_filepath.c_str());
-		return objects;
+		report(imported, level::error, "No mesh available; loading \"%s\" must have had issues", scene_filepath.c_str());
+		return false;
 	}
 
-	std::vector<texture_bindings> materials_bindings;
-	materials_bindings.reserve(assimp_scene->mNumMaterials);
-
-	LogInfo("\t* materials");
+	scene.materials.reserve(assimp_scene->mNumMaterials);
 	for (size_t i = 0; i < assimp_scene->mNumMaterials; ++i) {
-		texture_bindings bindings;
+		bonobo::mesh_cache::material_reference textures;
 		auto const material = assimp_scene->mMaterials[i];
 
-		auto const process_texture = [&bindings,&material,i](aiTextureType type, std::string const& type_as_str, std::string const& name){
+		auto const process_texture = [&imported,&textures,&material,i](aiTextureType type, std::string const& type_as_str, std::string const& name){
 			if (material->GetTextureCount(type)) {
 				if (material->GetTextureCount(type) > 1)
-					LogWarning("Material %d has more than one %s texture: discarding all but the first one.", i, type_as_str.c_str());
+					report(imported, level::warning, "Material %d has more than one %s texture: discarding all but the first one.", i, type_as_str.c_str());
 				aiString path;
 				material->GetTexture(type, 0, &path);
-				auto const id = bonobo::loadTexture2D("../crysponza/" + std::string(path.C_Str()), type_as_str != "opacity");
-				if (id != 0u)
-					bindings.emplace(name, id);
+				textures.push_back({ name, "../crysponza/" + std::string(path.C_Str()), type_as_str != "opacity" });
 			}
 		};
 
@@ -100,129 +510,594 @@ bonobo::loadObjects(std::string const& filename)
 		process_texture(aiTextureType_NORMALS,  "normals",  "normals_texture");
 		process_texture(aiTextureType_OPACITY,  "opacity",  "opacity_texture");
 
-		materials_bindings.push_back(bindings);
+		scene.materials.push_back(textures);
 	}
 
-	LogInfo("\t* meshes");
-	objects.reserve(assimp_scene->mNumMeshes);
+	scene.meshes.reserve(assimp_scene->mNumMeshes);
+	meshes_storage.reserve(assimp_scene->mNumMeshes);
+	std::vector<bool> is_triangle_list;
+	is_triangle_list.reserve(assimp_scene->mNumMeshes);
 	for (size_t j = 0; j < assimp_scene->mNumMeshes; ++j) {
 		auto const assimp_object_mesh = assimp_scene->mMeshes[j];
 
 		if (!assimp_object_mesh->HasFaces()) {
-			LogError("Unsupported object \"%s\": has no faces", assimp_object_mesh->mName.C_Str());
+			report(imported, level::error, "Unsupported object \"%s\": has no faces", assimp_object_mesh->mName.C_Str());
 			continue;
 		}
 		if ((assimp_object_mesh->mPrimitiveTypes & ~static_cast<uint32_t>(aiPrimitiveType_POINT))    != 0u
 		 && (assimp_object_mesh->mPrimitiveTypes & ~static_cast<uint32_t>(aiPrimitiveType_LINE))     != 0u
 		 && (assimp_object_mesh->mPrimitiveTypes & ~static_cast<uint32_t>(aiPrimitiveType_TRIANGLE)) != 0u) {
-			LogError("Unsupported object \"%s\": uses multiple primitive types", assimp_object_mesh->mName.C_Str());
+			report(imported, level::error, "Unsupported object \"%s\": uses multiple primitive types", assimp_object_mesh->mName.C_Str());
 			continue;
 		}
 		if ((assimp_object_mesh->mPrimitiveTypes & static_cast<uint32_t>(aiPrimitiveType_POLYGON)) == static_cast<uint32_t>(aiPrimitiveType_POLYGON)) {
-			LogError("Unsupported object \"%s\": uses polygons", assimp_object_mesh->mName.C_Str());
+			report(imported, level::error, "Unsupported object \"%s\": uses polygons", assimp_object_mesh->mName.C_Str());
 			continue;
 		}
 		if (!assimp_object_mesh->HasPositions()) {
-			LogError("Unsupported object \"%s\": has no positions", assimp_object_mesh->mName.C_Str());
+			report(imported, level::error, "Unsupported object \"%s\": has no positions", assimp_object_mesh->mName.C_Str());
 			continue;
 		}
 
-		bonobo::mesh_data object;
+		auto const num_vertices_per_face = assimp_object_mesh->mFaces[0u].mNumIndices;
+		auto object_indices = std::vector<u32>(assimp_object_mesh->mNumFaces * num_vertices_per_face);
+		for (size_t i = 0u; i < assimp_object_mesh->mNumFaces; ++i) {
+			auto const& face = assimp_object_mesh->mFaces[i];
+			assert(face.mNumIndices <= 3);
+			object_indices[num_vertices_per_face * i + 0u] = face.mIndices[0u];
+			if (num_vertices_per_face >= 1u)
+				object_indices[num_vertices_per_face * i + 1u] = face.mIndices[1u];
+			if (num_vertices_per_face >= 2u)
+				object_indices[num_vertices_per_face * i + 2u] = face.mIndices[2u];
+		}
 
-		glGenVertexArrays(1, &object.vao);
-		assert(object.vao != 0u);
-		glBindVertexArray(object.vao);
+		auto const copy_stream = [assimp_object_mesh](aiVector3D const* values){
+			if (values == nullptr)
+				return std::vector<f32>();
+			auto const first = reinterpret_cast<f32 const*>(values);
+			return std::vector<f32>(first, first + assimp_object_mesh->mNumVertices * 3u);
+		};
+		bonobo::mesh_optimizer::mesh object;
+		object.vertices_nb = assimp_object_mesh->mNumVertices;
+		object.vertices    = copy_stream(assimp_object_mesh->mVertices);
+		object.normals     = copy_stream(assimp_object_mesh->HasNormals() ? assimp_object_mesh->mNormals : nullptr);
+		object.texcoords   = copy_stream(assimp_object_mesh->HasTextureCoords(0u) ? assimp_object_mesh->mTextureCoords[0u] : nullptr);
+		object.tangents    = copy_stream(assimp_object_mesh->HasTangentsAndBitangents() ? assimp_object_mesh->mTangents : nullptr);
+		object.binormals   = copy_stream(assimp_object_mesh->HasTangentsAndBitangents() ? assimp_object_mesh->mBitangents : nullptr);
+		object.indices     = std::move(object_indices);
+		meshes_storage.push_back(std::move(object));
+
+		bonobo::mesh_cache::mesh_view mesh;
+		mesh.name         = assimp_object_mesh->mName.C_Str();
+		mesh.material_id  = assimp_object_mesh->mMaterialIndex;
+		mesh.drawing_mode = GL_TRIANGLES;
+		scene.meshes.push_back(mesh);
+		is_triangle_list.push_back(num_vertices_per_face == 3u);
+	}
 
-		auto const vertices_offset = 0u;
-		auto const vertices_size = static_cast<GLsizeiptr>(assimp_object_mesh->mNumVertices * sizeof(glm::vec3));
+	// Optimise all triangle meshes in parallel, split them into meshlets
+	// following their optimised triangle order, and append the indices of
+	// their coarser levels of detail; the storages are not resized
+	// anymore, so the workers can safely modify their elements.
+	auto const optimisation_start = StartTimer();
+	meshlets_storage.resize(meshes_storage.size());
+	lods_storage.resize(meshes_storage.size());
+	std::vector<std::future<bonobo::mesh_optimizer::report>> reports(meshes_storage.size());
+	for (size_t i = 0u; i < meshes_storage.size(); ++i) {
+		if (!is_triangle_list[i])
+			continue;
+		auto& object = meshes_storage[i];
+		auto& object_meshlets = meshlets_storage[i];
+		auto& object_lods = lods_storage[i];
+		auto const prepare = [&object,&object_meshlets,&object_lods](){
+			auto const optimisation = bonobo::mesh_optimizer::optimize(object);
+			object_meshlets = bonobo::meshlets::build(object.vertices.data(), object.indices.data(),
+			                                          object.indices.size(), object.vertices_nb);
+			object_lods = bonobo::mesh_simplifier::buildLodChain(object.indices, object.vertices.data(), object.vertices_nb);
+			return optimisation;
+		};
+		if (pool != nullptr) {
+			reports[i] = pool->submit(prepare);
+		} else {
+			std::promise<bonobo::mesh_optimizer::report> done;
+			done.set_value(prepare());
+			reports[i] = done.get_future();
+		}
+	}
 
-		auto const normals_offset = vertices_size;
-		auto const normals_size = assimp_object_mesh->HasNormals() ? vertices_size : 0u;
+	size_t triangles_nb = 0u, meshlets_nb = 0u, simplified_meshes_nb = 0u, lods_nb = 0u, coarsest_triangles_nb = 0u;
+	f32 misses_before = 0.0f, misses_after = 0.0f;
+	for (size_t i = 0u; i < meshes_storage.size(); ++i) {
+		if (!reports[i].valid())
+			continue;
+		auto const optimisation = reports[i].get();
+		auto const& levels = lods_storage[i].levels;
+		if (levels.empty())
+			continue;
+		auto const mesh_triangles_nb = levels.front().indices_nb / 3u;
+		meshlets_nb += meshlets_storage[i].size();
+		simplified_meshes_nb += levels.size() > 1u ? 1u : 0u;
+		lods_nb += levels.size() - 1u;
+		coarsest_triangles_nb += levels.back().indices_nb / 3u;
+		report(imported, level::trivia, "\t\t%s: %u -> %u vertices, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f",
+		          scene.meshes[i].name.c_str(),
+		          static_cast<unsigned int>(optimisation.vertices_nb_before), static_cast<unsigned int>(optimisation.vertices_nb_after),
+		          optimisation.before.acmr, optimisation.after.acmr, optimisation.before.atvr, optimisation.after.atvr);
+		triangles_nb += mesh_triangles_nb;
+		misses_before += optimisation.before.acmr * static_cast<f32>(mesh_triangles_nb);
+		misses_after += optimisation.after.acmr * static_cast<f32>(mesh_triangles_nb);
+	}
+	if (triangles_nb != 0u)
+		report(imported, level::info, "\t* optimised %u triangles for the vertex cache in %.1f ms: overall ACMR %.3f -> %.3f",
+		        static_cast<unsigned int>(triangles_nb), EndTimerSeconds(optimisation_start) * 1000.0,
+		        misses_before / static_cast<f32>(triangles_nb), misses_after / static_cast<f32>(triangles_nb));
+	if (meshlets_nb != 0u)
+		report(imported, level::info, "\t* split into %u meshlets of %.1f triangles on average",
+		        static_cast<unsigned int>(meshlets_nb), static_cast<f32>(triangles_nb) / static_cast<f32>(meshlets_nb));
+	if (simplified_meshes_nb != 0u)
+		report(imported, level::info, "\t* simplified %u meshes into %u coarser levels of detail, the coarsest ones keeping %.1f%% of the triangles",
+		        static_cast<unsigned int>(simplified_meshes_nb), static_cast<unsigned int>(lods_nb),
+		        100.0f * static_cast<f32>(coarsest_triangles_nb) / static_cast<f32>(triangles_nb));
+
+	auto const view = [](std::vector<f32> const& stream){
+		return stream.empty() ? nullptr : stream.data();
+	};
+	for (size_t i = 0u; i < meshes_storage.size(); ++i) {
+		auto const& object = meshes_storage[i];
+		auto& mesh = scene.meshes[i];
+		mesh.vertices_nb = static_cast<u32>(object.vertices_nb);
+		mesh.indices_nb  = static_cast<u32>(object.indices.size());
+		mesh.vertices    = view(object.vertices);
+		mesh.normals     = view(object.normals);
+		mesh.texcoords   = view(object.texcoords);
+		mesh.tangents    = view(object.tangents);
+		mesh.binormals   = view(object.binormals);
+		mesh.indices     = object.indices.data();
+		mesh.meshlets_nb = static_cast<u32>(meshlets_storage[i].size());
+		mesh.meshlets    = meshlets_storage[i].empty() ? nullptr : meshlets_storage[i].data();
+		auto const& lods = lods_storage[i];
+		mesh.lods_nb     = lods.levels.size() > 1u ? static_cast<u32>(lods.levels.size()) : 0u;
+		mesh.lods        = mesh.lods_nb != 0u ? lods.levels.data() : nullptr;
+		mesh.bounding_sphere = glm::vec4(lods.centre, lods.radius);
+	}
 
-		auto const texcoords_offset = normals_offset + normals_size;
-		auto const texcoords_size = assimp_object_mesh->HasTextureCoords(0u) ? vertices_size : 0u;
+	return true;
+}
 
-		auto const tangents_offset = texcoords_offset + texcoords_size;
-		auto const tangents_size = assimp_object_mesh->HasTangentsAndBitangents() ? vertices_size : 0u;
+void
+bonobo::logImportMessages(imported_scene const& imported)
+{
+	using level = imported_scene::message::level;
+	for (auto const& message : imported.messages) {
+		switch (message.type) {
+		case level::error:   LogError("%s", message.text.c_str()); break;
+		case level::warning: LogWarning("%s", message.text.c_str()); break;
+		case level::info:    LogInfo("%s", message.text.c_str()); break;
+		case level::trivia:  LogTrivia("%s", message.text.c_str()); break;
+		}
+	}
+}
 
-		auto const binormals_offset = tangents_offset + tangents_size;
-		auto const binormals_size = assimp_object_mesh->HasTangentsAndBitangents() ? vertices_size : 0u;
+unsigned int
+bonobo::getImportFlags()
+{
+	return local::import_flags;
+}
 
-		auto const bo_size = static_cast<GLsizeiptr>(vertices_size
-		                                            +normals_size
-		                                            +texcoords_size
-		                                            +tangents_size
-		                                            +binormals_size
-		                                            );
-		glGenBuffers(1, &object.bo);
-		assert(object.bo != 0u);
-		glBindBuffer(GL_ARRAY_BUFFER, object.bo);
-		glBufferData(GL_ARRAY_BUFFER, bo_size, nullptr, GL_STATIC_DRAW);
+std::vector<bonobo::mesh_data>
+bonobo::loadObjects(std::string const& filename, vertex_layout layout, geometry_pool* pool)
+{
+	std::vector<bonobo::mesh_data> objects;
 
-		glBufferSubData(GL_ARRAY_BUFFER, vertices_offset, vertices_size, static_cast<GLvoid const*>(assimp_object_mesh->mVertices));
-		glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::vertices));
-		glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::vertices), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(0x0));
+	auto const scene_filepath = config::resources_path("scenes/" + filename);
+	LogInfo("Loading \"%s\"", scene_filepath.c_str());
 
-		if (assimp_object_mesh->HasNormals()) {
-			glBufferSubData(GL_ARRAY_BUFFER, normals_offset, normals_size, static_cast<GLvoid const*>(assimp_object_mesh->mNormals));
-			glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::normals));
-			glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::normals), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(normals_offset));
+	u64 source_hash = 0u;
+	if (!bonobo::mesh_cache::hashSource(scene_filepath, source_hash)) {
+		LogError("Failed to open \"%s\"", scene_filepath.c_str());
+		return objects;
+	}
+
+	// Whichever path is taken, `scene` ends up pointing at the final data
+	// of all meshes: either inside the cache mapping, or inside the meshes
+	// imported and optimised in `imported_meshes`.
+	auto const cache_filepath = bonobo::mesh_cache::getCachePath(scene_filepath);
+	bonobo::mesh_cache::reader cache;
+	bonobo::imported_scene imported;
+	bonobo::mesh_cache::scene_view const* scene = nullptr;
+	if (cache.open(cache_filepath, source_hash, local::import_flags)) {
+		LogInfo("\t* using cache \"%s\"", cache_filepath.c_str());
+		scene = &cache.scene();
+	} else {
+		auto const is_imported = bonobo::importScene(scene_filepath, &bonobo::thread_pool::shared(), imported);
+		bonobo::logImportMessages(imported);
+		if (!is_imported)
+			return objects;
+		// Packs are read-only: their caches have to be baked beforehand.
+		if (bonobo::vfs::isPacked(scene_filepath))
+			LogInfo("\t* no mesh cache written, as \"%s\" comes from a pack", scene_filepath.c_str());
+		else if (!bonobo::mesh_cache::write(cache_filepath, source_hash, local::import_flags, imported.scene))
+			LogWarning("Failed to write the mesh cache \"%s\"", cache_filepath.c_str());
+		scene = &imported.scene;
+	}
+
+	LogInfo("\t* materials");
+	auto const materials_bindings = loadMaterials(scene->materials);
+
+	LogInfo("\t* meshes");
+	objects.reserve(scene->meshes.size());
+	for (auto const& mesh : scene->meshes) {
+		auto const stream = [](f32 const* values){
+			return reinterpret_cast<glm::vec3 const*>(values);
+		};
+		bonobo::vertex_streams streams;
+		streams.vertices_nb = mesh.vertices_nb;
+		streams.vertices    = stream(mesh.vertices);
+		streams.normals     = stream(mesh.normals);
+		streams.texcoords   = stream(mesh.texcoords);
+		streams.tangents    = stream(mesh.tangents);
+		streams.binormals   = stream(mesh.binormals);
+		auto object = pool != nullptr
+		            ? pool->get_mesh(pool->allocate(streams, mesh.indices, mesh.indices_nb), mesh.drawing_mode)
+		            : bonobo::createMesh(streams, mesh.indices, mesh.indices_nb, layout, mesh.drawing_mode);
+
+		if (mesh.material_id >= materials_bindings.size())
+			LogError("Object \"%s\" has a material index of %u, but only %u materials were retrieved.", mesh.name.c_str(), mesh.material_id, materials_bindings.size());
+		else
+			object.bindings = materials_bindings[mesh.material_id];
+		if (mesh.meshlets != nullptr)
+			object.meshlets = std::make_shared<std::vector<bonobo::meshlets::meshlet> const>(mesh.meshlets, mesh.meshlets + mesh.meshlets_nb);
+		if (mesh.lods != nullptr) {
+			object.lods = std::make_shared<bonobo::mesh_simplifier::lod_chain const>(bonobo::mesh_cache::getLodChain(mesh));
+			object.indices_nb = mesh.lods[0].indices_nb;
 		}
 
-		if (assimp_object_mesh->HasTextureCoords(0u)) {
-			glBufferSubData(GL_ARRAY_BUFFER, texcoords_offset, texcoords_size, static_cast<GLvoid const*>(assimp_object_mesh->mTextureCoords[0u]));
-			glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::texcoords));
-			glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::texcoords), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(texcoords_offset));
+		objects.push_back(object);
+	}
+
+	if (pool != nullptr) {
+		pool->log_statistics();
+	} else {
+		GLint64 vertex_bytes = 0;
+		for (auto const& object : objects) {
+			GLint bo_size = 0;
+			glBindBuffer(GL_ARRAY_BUFFER, object.bo);
+			glGetBufferParameteriv(GL_ARRAY_BUFFER, GL_BUFFER_SIZE, &bo_size);
+			vertex_bytes += bo_size;
 		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0u);
+		LogInfo("\t* %.2f MiB of vertex data", static_cast<double>(vertex_bytes) / (1024.0 * 1024.0));
+	}
+
+	return objects;
+}
 
-		if (assimp_object_mesh->HasTangentsAndBitangents()) {
-			glBufferSubData(GL_ARRAY_BUFFER, tangents_offset, tangents_size, static_cast<GLvoid const*>(assimp_object_mesh->mTangents));
-			glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::tangents));
-			glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::tangents), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(tangents_offset));
+static glm::vec2
+encodeOctahedral(glm::vec3 const& direction)
+{
+	// Project onto the octahedron |x| + |y| + |z| = 1, then fold the lower
+	// half over the upper one.
+	auto const sign_not_zero = [](float value){ return value >= 0.0f ? 1.0f : -1.0f; };
+	auto const l1_norm = std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z);
+	if (l1_norm == 0.0f)
+		return glm::vec2(0.0f, 0.0f);
+	auto const p = glm::vec2(direction.x, direction.y) / l1_norm;
+	if (direction.z >= 0.0f)
+		return p;
+	return glm::vec2((1.0f - std::abs(p.y)) * sign_not_zero(p.x),
+	                 (1.0f - std::abs(p.x)) * sign_not_zero(p.y));
+}
 
-			glBufferSubData(GL_ARRAY_BUFFER, binormals_offset, binormals_size, static_cast<GLvoid const*>(assimp_object_mesh->mBitangents));
-			glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::binormals));
-			glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::binormals), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(binormals_offset));
+bonobo::mesh_data
+bonobo::createMesh(vertex_streams const& streams, GLuint const* indices, size_t indices_nb, vertex_layout layout, GLenum drawing_mode)
+{
+	bonobo::mesh_data data;
+	data.vertices_nb = streams.vertices_nb;
+	data.drawing_mode = drawing_mode;
+	data.layout = layout;
+
+	// All data goes through the staging ring: buffers are only allocated
+	// here, and filled in by copies on the GPU side.
+	auto& ring = bonobo::staging_ring::shared();
+
+	glGenVertexArrays(1, &data.vao);
+	assert(data.vao != 0u);
+	glBindVertexArray(data.vao);
+
+	glGenBuffers(1, &data.bo);
+	assert(data.bo != 0u);
+	glBindBuffer(GL_ARRAY_BUFFER, data.bo);
+
+	if (layout == vertex_layout::planar) {
+		// One range per attribute, each filled in directly from the
+		// corresponding stream.
+		std::vector<std::pair<bonobo::shader_bindings, glm::vec3 const*>> attributes;
+		attributes.emplace_back(bonobo::shader_bindings::vertices, streams.vertices);
+		if (streams.normals != nullptr)
+			attributes.emplace_back(bonobo::shader_bindings::normals, streams.normals);
+		if (streams.texcoords != nullptr)
+			attributes.emplace_back(bonobo::shader_bindings::texcoords, streams.texcoords);
+		if (streams.tangents != nullptr)
+			attributes.emplace_back(bonobo::shader_bindings::tangents, streams.tangents);
+		if (streams.binormals != nullptr)
+			attributes.emplace_back(bonobo::shader_bindings::binormals, streams.binormals);
+
+		auto const attribute_size = static_cast<GLsizeiptr>(streams.vertices_nb * sizeof(glm::vec3));
+		auto const bo_size = attribute_size * static_cast<GLsizeiptr>(attributes.size());
+		glBufferData(GL_ARRAY_BUFFER, bo_size, nullptr, GL_STATIC_DRAW);
+		bonobo::resource_registry::track(bonobo::resource_registry::kind::buffer, data.bo, static_cast<u64>(bo_size),
+		                                 "planar, " + std::to_string(attributes.size()) + " x vec3", "vertices", RESOURCE_SITE);
+
+		GLsizeiptr offset = 0;
+		for (auto const& a : attributes) {
+			ring.upload_buffer(GL_ARRAY_BUFFER, offset, static_cast<void const*>(a.second), static_cast<size_t>(attribute_size));
+			glEnableVertexAttribArray(static_cast<unsigned int>(a.first));
+			glVertexAttribPointer(static_cast<unsigned int>(a.first), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(offset));
+			offset += attribute_size;
+		}
+	} else {
+		// Gather all attributes of a vertex next to each other, each one
+		// in the most compact format allowed by the layout; every format
+		// takes a multiple of 4 bytes to keep attributes aligned.
+		struct attribute {
+			bonobo::shader_bindings binding;
+			GLint components_nb;
+			GLenum type;
+			GLboolean normalized;
+			size_t size;
+			std::function<void (size_t vertex, u8* destination)> pack;
+		};
+		auto const copy_floats = [](glm::vec3 const* values, size_t components_nb){
+			return [values, components_nb](size_t vertex, u8* destination){
+				std::memcpy(destination, &values[vertex], components_nb * sizeof(f32));
+			};
+		};
+		auto const pack_octahedral = [](glm::vec3 const* values){
+			return [values](size_t vertex, u8* destination){
+				auto const packed = static_cast<u32>(glm::packSnorm2x16(encodeOctahedral(values[vertex])));
+				std::memcpy(destination, &packed, sizeof(packed));
+			};
+		};
+		bool const quantised = layout == vertex_layout::quantised || layout == vertex_layout::quantised_positions;
+
+		std::vector<attribute> attributes;
+		if (layout == vertex_layout::quantised_positions && streams.vertices_nb != 0u) {
+			// Store positions relative to the bounds of the mesh; the
+			// inverse transform is applied by the model matrix.
+			auto lower = streams.vertices[0], upper = streams.vertices[0];
+			for (size_t i = 1u; i < streams.vertices_nb; ++i) {
+				lower = glm::min(lower, streams.vertices[i]);
+				upper = glm::max(upper, streams.vertices[i]);
+			}
+			auto const centre = (lower + upper) * 0.5f;
+			auto half_extent = (upper - lower) * 0.5f;
+			for (int c = 0; c < 3; ++c)
+				if (half_extent[c] <= 0.0f)
+					half_extent[c] = 1.0f;
+			data.vertex_dequantisation = glm::scale(glm::translate(glm::mat4(1.0f), centre), half_extent);
+
+			auto const positions = streams.vertices;
+			attributes.push_back({ bonobo::shader_bindings::vertices, 4, GL_SHORT, GL_TRUE, 4u * sizeof(i16),
+			                       [positions, centre, half_extent](size_t vertex, u8* destination){
+				auto const packed = glm::packSnorm4x16(glm::vec4((positions[vertex] - centre) / half_extent, 1.0f));
+				std::memcpy(destination, &packed, sizeof(packed));
+			} });
+		} else {
+			attributes.push_back({ bonobo::shader_bindings::vertices, 3, GL_FLOAT, GL_FALSE, 3u * sizeof(f32), copy_floats(streams.vertices, 3u) });
+		}
+		if (streams.normals != nullptr) {
+			if (quantised)
+				attributes.push_back({ bonobo::shader_bindings::normals, 2, GL_SHORT, GL_TRUE, 2u * sizeof(i16), pack_octahedral(streams.normals) });
+			else
+				attributes.push_back({ bonobo::shader_bindings::normals, 3, GL_FLOAT, GL_FALSE, 3u * sizeof(f32), copy_floats(streams.normals, 3u) });
+		}
+		if (streams.texcoords != nullptr) {
+			if (quantised) {
+				auto const texcoords = streams.texcoords;
+				attributes.push_back({ bonobo::shader_bindings::texcoords, 2, GL_HALF_FLOAT, GL_FALSE, 2u * sizeof(u16),
+				                       [texcoords](size_t vertex, u8* destination){
+					auto const packed = static_cast<u32>(glm::packHalf2x16(glm::vec2(texcoords[vertex].x, texcoords[vertex].y)));
+					std::memcpy(destination, &packed, sizeof(packed));
+				} });
+			} else {
+				attributes.push_back({ bonobo::shader_bindings::texcoords, 2, GL_FLOAT, GL_FALSE, 2u * sizeof(f32), copy_floats(streams.texcoords, 2u) });
+			}
+		}
+		if (streams.tangents != nullptr) {
+			if (quantised)
+				attributes.push_back({ bonobo::shader_bindings::tangents, 2, GL_SHORT, GL_TRUE, 2u * sizeof(i16), pack_octahedral(streams.tangents) });
+			else
+				attributes.push_back({ bonobo::shader_bindings::tangents, 3, GL_FLOAT, GL_FALSE, 3u * sizeof(f32), copy_floats(streams.tangents, 3u) });
+		}
+		if (streams.binormals != nullptr) {
+			if (quantised && streams.normals != nullptr && streams.tangents != nullptr) {
+				// Only keep on which side of the normal-tangent plane the
+				// binormal lies; shaders rebuild it as sign * (n x t).
+				data.binormal_is_sign = true;
+				auto const normals = streams.normals, tangents = streams.tangents, binormals = streams.binormals;
+				attributes.push_back({ bonobo::shader_bindings::binormals, 4, GL_BYTE, GL_TRUE, 4u * sizeof(i8),
+				                       [normals, tangents, binormals](size_t vertex, u8* destination){
+					auto const side = glm::dot(glm::cross(normals[vertex], tangents[vertex]), binormals[vertex]);
+					i8 const packed[4] = { static_cast<i8>(side < 0.0f ? -127 : 127), 0, 0, 0 };
+					std::memcpy(destination, packed, sizeof(packed));
+				} });
+			} else {
+				// Without a normal and a tangent to rebuild it from, the
+				// binormal is kept whole rather than dropped.
+				if (quantised)
+					LogWarning("Storing the binormals of a quantised mesh as floats, as it lacks normals or tangents");
+				attributes.push_back({ bonobo::shader_bindings::binormals, 3, GL_FLOAT, GL_FALSE, 3u * sizeof(f32), copy_floats(streams.binormals, 3u) });
+			}
 		}
 
-		glBindBuffer(GL_ARRAY_BUFFER, 0u);
+		size_t stride = 0u;
+		for (auto const& a : attributes)
+			stride += a.size;
+
+		// Vertices are packed straight into the staging ring.
+		auto const bo_size = streams.vertices_nb * stride;
+		glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(bo_size), nullptr, GL_STATIC_DRAW);
+		bonobo::resource_registry::track(bonobo::resource_registry::kind::buffer, data.bo, bo_size,
+		                                 "interleaved, " + std::to_string(stride) + " B stride", "vertices", RESOURCE_SITE);
+		ring.upload_buffer(GL_ARRAY_BUFFER, 0, bo_size, [&attributes, &streams, stride](u8* packed){
+			size_t first_byte = 0u;
+			for (auto const& a : attributes) {
+				for (size_t i = 0u; i < streams.vertices_nb; ++i)
+					a.pack(i, packed + i * stride + first_byte);
+				first_byte += a.size;
+			}
+		});
 
-		auto const num_vertices_per_face = assimp_object_mesh->mFaces[0u].mNumIndices;
-		object.indices_nb = assimp_object_mesh->mNumFaces * num_vertices_per_face;
-		auto object_indices = std::make_unique<GLuint[]>(static_cast<size_t>(object.indices_nb));
-		for (size_t i = 0u; i < assimp_object_mesh->mNumFaces; ++i) {
-			auto const& face = assimp_object_mesh->mFaces[i];
-			assert(face.mNumIndices <= 3);
-			object_indices[num_vertices_per_face * i + 0u] = face.mIndices[0u];
-			if (num_vertices_per_face >= 1u)
-				object_indices[num_vertices_per_face * i + 1u] = face.mIndices[1u];
-			if (num_vertices_per_face >= 2u)
-				object_indices[num_vertices_per_face * i + 2u] = face.mIndices[2u];
+		size_t offset = 0u;
+		for (auto const& a : attributes) {
+			glEnableVertexAttribArray(static_cast<unsigned int>(a.binding));
+			glVertexAttribPointer(static_cast<unsigned int>(a.binding), a.components_nb, a.type, a.normalized, static_cast<GLsizei>(stride), reinterpret_cast<GLvoid const*>(offset));
+			offset += a.size;
 		}
-		glGenBuffers(1, &object.ibo);
-		assert(object.ibo != 0u);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, object.ibo);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<unsigned int>(object.indices_nb) * sizeof(GL_UNSIGNED_INT), reinterpret_cast<GLvoid const*>(object_indices.get()), GL_STATIC_DRAW);
-		object_indices.reset(nullptr);
+	}
 
-		glBindVertexArray(0u);
-		glBindBuffer(GL_ARRAY_BUFFER, 0u);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0u);
+	glBindBuffer(GL_ARRAY_BUFFER, 0u);
+
+	if (indices != nullptr && indices_nb != 0u) {
+		data.indices_nb = indices_nb;
+		glGenBuffers(1, &data.ibo);
+		assert(data.ibo != 0u);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, data.ibo);
+		// Indices are always smaller than the number of vertices, so
+		// 16 bits are enough as long as there are fewer than 2^16
+		// vertices: the largest value is kept for restarting strips, which
+		// the cast below maps `primitive_restart_index` to.
+		if (streams.vertices_nb <= static_cast<size_t>(std::numeric_limits<GLushort>::max())) {
+			data.indices_type = GL_UNSIGNED_SHORT;
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(indices_nb * sizeof(GLushort)), nullptr, GL_STATIC_DRAW);
+			bonobo::resource_registry::track(bonobo::resource_registry::kind::buffer, data.ibo, indices_nb * sizeof(GLushort),
+			                                 "u16", "indices", RESOURCE_SITE);
+			ring.upload_buffer(GL_ELEMENT_ARRAY_BUFFER, 0, indices_nb * sizeof(GLushort), [indices, indices_nb](u8* destination){
+				auto const short_indices = reinterpret_cast<GLushort*>(destination);
+				for (size_t i = 0u; i < indices_nb; ++i)
+					short_indices[i] = static_cast<GLushort>(indices[i]);
+			});
+		} else {
+			data.indices_type = GL_UNSIGNED_INT;
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(indices_nb * sizeof(GLuint)), nullptr, GL_STATIC_DRAW);
+			bonobo::resource_registry::track(bonobo::resource_registry::kind::buffer, data.ibo, indices_nb * sizeof(GLuint),
+			                                 "u32", "indices", RESOURCE_SITE);
+			ring.upload_buffer(GL_ELEMENT_ARRAY_BUFFER, 0, static_cast<void const*>(indices), indices_nb * sizeof(GLuint));
+		}
+	}
 
-		auto const material_id = assimp_object_mesh->mMaterialIndex;
-		if (material_id >= materials_bindings.size())
-			LogError("Object \"%s\" has a material index of %u, but only %u materials were retrieved.", assimp_object_mesh->mName.C_Str(), material_id, materials_bindings.size());
-		else
-			object.bindings = materials_bindings[material_id];
+	glBindVertexArray(0u);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0u);
 
-		objects.push_back(object);
+	return data;
+}
 
-//		LogInfo("Loaded object \"%s\" with normals:%d, tangents&bitangents:%d, texcoords:%d",
-//		        assimp_object_mesh->mName.C_Str(), assimp_object_mesh->HasNormals(),
-//		        assimp_object_mesh->HasTangentsAndBitangents(), assimp_object_mesh->HasTextureCoords(0));
+//! \brief Size of a texel of an uncompressed internal format, rounded up
+//!        as drivers pad 3-component formats.
+static u64
+getTexelSize(GLint internal_format)
+{
+	switch (internal_format) {
+	case GL_R8: case GL_RED:                                         return 1u;
+	case GL_RG8: case GL_RG: case GL_R16F: case GL_DEPTH_COMPONENT16: return 2u;
+	case GL_RGBA16F: case GL_RGB16F: case GL_RG32F:                  return 8u;
+	case GL_RGBA32F: case GL_RGB32F:                                 return 16u;
+	default:                                                         return 4u;
 	}
+}
 
-	return objects;
+//! \brief Name of an uncompressed internal format, for resource accounting.
+static std::string
+getInternalFormatName(GLint internal_format)
+{
+	switch (internal_format) {
+	case GL_RGBA: case GL_RGBA8:    return "RGBA8";
+	case GL_RGB: case GL_RGB8:      return "RGB8";
+	case GL_RG: case GL_RG8:        return "RG8";
+	case GL_RED: case GL_R8:        return "R8";
+	case GL_R16F:                   return "R16F";
+	case GL_RGB16F:                 return "RGB16F";
+	case GL_RGBA16F:                return "RGBA16F";
+	case GL_RG32F:                  return "RG32F";
+	case GL_RGB32F:                 return "RGB32F";
+	case GL_RGBA32F:                return "RGBA32F";
+	case GL_DEPTH_COMPONENT16:      return "DEPTH16";
+	case GL_DEPTH_COMPONENT24:      return "DEPTH24";
+	case GL_DEPTH_COMPONENT32F:     return "DEPTH32F";
+	case GL_DEPTH24_STENCIL8:       return "DEPTH24_STENCIL8";
+	case GL_DEPTH_COMPONENT:        return "DEPTH";
+	default:
+		char name[16];
+		std::snprintf(name, sizeof(name), "0x%04x", static_cast<unsigned int>(internal_format));
+		return name;
+	}
+}
+
+//! \brief Size of the pixel data read by `glTexImage2D()` with the
+//!        default unpack alignment of 4 bytes.
+//!
+//! @return the size in bytes, or 0 for formats and types not handled
+static size_t
+getPixelDataSize(u32 width, u32 height, GLenum format, GLenum type)
+{
+	size_t components_nb = 0u;
+	switch (format) {
+	case GL_RED: case GL_RED_INTEGER: case GL_DEPTH_COMPONENT: components_nb = 1u; break;
+	case GL_RG:  case GL_RG_INTEGER:                           components_nb = 2u; break;
+	case GL_RGB: case GL_RGB_INTEGER: case GL_BGR:             components_nb = 3u; break;
+	case GL_RGBA: case GL_RGBA_INTEGER: case GL_BGRA:          components_nb = 4u; break;
+	default: return 0u;
+	}
+
+	size_t component_size = 0u;
+	switch (type) {
+	case GL_BYTE: case GL_UNSIGNED_BYTE:                      component_size = 1u; break;
+	case GL_SHORT: case GL_UNSIGNED_SHORT: case GL_HALF_FLOAT: component_size = 2u; break;
+	case GL_INT: case GL_UNSIGNED_INT: case GL_FLOAT:         component_size = 4u; break;
+	default: return 0u;
+	}
+
+	// The last row is not padded.
+	auto const row_size = static_cast<size_t>(width) * components_nb * component_size;
+	auto const padded_row_size = (row_size + 3u) / 4u * 4u;
+	return height == 0u ? 0u : padded_row_size * static_cast<size_t>(height - 1u) + row_size;
+}
+
+//! \brief Deleter of host data recorded by the resource registry.
+template<typename T>
+static void
+untrackHost(T const* data)
+{
+	bonobo::resource_registry::untrack(bonobo::resource_registry::kind::host, reinterpret_cast<u64>(data));
+	delete data;
+}
+
+std::shared_ptr<std::vector<bonobo::meshlets::meshlet> const>
+bonobo::createMeshlets(vertex_streams const& streams, GLuint const* indices, size_t indices_nb)
+{
+	if (streams.vertices == nullptr || indices == nullptr || indices_nb < 3u)
+		return nullptr;
+
+	auto const built = new std::vector<meshlets::meshlet> const(
+		meshlets::build(reinterpret_cast<f32 const*>(streams.vertices), indices, indices_nb, streams.vertices_nb));
+	resource_registry::track(resource_registry::kind::host, reinterpret_cast<u64>(built), built->size() * sizeof(meshlets::meshlet),
+	                         std::to_string(built->size()) + " meshlets", "", RESOURCE_SITE);
+	return std::shared_ptr<std::vector<meshlets::meshlet> const>(built, untrackHost<std::vector<meshlets::meshlet>>);
+}
+
+std::shared_ptr<bonobo::mesh_simplifier::lod_chain const>
+bonobo::createLodChain(vertex_streams const& streams, std::vector<GLuint>& indices)
+{
+	if (streams.vertices == nullptr || indices.size() < 3u)
+		return nullptr;
+
+	auto chain = mesh_simplifier::buildLodChain(indices, reinterpret_cast<f32 const*>(streams.vertices), streams.vertices_nb);
+	if (chain.levels.size() < 2u)
+		return nullptr;
+	auto const built = new mesh_simplifier::lod_chain const(std::move(chain));
+	resource_registry::track(resource_registry::kind::host, reinterpret_cast<u64>(built), built->levels.size() * sizeof(mesh_simplifier::lod),
+	                         std::to_string(built->levels.size()) + " levels of detail", "", RESOURCE_SITE);
+	return std::shared_ptr<mesh_simplifier::lod_chain const>(built, untrackHost<mesh_simplifier::lod_chain>);
 }
 
 GLuint
@@ -234,8 +1109,18 @@ bonobo::createTexture(uint32_t width, uint32_t height, GLenum target, GLint inte
 	glBindTexture(target, texture);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexImage2D(target, 0, internal_format, static_cast<GLsizei>(width), static_cast<GLsizei>(height), 0, format, type, data);
+	auto const image_size = getPixelDataSize(width, height, format, type);
+	if (data != nullptr && image_size != 0u) {
+		bonobo::staging_ring::shared().upload_pixels(data, image_size, [&](GLvoid const* pixels){
+			glTexImage2D(target, 0, internal_format, static_cast<GLsizei>(width), static_cast<GLsizei>(height), 0, format, type, pixels);
+		});
+	} else {
+		glTexImage2D(target, 0, internal_format, static_cast<GLsizei>(width), static_cast<GLsizei>(height), 0, format, type, data);
+	}
 	glBindTexture(target, 0u);
+	bonobo::resource_registry::track(bonobo::resource_registry::kind::texture, texture,
+	                                 static_cast<u64>(width) * height * getTexelSize(internal_format),
+	                                 getInternalFormatName(internal_format), "", RESOURCE_SITE);
 
 	return texture;
 }
@@ -243,28 +1128,118 @@ bonobo::createTexture(uint32_t width, uint32_t height, GLenum target, GLint inte
 GLuint
 bonobo::loadTexture2D(std::string const& filename, bool generate_mipmap)
 {
-	u32 width, height;
-	auto const data = getTextureData("textures/" + filename, width, height, true);
-	if (data.empty())
+	auto const key = bonobo::texture_registry::makeKey(GL_TEXTURE_2D, filename, generate_mipmap);
+	auto const registered_texture = bonobo::texture_registry::acquire(key);
+	if (registered_texture != 0u)
+		return registered_texture;
+
+	auto const path = config::resources_path("textures/" + filename);
+	bonobo::texture_cache::loaded_image source;
+	auto const error = bonobo::texture_cache::load(path, true, bonobo::isTextureCompressionSupported(), &bonobo::thread_pool::shared(), source);
+	if (error != 0u) {
+		LogWarning("Couldn't load or decode image file %s: %s", path.c_str(), lodepng_error_text(error));
 		return 0u;
+	}
 
-	GLuint texture = bonobo::createTexture(width, height, GL_TEXTURE_2D, GL_RGBA, GL_RGBA, GL_UNSIGNED_BYTE, reinterpret_cast<GLvoid const*>(data.data()));
-	glBindTexture(GL_TEXTURE_2D, texture);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, generate_mipmap ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	if (generate_mipmap)
-		glGenerateMipmap(GL_TEXTURE_2D);
-	glBindTexture(GL_TEXTURE_2D, 0u);
+	auto const upload_start = StartTimer();
+	u64 bytes = 0u;
+	auto const texture = uploadTextureSource2D(source, filename, generate_mipmap, bytes);
+	logTextureSource(filename, source, EndTimerNanoseconds(upload_start));
+	bonobo::texture_registry::insert(key, texture, bytes);
+	return texture;
+}
+
+//! \brief Create a cube map out of six loaded faces.
+//!
+//! @param [in] names of the faces, for logging
+//! @param [in] label name of the cube map, for resource accounting
+//! @param [out] bytes how much memory the cube map uses
+static GLuint
+uploadCubeMap(std::array<bonobo::texture_cache::loaded_image, 6> const& sources, std::array<std::string, 6> const& names,
+              std::string const& label, bool generate_mipmap, u64& bytes)
+{
+	GLuint texture = 0u;
+	glGenTextures(1, &texture);
+	assert(texture != 0u);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, generate_mipmap ? static_cast<GLint>(sources[0].levels().size()) - 1 : 0);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, generate_mipmap ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	bytes = 0u;
+	for (size_t i = 0u; i < sources.size(); ++i) {
+		auto const upload_start = StartTimer();
+		bytes += uploadLevels(GL_TEXTURE_CUBE_MAP_POSITIVE_X + static_cast<GLenum>(i), sources[i], generate_mipmap);
+		logTextureSource(names[i], sources[i], EndTimerNanoseconds(upload_start));
+	}
+	glBindTexture(GL_TEXTURE_CUBE_MAP, 0u);
+	bonobo::resource_registry::track(bonobo::resource_registry::kind::texture, texture, bytes,
+	                                 std::string(getCompressedFormatName(sources[0].format())) + " cube map", label, RESOURCE_SITE);
 
 	return texture;
 }
 
+//! \brief Create a cube map out of the caches of its faces, baking them
+//!        first if needed.
+//!
+//! The six faces are loaded in parallel on the shared thread pool.
+//!
+//! @param [in] faces file names, relative to the `res/cubemaps` folder,
+//!             in the order of the targets: +x, -x, +y, -y, +z, -z
+//! @param [out] bytes how much memory the cube map uses
+//! @return the cube map, or 0 if a face could not be loaded or if the
+//!         faces do not share the same format and size
+static GLuint
+loadCachedCubeMap(std::array<std::string, 6> const& faces, bool generate_mipmap, u64& bytes)
+{
+	auto const compress = bonobo::isTextureCompressionSupported();
+	std::array<bonobo::texture_cache::loaded_image, 6> sources;
+	std::array<std::future<unsigned int>, 6> errors;
+	for (size_t i = 0u; i < faces.size(); ++i) {
+		auto const path = config::resources_path("cubemaps/" + faces[i]);
+		auto& source = sources[i];
+		errors[i] = bonobo::thread_pool::shared().submit([path, compress, &source](){
+			return bonobo::texture_cache::load(path, false, compress, nullptr, source);
+		});
+	}
+
+	// All faces are waited for, as the workers write into `sources`.
+	bool loaded = true;
+	for (auto& error : errors)
+		loaded = error.get() == 0u && loaded;
+	if (!loaded)
+		return 0u;
+	for (auto const& source : sources)
+		if (source.format() != sources[0].format() || source.width != sources[0].width || source.height != sources[0].height)
+			return 0u;
+
+	auto const label = faces[0] + "|" + faces[1] + "|" + faces[2] + "|" + faces[3] + "|" + faces[4] + "|" + faces[5];
+	return uploadCubeMap(sources, faces, label, generate_mipmap, bytes);
+}
+
 GLuint
 bonobo::loadTextureCubeMap(std::string const& posx, std::string const& negx,
                            std::string const& posy, std::string const& negy,
                            std::string const& posz, std::string const& negz,
                            bool generate_mipmap)
 {
+	auto const key = bonobo::texture_registry::makeKey(GL_TEXTURE_CUBE_MAP,
+	                                                   posx + "|" + negx + "|" + posy + "|" + negy + "|" + posz + "|" + negz,
+	                                                   generate_mipmap);
+	auto const registered_texture = bonobo::texture_registry::acquire(key);
+	if (registered_texture != 0u)
+		return registered_texture;
+
+	u64 cached_bytes = 0u;
+	auto const cached_texture = loadCachedCubeMap({ { posx, negx, posy, negy, posz, negz } }, generate_mipmap, cached_bytes);
+	if (cached_texture != 0u) {
+		bonobo::texture_registry::insert(key, cached_texture, cached_bytes);
+		return cached_texture;
+	}
+
 	GLuint texture = 0u;
 	// Create an OpenGL texture object. Similarly to `glGenVertexArrays()`
 	// and `glGenBuffers()` that were used in assignment 2,
@@ -293,12 +1268,22 @@ bonobo::loadTextureCubeMap(std::string const& posx, std::string const& negx,
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
 	// We need to fill in the cube map using the images passed in as
-	// argument. The function `getTextureData()` uses lodepng to read in
-	// the image files and return a `std::vector<u8>` containing all the
+	// argument. The function `decodeTextureDataAsync()` uses lodepng to
+	// read in the image files on the shared thread pool, so that all six
+	// of them get decoded in parallel, and `getTextureData()` waits for
+	// one of them and returns a pointer to a buffer containing all its
 	// texels.
+	std::array<std::future<decoded_image>, 6> faces_data = { {
+		decodeTextureDataAsync("cubemaps/" + negx),
+		decodeTextureDataAsync("cubemaps/" + negy),
+		decodeTextureDataAsync("cubemaps/" + negz),
+		decodeTextureDataAsync("cubemaps/" + posx),
+		decodeTextureDataAsync("cubemaps/" + posy),
+		decodeTextureDataAsync("cubemaps/" + posz)
+	} };
 	u32 width, height;
-	auto data = getTextureData("cubemaps/" + negx, width, height, false);
-	if (data.empty()) {
+	auto data = getTextureData(faces_data[0], width, height);
+	if (!data) {
 		glDeleteTextures(1, &texture);
 		return 0u;
 	}
@@ -319,7 +1304,7 @@ bonobo::loadTextureCubeMap(std::string const& posx, std::string const& negx,
 	             /* must always be 0 */0,
 	             /* the format of the pixel data: which components are available */GL_RGBA,
 	             /* the type of each component */GL_UNSIGNED_BYTE,
-	             /* the pointer to the actual data on the CPU */reinterpret_cast<GLvoid const*>(data.data()));
+	             /* the pointer to the actual data on the CPU */reinterpret_cast<GLvoid const*>(data.get()));
 
 	//! \todo repeat now the texture filling for the 5 remaining faces
 	std::vector<std::pair<std::string, int>> textures = {
@@ -331,8 +1316,8 @@ bonobo::loadTextureCubeMap(std::string const& posx, std::string const& negx,
 	};
 
 	for (int i = 0; i < textures.size(); i++) {
-		data = getTextureData("cubemaps/" + textures[i].first, width, height, false);
-		glTexImage2D(textures[i].second, 0, GL_RGBA, static_cast<GLsizei>(width), static_cast<GLsizei>(height), 0, GL_RGBA, GL_UNSIGNED_BYTE, reinterpret_cast<GLvoid const*>(data.data()));
+		data = getTextureData(faces_data[i + 1], width, height);
+		glTexImage2D(textures[i].second, 0, GL_RGBA, static_cast<GLsizei>(width), static_cast<GLsizei>(height), 0, GL_RGBA, GL_UNSIGNED_BYTE, reinterpret_cast<GLvoid const*>(data.get()));
 	}
 	
 	if (generate_mipmap)
@@ -342,9 +1327,49 @@ bonobo::loadTextureCubeMap(std::string const& posx, std::string const& negx,
 
 	glBindTexture(GL_TEXTURE_CUBE_MAP, 0u);
 
+	auto const bytes = estimateTextureBytes(width, height, 6u, generate_mipmap);
+	bonobo::resource_registry::track(bonobo::resource_registry::kind::texture, texture, bytes, "RGBA8 cube map",
+	                                 posx + "|" + negx + "|" + posy + "|" + negy + "|" + posz + "|" + negz, RESOURCE_SITE);
+	bonobo::texture_registry::insert(key, texture, bytes);
 	return texture;
 }
 
+GLuint
+bonobo::loadEquirectangularCubeMap(std::string const& equirectangular, bool generate_mipmap)
+{
+	auto const key = bonobo::texture_registry::makeKey(GL_TEXTURE_CUBE_MAP, equirectangular, generate_mipmap);
+	auto const registered_texture = bonobo::texture_registry::acquire(key);
+	if (registered_texture != 0u)
+		return registered_texture;
+
+	auto const path = config::resources_path("cubemaps/" + equirectangular);
+	std::array<bonobo::texture_cache::loaded_image, 6> faces;
+	auto const error = bonobo::texture_cache::loadCubeMapFaces(path, bonobo::isTextureCompressionSupported(),
+	                                                           &bonobo::thread_pool::shared(), faces);
+	if (error != 0u) {
+		LogWarning("Couldn't load or decode image file %s: %s", path.c_str(), lodepng_error_text(error));
+		return 0u;
+	}
+
+	std::array<std::string, 6> names;
+	static char const* const face_names[6] = { "+x", "-x", "+y", "-y", "+z", "-z" };
+	for (size_t i = 0u; i < names.size(); ++i)
+		names[i] = equirectangular + " " + face_names[i];
+	u64 bytes = 0u;
+	auto const texture = uploadCubeMap(faces, names, equirectangular, generate_mipmap, bytes);
+	bonobo::texture_registry::insert(key, texture, bytes);
+	return texture;
+}
+
+void
+bonobo::releaseTexture(GLuint texture)
+{
+	if (texture != 0u && !bonobo::texture_registry::release(texture)) {
+		glDeleteTextures(1, &texture);
+		bonobo::resource_registry::untrack(bonobo::resource_registry::kind::texture, texture);
+	}
+}
+
 GLuint
 bonobo::createProgram(std::string const& vert_shader_source_path, std::string const& frag_shader_source_path)
 {
@@ -415,6 +1440,12 @@ bonobo::createFBO(std::vector<GLuint> const& color_attachments, GLuint depth_att
 		attach(GL_DEPTH_ATTACHMENT, depth_attachment);
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
+	// Attachments are accounted for as textures already.
+	auto attachments = std::to_string(color_attachments.size()) + " colour";
+	if (depth_attachment != 0u)
+		attachments += " + depth";
+	bonobo::resource_registry::track(bonobo::resource_registry::kind::framebuffer, fbo, 0u, attachments, "", RESOURCE_SITE);
+
 	return fbo;
 }
 
@@ -4,9 +4,15 @@
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 
+#include "core/block_compression.hpp"
+#include "core/mesh_cache.hpp"
+#include "core/mesh_optimizer.hpp"
+#include "core/mesh_simplifier.hpp"
+#include "core/meshlets.hpp"
 #include "core/FPSCamera.h" // As it includes OpenGL headers, import it after glad
 
 #include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -14,6 +20,9 @@
 //! \brief Namespace containing a few helpers for the LUGG computer graphics labs.
 namespace bonobo
 {
+	class geometry_pool;
+	class thread_pool;
+
 	//! \brief Formalise mapping between an OpenGL VAO attribute binding,
 	//!        and the meaning of that attribute.
 	enum class shader_bindings : unsigned int{
@@ -24,25 +33,64 @@ namespace bonobo
 		binormals      //!< = 4, value of the binding point for binormals
 	};
 
+	//! \brief How the vertex attributes of a mesh are laid out in its
+	//!        buffer object.
+	enum class vertex_layout : unsigned int {
+		planar = 0u,   //!< = 0, one range per attribute, one after the other; every attribute is stored as 3 floats
+		interleaved,   //!< = 1, all attributes of a vertex next to each other; texcoords are stored as 2 floats
+		quantised,     //!< = 2, as `interleaved`, with octahedral-encoded normals and tangents on 2x16-bit snorm, the binormal reduced to its sign when normals and tangents are present, and half-float texcoords
+		quantised_positions //!< = 3, as `quantised`, with positions also stored on 16-bit snorm relative to the mesh bounds
+	};
+
 	//! \brief Association of a sampler name used in GLSL to a
 	//!        corresponding texture ID.
 	using texture_bindings = std::unordered_map<std::string, GLuint>;
 
+	//! \brief Index ending the current strip, for strip drawing modes;
+	//!        stored as 0xFFFF along with 16-bit indices, and enabled by
+	//!        `Node::render()` for any strip.
+	GLuint const primitive_restart_index = 0xFFFFFFFFu;
+
 	//! \brief Contains the data for a mesh in OpenGL.
 	struct mesh_data {
 		GLuint vao;                //!< OpenGL name of the Vertex Array Object
 		GLuint bo;                 //!< OpenGL name of the Buffer Object
 		GLuint ibo;                //!< OpenGL name of the Buffer Object for indices
-		size_t vertices_nb;        //!< number of vertices stored in bo
-		size_t indices_nb;         //!< number of indices stored in ibo
+		size_t vertices_nb;        //!< number of vertices stored in bo, or drawn per instance if bo is 0
+		size_t instances_nb;       //!< number of instances drawn, 1 unless e.g. an implicit grid draws one per row
+		size_t indices_nb;         //!< number of indices of the finest level of detail stored in ibo
+		GLenum indices_type;       //!< type of the indices stored in ibo, i.e. GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
 		texture_bindings bindings; //!< texture bindings for this mesh
 		GLenum drawing_mode;       //!< OpenGL drawing mode, i.e. GL_TRIANGLES, GL_LINES, etc.
+		vertex_layout layout;      //!< how the vertex attributes are laid out in bo
+		bool binormal_is_sign;     //!< whether bo only stores on which side of the normal-tangent plane binormals lie, as with quantised layouts when normals and tangents are present
+		GLint base_vertex;         //!< index of the first vertex of the mesh in bo
+		size_t first_index;        //!< index of the first index of the mesh in ibo
+		unsigned int pool_allocation; //!< allocation inside the `geometry_pool` owning bo and ibo, or 0 if the mesh owns them
+		glm::mat4 vertex_dequantisation; //!< transform from the positions stored in bo to model space; identity unless positions are quantised
+		std::shared_ptr<std::vector<meshlets::meshlet> const> meshlets; //!< clusters of the mesh, for culling parts of it; nullptr if it was not split
+		std::shared_ptr<mesh_simplifier::lod_chain const> lods; //!< levels of detail of the mesh, whose indices follow the ones of the finest level in ibo; nullptr if it has none
 
-		mesh_data() : vao(0u), bo(0u), ibo(0u), vertices_nb(0u), indices_nb(0u), bindings(), drawing_mode(GL_TRIANGLES)
+		mesh_data() : vao(0u), bo(0u), ibo(0u), vertices_nb(0u), instances_nb(1u), indices_nb(0u), indices_type(GL_UNSIGNED_INT), bindings(), drawing_mode(GL_TRIANGLES), layout(vertex_layout::planar), binormal_is_sign(false), base_vertex(0), first_index(0u), pool_allocation(0u), vertex_dequantisation(1.0f), meshlets(), lods()
 		{
 		}
 	};
 
+	//! \brief Non-owning view over the vertex attributes of a mesh, as
+	//!        stored on the CPU.
+	//!
+	//! Only `vertices` is mandatory; other attributes can be left to
+	//! nullptr if the mesh does not provide them. Texcoords use the first
+	//! two components only.
+	struct vertex_streams {
+		size_t vertices_nb;
+		glm::vec3 const* vertices;
+		glm::vec3 const* normals;
+		glm::vec3 const* texcoords;
+		glm::vec3 const* tangents;
+		glm::vec3 const* binormals;
+	};
+
 	//! \brief Allocate some objects needed by some helper functions.
 	void init();
 
@@ -53,9 +101,111 @@ namespace bonobo
 	//!
 	//! @param [in] filename of the object/scene file to load, relative to
 	//!             the `res/scenes` folder
+	//! @param [in] layout how to lay out the vertex attributes of all the
+	//!             objects
+	//! @param [in] pool if not nullptr, all objects are allocated from it
+	//!             rather than getting their own buffers, and `layout` is
+	//!             ignored
 	//! @return a vector of filled in `mesh_data` structures, one per
 	//!         object found in the input file
-	std::vector<mesh_data> loadObjects(std::string const& filename);
+	std::vector<mesh_data> loadObjects(std::string const& filename,
+	                                   vertex_layout layout = vertex_layout::planar,
+	                                   geometry_pool* pool = nullptr);
+
+	//! \brief Assimp flags `loadObjects()` imports scenes with, which
+	//!        also key their mesh caches.
+	unsigned int getImportFlags();
+
+	//! \brief A scene file imported by assimp and prepared as by
+	//!        `loadObjects()`: optimised, split into meshlets and
+	//!        simplified, but not uploaded yet.
+	//!
+	//! `scene` points into the other members, which moving keeps valid,
+	//! but copying does not.
+	struct imported_scene {
+		//! \brief Something to log from the thread owning the GL context.
+		struct message {
+			enum class level { error, warning, info, trivia } type;
+			std::string text;
+		};
+
+		mesh_cache::scene_view scene;
+		std::vector<mesh_optimizer::mesh> meshes;
+		std::vector<std::vector<meshlets::meshlet>> meshlets;
+		std::vector<mesh_simplifier::lod_chain> lods;
+		std::vector<message> messages; //!< see `logImportMessages()`
+	};
+
+	//! \brief Import and prepare a scene file, the way `loadObjects()`
+	//!        does on a cache miss.
+	//!
+	//! Neither logs nor uses OpenGL, so that it can run on worker threads;
+	//! messages are gathered into `imported_scene::messages` instead.
+	//!
+	//! @param [in] scene_filepath path to the scene file
+	//! @param [in] pool if not nullptr, meshes get prepared in parallel
+	//!             by its workers; must then not be called from one of
+	//!             those workers
+	//! @param [out] imported the scene, along with the messages gathered
+	//! @return whether the scene could be imported
+	bool importScene(std::string const& scene_filepath, thread_pool* pool, imported_scene& imported);
+
+	//! \brief Log the messages gathered by `importScene()`.
+	void logImportMessages(imported_scene const& imported);
+
+	//! \brief Upload a mesh to OpenGL.
+	//!
+	//! With the quantised layouts, shaders reading normals, tangents or
+	//! binormals have to decode them when the `has_quantised_attributes`
+	//! uniform is set by `Node`. Binormals are only reduced to a sign if
+	//! the mesh also has normals and tangents, as recorded in
+	//! `mesh_data::binormal_is_sign`, and are stored as floats otherwise.
+	//!
+	//! Indices are stored on 16 bits whenever the mesh has few enough
+	//! vertices for them to fit, and on 32 bits otherwise; the chosen
+	//! type is recorded in `mesh_data::indices_type`. Strips can be
+	//! separated by `primitive_restart_index`, whatever the type.
+	//!
+	//! @param [in] streams the vertex attributes of the mesh
+	//! @param [in] indices the indices of the mesh, or nullptr if the mesh
+	//!             is not indexed
+	//! @param [in] indices_nb how many indices there are
+	//! @param [in] layout how to lay out the vertex attributes in the
+	//!             buffer object
+	//! @param [in] drawing_mode OpenGL drawing mode, i.e. GL_TRIANGLES,
+	//!             GL_LINES, etc.
+	//! @return the filled in `mesh_data` structure
+	mesh_data createMesh(vertex_streams const& streams,
+	                     GLuint const* indices, size_t indices_nb,
+	                     vertex_layout layout = vertex_layout::planar,
+	                     GLenum drawing_mode = GL_TRIANGLES);
+
+	//! \brief Split a triangle mesh into meshlets, see
+	//!        `meshlets::build()`, to be stored in `mesh_data::meshlets`.
+	//!
+	//! @param [in] streams the vertex attributes of the mesh, of which
+	//!             only the positions are used
+	//! @param [in] indices the indices of the mesh, as a triangle list
+	//! @param [in] indices_nb how many indices there are
+	//! @return the meshlets, or nullptr if there are no triangles
+	std::shared_ptr<std::vector<meshlets::meshlet> const> createMeshlets(vertex_streams const& streams,
+	                                                                     GLuint const* indices, size_t indices_nb);
+
+	//! \brief Build the levels of detail of a triangle mesh, see
+	//!        `mesh_simplifier::buildLodChain()`, to be stored in
+	//!        `mesh_data::lods`.
+	//!
+	//! The mesh is then to be created from all indices, with
+	//! `mesh_data::indices_nb` reset to the ones of the finest level.
+	//!
+	//! @param [in] streams the vertex attributes of the mesh, of which
+	//!             only the positions are used
+	//! @param [in,out] indices the triangle list of the mesh, to which the
+	//!                 indices of the coarser levels get appended
+	//! @return the levels of detail, or nullptr if the mesh could not be
+	//!         simplified
+	std::shared_ptr<mesh_simplifier::lod_chain const> createLodChain(vertex_streams const& streams,
+	                                                                 std::vector<GLuint>& indices);
 
 	//! \brief Creates an OpenGL texture without any content nor parameterised.
 	//!
@@ -76,8 +226,23 @@ namespace bonobo
 	                     GLenum type = GL_UNSIGNED_BYTE,
 	                     GLvoid const* data = nullptr);
 
+	//! \brief Whether block-compressed caches can be used for colour
+	//!        textures.
+	//!
+	//! BC5 (RGTC2) is core since OpenGL 3.0, but BC1 and BC3 come from
+	//! EXT_texture_compression_s3tc, which is not part of the core
+	//! profile even though every desktop driver exposes it.
+	bool isTextureCompressionSupported();
+
+	//! \brief OpenGL internal format to upload images of a given
+	//!        `block_compression::format` with.
+	GLenum getCompressedInternalFormat(block_compression::format fmt);
+
 	//! \brief Load a PNG image into an OpenGL 2D-texture.
 	//!
+	//! Loading the same file with the same options several times returns
+	//! the same, shared, texture; see `bonobo::texture_registry`.
+	//!
 	//! @param [in] filename of the PNG image, relative to the `textures`
 	//!             folder within the `resources` folder.
 	//! @param [in] generate_mipmap whether or not to generate a mipmap hierarchy
@@ -96,12 +261,36 @@ namespace bonobo
 	//! @param [in] generate_mipmap whether or not to generate a mipmap hierarchy
 	//! @return the name of the OpenGL cubemap-texture
 	//!
-	//! All paths are relative to the `res/cubemaps` folder.
+	//! All paths are relative to the `res/cubemaps` folder. As for
+	//! `loadTexture2D()`, identical loads share the same texture.
 	GLuint loadTextureCubeMap(std::string const& posx, std::string const& negx,
                                   std::string const& posy, std::string const& negy,
                                   std::string const& posz, std::string const& negz,
                                   bool generate_mipmap = true);
 
+	//! \brief Load a single equirectangular PNG image into an OpenGL
+	//!        cubemap-texture.
+	//!
+	//! The image is resampled into the six faces on the CPU, in
+	//! parallel, and each face is cached like a 2D-texture; see
+	//! `bonobo::texture_cache::loadCubeMapFaces()` for the conventions.
+	//!
+	//! @param [in] equirectangular path to the image, relative to the
+	//!             `res/cubemaps` folder
+	//! @param [in] generate_mipmap whether or not to generate a mipmap hierarchy
+	//! @return the name of the OpenGL cubemap-texture, or 0 on failure
+	GLuint loadEquirectangularCubeMap(std::string const& equirectangular, bool generate_mipmap = true);
+
+	//! \brief Release a texture obtained from one of the loading
+	//!        functions.
+	//!
+	//! Shared textures are only deleted once all their users have
+	//! released them, and may be kept around for a while afterwards in
+	//! case they get loaded again; other textures are deleted right away.
+	//!
+	//! @param [in] texture the name of the OpenGL texture to release
+	void releaseTexture(GLuint texture);
+
 	//! \brief Create an OpenGL program consisting of a vertex and a
 	//!        fragment shader.
 	//!
@@ -0,0 +1,157 @@
+#include "lz4.hpp"
+
+#include <cstring>
+
+namespace
+{
+	size_t const min_match = 4u;
+	size_t const max_offset = 65535u;
+	size_t const hash_bits = 16u;
+
+	// The format requires the last 5 bytes to be literals, and the last
+	// match to start at least 12 bytes before the end of the block.
+	size_t const last_literals = 5u;
+	size_t const match_safety = 12u;
+
+	u32 read32(u8 const* bytes)
+	{
+		u32 value;
+		std::memcpy(&value, bytes, sizeof(value));
+		return value;
+	}
+
+	u32 hash(u32 sequence)
+	{
+		return (sequence * 2654435761u) >> (32u - hash_bits);
+	}
+
+	//! \brief Append a length beyond what fits in a token nibble.
+	void writeLength(std::vector<u8>& block, size_t length)
+	{
+		for (; length >= 255u; length -= 255u)
+			block.push_back(255u);
+		block.push_back(static_cast<u8>(length));
+	}
+
+	//! \brief Append a sequence: its token, literals and match, if any.
+	void writeSequence(std::vector<u8>& block, u8 const* literals, size_t literals_nb, size_t offset, size_t match_length)
+	{
+		auto const match_code = match_length >= min_match ? match_length - min_match : 0u;
+		auto const token = static_cast<u8>(((literals_nb < 15u ? literals_nb : 15u) << 4)
+		                                 | (match_code < 15u ? match_code : 15u));
+		block.push_back(token);
+		if (literals_nb >= 15u)
+			writeLength(block, literals_nb - 15u);
+		block.insert(block.end(), literals, literals + literals_nb);
+		if (match_length < min_match)
+			return;
+		block.push_back(static_cast<u8>(offset & 0xffu));
+		block.push_back(static_cast<u8>(offset >> 8));
+		if (match_code >= 15u)
+			writeLength(block, match_code - 15u);
+	}
+
+	//! \brief Read a length continued over extra bytes.
+	bool readLength(u8 const*& cursor, u8 const* end, size_t& length)
+	{
+		u8 byte;
+		do {
+			if (cursor == end)
+				return false;
+			byte = *cursor++;
+			length += byte;
+		} while (byte == 255u);
+		return true;
+	}
+}
+
+size_t
+bonobo::lz4::getCompressBound(size_t size)
+{
+	return size + size / 255u + 16u;
+}
+
+std::vector<u8>
+bonobo::lz4::compress(u8 const* source, size_t size)
+{
+	auto block = std::vector<u8>();
+	block.reserve(getCompressBound(size));
+	if (size == 0u) {
+		block.push_back(0u);
+		return block;
+	}
+
+	// Positions of the last sequence seen for each hash, plus one so
+	// that zero means none.
+	auto table = std::vector<u32>(size_t(1u) << hash_bits, 0u);
+	size_t anchor = 0u;
+	size_t position = 0u;
+	auto const match_limit = size > match_safety ? size - match_safety : 0u;
+	while (position < match_limit) {
+		auto const sequence = read32(source + position);
+		auto& entry = table[hash(sequence)];
+		auto const candidate = static_cast<size_t>(entry);
+		entry = static_cast<u32>(position + 1u);
+		if (candidate == 0u || position - (candidate - 1u) > max_offset
+		    || read32(source + candidate - 1u) != sequence) {
+			++position;
+			continue;
+		}
+
+		auto const match = candidate - 1u;
+		auto length = min_match;
+		while (position + length < size - last_literals && source[match + length] == source[position + length])
+			++length;
+		writeSequence(block, source + anchor, position - anchor, position - match, length);
+		position += length;
+		anchor = position;
+	}
+	writeSequence(block, source + anchor, size - anchor, 0u, 0u);
+	return block;
+}
+
+bool
+bonobo::lz4::decompress(u8 const* block, size_t block_size, u8* destination, size_t size)
+{
+	auto cursor = block;
+	auto const end = block + block_size;
+	size_t written = 0u;
+	while (cursor != end) {
+		auto const token = *cursor++;
+
+		size_t literals_nb = token >> 4;
+		if (literals_nb == 15u && !readLength(cursor, end, literals_nb))
+			return false;
+		if (literals_nb > static_cast<size_t>(end - cursor) || literals_nb > size - written)
+			return false;
+		std::memcpy(destination + written, cursor, literals_nb);
+		cursor += literals_nb;
+		written += literals_nb;
+		if (cursor == end)
+			break;
+
+		if (end - cursor < 2)
+			return false;
+		auto const offset = static_cast<size_t>(cursor[0]) | (static_cast<size_t>(cursor[1]) << 8);
+		cursor += 2;
+		size_t match_length = token & 0x0fu;
+		if (match_length == 15u && !readLength(cursor, end, match_length))
+			return false;
+		match_length += min_match;
+		if (offset == 0u || offset > written || match_length > size - written)
+			return false;
+
+		// Matches may overlap the bytes they produce, e.g. to repeat a
+		// pattern, hence the byte by byte copy.
+		auto const from = destination + written - offset;
+		auto const to = destination + written;
+		if (offset >= match_length) {
+			std::memcpy(to, from, match_length);
+		} else {
+			for (size_t i = 0u; i < match_length; ++i)
+				to[i] = from[i];
+		}
+		written += match_length;
+	}
+	return written == size;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "core/Types.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace bonobo
+{
+	//! \brief Encoder and decoder for the LZ4 block format.
+	//!
+	//! Blocks are sequences of literals followed by matches copied from
+	//! up to 64 KiB back, as specified by the reference implementation,
+	//! which can therefore decode what is encoded here and vice versa.
+	//! The encoder is a plain greedy one, with a single hash table probe
+	//! per position: it trades ratio for simplicity, as decoding speed is
+	//! what matters when loading assets.
+	//!
+	//! The functions only operate on CPU data and neither use OpenGL nor
+	//! the `Log*()` macros, so they can run on worker threads.
+	namespace lz4
+	{
+		//! \brief Largest size a block of `size` bytes can encode to.
+		size_t getCompressBound(size_t size);
+
+		//! \brief Encode a block.
+		//!
+		//! @param [in] source bytes to encode
+		//! @param [in] size how many bytes there are
+		//! @return the encoded block, at most `getCompressBound(size)`
+		//!         bytes long
+		std::vector<u8> compress(u8 const* source, size_t size);
+
+		//! \brief Decode a block.
+		//!
+		//! Malformed blocks are detected, and never make the decoder
+		//! read or write out of bounds.
+		//!
+		//! @param [in] block encoded bytes
+		//! @param [in] block_size how many encoded bytes there are
+		//! @param [out] destination where to decode to
+		//! @param [in] size exact size of the decoded data
+		//! @return whether the block was well-formed and decoded to
+		//!         exactly `size` bytes
+		bool decompress(u8 const* block, size_t block_size, u8* destination, size_t size);
+	}
+}
@@ -0,0 +1,147 @@
+#include "mapped_file.hpp"
+
+#include "core/asset_pack.hpp"
+#include "core/vfs.hpp"
+
+#ifdef _WIN32
+#	include <Windows.h>
+#else
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+
+#include <utility>
+#include <vector>
+
+bonobo::mapped_file::mapped_file() : _data(nullptr), _size(0u)
+#ifdef _WIN32
+                                   , _file(nullptr), _mapping(nullptr)
+#endif
+{
+}
+
+bonobo::mapped_file::~mapped_file()
+{
+	close();
+}
+
+bonobo::mapped_file::mapped_file(mapped_file&& other) : mapped_file()
+{
+	*this = std::move(other);
+}
+
+bonobo::mapped_file&
+bonobo::mapped_file::operator=(mapped_file&& other)
+{
+	if (this == &other)
+		return *this;
+
+	close();
+	std::swap(_data, other._data);
+	std::swap(_size, other._size);
+	std::swap(_owner, other._owner);
+#ifdef _WIN32
+	std::swap(_file, other._file);
+	std::swap(_mapping, other._mapping);
+#endif
+	return *this;
+}
+
+bool
+bonobo::mapped_file::open(std::string const& path)
+{
+	close();
+
+	std::string entry_path;
+	if (auto pack = vfs::findPack(path, entry_path)) {
+		auto const entry = pack->find(entry_path);
+		if (entry == nullptr)
+			return false;
+		if (!entry->compressed) {
+			_data = pack->data(*entry);
+			_size = static_cast<size_t>(entry->size);
+			_owner = std::move(pack);
+			return true;
+		}
+		auto buffer = std::make_shared<std::vector<u8>>(static_cast<size_t>(entry->size));
+		if (!pack->extract(*entry, buffer->data()))
+			return false;
+		_data = buffer->data();
+		_size = buffer->size();
+		_owner = std::move(buffer);
+		return true;
+	}
+
+#ifdef _WIN32
+	auto const file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+		CloseHandle(file);
+		return false;
+	}
+	auto const mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr) {
+		CloseHandle(file);
+		return false;
+	}
+	auto const view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (view == nullptr) {
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+	_file = file;
+	_mapping = mapping;
+	_data = static_cast<u8 const*>(view);
+	_size = static_cast<size_t>(file_size.QuadPart);
+#else
+	auto const fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat file_stat;
+	if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+		::close(fd);
+		return false;
+	}
+	auto const size = static_cast<size_t>(file_stat.st_size);
+	auto const view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	// The mapping keeps its own reference to the file.
+	::close(fd);
+	if (view == MAP_FAILED)
+		return false;
+	_data = static_cast<u8 const*>(view);
+	_size = size;
+#endif
+
+	return true;
+}
+
+void
+bonobo::mapped_file::close()
+{
+	if (_data == nullptr)
+		return;
+
+	if (_owner != nullptr) {
+		_owner.reset();
+		_data = nullptr;
+		_size = 0u;
+		return;
+	}
+
+#ifdef _WIN32
+	UnmapViewOfFile(_data);
+	CloseHandle(_mapping);
+	CloseHandle(_file);
+	_mapping = nullptr;
+	_file = nullptr;
+#else
+	munmap(const_cast<u8*>(_data), _size);
+#endif
+	_data = nullptr;
+	_size = 0u;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "core/Types.h"
+
+#include <memory>
+#include <string>
+
+namespace bonobo
+{
+	//! \brief Read-only memory mapping of a whole file.
+	//!
+	//! The mapping stays valid until the object is closed or destroyed, so
+	//! any pointer obtained through `data()` must not outlive it.
+	//!
+	//! Files stored in a mounted asset pack, see `bonobo::vfs`, are served
+	//! from the mapping of the pack, or decoded into a buffer owned by the
+	//! object if compressed.
+	class mapped_file
+	{
+	public:
+		mapped_file();
+		~mapped_file();
+
+		mapped_file(mapped_file const&) = delete;
+		mapped_file& operator=(mapped_file const&) = delete;
+		mapped_file(mapped_file&& other);
+		mapped_file& operator=(mapped_file&& other);
+
+		//! \brief Map the content of a file into memory.
+		//!
+		//! Any previously mapped file is closed first.
+		//!
+		//! @param [in] path of the file to map
+		//! @return whether the file could be mapped; empty files are
+		//!         reported as failures, unless stored in a pack
+		bool open(std::string const& path);
+
+		//! \brief Unmap the file, if any.
+		void close();
+
+		//! \brief Whether a file is currently mapped.
+		bool is_open() const { return _data != nullptr; }
+
+		//! \brief Pointer to the first byte of the mapped file.
+		u8 const* data() const { return _data; }
+
+		//! \brief Size in bytes of the mapped file.
+		size_t size() const { return _size; }
+
+	private:
+		u8 const* _data;
+		size_t _size;
+		std::shared_ptr<void const> _owner; // pack or decoded buffer holding the data, if any
+#ifdef _WIN32
+		void* _file;
+		void* _mapping;
+#endif
+	};
+}
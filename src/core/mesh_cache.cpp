@@ -0,0 +1,417 @@
+#include "mesh_cache.hpp"
+
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+	u32 const magic = 0x48534d42u; // "BMSH" when read as little-endian bytes
+	u32 const version = 4u; // 2: meshes are welded and optimised for the vertex cache; 3: meshes carry meshlets; 4: and levels of detail
+	size_t const data_alignment = 16u;
+
+	enum attribute : u32 {
+		attribute_normals   = 1u << 0,
+		attribute_texcoords = 1u << 1,
+		attribute_tangents  = 1u << 2,
+		attribute_binormals = 1u << 3
+	};
+
+	struct header {
+		u32 magic;
+		u32 version;
+		u64 source_hash;
+		u32 import_flags;
+		u32 materials_nb;
+		u32 meshes_nb;
+		u32 reserved;
+		u64 file_size;
+	};
+
+	size_t align(size_t offset)
+	{
+		return (offset + data_alignment - 1u) & ~(data_alignment - 1u);
+	}
+
+	size_t streams_size(bonobo::mesh_cache::mesh_view const& mesh, u32 attributes)
+	{
+		size_t streams_nb = 1u;
+		for (u32 bit = attribute_normals; bit <= attribute_binormals; bit <<= 1u)
+			streams_nb += (attributes & bit) != 0u ? 1u : 0u;
+		return streams_nb * mesh.vertices_nb * 3u * sizeof(f32);
+	}
+
+	//! \brief Offset of the meshlets from the start of the data of a
+	//!        mesh, as they follow its indices.
+	size_t meshlets_offset(bonobo::mesh_cache::mesh_view const& mesh, u32 attributes)
+	{
+		return align(streams_size(mesh, attributes) + mesh.indices_nb * sizeof(u32));
+	}
+
+	//! \brief Offset of the levels of detail from the start of the data
+	//!        of a mesh, as they follow its meshlets.
+	size_t lods_offset(bonobo::mesh_cache::mesh_view const& mesh, u32 attributes, u32 meshlets_nb)
+	{
+		return align(meshlets_offset(mesh, attributes) + meshlets_nb * sizeof(bonobo::meshlets::meshlet));
+	}
+
+	u32 attributes_of(bonobo::mesh_cache::mesh_view const& mesh)
+	{
+		return (mesh.normals   != nullptr ? attribute_normals   : 0u)
+		     | (mesh.texcoords != nullptr ? attribute_texcoords : 0u)
+		     | (mesh.tangents  != nullptr ? attribute_tangents  : 0u)
+		     | (mesh.binormals != nullptr ? attribute_binormals : 0u);
+	}
+
+	class table_writer
+	{
+	public:
+		void put(void const* data, size_t size)
+		{
+			auto const bytes = static_cast<u8 const*>(data);
+			_content.insert(_content.end(), bytes, bytes + size);
+		}
+		void put_u32(u32 value) { put(&value, sizeof(value)); }
+		void put_u64(u64 value) { put(&value, sizeof(value)); }
+		void put_string(std::string const& value)
+		{
+			put_u32(static_cast<u32>(value.size()));
+			put(value.data(), value.size());
+		}
+		std::vector<u8> const& content() const { return _content; }
+
+	private:
+		std::vector<u8> _content;
+	};
+
+	class table_reader
+	{
+	public:
+		table_reader(u8 const* data, size_t size, size_t offset) : _data(data), _size(size), _offset(offset), _valid(true)
+		{
+		}
+		bool get(void* data, size_t size)
+		{
+			if (!_valid || size > _size - _offset) {
+				_valid = false;
+				return false;
+			}
+			std::memcpy(data, _data + _offset, size);
+			_offset += size;
+			return true;
+		}
+		u32 get_u32() { u32 value = 0u; get(&value, sizeof(value)); return value; }
+		u64 get_u64() { u64 value = 0u; get(&value, sizeof(value)); return value; }
+		std::string get_string()
+		{
+			auto const length = get_u32();
+			if (!_valid || length > _size - _offset) {
+				_valid = false;
+				return std::string();
+			}
+			auto const value = std::string(reinterpret_cast<char const*>(_data + _offset), length);
+			_offset += length;
+			return value;
+		}
+		bool valid() const { return _valid; }
+
+	private:
+		u8 const* _data;
+		size_t _size;
+		size_t _offset;
+		bool _valid;
+	};
+
+	u64 fold(u64 value, u8 const* data, size_t size)
+	{
+		for (size_t i = 0u; i < size; ++i) {
+			value ^= data[i];
+			value *= 0x100000001b3ull;
+		}
+		return value;
+	}
+
+	bool endsWith(std::string const& value, std::string const& suffix)
+	{
+		return value.size() >= suffix.size()
+		    && value.compare(value.size() - suffix.size(), suffix.size(), suffix) == 0;
+	}
+
+	//! \brief Material libraries referenced by `mtllib` statements of an
+	//!        OBJ file, each taking the rest of its line as assimp does.
+	std::vector<std::string> getMaterialLibraries(u8 const* data, size_t size)
+	{
+		std::vector<std::string> libraries;
+		auto const text = reinterpret_cast<char const*>(data);
+		for (size_t line_start = 0u; line_start < size;) {
+			auto line_end = line_start;
+			while (line_end < size && text[line_end] != '\n')
+				++line_end;
+			auto first = line_start;
+			while (first < line_end && (text[first] == ' ' || text[first] == '\t'))
+				++first;
+			if (line_end - first > 7u && std::strncmp(text + first, "mtllib", 6u) == 0
+			    && (text[first + 6u] == ' ' || text[first + 6u] == '\t')) {
+				first += 7u;
+				auto last = line_end;
+				while (last > first && std::isspace(static_cast<unsigned char>(text[last - 1u])))
+					--last;
+				while (first < last && std::isspace(static_cast<unsigned char>(text[first])))
+					++first;
+				if (first < last)
+					libraries.emplace_back(text + first, last - first);
+			}
+			line_start = line_end + 1u;
+		}
+		return libraries;
+	}
+}
+
+u64
+bonobo::mesh_cache::hash(u8 const* data, size_t size)
+{
+	return fold(0xcbf29ce484222325ull, data, size);
+}
+
+bool
+bonobo::mesh_cache::hashSource(std::string const& scene_path, u64& source_hash)
+{
+	mapped_file source;
+	if (!source.open(scene_path))
+		return false;
+	source_hash = hash(source.data(), source.size());
+	if (!endsWith(scene_path, ".obj"))
+		return true;
+
+	// Materials, and the textures they bind, come from the libraries, so
+	// editing one of them has to invalidate the cache as well. A missing
+	// library adds nothing, but it changes the hash once it appears.
+	auto const separator = scene_path.find_last_of("/\\");
+	auto const directory = separator != std::string::npos ? scene_path.substr(0u, separator + 1u) : std::string();
+	for (auto const& library : getMaterialLibraries(source.data(), source.size())) {
+		mapped_file material;
+		if (material.open(directory + library))
+			source_hash = fold(source_hash, material.data(), material.size());
+	}
+	return true;
+}
+
+bonobo::mesh_simplifier::lod_chain
+bonobo::mesh_cache::getLodChain(mesh_view const& mesh)
+{
+	auto chain = mesh_simplifier::lod_chain();
+	chain.centre = glm::vec3(mesh.bounding_sphere);
+	chain.radius = mesh.bounding_sphere.w;
+	if (mesh.lods != nullptr)
+		chain.levels.assign(mesh.lods, mesh.lods + mesh.lods_nb);
+	return chain;
+}
+
+std::string
+bonobo::mesh_cache::getCachePath(std::string const& scene_path)
+{
+	return scene_path + ".meshcache";
+}
+
+bool
+bonobo::mesh_cache::reader::open(std::string const& cache_path, u64 source_hash, u32 import_flags)
+{
+	_scene = scene_view();
+	if (!_file.open(cache_path))
+		return false;
+
+	auto const data = _file.data();
+	auto const size = _file.size();
+
+	header file_header;
+	if (size < sizeof(file_header)) {
+		_file.close();
+		return false;
+	}
+	std::memcpy(&file_header, data, sizeof(file_header));
+	if (file_header.magic != magic
+	 || file_header.version != version
+	 || file_header.source_hash != source_hash
+	 || file_header.import_flags != import_flags
+	 || file_header.file_size != size) {
+		_file.close();
+		return false;
+	}
+
+	table_reader table(data, size, sizeof(file_header));
+
+	_scene.materials.resize(file_header.materials_nb);
+	for (auto& material : _scene.materials) {
+		auto const textures_nb = table.get_u32();
+		for (u32 i = 0u; i < textures_nb && table.valid(); ++i) {
+			texture_reference texture;
+			texture.binding = table.get_string();
+			texture.path = table.get_string();
+			texture.generate_mipmap = table.get_u32() != 0u;
+			material.push_back(texture);
+		}
+	}
+
+	_scene.meshes.resize(file_header.meshes_nb);
+	for (auto& mesh : _scene.meshes) {
+		mesh.vertices_nb  = table.get_u32();
+		mesh.indices_nb   = table.get_u32();
+		mesh.meshlets_nb  = table.get_u32();
+		mesh.lods_nb      = table.get_u32();
+		mesh.material_id  = table.get_u32();
+		mesh.drawing_mode = table.get_u32();
+		auto const attributes  = table.get_u32();
+		auto const data_offset = table.get_u64();
+		table.get(&mesh.bounding_sphere, sizeof(mesh.bounding_sphere));
+		mesh.name = table.get_string();
+		if (!table.valid())
+			break;
+
+		auto const vertex_stream_size = static_cast<u64>(mesh.vertices_nb) * 3u * sizeof(f32);
+		auto const required_size = static_cast<u64>(lods_offset(mesh, attributes, mesh.meshlets_nb))
+		                         + static_cast<u64>(mesh.lods_nb) * sizeof(mesh_simplifier::lod);
+		if (data_offset % data_alignment != 0u || data_offset > size || required_size > size - data_offset) {
+			_file.close();
+			_scene = scene_view();
+			return false;
+		}
+
+		auto stream = data + data_offset;
+		auto const next_stream = [&stream, vertex_stream_size](bool present) -> f32 const* {
+			if (!present)
+				return nullptr;
+			auto const current = reinterpret_cast<f32 const*>(stream);
+			stream += vertex_stream_size;
+			return current;
+		};
+		mesh.vertices  = next_stream(true);
+		mesh.normals   = next_stream((attributes & attribute_normals)   != 0u);
+		mesh.texcoords = next_stream((attributes & attribute_texcoords) != 0u);
+		mesh.tangents  = next_stream((attributes & attribute_tangents)  != 0u);
+		mesh.binormals = next_stream((attributes & attribute_binormals) != 0u);
+		mesh.indices   = reinterpret_cast<u32 const*>(stream);
+		mesh.meshlets  = mesh.meshlets_nb != 0u
+		               ? reinterpret_cast<meshlets::meshlet const*>(data + data_offset + meshlets_offset(mesh, attributes))
+		               : nullptr;
+		mesh.lods      = mesh.lods_nb != 0u
+		               ? reinterpret_cast<mesh_simplifier::lod const*>(data + data_offset + lods_offset(mesh, attributes, mesh.meshlets_nb))
+		               : nullptr;
+	}
+
+	if (!table.valid()) {
+		_file.close();
+		_scene = scene_view();
+		return false;
+	}
+
+	return true;
+}
+
+bool
+bonobo::mesh_cache::write(std::string const& cache_path, u64 source_hash, u32 import_flags, scene_view const& scene)
+{
+	table_writer materials_table;
+	for (auto const& material : scene.materials) {
+		materials_table.put_u32(static_cast<u32>(material.size()));
+		for (auto const& texture : material) {
+			materials_table.put_string(texture.binding);
+			materials_table.put_string(texture.path);
+			materials_table.put_u32(texture.generate_mipmap ? 1u : 0u);
+		}
+	}
+
+	// The size of the mesh table does not depend on the data offsets, so
+	// compute it first to know where the data section starts.
+	size_t meshes_table_size = 0u;
+	for (auto const& mesh : scene.meshes)
+		meshes_table_size += 7u * sizeof(u32) + sizeof(u64) + sizeof(glm::vec4) + sizeof(u32) + mesh.name.size();
+
+	auto data_offset = align(sizeof(header) + materials_table.content().size() + meshes_table_size);
+	std::vector<size_t> data_offsets;
+	data_offsets.reserve(scene.meshes.size());
+	table_writer meshes_table;
+	for (auto const& mesh : scene.meshes) {
+		auto const attributes = attributes_of(mesh);
+		meshes_table.put_u32(mesh.vertices_nb);
+		meshes_table.put_u32(mesh.indices_nb);
+		meshes_table.put_u32(mesh.meshlets != nullptr ? mesh.meshlets_nb : 0u);
+		meshes_table.put_u32(mesh.lods != nullptr ? mesh.lods_nb : 0u);
+		meshes_table.put_u32(mesh.material_id);
+		meshes_table.put_u32(mesh.drawing_mode);
+		meshes_table.put_u32(attributes);
+		meshes_table.put_u64(data_offset);
+		meshes_table.put(&mesh.bounding_sphere, sizeof(mesh.bounding_sphere));
+		meshes_table.put_string(mesh.name);
+		data_offsets.push_back(data_offset);
+		auto const meshlets_nb = mesh.meshlets != nullptr ? mesh.meshlets_nb : 0u;
+		auto const lods_nb = mesh.lods != nullptr ? mesh.lods_nb : 0u;
+		data_offset = align(data_offset + lods_offset(mesh, attributes, meshlets_nb) + lods_nb * sizeof(mesh_simplifier::lod));
+	}
+
+	header file_header;
+	file_header.magic = magic;
+	file_header.version = version;
+	file_header.source_hash = source_hash;
+	file_header.import_flags = import_flags;
+	file_header.materials_nb = static_cast<u32>(scene.materials.size());
+	file_header.meshes_nb = static_cast<u32>(scene.meshes.size());
+	file_header.reserved = 0u;
+	file_header.file_size = data_offset;
+
+	auto const temporary_path = cache_path + ".tmp";
+	{
+		std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+			return false;
+
+		size_t written = 0u;
+		auto const put = [&file, &written](void const* data, size_t size) {
+			file.write(static_cast<char const*>(data), static_cast<std::streamsize>(size));
+			written += size;
+		};
+		auto const pad_to = [&put, &written](size_t offset) {
+			static u8 const zeroes[data_alignment] = {};
+			put(zeroes, offset - written);
+		};
+
+		put(&file_header, sizeof(file_header));
+		put(materials_table.content().data(), materials_table.content().size());
+		put(meshes_table.content().data(), meshes_table.content().size());
+
+		for (size_t i = 0u; i < scene.meshes.size(); ++i) {
+			auto const& mesh = scene.meshes[i];
+			pad_to(data_offsets[i]);
+			auto const vertex_stream_size = mesh.vertices_nb * 3u * sizeof(f32);
+			for (auto const stream : { mesh.vertices, mesh.normals, mesh.texcoords, mesh.tangents, mesh.binormals })
+				if (stream != nullptr)
+					put(stream, vertex_stream_size);
+			put(mesh.indices, mesh.indices_nb * sizeof(u32));
+			if (mesh.meshlets != nullptr && mesh.meshlets_nb != 0u) {
+				pad_to(data_offsets[i] + meshlets_offset(mesh, attributes_of(mesh)));
+				put(mesh.meshlets, mesh.meshlets_nb * sizeof(meshlets::meshlet));
+			}
+			if (mesh.lods != nullptr && mesh.lods_nb != 0u) {
+				auto const meshlets_nb = mesh.meshlets != nullptr ? mesh.meshlets_nb : 0u;
+				pad_to(data_offsets[i] + lods_offset(mesh, attributes_of(mesh), meshlets_nb));
+				put(mesh.lods, mesh.lods_nb * sizeof(mesh_simplifier::lod));
+			}
+		}
+		pad_to(data_offset);
+
+		if (!file.good()) {
+			file.close();
+			std::remove(temporary_path.c_str());
+			return false;
+		}
+	}
+
+	// std::rename() does not replace existing files on every platform.
+	std::remove(cache_path.c_str());
+	if (std::rename(temporary_path.c_str(), cache_path.c_str()) != 0) {
+		std::remove(temporary_path.c_str());
+		return false;
+	}
+
+	return true;
+}
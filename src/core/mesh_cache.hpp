@@ -0,0 +1,129 @@
+#pragma once
+
+#include "core/mapped_file.hpp"
+#include "core/mesh_simplifier.hpp"
+#include "core/meshlets.hpp"
+#include "core/Types.h"
+
+#include <string>
+#include <vector>
+
+namespace bonobo
+{
+	//! \brief On-disk cache of the meshes imported by `bonobo::loadObjects()`.
+	//!
+	//! A cache file stores, for one scene file, the final vertex streams,
+	//! index buffers, meshlets, levels of detail and material bindings of
+	//! every mesh, i.e. after the `mesh_optimizer` pass, so that warm
+	//! starts can upload them straight from a memory mapping without going
+	//! through assimp nor the optimiser. It is keyed by a hash of the scene
+	//! file content, along with the material libraries of OBJ files, and
+	//! by the import flags used, and carries a format version: a mismatch
+	//! on any of those makes the cache stale.
+	namespace mesh_cache
+	{
+		//! \brief Texture referenced by a material.
+		struct texture_reference {
+			std::string binding;  //!< sampler name used in GLSL, e.g. `diffuse_texture`
+			std::string path;     //!< path given to `bonobo::loadTexture2D()`
+			bool generate_mipmap; //!< whether a mipmap hierarchy is wanted
+		};
+
+		//! \brief All the textures referenced by a material.
+		using material_reference = std::vector<texture_reference>;
+
+		//! \brief Non-owning view over the final data of a mesh.
+		//!
+		//! Every vertex stream holds three floats per vertex, and is
+		//! nullptr when the mesh does not provide that attribute.
+		//! `meshlets` is nullptr when the mesh was not split into
+		//! clusters, e.g. if it is not made of triangles; likewise for
+		//! `lods` when the mesh has a single level of detail. `indices`
+		//! holds the indices of all levels, the finest one first.
+		struct mesh_view {
+			std::string name;
+			u32 vertices_nb;
+			u32 indices_nb;
+			u32 meshlets_nb;
+			u32 lods_nb;
+			u32 material_id;
+			u32 drawing_mode;
+			f32 const* vertices;
+			f32 const* normals;
+			f32 const* texcoords;
+			f32 const* tangents;
+			f32 const* binormals;
+			u32 const* indices;
+			meshlets::meshlet const* meshlets;
+			mesh_simplifier::lod const* lods;
+			glm::vec4 bounding_sphere; //!< centre and radius of the levels of detail, in model space
+		};
+
+		//! \brief Non-owning view over all materials and meshes of a scene.
+		struct scene_view {
+			std::vector<material_reference> materials;
+			std::vector<mesh_view> meshes;
+		};
+
+		//! \brief Copy the levels of detail of a mesh out of its view.
+		mesh_simplifier::lod_chain getLodChain(mesh_view const& mesh);
+
+		//! \brief Compute the hash used to key the cache of a scene file.
+		//!
+		//! @param [in] data content of the scene file
+		//! @param [in] size size in bytes of the content
+		//! @return a 64-bit FNV-1a hash of the content
+		u64 hash(u8 const* data, size_t size);
+
+		//! \brief Compute the hash keying the cache of a scene file: that
+		//!        of its content, extended with the content of the `.mtl`
+		//!        files it references if it is an OBJ file.
+		//!
+		//! Does not log, so it can run on worker threads.
+		//!
+		//! @param [in] scene_path path to the scene file
+		//! @param [out] source_hash the hash, when the file could be read
+		//! @return whether the scene file could be read
+		bool hashSource(std::string const& scene_path, u64& source_hash);
+
+		//! \brief Path of the cache file associated to a scene file.
+		std::string getCachePath(std::string const& scene_path);
+
+		//! \brief A cache file opened for reading.
+		//!
+		//! The views returned by `scene()` point inside the memory
+		//! mapping of the cache file, and are only valid as long as the
+		//! reader is alive.
+		class reader
+		{
+		public:
+			//! \brief Map a cache file and validate it.
+			//!
+			//! @param [in] cache_path path to the cache file
+			//! @param [in] source_hash hash of the scene file content
+			//! @param [in] import_flags assimp flags used for importing
+			//! @return whether the cache exists, is well-formed and
+			//!         matches the current version, hash and flags
+			bool open(std::string const& cache_path, u64 source_hash, u32 import_flags);
+
+			//! \brief Materials and meshes found in the cache.
+			scene_view const& scene() const { return _scene; }
+
+		private:
+			mapped_file _file;
+			scene_view _scene;
+		};
+
+		//! \brief Write a cache file.
+		//!
+		//! The file is first written under a temporary name and then
+		//! renamed, so that readers never see a partially written cache.
+		//!
+		//! @param [in] cache_path path to the cache file
+		//! @param [in] source_hash hash of the scene file content
+		//! @param [in] import_flags assimp flags used for importing
+		//! @param [in] scene materials and meshes to store
+		//! @return whether the cache file could be written
+		bool write(std::string const& cache_path, u64 source_hash, u32 import_flags, scene_view const& scene);
+	}
+}
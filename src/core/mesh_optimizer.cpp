@@ -0,0 +1,371 @@
+#include "mesh_optimizer.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <unordered_map>
+
+namespace
+{
+	// Parameters from Tom Forsyth's article.
+	size_t const forsyth_cache_size = 32u;
+	float const forsyth_cache_decay_power = 1.5f;
+	float const forsyth_last_triangle_score = 0.75f;
+	float const forsyth_valence_boost_scale = 2.0f;
+	float const forsyth_valence_boost_power = 0.5f;
+
+	float vertexScore(int cache_position, u32 remaining_triangles_nb)
+	{
+		if (remaining_triangles_nb == 0u)
+			return -1.0f;
+
+		float score = 0.0f;
+		if (cache_position >= 0) {
+			if (cache_position < 3)
+				score = forsyth_last_triangle_score;
+			else
+				score = std::pow(1.0f - static_cast<float>(cache_position - 3) / static_cast<float>(forsyth_cache_size - 3u),
+				                 forsyth_cache_decay_power);
+		}
+		score += forsyth_valence_boost_scale * std::pow(static_cast<float>(remaining_triangles_nb), -forsyth_valence_boost_power);
+		return score;
+	}
+
+	std::vector<std::vector<f32>*> streams_of(bonobo::mesh_optimizer::mesh& m)
+	{
+		std::vector<std::vector<f32>*> streams;
+		for (auto stream : { &m.vertices, &m.normals, &m.texcoords, &m.tangents, &m.binormals })
+			if (!stream->empty())
+				streams.push_back(stream);
+		return streams;
+	}
+
+	// Move vertex `new_to_old[i]` of every stream to position i.
+	void remapVertices(bonobo::mesh_optimizer::mesh& m, std::vector<u32> const& new_to_old)
+	{
+		for (auto stream : streams_of(m)) {
+			auto remapped = std::vector<f32>(new_to_old.size() * 3u);
+			for (size_t i = 0u; i < new_to_old.size(); ++i)
+				std::memcpy(&remapped[i * 3u], &(*stream)[new_to_old[i] * 3u], 3u * sizeof(f32));
+			stream->swap(remapped);
+		}
+		m.vertices_nb = new_to_old.size();
+	}
+}
+
+bonobo::mesh_optimizer::cache_statistics
+bonobo::mesh_optimizer::analyseVertexCache(u32 const* indices, size_t indices_nb, size_t vertices_nb, size_t cache_size)
+{
+	cache_statistics stats = { 0.0f, 0.0f };
+	if (indices_nb < 3u || vertices_nb == 0u)
+		return stats;
+
+	// A vertex is in the cache if it was inserted less than `cache_size`
+	// misses ago.
+	auto insertion_time = std::vector<size_t>(vertices_nb, 0u);
+	size_t misses_nb = 0u;
+	for (size_t i = 0u; i < indices_nb; ++i) {
+		auto const v = indices[i];
+		if (insertion_time[v] == 0u || misses_nb - insertion_time[v] >= cache_size) {
+			++misses_nb;
+			insertion_time[v] = misses_nb;
+		}
+	}
+
+	stats.acmr = static_cast<float>(misses_nb) / static_cast<float>(indices_nb / 3u);
+	stats.atvr = static_cast<float>(misses_nb) / static_cast<float>(vertices_nb);
+	return stats;
+}
+
+bonobo::mesh_optimizer::cache_statistics
+bonobo::mesh_optimizer::analyseStripVertexCache(u32 const* indices, size_t indices_nb, size_t vertices_nb, size_t cache_size)
+{
+	cache_statistics stats = { 0.0f, 0.0f };
+	if (indices_nb < 3u || vertices_nb == 0u)
+		return stats;
+
+	auto insertion_time = std::vector<size_t>(vertices_nb, 0u);
+	size_t misses_nb = 0u;
+	size_t triangles_nb = 0u;
+	size_t strip_length = 0u;
+	for (size_t i = 0u; i < indices_nb; ++i) {
+		auto const v = indices[i];
+		if (v == ~0u) {
+			strip_length = 0u;
+			continue;
+		}
+		// Every index past the first two of a strip adds a triangle.
+		if (++strip_length >= 3u)
+			++triangles_nb;
+		if (insertion_time[v] == 0u || misses_nb - insertion_time[v] >= cache_size) {
+			++misses_nb;
+			insertion_time[v] = misses_nb;
+		}
+	}
+	if (triangles_nb == 0u)
+		return stats;
+
+	stats.acmr = static_cast<float>(misses_nb) / static_cast<float>(triangles_nb);
+	stats.atvr = static_cast<float>(misses_nb) / static_cast<float>(vertices_nb);
+	return stats;
+}
+
+void
+bonobo::mesh_optimizer::weldVertices(mesh& m)
+{
+	auto const streams = streams_of(m);
+	auto const vertex_hash = [&streams](size_t v){
+		u64 value = 0xcbf29ce484222325ull;
+		for (auto const stream : streams) {
+			auto const bytes = reinterpret_cast<u8 const*>(&(*stream)[v * 3u]);
+			for (size_t i = 0u; i < 3u * sizeof(f32); ++i) {
+				value ^= bytes[i];
+				value *= 0x100000001b3ull;
+			}
+		}
+		return static_cast<size_t>(value);
+	};
+	auto const vertex_equal = [&streams](size_t a, size_t b){
+		for (auto const stream : streams)
+			if (std::memcmp(&(*stream)[a * 3u], &(*stream)[b * 3u], 3u * sizeof(f32)) != 0)
+				return false;
+		return true;
+	};
+
+	std::unordered_map<size_t, u32, decltype(vertex_hash), decltype(vertex_equal)> unique_vertices(m.vertices_nb, vertex_hash, vertex_equal);
+	auto old_to_unique = std::vector<u32>(m.vertices_nb);
+	std::vector<u32> unique_to_old;
+	for (size_t v = 0u; v < m.vertices_nb; ++v) {
+		auto const inserted = unique_vertices.emplace(v, static_cast<u32>(unique_to_old.size()));
+		if (inserted.second)
+			unique_to_old.push_back(static_cast<u32>(v));
+		old_to_unique[v] = inserted.first->second;
+	}
+	if (unique_to_old.size() == m.vertices_nb)
+		return;
+
+	for (auto& index : m.indices)
+		index = old_to_unique[index];
+	remapVertices(m, unique_to_old);
+}
+
+void
+bonobo::mesh_optimizer::optimizeVertexCache(std::vector<u32>& indices, size_t vertices_nb)
+{
+	auto const triangles_nb = indices.size() / 3u;
+	if (triangles_nb == 0u)
+		return;
+
+	// Vertex to triangles adjacency, stored as one flat array.
+	auto remaining_nb = std::vector<u32>(vertices_nb, 0u);
+	for (auto const index : indices)
+		++remaining_nb[index];
+	auto adjacency_offsets = std::vector<u32>(vertices_nb + 1u, 0u);
+	std::partial_sum(remaining_nb.begin(), remaining_nb.end(), adjacency_offsets.begin() + 1);
+	auto adjacency = std::vector<u32>(indices.size());
+	{
+		auto fill = std::vector<u32>(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+		for (size_t t = 0u; t < triangles_nb; ++t)
+			for (size_t k = 0u; k < 3u; ++k)
+				adjacency[fill[indices[t * 3u + k]]++] = static_cast<u32>(t);
+	}
+
+	auto cache_position = std::vector<int>(vertices_nb, -1);
+	auto vertex_scores = std::vector<float>(vertices_nb);
+	for (size_t v = 0u; v < vertices_nb; ++v)
+		vertex_scores[v] = vertexScore(-1, remaining_nb[v]);
+
+	auto triangle_added = std::vector<bool>(triangles_nb, false);
+	auto triangle_scores = std::vector<float>(triangles_nb);
+	for (size_t t = 0u; t < triangles_nb; ++t)
+		triangle_scores[t] = vertex_scores[indices[t * 3u]] + vertex_scores[indices[t * 3u + 1u]] + vertex_scores[indices[t * 3u + 2u]];
+
+	auto best_triangle = static_cast<size_t>(std::max_element(triangle_scores.begin(), triangle_scores.end()) - triangle_scores.begin());
+	size_t next_unadded = 0u;
+
+	std::vector<u32> cache;
+	cache.reserve(forsyth_cache_size + 3u);
+	std::vector<u32> new_cache;
+	new_cache.reserve(forsyth_cache_size + 3u);
+
+	auto optimized = std::vector<u32>();
+	optimized.reserve(indices.size());
+	for (size_t emitted = 0u; emitted < triangles_nb; ++emitted) {
+		if (best_triangle == triangles_nb) {
+			// Nothing in the cache leads to a triangle: start over from
+			// the first triangle not yet emitted.
+			while (triangle_added[next_unadded])
+				++next_unadded;
+			best_triangle = next_unadded;
+		}
+
+		triangle_added[best_triangle] = true;
+		u32 const* const triangle = &indices[best_triangle * 3u];
+		optimized.insert(optimized.end(), triangle, triangle + 3u);
+
+		// Remove the triangle from the adjacency of its vertices.
+		for (size_t k = 0u; k < 3u; ++k) {
+			auto const v = triangle[k];
+			auto const begin = adjacency.begin() + adjacency_offsets[v];
+			auto const end = begin + remaining_nb[v];
+			auto const position = std::find(begin, end, static_cast<u32>(best_triangle));
+			std::iter_swap(position, end - 1);
+			--remaining_nb[v];
+		}
+
+		// Put the triangle vertices at the front of the LRU cache.
+		new_cache.assign(triangle, triangle + 3u);
+		for (auto const v : cache)
+			if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+				new_cache.push_back(v);
+		for (size_t i = forsyth_cache_size; i < new_cache.size(); ++i)
+			cache_position[new_cache[i]] = -1;
+		for (size_t i = 0u; i < std::min(new_cache.size(), forsyth_cache_size); ++i)
+			cache_position[new_cache[i]] = static_cast<int>(i);
+
+		// Update the scores of everything touched, and pick the best
+		// triangle among those using cached vertices.
+		for (auto const v : new_cache)
+			vertex_scores[v] = vertexScore(cache_position[v], remaining_nb[v]);
+		best_triangle = triangles_nb;
+		float best_score = -1.0f;
+		for (auto const v : new_cache) {
+			for (u32 i = 0u; i < remaining_nb[v]; ++i) {
+				auto const t = adjacency[adjacency_offsets[v] + i];
+				auto const score = vertex_scores[indices[t * 3u]] + vertex_scores[indices[t * 3u + 1u]] + vertex_scores[indices[t * 3u + 2u]];
+				triangle_scores[t] = score;
+				if (score > best_score) {
+					best_score = score;
+					best_triangle = t;
+				}
+			}
+		}
+
+		if (new_cache.size() > forsyth_cache_size)
+			new_cache.resize(forsyth_cache_size);
+		cache.swap(new_cache);
+	}
+
+	indices.swap(optimized);
+}
+
+void
+bonobo::mesh_optimizer::optimizeOverdraw(std::vector<u32>& indices, f32 const* positions, size_t vertices_nb, float threshold)
+{
+	auto const triangles_nb = indices.size() / 3u;
+	if (triangles_nb < 2u)
+		return;
+
+	// Cut clusters where a triangle misses the cache on all its vertices.
+	size_t const cache_size = 16u;
+	std::vector<size_t> cluster_starts;
+	{
+		auto insertion_time = std::vector<size_t>(vertices_nb, 0u);
+		size_t misses_nb = 0u;
+		for (size_t t = 0u; t < triangles_nb; ++t) {
+			unsigned int triangle_misses_nb = 0u;
+			for (size_t k = 0u; k < 3u; ++k) {
+				auto const v = indices[t * 3u + k];
+				if (insertion_time[v] == 0u || misses_nb - insertion_time[v] >= cache_size) {
+					++misses_nb;
+					++triangle_misses_nb;
+					insertion_time[v] = misses_nb;
+				}
+			}
+			if (t == 0u || triangle_misses_nb == 3u)
+				cluster_starts.push_back(t);
+		}
+	}
+	if (cluster_starts.size() < 2u)
+		return;
+
+	auto const position = [positions](u32 v){
+		return glm::vec3(positions[v * 3u], positions[v * 3u + 1u], positions[v * 3u + 2u]);
+	};
+
+	auto mesh_centroid = glm::vec3(0.0f);
+	for (size_t v = 0u; v < vertices_nb; ++v)
+		mesh_centroid += position(static_cast<u32>(v));
+	mesh_centroid /= static_cast<float>(vertices_nb);
+
+	// Sort clusters by how much they face away from the mesh centre:
+	// those are the most likely to occlude the others.
+	struct cluster {
+		size_t first_triangle;
+		size_t triangles_nb;
+		float sort_key;
+	};
+	std::vector<cluster> clusters;
+	clusters.reserve(cluster_starts.size());
+	for (size_t c = 0u; c < cluster_starts.size(); ++c) {
+		auto const first = cluster_starts[c];
+		auto const last = c + 1u < cluster_starts.size() ? cluster_starts[c + 1u] : triangles_nb;
+
+		auto centroid = glm::vec3(0.0f), normal = glm::vec3(0.0f);
+		float area = 0.0f;
+		for (size_t t = first; t < last; ++t) {
+			auto const a = position(indices[t * 3u]), b = position(indices[t * 3u + 1u]), c2 = position(indices[t * 3u + 2u]);
+			auto const area_normal = glm::cross(b - a, c2 - a); // twice the area, along the normal
+			auto const triangle_area = glm::length(area_normal);
+			centroid += (a + b + c2) * (triangle_area / 3.0f);
+			normal += area_normal;
+			area += triangle_area;
+		}
+		if (area > 0.0f)
+			centroid /= area;
+		auto const normal_length = glm::length(normal);
+		if (normal_length > 0.0f)
+			normal /= normal_length;
+
+		clusters.push_back({ first, last - first, glm::dot(centroid - mesh_centroid, normal) });
+	}
+	std::stable_sort(clusters.begin(), clusters.end(), [](cluster const& a, cluster const& b){ return a.sort_key > b.sort_key; });
+
+	auto reordered = std::vector<u32>();
+	reordered.reserve(indices.size());
+	for (auto const& c : clusters)
+		reordered.insert(reordered.end(), indices.begin() + static_cast<std::ptrdiff_t>(c.first_triangle * 3u),
+		                 indices.begin() + static_cast<std::ptrdiff_t>((c.first_triangle + c.triangles_nb) * 3u));
+
+	auto const acmr_before = analyseVertexCache(indices.data(), indices.size(), vertices_nb).acmr;
+	auto const acmr_after = analyseVertexCache(reordered.data(), reordered.size(), vertices_nb).acmr;
+	if (acmr_after <= acmr_before * threshold)
+		indices.swap(reordered);
+}
+
+void
+bonobo::mesh_optimizer::optimizeVertexFetch(mesh& m)
+{
+	auto const unassigned = ~u32(0u);
+	auto old_to_new = std::vector<u32>(m.vertices_nb, unassigned);
+	std::vector<u32> new_to_old;
+	new_to_old.reserve(m.vertices_nb);
+	for (auto& index : m.indices) {
+		if (old_to_new[index] == unassigned) {
+			old_to_new[index] = static_cast<u32>(new_to_old.size());
+			new_to_old.push_back(index);
+		}
+		index = old_to_new[index];
+	}
+	remapVertices(m, new_to_old);
+}
+
+bonobo::mesh_optimizer::report
+bonobo::mesh_optimizer::optimize(mesh& m)
+{
+	report r;
+	r.vertices_nb_before = m.vertices_nb;
+	r.before = analyseVertexCache(m.indices.data(), m.indices.size(), m.vertices_nb);
+
+	weldVertices(m);
+	optimizeVertexCache(m.indices, m.vertices_nb);
+	optimizeOverdraw(m.indices, m.vertices.data(), m.vertices_nb);
+	optimizeVertexFetch(m);
+
+	r.vertices_nb_after = m.vertices_nb;
+	r.after = analyseVertexCache(m.indices.data(), m.indices.size(), m.vertices_nb);
+	return r;
+}
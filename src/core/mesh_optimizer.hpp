@@ -0,0 +1,94 @@
+#pragma once
+
+#include "core/Types.h"
+
+#include <vector>
+
+namespace bonobo
+{
+	//! \brief Import-time optimisations of triangle meshes for the GPU
+	//!        vertex pipeline.
+	//!
+	//! The functions only operate on CPU data and neither use OpenGL nor
+	//! the `Log*()` macros, so they can run on worker threads.
+	namespace mesh_optimizer
+	{
+		//! \brief Triangle mesh owning its data.
+		//!
+		//! Every vertex stream holds three floats per vertex, and is
+		//! empty when the mesh does not provide that attribute.
+		struct mesh {
+			size_t vertices_nb;
+			std::vector<f32> vertices;
+			std::vector<f32> normals;
+			std::vector<f32> texcoords;
+			std::vector<f32> tangents;
+			std::vector<f32> binormals;
+			std::vector<u32> indices;
+		};
+
+		//! \brief Efficiency of an index buffer with respect to a FIFO
+		//!        post-transform vertex cache.
+		struct cache_statistics {
+			float acmr; //!< average cache miss ratio: transformed vertices per triangle, between 0.5 and 3
+			float atvr; //!< average transform to vertex ratio: transformed vertices per vertex, 1 being optimal
+		};
+
+		//! \brief Outcome of `optimize()`.
+		struct report {
+			size_t vertices_nb_before;
+			size_t vertices_nb_after;
+			cache_statistics before;
+			cache_statistics after;
+		};
+
+		//! \brief Simulate a FIFO post-transform vertex cache.
+		//!
+		//! @param [in] indices triangle list
+		//! @param [in] indices_nb how many indices there are
+		//! @param [in] vertices_nb how many vertices the indices refer to
+		//! @param [in] cache_size how many vertices the cache holds
+		cache_statistics analyseVertexCache(u32 const* indices, size_t indices_nb, size_t vertices_nb, size_t cache_size = 16u);
+
+		//! \brief Simulate a FIFO post-transform vertex cache over
+		//!        triangle strips.
+		//!
+		//! Restart indices, i.e. `~0u`, only end the current strip: the
+		//! cache is kept across them, as it is on GPUs.
+		//!
+		//! @param [in] indices triangle strips separated by restart indices
+		//! @param [in] indices_nb how many indices there are
+		//! @param [in] vertices_nb how many vertices the indices refer to
+		//! @param [in] cache_size how many vertices the cache holds
+		cache_statistics analyseStripVertexCache(u32 const* indices, size_t indices_nb, size_t vertices_nb, size_t cache_size = 16u);
+
+		//! \brief Merge vertices whose attributes are all identical.
+		void weldVertices(mesh& m);
+
+		//! \brief Reorder triangles to make the best use of the
+		//!        post-transform vertex cache, following Tom Forsyth's
+		//!        "Linear-speed vertex cache optimisation".
+		void optimizeVertexCache(std::vector<u32>& indices, size_t vertices_nb);
+
+		//! \brief Reorder clusters of triangles so that outward facing
+		//!        ones are drawn first, reducing overdraw.
+		//!
+		//! Clusters are cut where the cache-optimised order already
+		//! restarts from cold, so the cache efficiency is mostly
+		//! preserved; the new order is discarded if its ACMR is worse than
+		//! `threshold` times the current one.
+		//!
+		//! @param [in,out] indices cache-optimised triangle list
+		//! @param [in] positions three floats per vertex
+		//! @param [in] vertices_nb how many vertices there are
+		//! @param [in] threshold how much ACMR degradation is allowed
+		void optimizeOverdraw(std::vector<u32>& indices, f32 const* positions, size_t vertices_nb, float threshold = 1.05f);
+
+		//! \brief Reorder vertices in the order they are first referenced
+		//!        by the indices, dropping unreferenced ones.
+		void optimizeVertexFetch(mesh& m);
+
+		//! \brief Run all the above optimisations on a triangle mesh.
+		report optimize(mesh& m);
+	}
+}
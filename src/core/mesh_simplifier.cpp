@@ -0,0 +1,356 @@
+#include "mesh_simplifier.hpp"
+
+#include "core/mesh_optimizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <queue>
+
+namespace
+{
+	// Weight of the planes keeping open borders in place, relative to
+	// the planes of the triangles.
+	double const border_weight = 10.0;
+
+	// Collapses are rejected if they turn a triangle by more than about
+	// 78 degrees, which mostly happens when folding it over.
+	float const min_normal_cosine = 0.2f;
+
+	//! \brief Symmetric 4x4 matrix measuring the squared distance of a
+	//!        point to a set of planes, along with the total weight of
+	//!        those planes.
+	struct quadric {
+		double a00, a01, a02, a03, a11, a12, a13, a22, a23, a33;
+		double weight;
+	};
+
+	quadric makeQuadric(glm::dvec3 const& normal, double d, double weight)
+	{
+		auto const n = normal * weight;
+		return { n.x * normal.x, n.x * normal.y, n.x * normal.z, n.x * d,
+		         n.y * normal.y, n.y * normal.z, n.y * d,
+		         n.z * normal.z, n.z * d,
+		         weight * d * d,
+		         weight };
+	}
+
+	void add(quadric& q, quadric const& other)
+	{
+		q.a00 += other.a00; q.a01 += other.a01; q.a02 += other.a02; q.a03 += other.a03;
+		q.a11 += other.a11; q.a12 += other.a12; q.a13 += other.a13;
+		q.a22 += other.a22; q.a23 += other.a23;
+		q.a33 += other.a33;
+		q.weight += other.weight;
+	}
+
+	//! \brief Weighted sum of the squared distances of `p` to the planes.
+	double evaluate(quadric const& q, glm::vec3 const& p)
+	{
+		double const x = p.x, y = p.y, z = p.z;
+		auto const value = q.a00 * x * x + 2.0 * q.a01 * x * y + 2.0 * q.a02 * x * z + 2.0 * q.a03 * x
+		                 + q.a11 * y * y + 2.0 * q.a12 * y * z + 2.0 * q.a13 * y
+		                 + q.a22 * z * z + 2.0 * q.a23 * z
+		                 + q.a33;
+		return std::max(value, 0.0);
+	}
+
+	//! \brief Root mean square distance of `p` to the planes.
+	f32 error(quadric const& q, glm::vec3 const& p)
+	{
+		return q.weight > 0.0 ? static_cast<f32>(std::sqrt(evaluate(q, p) / q.weight)) : 0.0f;
+	}
+
+	glm::vec3 getPosition(f32 const* positions, u32 index)
+	{
+		return glm::vec3(positions[3u * index + 0u], positions[3u * index + 1u], positions[3u * index + 2u]);
+	}
+
+	struct collapse {
+		f32 error;
+		u32 from, to;          //!< canonical vertices
+		u32 from_version, to_version;
+		bool operator<(collapse const& other) const { return error > other.error; } // for a min-heap
+	};
+}
+
+std::vector<u32>
+bonobo::mesh_simplifier::simplify(u32 const* indices, size_t indices_nb, f32 const* positions, size_t vertices_nb,
+                                  size_t target_indices_nb, f32 max_error, f32& result_error)
+{
+	result_error = 0.0f;
+	auto const triangles_nb = indices_nb / 3u;
+	if (triangles_nb == 0u || indices_nb <= target_indices_nb)
+		return std::vector<u32>(indices, indices + indices_nb);
+
+	// Vertices sharing a position, e.g. on each side of a texture seam,
+	// are simplified as one canonical vertex, so as not to tear the
+	// surface apart.
+	auto canonical = std::vector<u32>(vertices_nb);
+	{
+		auto order = std::vector<u32>(vertices_nb);
+		std::iota(order.begin(), order.end(), 0u);
+		auto const less = [positions](u32 a, u32 b){
+			return std::lexicographical_compare(positions + 3u * a, positions + 3u * a + 3u,
+			                                    positions + 3u * b, positions + 3u * b + 3u);
+		};
+		std::sort(order.begin(), order.end(), less);
+		for (size_t i = 0u; i < vertices_nb; ++i)
+			canonical[order[i]] = (i != 0u && !less(order[i - 1u], order[i])) ? canonical[order[i - 1u]] : order[i];
+	}
+
+	// Triangles keep their actual vertices; a triangle is alive as long as
+	// its canonical vertices are distinct.
+	auto corners = std::vector<u32>(indices, indices + 3u * triangles_nb);
+	auto alive = std::vector<bool>(triangles_nb, false);
+	auto adjacency = std::vector<std::vector<u32>>(vertices_nb);
+	auto quadrics = std::vector<quadric>(vertices_nb, quadric());
+	auto edges = std::vector<u64>();
+	edges.reserve(3u * triangles_nb);
+	size_t alive_nb = 0u;
+	for (size_t t = 0u; t < triangles_nb; ++t) {
+		u32 const c[3] = { canonical[corners[3u * t + 0u]], canonical[corners[3u * t + 1u]], canonical[corners[3u * t + 2u]] };
+		if (c[0] == c[1] || c[1] == c[2] || c[2] == c[0])
+			continue;
+		alive[t] = true;
+		++alive_nb;
+
+		auto const p0 = glm::dvec3(getPosition(positions, c[0]));
+		auto const p1 = glm::dvec3(getPosition(positions, c[1]));
+		auto const p2 = glm::dvec3(getPosition(positions, c[2]));
+		auto const normal = glm::cross(p1 - p0, p2 - p0);
+		auto const double_area = glm::length(normal);
+		auto const plane = double_area > 0.0
+		                 ? makeQuadric(normal / double_area, -glm::dot(normal / double_area, p0), 0.5 * double_area)
+		                 : quadric();
+		for (int k = 0; k < 3; ++k) {
+			add(quadrics[c[k]], plane);
+			adjacency[c[k]].push_back(static_cast<u32>(t));
+			auto const a = std::min(c[k], c[(k + 1) % 3]), b = std::max(c[k], c[(k + 1) % 3]);
+			edges.push_back((static_cast<u64>(a) << 32) | b);
+		}
+	}
+
+	// Edges used by a single triangle lie on an open border: keep them in
+	// place with planes orthogonal to their triangle.
+	std::sort(edges.begin(), edges.end());
+	for (size_t t = 0u; t < triangles_nb; ++t) {
+		if (!alive[t])
+			continue;
+		u32 const c[3] = { canonical[corners[3u * t + 0u]], canonical[corners[3u * t + 1u]], canonical[corners[3u * t + 2u]] };
+		auto const p0 = glm::dvec3(getPosition(positions, c[0]));
+		auto const normal = glm::cross(glm::dvec3(getPosition(positions, c[1])) - p0, glm::dvec3(getPosition(positions, c[2])) - p0);
+		if (glm::length(normal) <= 0.0)
+			continue;
+		for (int k = 0; k < 3; ++k) {
+			auto const a = std::min(c[k], c[(k + 1) % 3]), b = std::max(c[k], c[(k + 1) % 3]);
+			auto const key = (static_cast<u64>(a) << 32) | b;
+			auto const range = std::equal_range(edges.begin(), edges.end(), key);
+			if (range.second - range.first != 1)
+				continue;
+			auto const pa = glm::dvec3(getPosition(positions, c[k])), pb = glm::dvec3(getPosition(positions, c[(k + 1) % 3]));
+			auto const edge = pb - pa;
+			auto const length = glm::length(edge);
+			if (length <= 0.0)
+				continue;
+			auto const border_normal = glm::normalize(glm::cross(edge, normal));
+			auto const border_plane = makeQuadric(border_normal, -glm::dot(border_normal, pa), border_weight * length * length);
+			add(quadrics[c[k]], border_plane);
+			add(quadrics[c[(k + 1) % 3]], border_plane);
+		}
+	}
+
+	auto versions = std::vector<u32>(vertices_nb, 0u);
+	auto removed = std::vector<bool>(vertices_nb, false);
+	auto heap = std::priority_queue<collapse>();
+	auto const push_edge = [&](u32 a, u32 b){
+		auto q = quadrics[a];
+		add(q, quadrics[b]);
+		auto const pa = getPosition(positions, a), pb = getPosition(positions, b);
+		auto const to_b = error(q, pb), to_a = error(q, pa);
+		if (to_b <= to_a)
+			heap.push({ to_b, a, b, versions[a], versions[b] });
+		else
+			heap.push({ to_a, b, a, versions[b], versions[a] });
+	};
+	for (size_t i = 0u; i < edges.size(); ++i) {
+		if (i != 0u && edges[i] == edges[i - 1u])
+			continue;
+		push_edge(static_cast<u32>(edges[i] >> 32), static_cast<u32>(edges[i] & 0xffffffffu));
+	}
+	edges = std::vector<u64>();
+
+	auto const contains = [&](u32 t, u32 v){
+		return canonical[corners[3u * t + 0u]] == v || canonical[corners[3u * t + 1u]] == v || canonical[corners[3u * t + 2u]] == v;
+	};
+	auto wedges = std::vector<std::pair<u32, u32>>();
+	auto neighbours = std::vector<u32>();
+	auto const target_triangles_nb = target_indices_nb / 3u;
+	while (alive_nb > target_triangles_nb && !heap.empty()) {
+		auto const candidate = heap.top();
+		heap.pop();
+		auto const u = candidate.from, v = candidate.to;
+		if (removed[u] || removed[v] || versions[u] != candidate.from_version || versions[v] != candidate.to_version)
+			continue;
+		if (candidate.error > max_error)
+			break;
+
+		// Reject collapses folding triangles over, or leaving them with
+		// no area.
+		auto const pv = getPosition(positions, v);
+		bool valid = true;
+		for (auto const t : adjacency[u]) {
+			if (!alive[t] || !contains(t, u) || contains(t, v))
+				continue;
+			glm::vec3 before[3], after[3];
+			for (int k = 0; k < 3; ++k) {
+				auto const c = canonical[corners[3u * t + k]];
+				before[k] = getPosition(positions, c);
+				after[k] = c == u ? pv : before[k];
+			}
+			auto const normal_before = glm::cross(before[1] - before[0], before[2] - before[0]);
+			auto const normal_after = glm::cross(after[1] - after[0], after[2] - after[0]);
+			auto const lengths = glm::length(normal_before) * glm::length(normal_after);
+			if (lengths <= 0.0f || glm::dot(normal_before, normal_after) < min_normal_cosine * lengths) {
+				valid = false;
+				break;
+			}
+		}
+		if (!valid)
+			continue;
+
+		// Triangles around the edge disappear; they tell which actual
+		// vertex of v replaces each actual vertex of u.
+		wedges.clear();
+		for (auto const t : adjacency[u]) {
+			if (!alive[t] || !contains(t, u) || !contains(t, v))
+				continue;
+			u32 wedge_u = 0u, wedge_v = 0u;
+			for (int k = 0; k < 3; ++k) {
+				auto const corner = corners[3u * t + k];
+				if (canonical[corner] == u)
+					wedge_u = corner;
+				else if (canonical[corner] == v)
+					wedge_v = corner;
+			}
+			wedges.emplace_back(wedge_u, wedge_v);
+			alive[t] = false;
+			--alive_nb;
+		}
+		for (auto const t : adjacency[u]) {
+			if (!alive[t] || !contains(t, u))
+				continue;
+			for (int k = 0; k < 3; ++k) {
+				auto& corner = corners[3u * t + k];
+				if (canonical[corner] != u)
+					continue;
+				auto const wedge = std::find_if(wedges.begin(), wedges.end(), [corner](std::pair<u32, u32> const& w){ return w.first == corner; });
+				corner = wedge != wedges.end() ? wedge->second : (wedges.empty() ? v : wedges.front().second);
+			}
+			adjacency[v].push_back(t);
+		}
+
+		result_error = std::max(result_error, candidate.error);
+		add(quadrics[v], quadrics[u]);
+		removed[u] = true;
+		adjacency[u] = std::vector<u32>();
+		++versions[v];
+
+		// Drop stale triangles from the adjacency of v, and queue the
+		// edges around it again with its new quadric; the version bump
+		// above discards the ones already queued.
+		auto& around_v = adjacency[v];
+		around_v.erase(std::remove_if(around_v.begin(), around_v.end(), [&](u32 t){ return !alive[t] || !contains(t, v); }), around_v.end());
+		std::sort(around_v.begin(), around_v.end());
+		around_v.erase(std::unique(around_v.begin(), around_v.end()), around_v.end());
+		neighbours.clear();
+		for (auto const t : around_v)
+			for (int k = 0; k < 3; ++k)
+				if (canonical[corners[3u * t + k]] != v)
+					neighbours.push_back(canonical[corners[3u * t + k]]);
+		std::sort(neighbours.begin(), neighbours.end());
+		neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+		for (auto const n : neighbours)
+			push_edge(n, v);
+	}
+
+	auto simplified = std::vector<u32>();
+	simplified.reserve(3u * alive_nb);
+	for (size_t t = 0u; t < triangles_nb; ++t)
+		if (alive[t])
+			simplified.insert(simplified.end(), corners.begin() + 3u * t, corners.begin() + 3u * t + 3u);
+	return simplified;
+}
+
+bonobo::mesh_simplifier::lod_chain
+bonobo::mesh_simplifier::buildLodChain(std::vector<u32>& indices, f32 const* positions, size_t vertices_nb,
+                                       lod_settings const& settings)
+{
+	auto chain = lod_chain();
+	chain.centre = glm::vec3(0.0f);
+	chain.radius = 0.0f;
+	if (indices.empty())
+		return chain;
+
+	auto lower = glm::vec3(std::numeric_limits<f32>::max());
+	auto upper = glm::vec3(std::numeric_limits<f32>::lowest());
+	for (auto const index : indices) {
+		lower = glm::min(lower, getPosition(positions, index));
+		upper = glm::max(upper, getPosition(positions, index));
+	}
+	chain.centre = 0.5f * (lower + upper);
+	for (auto const index : indices)
+		chain.radius = std::max(chain.radius, glm::length(getPosition(positions, index) - chain.centre));
+
+	chain.levels.push_back({ 0u, static_cast<u32>(indices.size()), 0.0f });
+	auto current = std::vector<u32>(indices);
+	auto const min_indices_nb = 3u * static_cast<size_t>(settings.min_triangles_nb);
+	for (u32 level = 1u; level < settings.levels_nb && current.size() > min_indices_nb; ++level) {
+		auto target = static_cast<size_t>(static_cast<f32>(current.size() / 3u) * settings.reduction) * 3u;
+		target = std::max(target, min_indices_nb);
+
+		f32 level_error = 0.0f;
+		auto next = simplify(current.data(), current.size(), positions, vertices_nb, target,
+		                     settings.max_error * chain.radius, level_error);
+		// Levels barely coarser than the previous one are not worth
+		// switching to.
+		if (next.empty() || next.size() * 10u > current.size() * 9u)
+			break;
+
+		mesh_optimizer::optimizeVertexCache(next, vertices_nb);
+		// Errors of successive simplifications add up at worst.
+		auto const error = chain.levels.back().error + level_error;
+		chain.levels.push_back({ static_cast<u32>(indices.size()), static_cast<u32>(next.size()), error });
+		indices.insert(indices.end(), next.begin(), next.end());
+		current.swap(next);
+	}
+
+	return chain;
+}
+
+size_t
+bonobo::mesh_simplifier::selectLod(lod_chain const& chain, glm::mat4 const& model_to_world, glm::vec3 const& camera_position,
+                                   f32 fov_y, f32 viewport_height, f32 max_pixel_error)
+{
+	if (chain.levels.size() < 2u)
+		return 0u;
+
+	auto const scale = std::max(std::max(glm::length(glm::vec3(model_to_world[0])), glm::length(glm::vec3(model_to_world[1]))),
+	                            glm::length(glm::vec3(model_to_world[2])));
+	if (scale <= 0.0f)
+		return chain.levels.size() - 1u;
+
+	// Distance to the closest point of the bounding sphere, along which
+	// a world-space length of 1 covers `pixels_per_unit` pixels.
+	auto const centre = glm::vec3(model_to_world * glm::vec4(chain.centre, 1.0f));
+	auto const distance = glm::length(centre - camera_position) - chain.radius * scale;
+	if (distance <= 0.0f)
+		return 0u;
+	auto const pixels_per_unit = viewport_height / (2.0f * std::tan(0.5f * fov_y) * distance);
+
+	for (auto level = chain.levels.size() - 1u; level > 0u; --level)
+		if (chain.levels[level].error * scale * pixels_per_unit <= max_pixel_error)
+			return level;
+	return 0u;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "core/Types.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+namespace bonobo
+{
+	//! \brief Import-time simplification of triangle meshes into chains of
+	//!        levels of detail, and their selection at runtime.
+	//!
+	//! Simplification collapses edges in the order of their quadric error
+	//! (Garland & Heckbert, "Surface Simplification Using Quadric Error
+	//! Metrics"), always onto one of their existing end points: coarser
+	//! levels only need a new index buffer, and share the vertices of the
+	//! full-resolution mesh.
+	//!
+	//! The functions only operate on CPU data and neither use OpenGL nor
+	//! the `Log*()` macros, so they can run on worker threads.
+	namespace mesh_simplifier
+	{
+		//! \brief One level of detail, as a range of the index buffer of
+		//!        its mesh.
+		//!
+		//! Stored as is in the mesh caches.
+		struct lod {
+			u32 first_index; //!< relative to the first index of the mesh
+			u32 indices_nb;
+			f32 error;       //!< estimated geometric deviation from the full-resolution mesh, in model space
+		};
+		static_assert(sizeof(lod) == 12u, "Levels of detail are stored as is in the mesh caches");
+
+		//! \brief All the levels of detail of a mesh, from the finest.
+		struct lod_chain {
+			glm::vec3 centre; //!< of the bounding sphere of the mesh, in model space
+			f32 radius;       //!< of the bounding sphere of the mesh, in model space
+			std::vector<lod> levels;
+		};
+
+		//! \brief How to build a chain of levels of detail.
+		struct lod_settings {
+			u32 levels_nb = 4u;         //!< including the full-resolution level
+			f32 reduction = 0.5f;       //!< ratio of triangles kept from one level to the next
+			u32 min_triangles_nb = 32u; //!< no level gets simplified below this
+			f32 max_error = 0.05f;      //!< largest error allowed, relative to the radius of the mesh
+		};
+
+		//! \brief Simplify a triangle list.
+		//!
+		//! Vertices sharing the same position, e.g. along texture seams,
+		//! are collapsed together; open borders are preserved by
+		//! penalising collapses moving them away from their edges.
+		//!
+		//! @param [in] indices triangle list
+		//! @param [in] indices_nb how many indices there are
+		//! @param [in] positions three floats per vertex
+		//! @param [in] vertices_nb how many vertices the indices refer to
+		//! @param [in] target_indices_nb stop once there are no more
+		//!             indices than this
+		//! @param [in] max_error stop before collapses moving the surface
+		//!             further than this, in model space
+		//! @param [out] error largest error of the collapses carried out
+		//! @return the simplified triangle list, referencing the same
+		//!         vertices, with degenerate triangles removed
+		std::vector<u32> simplify(u32 const* indices, size_t indices_nb, f32 const* positions, size_t vertices_nb,
+		                          size_t target_indices_nb, f32 max_error, f32& error);
+
+		//! \brief Build the levels of detail of a triangle mesh.
+		//!
+		//! Each level simplifies the previous one, and gets optimised for
+		//! the vertex cache; the chain ends early once a level can not be
+		//! simplified much further.
+		//!
+		//! @param [in,out] indices triangle list of the full-resolution
+		//!                 mesh, to which the indices of all coarser levels
+		//!                 get appended
+		//! @param [in] positions three floats per vertex
+		//! @param [in] vertices_nb how many vertices the indices refer to
+		//! @param [in] settings how many levels to build, and how coarse
+		lod_chain buildLodChain(std::vector<u32>& indices, f32 const* positions, size_t vertices_nb,
+		                        lod_settings const& settings = lod_settings());
+
+		//! \brief Pick the coarsest level whose error, projected on screen,
+		//!        stays below a given number of pixels.
+		//!
+		//! @param [in] chain levels of the mesh
+		//! @param [in] model_to_world transform of the mesh
+		//! @param [in] camera_position in world space
+		//! @param [in] fov_y vertical field of view of the camera, in
+		//!             radians, e.g. `FPSCamera::GetFov()`
+		//! @param [in] viewport_height in pixels
+		//! @param [in] max_pixel_error largest error allowed on screen
+		//! @return the index of the level to draw
+		size_t selectLod(lod_chain const& chain, glm::mat4 const& model_to_world, glm::vec3 const& camera_position,
+		                 f32 fov_y, f32 viewport_height, f32 max_pixel_error);
+	}
+}
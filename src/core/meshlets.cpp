@@ -0,0 +1,231 @@
+#include "meshlets.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+	glm::vec3 getPosition(f32 const* positions, u32 index)
+	{
+		return glm::vec3(positions[3u * index + 0u], positions[3u * index + 1u], positions[3u * index + 2u]);
+	}
+
+	//! \brief Fill in the bounds of a cluster from its triangles.
+	void computeBounds(f32 const* positions, u32 const* indices, bonobo::meshlets::meshlet& cluster)
+	{
+		auto const triangles = indices + cluster.first_index;
+		auto const corners_nb = 3u * cluster.triangles_nb;
+
+		cluster.lower = glm::vec3(std::numeric_limits<f32>::max());
+		cluster.upper = glm::vec3(std::numeric_limits<f32>::lowest());
+		for (u32 i = 0u; i < corners_nb; ++i) {
+			auto const p = getPosition(positions, triangles[i]);
+			cluster.lower = glm::min(cluster.lower, p);
+			cluster.upper = glm::max(cluster.upper, p);
+		}
+		cluster.centre = 0.5f * (cluster.lower + cluster.upper);
+		cluster.radius = 0.0f;
+		for (u32 i = 0u; i < corners_nb; ++i)
+			cluster.radius = std::max(cluster.radius, glm::length(getPosition(positions, triangles[i]) - cluster.centre));
+
+		// The cone axis averages the normals of the non-degenerate
+		// triangles, weighted by their area.
+		auto normals = std::vector<glm::vec3>();
+		normals.reserve(cluster.triangles_nb);
+		auto axis = glm::vec3(0.0f);
+		for (u32 i = 0u; i < corners_nb; i += 3u) {
+			auto const p0 = getPosition(positions, triangles[i + 0u]);
+			auto const p1 = getPosition(positions, triangles[i + 1u]);
+			auto const p2 = getPosition(positions, triangles[i + 2u]);
+			auto const n = glm::cross(p1 - p0, p2 - p0);
+			auto const double_area = glm::length(n);
+			if (double_area <= std::numeric_limits<f32>::min())
+				continue;
+			axis += n;
+			normals.push_back(n / double_area);
+		}
+
+		cluster.cone_apex = cluster.centre;
+		cluster.cone_axis = glm::vec3(0.0f, 0.0f, 1.0f);
+		cluster.cone_cutoff = 1.0f;
+		auto const axis_length = glm::length(axis);
+		if (normals.empty() || axis_length <= std::numeric_limits<f32>::min())
+			return;
+		axis /= axis_length;
+
+		auto min_dp = 1.0f;
+		for (auto const& n : normals)
+			min_dp = std::min(min_dp, glm::dot(axis, n));
+		cluster.cone_axis = axis;
+
+		// Past about 84 degrees of spread, the cone rejects so few view
+		// points that it is not worth testing.
+		if (min_dp <= 0.1f)
+			return;
+
+		// Move the apex back along the axis until every triangle plane
+		// lies in front of it: a camera inside the cone, past the apex,
+		// then sees all triangles from behind.
+		auto max_t = 0.0f;
+		u32 n = 0u;
+		for (u32 i = 0u; i < corners_nb; i += 3u) {
+			auto const p0 = getPosition(positions, triangles[i + 0u]);
+			auto const p1 = getPosition(positions, triangles[i + 1u]);
+			auto const p2 = getPosition(positions, triangles[i + 2u]);
+			auto const normal = glm::cross(p1 - p0, p2 - p0);
+			if (glm::length(normal) <= std::numeric_limits<f32>::min())
+				continue;
+			auto const& unit_normal = normals[n++];
+			auto const t = glm::dot(cluster.centre - p0, unit_normal) / glm::dot(axis, unit_normal);
+			max_t = std::max(max_t, t);
+		}
+		cluster.cone_apex = cluster.centre - axis * max_t;
+		cluster.cone_cutoff = std::sqrt(1.0f - min_dp * min_dp);
+	}
+
+	//! \brief Whether a bounding box is fully behind a plane.
+	bool isBehind(glm::vec4 const& plane, glm::vec3 const& lower, glm::vec3 const& upper)
+	{
+		auto const farthest = glm::vec3(plane.x >= 0.0f ? upper.x : lower.x,
+		                                plane.y >= 0.0f ? upper.y : lower.y,
+		                                plane.z >= 0.0f ? upper.z : lower.z);
+		return glm::dot(glm::vec3(plane), farthest) + plane.w < 0.0f;
+	}
+}
+
+std::vector<bonobo::meshlets::meshlet>
+bonobo::meshlets::build(f32 const* positions, u32 const* indices, size_t indices_nb, size_t vertices_nb,
+                        u32 max_vertices, u32 max_triangles)
+{
+	auto clusters = std::vector<meshlet>();
+	if (positions == nullptr || indices == nullptr || indices_nb < 3u || max_vertices < 3u || max_triangles == 0u)
+		return clusters;
+	clusters.reserve(indices_nb / 3u / max_triangles + 1u);
+
+	// Marks the vertices already referenced by the current cluster with
+	// its number plus one, so the markers never need clearing.
+	auto markers = std::vector<u32>(vertices_nb, 0u);
+	auto current = meshlet();
+	current.first_index = 0u;
+	current.triangles_nb = 0u;
+	current.vertices_nb = 0u;
+	auto current_id = 1u;
+
+	auto const triangles_nb = indices_nb / 3u;
+	for (size_t t = 0u; t < triangles_nb; ++t) {
+		auto const triangle = indices + 3u * t;
+		u32 new_vertices_nb = 0u;
+		for (u32 c = 0u; c < 3u; ++c)
+			if (markers[triangle[c]] != current_id)
+				++new_vertices_nb;
+
+		if (current.triangles_nb == max_triangles || current.vertices_nb + new_vertices_nb > max_vertices) {
+			computeBounds(positions, indices, current);
+			clusters.push_back(current);
+			current.first_index = static_cast<u32>(3u * t);
+			current.triangles_nb = 0u;
+			current.vertices_nb = 0u;
+			++current_id;
+		}
+
+		for (u32 c = 0u; c < 3u; ++c) {
+			if (markers[triangle[c]] == current_id)
+				continue;
+			markers[triangle[c]] = current_id;
+			++current.vertices_nb;
+		}
+		++current.triangles_nb;
+	}
+	if (current.triangles_nb != 0u) {
+		computeBounds(positions, indices, current);
+		clusters.push_back(current);
+	}
+
+	return clusters;
+}
+
+bonobo::meshlets::view
+bonobo::meshlets::makeView(glm::mat4 const& world_to_clip, glm::vec3 const& position)
+{
+	// Gribb & Hartmann: with r_i the rows of the matrix, a point is in
+	// the frustum iff -w <= x, y, z <= w, i.e. (r_3 ± r_i) . p >= 0.
+	auto const rows = glm::transpose(world_to_clip);
+	auto camera = view();
+	camera.planes[0] = rows[3] + rows[0]; // left
+	camera.planes[1] = rows[3] - rows[0]; // right
+	camera.planes[2] = rows[3] + rows[1]; // bottom
+	camera.planes[3] = rows[3] - rows[1]; // top
+	camera.planes[4] = rows[3] + rows[2]; // near
+	camera.planes[5] = rows[3] - rows[2]; // far
+	camera.position = position;
+	return camera;
+}
+
+void
+bonobo::meshlets::cull(std::vector<meshlet> const& clusters, glm::mat4 const& model_to_world, view const& camera,
+                       draw_ranges& ranges, cull_statistics* statistics)
+{
+	ranges.firsts.clear();
+	ranges.counts.clear();
+
+	// Rather than moving every cluster to world space, move the view to
+	// model space: a plane p becomes M^T p, normalised so that distances
+	// can be compared to the radii.
+	glm::vec4 planes[6];
+	auto const plane_to_model = glm::transpose(model_to_world);
+	for (int i = 0; i < 6; ++i) {
+		planes[i] = plane_to_model * camera.planes[i];
+		auto const length = glm::length(glm::vec3(planes[i]));
+		if (length > 0.0f)
+			planes[i] = planes[i] / length;
+	}
+	auto const position = glm::vec3(glm::inverse(model_to_world) * glm::vec4(camera.position, 1.0f));
+
+	size_t visible_nb = 0u, frustum_culled_nb = 0u, cone_culled_nb = 0u, triangles_nb = 0u, visible_triangles_nb = 0u;
+	for (auto const& cluster : clusters) {
+		triangles_nb += cluster.triangles_nb;
+
+		bool outside = false;
+		for (int i = 0; i < 6 && !outside; ++i) {
+			auto const distance = glm::dot(glm::vec3(planes[i]), cluster.centre) + planes[i].w;
+			if (distance < -cluster.radius)
+				outside = true;
+			else if (distance < cluster.radius)
+				outside = isBehind(planes[i], cluster.lower, cluster.upper);
+		}
+		if (outside) {
+			++frustum_culled_nb;
+			continue;
+		}
+
+		if (cluster.cone_cutoff < 1.0f) {
+			auto const to_apex = cluster.cone_apex - position;
+			auto const distance = glm::length(to_apex);
+			if (distance > 0.0f && glm::dot(to_apex, cluster.cone_axis) >= cluster.cone_cutoff * distance) {
+				++cone_culled_nb;
+				continue;
+			}
+		}
+
+		++visible_nb;
+		visible_triangles_nb += cluster.triangles_nb;
+		auto const count = 3u * cluster.triangles_nb;
+		if (!ranges.firsts.empty() && ranges.firsts.back() + ranges.counts.back() == cluster.first_index) {
+			ranges.counts.back() += count;
+		} else {
+			ranges.firsts.push_back(cluster.first_index);
+			ranges.counts.push_back(count);
+		}
+	}
+
+	if (statistics == nullptr)
+		return;
+	statistics->meshlets_nb += clusters.size();
+	statistics->visible_meshlets_nb += visible_nb;
+	statistics->frustum_culled_nb += frustum_culled_nb;
+	statistics->cone_culled_nb += cone_culled_nb;
+	statistics->triangles_nb += triangles_nb;
+	statistics->visible_triangles_nb += visible_triangles_nb;
+	statistics->ranges_nb += ranges.firsts.size();
+}
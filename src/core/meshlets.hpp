@@ -0,0 +1,108 @@
+#pragma once
+
+#include "core/Types.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+namespace bonobo
+{
+	//! \brief Clusters of triangles, or meshlets, with bounds tight enough
+	//!        to cull parts of a mesh rather than the mesh as a whole.
+	//!
+	//! Without mesh shaders, a meshlet is simply a range of the index
+	//! buffer of its mesh: culling outputs the ranges left visible, which
+	//! get drawn with a single `glMultiDrawElementsBaseVertex()`.
+	//!
+	//! The functions only operate on CPU data and neither use OpenGL nor
+	//! the `Log*()` macros, so they can run on worker threads.
+	namespace meshlets
+	{
+		u32 const max_vertices_nb = 64u;
+		u32 const max_triangles_nb = 124u;
+
+		//! \brief A cluster of triangles along with its bounds, all in
+		//!        model space.
+		//!
+		//! Stored as is in the mesh caches, hence the explicit padding
+		//! of the vectors.
+		struct meshlet {
+			glm::vec3 centre;    //!< of the bounding sphere
+			f32 radius;          //!< of the bounding sphere
+			glm::vec3 lower;     //!< corner of the bounding box
+			u32 first_index;     //!< first index of the cluster, relative to the first index of the mesh
+			glm::vec3 upper;     //!< corner of the bounding box
+			u32 triangles_nb;
+			glm::vec3 cone_apex; //!< of the cone the cluster is backfacing from the outside of
+			u32 vertices_nb;     //!< distinct vertices referenced by the cluster
+			glm::vec3 cone_axis; //!< average direction of the triangle normals
+			f32 cone_cutoff;     //!< sine of the spread of the normals around the axis; 1 or more if the cluster can not be backface-culled
+		};
+		static_assert(sizeof(meshlet) == 80u, "Meshlets are stored as is in the mesh caches");
+
+		//! \brief Split a triangle list into clusters of contiguous
+		//!        triangles.
+		//!
+		//! Triangles are kept in their current order, which is expected
+		//! to be spatially coherent, e.g. after
+		//! `mesh_optimizer::optimize()`, so the index buffer is left
+		//! untouched.
+		//!
+		//! @param [in] positions three floats per vertex
+		//! @param [in] indices triangle list
+		//! @param [in] indices_nb how many indices there are
+		//! @param [in] vertices_nb how many vertices the indices refer to
+		//! @param [in] max_vertices, max_triangles limits of each cluster
+		std::vector<meshlet> build(f32 const* positions, u32 const* indices, size_t indices_nb, size_t vertices_nb,
+		                           u32 max_vertices = max_vertices_nb, u32 max_triangles = max_triangles_nb);
+
+		//! \brief What clusters are culled against.
+		struct view {
+			glm::vec4 planes[6]; //!< frustum planes in world space, pointing inwards
+			glm::vec3 position;  //!< of the camera in world space
+		};
+
+		//! \brief Extract the view of a camera.
+		//!
+		//! @param [in] world_to_clip e.g. `FPSCamera::GetWorldToClipMatrix()`
+		//! @param [in] position e.g. `FPSCamera::mWorld.GetTranslation()`
+		view makeView(glm::mat4 const& world_to_clip, glm::vec3 const& position);
+
+		//! \brief Index ranges left visible by `cull()`, relative to the
+		//!        first index of the mesh; adjacent visible clusters are
+		//!        merged into a single range.
+		struct draw_ranges {
+			std::vector<u32> firsts;
+			std::vector<u32> counts;
+		};
+
+		//! \brief Accumulated outcome of `cull()`.
+		struct cull_statistics {
+			size_t meshlets_nb;
+			size_t visible_meshlets_nb;
+			size_t frustum_culled_nb; //!< clusters outside of the frustum
+			size_t cone_culled_nb;    //!< clusters inside of the frustum, but backfacing
+			size_t triangles_nb;
+			size_t visible_triangles_nb;
+			size_t ranges_nb;
+		};
+
+		//! \brief Cull the clusters of a mesh.
+		//!
+		//! Clusters are tested against the frustum by their bounding
+		//! sphere, then by their bounding box if the sphere straddles a
+		//! plane, and against the camera position by their normal cone.
+		//! The cone test assumes `model_to_world` keeps angles, i.e.
+		//! only rotates, translates and scales uniformly.
+		//!
+		//! @param [in] clusters as returned by `build()`
+		//! @param [in] model_to_world transform of the mesh
+		//! @param [in] camera what to cull against
+		//! @param [out] ranges visible index ranges, cleared first
+		//! @param [in,out] statistics if not nullptr, gets the outcome
+		//!                 added to it
+		void cull(std::vector<meshlet> const& clusters, glm::mat4 const& model_to_world, view const& camera,
+		          draw_ranges& ranges, cull_statistics* statistics = nullptr);
+	}
+}
@@ -0,0 +1,264 @@
+#include "mipmap_generator.hpp"
+
+#include "core/thread_pool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	include <emmintrin.h>
+#	define BONOBO_MIPMAP_GENERATOR_SSE2 1
+#endif
+
+namespace
+{
+	using bonobo::mipmaps::filter;
+	using bonobo::mipmaps::options;
+
+	u32 const tile_rows = 32u; // destination rows per tile
+	u32 const tiling_threshold = 256u * 256u; // destination texels under which a level is not split
+
+	//! \brief Weights of a separable filter halving the resolution: the
+	//!        destination texel x gathers the source texels
+	//!        2x + first .. 2x + first + taps_nb - 1.
+	struct kernel {
+		int first;
+		int taps_nb;
+		float weights[8];
+	};
+
+	double besselI0(double x)
+	{
+		double sum = 1.0, term = 1.0;
+		for (int k = 1; k < 32; ++k) {
+			term *= (x * 0.5 / k) * (x * 0.5 / k);
+			sum += term;
+		}
+		return sum;
+	}
+
+	kernel makeKernel(filter kernel_filter)
+	{
+		kernel k;
+		if (kernel_filter == filter::box) {
+			k.first = 0;
+			k.taps_nb = 2;
+			k.weights[0] = k.weights[1] = 0.5f;
+			return k;
+		}
+
+		// sinc(d / 2) cut off at 2 destination texels by a Kaiser window,
+		// d being the distance in source texels to the destination
+		// texel centre.
+		double const pi = 3.14159265358979323846, alpha = 4.0, radius = 4.0;
+		k.first = -3;
+		k.taps_nb = 8;
+		double weights[8], sum = 0.0;
+		for (int t = 0; t < 8; ++t) {
+			auto const d = t - 3.5;
+			auto const x = pi * d * 0.5;
+			auto const ratio = d / radius;
+			weights[t] = std::sin(x) / x * besselI0(alpha * std::sqrt(1.0 - ratio * ratio)) / besselI0(alpha);
+			sum += weights[t];
+		}
+		for (int t = 0; t < 8; ++t)
+			k.weights[t] = static_cast<float>(weights[t] / sum);
+		return k;
+	}
+
+	kernel const& getKernel(filter kernel_filter)
+	{
+		static kernel const box = makeKernel(filter::box);
+		static kernel const kaiser = makeKernel(filter::kaiser);
+		return kernel_filter == filter::box ? box : kaiser;
+	}
+
+	//! \brief Conversions between 8-bit values and the space filtering
+	//!        happens in.
+	struct conversion_tables {
+		float to_float[2][256];        // [srgb][value]
+		u8 from_linear[4096];          // linear value * 4095 -> sRGB
+	};
+
+	conversion_tables const& getTables()
+	{
+		static conversion_tables const tables = [](){
+			conversion_tables t;
+			for (int i = 0; i < 256; ++i) {
+				auto const v = i / 255.0;
+				t.to_float[0][i] = static_cast<float>(v);
+				t.to_float[1][i] = static_cast<float>(v <= 0.04045 ? v / 12.92 : std::pow((v + 0.055) / 1.055, 2.4));
+			}
+			for (int i = 0; i < 4096; ++i) {
+				auto const v = i / 4095.0;
+				auto const s = v <= 0.0031308 ? v * 12.92 : 1.055 * std::pow(v, 1.0 / 2.4) - 0.055;
+				t.from_linear[i] = static_cast<u8>(std::lround(std::min(std::max(s, 0.0), 1.0) * 255.0));
+			}
+			return t;
+		}();
+		return tables;
+	}
+
+	//! \brief Plain 2x2 average computed on integers, two destination
+	//!        texels at a time when SSE2 is available.
+	void boxRows(u8 const* rgba, u32 width, u32 height, std::ptrdiff_t row_stride,
+	             u8* next, u32 next_width, u32 first_row, u32 last_row)
+	{
+		for (u32 y = first_row; y < last_row; ++y) {
+			auto const row0 = rgba + static_cast<std::ptrdiff_t>(std::min(2u * y, height - 1u)) * row_stride;
+			auto const row1 = rgba + static_cast<std::ptrdiff_t>(std::min(2u * y + 1u, height - 1u)) * row_stride;
+			auto const output = next + static_cast<size_t>(y) * next_width * 4u;
+			u32 x = 0u;
+#ifdef BONOBO_MIPMAP_GENERATOR_SSE2
+			// Each iteration reads 4 source texels per row, which must all
+			// lie inside the image.
+			auto const zero = _mm_setzero_si128();
+			auto const rounding = _mm_set1_epi16(2);
+			for (; 2u * x + 3u < width; x += 2u) {
+				auto const a = _mm_loadu_si128(reinterpret_cast<__m128i const*>(row0 + 8u * x));
+				auto const b = _mm_loadu_si128(reinterpret_cast<__m128i const*>(row1 + 8u * x));
+				auto const low = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+				auto const high = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+				auto sums = _mm_unpacklo_epi64(_mm_add_epi16(low, _mm_srli_si128(low, 8)),
+				                               _mm_add_epi16(high, _mm_srli_si128(high, 8)));
+				sums = _mm_srli_epi16(_mm_add_epi16(sums, rounding), 2);
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(output + 4u * x), _mm_packus_epi16(sums, sums));
+			}
+#endif
+			for (; x < next_width; ++x) {
+				auto const x0 = std::min(2u * x, width - 1u) * 4u, x1 = std::min(2u * x + 1u, width - 1u) * 4u;
+				for (u32 c = 0u; c < 4u; ++c)
+					output[x * 4u + c] = static_cast<u8>((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2u) / 4u);
+			}
+		}
+	}
+
+	//! \brief Separable filtering in floating point, one RGBA texel per
+	//!        SSE register: rows are first filtered horizontally into a
+	//!        scratch buffer, which is then filtered vertically.
+	void filterRows(u8 const* rgba, u32 width, u32 height, std::ptrdiff_t row_stride,
+	                u8* next, u32 next_width, u32 first_row, u32 last_row, options const& settings)
+	{
+		auto const& k = getKernel(settings.kernel);
+		auto const& tables = getTables();
+		auto const& to_rgb = tables.to_float[settings.srgb ? 1 : 0];
+		auto const& to_alpha = tables.to_float[0];
+
+		auto const clamp_row = [height](int y) { return static_cast<u32>(std::min(std::max(y, 0), static_cast<int>(height) - 1)); };
+		auto const source_first = static_cast<int>(2u * first_row) + k.first;
+		auto const source_rows_nb = static_cast<int>(2u * (last_row - first_row)) + k.taps_nb - 2;
+
+		// Every source texel is read by several taps, so rows are
+		// converted to floating point once beforehand.
+		std::vector<float> source_row(static_cast<size_t>(width) * 4u);
+		std::vector<float> horizontal(static_cast<size_t>(source_rows_nb) * next_width * 4u);
+		for (int r = 0; r < source_rows_nb; ++r) {
+			auto const row = rgba + static_cast<std::ptrdiff_t>(clamp_row(source_first + r)) * row_stride;
+			for (u32 x = 0u; x < width; ++x) {
+				for (u32 c = 0u; c < 3u; ++c)
+					source_row[x * 4u + c] = to_rgb[row[x * 4u + c]];
+				source_row[x * 4u + 3u] = to_alpha[row[x * 4u + 3u]];
+			}
+
+			auto output = horizontal.data() + static_cast<size_t>(r) * next_width * 4u;
+			for (u32 x = 0u; x < next_width; ++x, output += 4) {
+#ifdef BONOBO_MIPMAP_GENERATOR_SSE2
+				auto sum = _mm_setzero_ps();
+				for (int t = 0; t < k.taps_nb; ++t) {
+					auto const sx = std::min(std::max(static_cast<int>(2u * x) + k.first + t, 0), static_cast<int>(width) - 1);
+					sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(source_row.data() + sx * 4), _mm_set1_ps(k.weights[t])));
+				}
+				_mm_storeu_ps(output, sum);
+#else
+				float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+				for (int t = 0; t < k.taps_nb; ++t) {
+					auto const sx = std::min(std::max(static_cast<int>(2u * x) + k.first + t, 0), static_cast<int>(width) - 1);
+					for (int c = 0; c < 4; ++c)
+						sum[c] += source_row[sx * 4 + c] * k.weights[t];
+				}
+				std::copy(sum, sum + 4, output);
+#endif
+			}
+		}
+
+		for (u32 y = first_row; y < last_row; ++y) {
+			auto const first_source = static_cast<int>(2u * y) + k.first - source_first;
+			auto output = next + static_cast<size_t>(y) * next_width * 4u;
+			for (u32 x = 0u; x < next_width; ++x, output += 4) {
+				float values[4];
+#ifdef BONOBO_MIPMAP_GENERATOR_SSE2
+				auto sum = _mm_setzero_ps();
+				for (int t = 0; t < k.taps_nb; ++t) {
+					auto const input = horizontal.data() + (static_cast<size_t>(first_source + t) * next_width + x) * 4u;
+					sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(input), _mm_set1_ps(k.weights[t])));
+				}
+				sum = _mm_min_ps(_mm_max_ps(sum, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+				_mm_storeu_ps(values, sum);
+#else
+				std::fill(values, values + 4, 0.0f);
+				for (int t = 0; t < k.taps_nb; ++t) {
+					auto const input = horizontal.data() + (static_cast<size_t>(first_source + t) * next_width + x) * 4u;
+					for (int c = 0; c < 4; ++c)
+						values[c] += input[c] * k.weights[t];
+				}
+				for (auto& v : values)
+					v = std::min(std::max(v, 0.0f), 1.0f);
+#endif
+				for (int c = 0; c < 3; ++c)
+					output[c] = settings.srgb ? tables.from_linear[static_cast<int>(values[c] * 4095.0f + 0.5f)]
+					                          : static_cast<u8>(values[c] * 255.0f + 0.5f);
+				output[3] = static_cast<u8>(values[3] * 255.0f + 0.5f);
+			}
+		}
+	}
+
+	void generateRows(u8 const* rgba, u32 width, u32 height, std::ptrdiff_t row_stride,
+	                  u8* next, u32 next_width, u32 first_row, u32 last_row, options const& settings)
+	{
+		if (settings.kernel == filter::box && !settings.srgb)
+			boxRows(rgba, width, height, row_stride, next, next_width, first_row, last_row);
+		else
+			filterRows(rgba, width, height, row_stride, next, next_width, first_row, last_row, settings);
+	}
+}
+
+u32
+bonobo::mipmaps::getNextSize(u32 size)
+{
+	return std::max(size / 2u, 1u);
+}
+
+u32
+bonobo::mipmaps::getLevelsCount(u32 width, u32 height)
+{
+	u32 levels_nb = 1u;
+	for (; width > 1u || height > 1u; ++levels_nb) {
+		width = getNextSize(width);
+		height = getNextSize(height);
+	}
+	return levels_nb;
+}
+
+void
+bonobo::mipmaps::generateLevel(u8 const* rgba, u32 width, u32 height, std::ptrdiff_t row_stride, u8* next,
+                               options const& settings, thread_pool* pool)
+{
+	auto const next_width = getNextSize(width), next_height = getNextSize(height);
+	if (pool == nullptr || pool->size() < 2u || static_cast<u64>(next_width) * next_height < tiling_threshold) {
+		generateRows(rgba, width, height, row_stride, next, next_width, 0u, next_height, settings);
+		return;
+	}
+
+	std::vector<std::future<void>> tiles;
+	tiles.reserve((next_height + tile_rows - 1u) / tile_rows);
+	for (u32 first_row = 0u; first_row < next_height; first_row += tile_rows) {
+		auto const last_row = std::min(first_row + tile_rows, next_height);
+		tiles.push_back(pool->submit([=, &settings](){
+			generateRows(rgba, width, height, row_stride, next, next_width, first_row, last_row, settings);
+		}));
+	}
+	for (auto& tile : tiles)
+		tile.wait();
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "core/Types.h"
+
+#include <cstddef>
+
+namespace bonobo
+{
+	class thread_pool;
+
+	//! \brief CPU generation of mipmap levels for RGBA8 images, so that
+	//!        every level can be uploaded explicitly instead of relying on
+	//!        `glGenerateMipmap()`, whose cost and filter are up to the
+	//!        driver.
+	//!
+	//! The functions only operate on CPU data and neither use OpenGL nor
+	//! the `Log*()` macros, so they can run on worker threads.
+	namespace mipmaps
+	{
+		enum class filter : u32 {
+			box = 0u, //!< average of 2x2 texels
+			kaiser    //!< 8-tap Kaiser-windowed sinc, sharper than box
+		};
+
+		//! \brief How levels are computed.
+		struct options {
+			filter kernel;
+			bool srgb; //!< whether RGB is filtered in linear space rather than on the stored sRGB values; alpha is always linear
+		};
+
+		//! \brief Size of the next level along one dimension.
+		u32 getNextSize(u32 size);
+
+		//! \brief Number of levels of a full chain, base level included.
+		u32 getLevelsCount(u32 width, u32 height);
+
+		//! \brief Compute the level following a given one.
+		//!
+		//! Texels outside of the image are clamped to its border.
+		//!
+		//! @param [in] rgba first row of RGBA texels of the source level
+		//! @param [in] width of the source level
+		//! @param [in] height of the source level
+		//! @param [in] row_stride distance in bytes from one source row to
+		//!             the next; can be negative to flip the image
+		//! @param [out] next tightly packed RGBA texels of size
+		//!             `getNextSize(width)` x `getNextSize(height)`
+		//! @param [in] settings filter to use
+		//! @param [in] pool if not nullptr, large levels are split into
+		//!             tiles of rows spread over its workers; must then
+		//!             not be called from one of those workers
+		void generateLevel(u8 const* rgba, u32 width, u32 height, std::ptrdiff_t row_stride, u8* next,
+		                   options const& settings, thread_pool* pool = nullptr);
+	}
+}
@@ -6,7 +6,20 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
-Node::Node() : _vao(0u), _vertices_nb(0u), _indices_nb(0u), _drawing_mode(GL_TRIANGLES), _has_indices(true), _program(0u), _textures(), _scaling(1.0f, 1.0f, 1.0f), _rotation(), _translation(), _children()
+#include <algorithm>
+
+namespace
+{
+	//! \brief Texture bound to each unit by the current batch, if any.
+	struct texture_batch {
+		bool active = false;
+		std::vector<std::pair<GLenum, GLuint>> units; // (target, texture)
+	};
+	texture_batch batch;
+	Node::texture_bind_statistics bind_statistics = {};
+}
+
+Node::Node() : _vao(0u), _vertices_nb(0u), _instances_nb(1), _indices_nb(0u), _indices_type(GL_UNSIGNED_INT), _base_vertex(0), _first_index(0u), _has_quantised_attributes(false), _binormal_is_sign(false), _vertex_dequantisation(1.0f), _drawing_mode(GL_TRIANGLES), _has_indices(true), _meshlets(), _lods(), _lod(0u), _program(0u), _textures(), _scaling(1.0f, 1.0f, 1.0f), _rotation(), _translation(), _children()
 {
 }
 
@@ -17,10 +30,13 @@ Node::render(glm::mat4 const& WVP, glm::mat4 const& world) const
 }
 
 void
-Node::render(glm::mat4 const& WVP, glm::mat4 const& world, GLuint program, std::function<void (GLuint)> const& set_uniforms) const
+Node::render(glm::mat4 const& WVP, glm::mat4 const& world, GLuint program, std::function<void (GLuint)> const& set_uniforms,
+             bonobo::meshlets::draw_ranges const* ranges) const
 {
 	if (_vao == 0u || program == 0u)
 		return;
+	if (ranges != nullptr && _has_indices && _lod == 0u && ranges->firsts.empty())
+		return;
 
 	glUseProgram(program);
 
@@ -28,17 +44,39 @@ Node::render(glm::mat4 const& WVP, glm::mat4 const& world, GLuint program, std::
 
 	set_uniforms(program);
 
-	glUniformMatrix4fv(glGetUniformLocation(program, "vertex_model_to_world"), 1, GL_FALSE, glm::value_ptr(world));
+	auto const vertex_model_to_world = world * _vertex_dequantisation;
+	glUniformMatrix4fv(glGetUniformLocation(program, "vertex_model_to_world"), 1, GL_FALSE, glm::value_ptr(vertex_model_to_world));
 	glUniformMatrix4fv(glGetUniformLocation(program, "normal_model_to_world"), 1, GL_FALSE, glm::value_ptr(normal_model_to_world));
 	glUniformMatrix4fv(glGetUniformLocation(program, "vertex_world_to_clip"), 1, GL_FALSE, glm::value_ptr(WVP));
 
+	glUniform1i(glGetUniformLocation(program, "has_quantised_attributes"), _has_quantised_attributes);
+	glUniform1i(glGetUniformLocation(program, "binormal_is_sign"), _binormal_is_sign);
+
 	glUniform1i(glGetUniformLocation(program, "has_textures"), !_textures.empty());
 	bool has_diffuse_texture = false, has_opacity_texture = false;
+	if (batch.active && batch.units.size() < _textures.size())
+		batch.units.resize(_textures.size(), std::make_pair(GL_NONE, 0u));
 	for (size_t i = 0u; i < _textures.size(); ++i) {
-		auto const texture = _textures[i];
-		glActiveTexture(GL_TEXTURE0 + static_cast<GLenum>(i));
-		glBindTexture(std::get<2>(texture), std::get<1>(texture));
+		auto const& texture = _textures[i];
+		auto const target = std::get<2>(texture);
+		auto const id = std::get<1>(texture);
+		auto const layer = std::get<3>(texture);
+		if (id == 0u) {
+			// Reserved unit of a texture array layer the node lacks.
+		} else if (batch.active && batch.units[i] == std::make_pair(target, id)) {
+			++bind_statistics.skipped_nb;
+		} else {
+			glActiveTexture(GL_TEXTURE0 + static_cast<GLenum>(i));
+			glBindTexture(target, id);
+			++bind_statistics.binds_nb;
+			if (batch.active)
+				batch.units[i] = std::make_pair(target, id);
+		}
 		glUniform1i(glGetUniformLocation(program, std::get<0>(texture).c_str()), static_cast<GLint>(i));
+		if (target == GL_TEXTURE_2D_ARRAY)
+			glUniform1i(glGetUniformLocation(program, (std::get<0>(texture) + "_layer").c_str()), layer);
+		if (id == 0u)
+			continue;
 		if (std::get<0>(texture) == "diffuse_texture")
 			has_diffuse_texture = true;
 		else if (std::get<0>(texture) == "opacity_texture")
@@ -48,10 +86,46 @@ Node::render(glm::mat4 const& WVP, glm::mat4 const& world, GLuint program, std::
 	glUniform1i(glGetUniformLocation(program, "has_opacity_texture"), has_opacity_texture);
 
 	glBindVertexArray(_vao);
-	if (_has_indices)
-		glDrawElements(_drawing_mode, _indices_nb, GL_UNSIGNED_INT, reinterpret_cast<GLvoid const*>(0x0));
-	else
-		glDrawArrays(_drawing_mode, 0, _vertices_nb);
+	if (_has_indices) {
+		auto const index_size = _indices_type == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+		// GL_PRIMITIVE_RESTART_FIXED_INDEX is only core from OpenGL 4.3
+		// onwards, hence the index being set for each type.
+		auto const restarts = _drawing_mode == GL_TRIANGLE_STRIP || _drawing_mode == GL_LINE_STRIP;
+		if (restarts) {
+			glEnable(GL_PRIMITIVE_RESTART);
+			glPrimitiveRestartIndex(_indices_type == GL_UNSIGNED_SHORT ? 0xFFFFu : bonobo::primitive_restart_index);
+		}
+		if (_lod != 0u) {
+			auto const& level = _lods->levels[_lod];
+			glDrawElementsBaseVertex(_drawing_mode, static_cast<GLsizei>(level.indices_nb), _indices_type,
+			                         reinterpret_cast<GLvoid const*>((_first_index + level.first_index) * index_size), _base_vertex);
+		} else if (ranges == nullptr) {
+			glDrawElementsBaseVertex(_drawing_mode, _indices_nb, _indices_type, reinterpret_cast<GLvoid const*>(_first_index * index_size), _base_vertex);
+		} else {
+			// Reused from one call to the next, as nodes get rendered from
+			// the thread owning the GL context only.
+			static std::vector<GLsizei> counts;
+			static std::vector<GLvoid const*> offsets;
+			static std::vector<GLint> base_vertices;
+			auto const ranges_nb = ranges->firsts.size();
+			counts.resize(ranges_nb);
+			offsets.resize(ranges_nb);
+			base_vertices.assign(ranges_nb, _base_vertex);
+			for (size_t i = 0u; i < ranges_nb; ++i) {
+				counts[i] = static_cast<GLsizei>(ranges->counts[i]);
+				offsets[i] = reinterpret_cast<GLvoid const*>((_first_index + ranges->firsts[i]) * index_size);
+			}
+			glMultiDrawElementsBaseVertex(_drawing_mode, counts.data(), _indices_type, offsets.data(),
+			                              static_cast<GLsizei>(ranges_nb), base_vertices.data());
+		}
+		if (restarts)
+			glDisable(GL_PRIMITIVE_RESTART);
+	} else {
+		if (_instances_nb == 1)
+			glDrawArrays(_drawing_mode, _base_vertex, _vertices_nb);
+		else
+			glDrawArraysInstanced(_drawing_mode, _base_vertex, _vertices_nb, _instances_nb);
+	}
 	glBindVertexArray(0u);
 
 	glUseProgram(0u);
@@ -62,9 +136,19 @@ Node::set_geometry(bonobo::mesh_data const& shape)
 {
 	_vao = shape.vao;
 	_vertices_nb = static_cast<GLsizei>(shape.vertices_nb);
+	_instances_nb = static_cast<GLsizei>(shape.instances_nb);
 	_indices_nb = static_cast<GLsizei>(shape.indices_nb);
+	_indices_type = shape.indices_type;
+	_base_vertex = shape.base_vertex;
+	_first_index = shape.first_index;
+	_has_quantised_attributes = shape.layout == bonobo::vertex_layout::quantised || shape.layout == bonobo::vertex_layout::quantised_positions;
+	_binormal_is_sign = shape.binormal_is_sign;
+	_vertex_dequantisation = shape.vertex_dequantisation;
 	_drawing_mode = shape.drawing_mode;
 	_has_indices = shape.ibo != 0u;
+	_meshlets = shape.meshlets;
+	_lods = shape.lods;
+	_lod = 0u;
 
 	if (!shape.bindings.empty()) {
 		for (auto const& binding : shape.bindings)
@@ -91,11 +175,72 @@ Node::set_indices_nb(size_t const& indices_nb)
 	_indices_nb = static_cast<GLsizei>(indices_nb);
 }
 
+std::shared_ptr<std::vector<bonobo::meshlets::meshlet> const> const&
+Node::get_meshlets() const
+{
+	return _meshlets;
+}
+
+size_t
+Node::select_lod(glm::vec3 const& camera_position, float fov_y, float viewport_height, float max_pixel_error)
+{
+	_lod = _lods != nullptr
+	     ? bonobo::mesh_simplifier::selectLod(*_lods, get_transform(), camera_position, fov_y, viewport_height, max_pixel_error)
+	     : 0u;
+	return _lod;
+}
+
+void
+Node::set_lod(size_t level)
+{
+	_lod = _lods != nullptr ? std::min(level, _lods->levels.size() - 1u) : 0u;
+}
+
+size_t
+Node::get_lod_indices_nb(size_t level) const
+{
+	if (_lods == nullptr || level == 0u)
+		return static_cast<size_t>(_indices_nb);
+	return _lods->levels[std::min(level, _lods->levels.size() - 1u)].indices_nb;
+}
+
 void
 Node::add_texture(std::string const& name, GLuint tex_id, GLenum type)
 {
 	if (tex_id != 0u)
-		_textures.emplace_back(name, tex_id, type);
+		_textures.emplace_back(name, tex_id, type, -1);
+}
+
+void
+Node::add_texture_layer(std::string const& name, GLuint array, GLint layer)
+{
+	_textures.emplace_back(name, layer >= 0 ? array : 0u, GL_TEXTURE_2D_ARRAY, layer);
+}
+
+void
+Node::begin_texture_batch()
+{
+	batch.active = true;
+	batch.units.clear();
+}
+
+void
+Node::end_texture_batch()
+{
+	batch.active = false;
+	batch.units.clear();
+}
+
+Node::texture_bind_statistics
+Node::get_texture_bind_statistics()
+{
+	return bind_statistics;
+}
+
+void
+Node::reset_texture_bind_statistics()
+{
+	bind_statistics = {};
 }
 
 void
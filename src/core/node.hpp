@@ -4,7 +4,11 @@
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 
+#include "core/mesh_simplifier.hpp"
+#include "core/meshlets.hpp"
+
 #include <functional>
+#include <memory>
 #include <tuple>
 #include <vector>
 
@@ -17,6 +21,12 @@ namespace bonobo
 class Node
 {
 public:
+	//! \brief Counters of the texture binds issued by `render()`.
+	struct texture_bind_statistics {
+		size_t binds_nb;   //!< textures bound
+		size_t skipped_nb; //!< binds skipped, as the texture was still bound
+	};
+
 	//! \brief Default constructor.
 	Node();
 
@@ -36,9 +46,14 @@ public:
 	//! @param [in] set_uniforms function that will take as argument an
 	//!             OpenGL shader program, and will setup that program's
 	//!             uniforms
+	//! @param [in] ranges if not nullptr, only draw those ranges of the
+	//!             indices, e.g. the meshlets left visible by
+	//!             `bonobo::meshlets::cull()`; ignored unless the finest
+	//!             level of detail is selected
 	void render(glm::mat4 const& WVP, glm::mat4 const& world,
 	            GLuint program,
-	            std::function<void (GLuint)> const& set_uniforms) const;
+	            std::function<void (GLuint)> const& set_uniforms,
+	            bonobo::meshlets::draw_ranges const* ranges = nullptr) const;
 
 	//! \brief Set the geometry of this node.
 	//!
@@ -58,6 +73,39 @@ public:
 	//! @param [in] indices_nb how many indices to use when rendering
 	void set_indices_nb(size_t const& indices_nb);
 
+	//! \brief Get the meshlets of the geometry.
+	//!
+	//! @return the clusters of the geometry, or nullptr if it was not
+	//!         split into clusters
+	std::shared_ptr<std::vector<bonobo::meshlets::meshlet> const> const& get_meshlets() const;
+
+	//! \brief Select the level of detail to render, from the size on
+	//!        screen of the geometry; see
+	//!        `bonobo::mesh_simplifier::selectLod()`.
+	//!
+	//! @param [in] camera_position in world space
+	//! @param [in] fov_y vertical field of view of the camera, in radians
+	//! @param [in] viewport_height in pixels
+	//! @param [in] max_pixel_error largest error allowed on screen
+	//! @return the selected level, 0 being the finest one
+	size_t select_lod(glm::vec3 const& camera_position, float fov_y, float viewport_height, float max_pixel_error);
+
+	//! \brief Set the level of detail to render.
+	//!
+	//! @param [in] level 0 for the finest level; clamped to the coarsest
+	//!             one available
+	void set_lod(size_t level);
+
+	//! \brief Get the number of indices of a level of detail.
+	//!
+	//! @param [in] level which level; the currently selected one is
+	//!             given by `get_lod()`
+	//! @return how many indices that level renders
+	size_t get_lod_indices_nb(size_t level) const;
+
+	//! \brief Get the level of detail currently selected.
+	size_t get_lod() const { return _lod; }
+
 	//! \brief Set the program of this node.
 	//!
 	//! A node without a program will not render itself, but its children
@@ -79,6 +127,39 @@ public:
 	//!                  GL_TEXTURE_CUBE_MAP, etc.
 	void add_texture(std::string const& name, GLuint tex_id, GLenum type);
 
+	//! \brief Add a layer of a texture array to this node.
+	//!
+	//! Besides binding the array to the sampler `name`, `render()` sets
+	//! the `int` uniform `name` followed by `_layer` to the layer; see
+	//! `bonobo::texture_arrays`.
+	//!
+	//! @param [in] name the variable name of the `sampler2DArray` used by
+	//!                  the attached OpenGL shader program
+	//! @param [in] array the name of an OpenGL 2D-array texture, or 0 if
+	//!                   the node has no such texture; the texture unit
+	//!                   is then reserved but left untouched
+	//! @param [in] layer which layer to sample, or -1 if none
+	void add_texture_layer(std::string const& name, GLuint array, GLint layer);
+
+	//! \brief Start a batch of draws sharing their texture bindings.
+	//!
+	//! Within a batch, `render()` skips binding a texture to a unit it
+	//! was already bound to by a previous `render()` of the batch, which
+	//! pays off when draws get grouped by texture, e.g. once materials
+	//! are packed into texture arrays. Nothing else may bind textures
+	//! until `end_texture_batch()`.
+	static void begin_texture_batch();
+
+	//! \brief End the current batch of draws; see
+	//!        `begin_texture_batch()`.
+	static void end_texture_batch();
+
+	//! \brief Get the texture binds issued since the last reset.
+	static texture_bind_statistics get_texture_bind_statistics();
+
+	//! \brief Reset the texture bind counters.
+	static void reset_texture_bind_statistics();
+
 	//! \brief Add a child to this node.
 	//!
 	//! @param [in] child pointer to the child to add; the pointer has to
@@ -169,16 +250,26 @@ private:
 	// Geometry data
 	GLuint _vao;
 	GLsizei _vertices_nb;
+	GLsizei _instances_nb;
 	GLsizei _indices_nb;
+	GLenum _indices_type;
+	GLint _base_vertex;
+	size_t _first_index;
+	bool _has_quantised_attributes;
+	bool _binormal_is_sign;
+	glm::mat4 _vertex_dequantisation;
 	GLenum _drawing_mode;
 	bool _has_indices;
+	std::shared_ptr<std::vector<bonobo::meshlets::meshlet> const> _meshlets;
+	std::shared_ptr<bonobo::mesh_simplifier::lod_chain const> _lods;
+	size_t _lod;
 
 	// Program data
 	GLuint _program;
 	std::function<void (GLuint)> _set_uniforms;
 
-	// Textures data
-	std::vector<std::tuple<std::string, GLuint, GLenum>> _textures;
+	// Textures data, as (sampler name, texture, target, layer or -1)
+	std::vector<std::tuple<std::string, GLuint, GLenum, GLint>> _textures;
 
 	// Transformation data
 	glm::vec3 _scaling;
@@ -0,0 +1,282 @@
+#include "resource_registry.hpp"
+
+#include "core/Log.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <unordered_map>
+
+namespace
+{
+	size_t const kinds_nb = static_cast<size_t>(bonobo::resource_registry::kind::count);
+
+	struct registry {
+		std::mutex mutex;
+		std::array<std::unordered_map<u64, bonobo::resource_registry::record>, kinds_nb> records;
+		bonobo::resource_registry::statistics stats = {};
+		bool gpu_warned = false;
+		bool host_warned = false;
+
+		registry()
+		{
+			stats.gpu_budget = 1024ull * 1024ull * 1024ull;
+		}
+	};
+
+	registry& get()
+	{
+		static registry instance;
+		return instance;
+	}
+
+	thread_local std::vector<char const*> owners;
+
+	bool isHost(bonobo::resource_registry::kind type)
+	{
+		return type == bonobo::resource_registry::kind::host;
+	}
+
+	//! \brief Account for a change in size of a resource.
+	void addBytes(registry& r, bonobo::resource_registry::kind type, u64 removed, u64 added)
+	{
+		auto& stats = r.stats;
+		stats.bytes[static_cast<size_t>(type)] += added - removed;
+		auto& total = isHost(type) ? stats.host_bytes : stats.gpu_bytes;
+		auto& peak = isHost(type) ? stats.peak_host_bytes : stats.peak_gpu_bytes;
+		total += added - removed;
+		peak = std::max(peak, total);
+	}
+
+	//! \brief Which budgets got exceeded since last checked; each one
+	//!        is reported once, until its memory goes back under it.
+	void checkBudgets(registry& r, bool& gpu_exceeded, bool& host_exceeded)
+	{
+		auto const check = [](u64 bytes, u64 budget, bool& warned) {
+			auto const over = budget != 0u && bytes > budget;
+			auto const report = over && !warned;
+			warned = over;
+			return report;
+		};
+		gpu_exceeded = check(r.stats.gpu_bytes, r.stats.gpu_budget, r.gpu_warned);
+		host_exceeded = check(r.stats.host_bytes, r.stats.host_budget, r.host_warned);
+	}
+
+	void warnBudgets(bonobo::resource_registry::statistics const& stats, bool gpu_exceeded, bool host_exceeded)
+	{
+		if (gpu_exceeded)
+			LogWarning("GPU resources use %.2f MiB, over the budget of %.2f MiB",
+			           stats.gpu_bytes / (1024.0 * 1024.0), stats.gpu_budget / (1024.0 * 1024.0));
+		if (host_exceeded)
+			LogWarning("Host resources use %.2f MiB, over the budget of %.2f MiB",
+			           stats.host_bytes / (1024.0 * 1024.0), stats.host_budget / (1024.0 * 1024.0));
+	}
+
+	void writeJsonString(std::ostream& out, std::string const& value)
+	{
+		out << '"';
+		for (auto const c : value) {
+			switch (c) {
+			case '"':  out << "\\\""; break;
+			case '\\': out << "\\\\"; break;
+			case '\n': out << "\\n"; break;
+			case '\t': out << "\\t"; break;
+			default:
+				if (static_cast<unsigned char>(c) < 0x20u) {
+					char escaped[8];
+					std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned int>(c));
+					out << escaped;
+				} else {
+					out << c;
+				}
+			}
+		}
+		out << '"';
+	}
+}
+
+void
+bonobo::resource_registry::pushOwner(char const* tag)
+{
+	owners.push_back(tag);
+}
+
+void
+bonobo::resource_registry::popOwner()
+{
+	if (!owners.empty())
+		owners.pop_back();
+}
+
+void
+bonobo::resource_registry::track(kind type, u64 id, u64 bytes, std::string const& format, std::string const& label, char const* site)
+{
+	auto& r = get();
+	statistics stats;
+	bool gpu_exceeded = false, host_exceeded = false;
+	{
+		std::lock_guard<std::mutex> lock(r.mutex);
+		auto& records = r.records[static_cast<size_t>(type)];
+		auto const previous = records.find(id);
+		if (previous != records.end()) {
+			addBytes(r, type, previous->second.bytes, 0u);
+			records.erase(previous);
+		} else {
+			++r.stats.counts[static_cast<size_t>(type)];
+		}
+		records.emplace(id, record{ type, id, bytes, format, label,
+		                            !owners.empty() && owners.back() != nullptr ? owners.back() : "", site });
+		addBytes(r, type, 0u, bytes);
+		checkBudgets(r, gpu_exceeded, host_exceeded);
+		stats = r.stats;
+	}
+	warnBudgets(stats, gpu_exceeded, host_exceeded);
+}
+
+void
+bonobo::resource_registry::resize(kind type, u64 id, u64 bytes)
+{
+	auto& r = get();
+	statistics stats;
+	bool gpu_exceeded = false, host_exceeded = false;
+	{
+		std::lock_guard<std::mutex> lock(r.mutex);
+		auto& records = r.records[static_cast<size_t>(type)];
+		auto const it = records.find(id);
+		if (it == records.end())
+			return;
+		addBytes(r, type, it->second.bytes, bytes);
+		it->second.bytes = bytes;
+		checkBudgets(r, gpu_exceeded, host_exceeded);
+		stats = r.stats;
+	}
+	warnBudgets(stats, gpu_exceeded, host_exceeded);
+}
+
+void
+bonobo::resource_registry::untrack(kind type, u64 id)
+{
+	auto& r = get();
+	std::lock_guard<std::mutex> lock(r.mutex);
+	auto& records = r.records[static_cast<size_t>(type)];
+	auto const it = records.find(id);
+	if (it == records.end())
+		return;
+	addBytes(r, type, it->second.bytes, 0u);
+	--r.stats.counts[static_cast<size_t>(type)];
+	records.erase(it);
+	bool gpu_exceeded = false, host_exceeded = false;
+	checkBudgets(r, gpu_exceeded, host_exceeded);
+}
+
+void
+bonobo::resource_registry::setBudgets(u64 gpu_bytes, u64 host_bytes)
+{
+	auto& r = get();
+	statistics stats;
+	bool gpu_exceeded = false, host_exceeded = false;
+	{
+		std::lock_guard<std::mutex> lock(r.mutex);
+		r.stats.gpu_budget = gpu_bytes;
+		r.stats.host_budget = host_bytes;
+		checkBudgets(r, gpu_exceeded, host_exceeded);
+		stats = r.stats;
+	}
+	warnBudgets(stats, gpu_exceeded, host_exceeded);
+}
+
+bonobo::resource_registry::statistics
+bonobo::resource_registry::getStatistics()
+{
+	auto& r = get();
+	std::lock_guard<std::mutex> lock(r.mutex);
+	return r.stats;
+}
+
+std::vector<bonobo::resource_registry::record>
+bonobo::resource_registry::getRecords()
+{
+	std::vector<record> records;
+	{
+		auto& r = get();
+		std::lock_guard<std::mutex> lock(r.mutex);
+		for (auto const& of_kind : r.records)
+			for (auto const& entry : of_kind)
+				records.push_back(entry.second);
+	}
+	std::sort(records.begin(), records.end(), [](record const& a, record const& b) {
+		return a.bytes != b.bytes ? a.bytes > b.bytes : a.id < b.id;
+	});
+	return records;
+}
+
+bool
+bonobo::resource_registry::dumpJson(std::string const& path)
+{
+	auto const stats = getStatistics();
+	auto const records = getRecords();
+
+	std::ofstream file(path, std::ios::trunc);
+	if (!file.is_open())
+		return false;
+
+	file << "{\n"
+	     << "\t\"gpu_bytes\": " << stats.gpu_bytes << ",\n"
+	     << "\t\"host_bytes\": " << stats.host_bytes << ",\n"
+	     << "\t\"peak_gpu_bytes\": " << stats.peak_gpu_bytes << ",\n"
+	     << "\t\"peak_host_bytes\": " << stats.peak_host_bytes << ",\n"
+	     << "\t\"gpu_budget\": " << stats.gpu_budget << ",\n"
+	     << "\t\"host_budget\": " << stats.host_budget << ",\n"
+	     << "\t\"kinds\": {";
+	for (size_t i = 0u; i < kinds_nb; ++i) {
+		file << (i != 0u ? ",\n" : "\n") << "\t\t\"" << getKindName(static_cast<kind>(i)) << "\": { \"count\": "
+		     << stats.counts[i] << ", \"bytes\": " << stats.bytes[i] << " }";
+	}
+	file << "\n\t},\n"
+	     << "\t\"resources\": [";
+	for (size_t i = 0u; i < records.size(); ++i) {
+		auto const& resource = records[i];
+		file << (i != 0u ? ",\n" : "\n") << "\t\t{ \"kind\": \"" << getKindName(resource.type) << "\", \"id\": " << resource.id
+		     << ", \"bytes\": " << resource.bytes << ", \"format\": ";
+		writeJsonString(file, resource.format);
+		file << ", \"label\": ";
+		writeJsonString(file, resource.label);
+		file << ", \"owner\": ";
+		writeJsonString(file, resource.owner);
+		file << ", \"site\": ";
+		writeJsonString(file, resource.site != nullptr ? resource.site : "");
+		file << " }";
+	}
+	file << "\n\t]\n"
+	     << "}\n";
+
+	return file.good();
+}
+
+char const*
+bonobo::resource_registry::getKindName(kind type)
+{
+	switch (type) {
+	case kind::buffer:       return "buffer";
+	case kind::texture:      return "texture";
+	case kind::renderbuffer: return "renderbuffer";
+	case kind::framebuffer:  return "framebuffer";
+	case kind::host:         return "host";
+	default:                 return "unknown";
+	}
+}
+
+void
+bonobo::resource_registry::logStatistics()
+{
+	auto const stats = getStatistics();
+	LogInfo("Resources: %.2f MiB on the GPU (peak %.2f MiB) in %u buffers, %u textures, %u renderbuffers and %u framebuffers; %.2f MiB on the host (peak %.2f MiB)",
+	        stats.gpu_bytes / (1024.0 * 1024.0), stats.peak_gpu_bytes / (1024.0 * 1024.0),
+	        static_cast<unsigned int>(stats.counts[static_cast<size_t>(kind::buffer)]),
+	        static_cast<unsigned int>(stats.counts[static_cast<size_t>(kind::texture)]),
+	        static_cast<unsigned int>(stats.counts[static_cast<size_t>(kind::renderbuffer)]),
+	        static_cast<unsigned int>(stats.counts[static_cast<size_t>(kind::framebuffer)]),
+	        stats.host_bytes / (1024.0 * 1024.0), stats.peak_host_bytes / (1024.0 * 1024.0));
+}
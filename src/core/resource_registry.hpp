@@ -0,0 +1,132 @@
+#pragma once
+
+#include "core/Types.h"
+
+#include <string>
+#include <vector>
+
+#define RESOURCE_REGISTRY_STRINGIFY_(x) #x
+#define RESOURCE_REGISTRY_STRINGIFY(x) RESOURCE_REGISTRY_STRINGIFY_(x)
+
+//! \brief Location of the current line, as passed to
+//!        `bonobo::resource_registry::track()`.
+#define RESOURCE_SITE __FILE__ ":" RESOURCE_REGISTRY_STRINGIFY(__LINE__)
+
+namespace bonobo
+{
+	//! \brief Process-wide accounting of the memory used by GPU resources,
+	//!        and by the CPU data kept alongside them.
+	//!
+	//! The core helpers record every buffer, texture and framebuffer they
+	//! create, along with its size, format, a label such as the file it
+	//! was loaded from, the current owner tag, and the line creating it;
+	//! CPU allocations, e.g. meshlets, are recorded as host resources.
+	//! Sizes are those requested from OpenGL, which does not report how
+	//! much the driver actually allocates.
+	//!
+	//! The registry can be inspected through `renderView()`, or dumped as
+	//! JSON for offline analysis. A warning gets logged whenever the GPU
+	//! or host memory goes over its budget.
+	//!
+	//! All functions can be called from any thread, but `track()` and
+	//! `resize()` may log, and should therefore stay on the main thread.
+	namespace resource_registry
+	{
+		enum class kind : u32 {
+			buffer,
+			texture,
+			renderbuffer,
+			framebuffer,
+			host,
+			count
+		};
+
+		//! \brief A recorded resource.
+		struct record {
+			kind type;
+			u64 id;             //!< OpenGL name, or address for host resources
+			u64 bytes;
+			std::string format; //!< e.g. `BC1`, `u16 indices`
+			std::string label;  //!< e.g. the file a texture was loaded from
+			std::string owner;  //!< owner tag current at creation
+			char const* site;   //!< `file:line` of the creation
+		};
+
+		//! \brief Totals over all recorded resources.
+		struct statistics {
+			size_t counts[static_cast<size_t>(kind::count)];
+			u64 bytes[static_cast<size_t>(kind::count)];
+			u64 gpu_bytes;       //!< all kinds but host
+			u64 host_bytes;
+			u64 peak_gpu_bytes;
+			u64 peak_host_bytes;
+			u64 gpu_budget;      //!< 0 if unlimited
+			u64 host_budget;     //!< 0 if unlimited
+		};
+
+		//! \brief Tag the resources created from now on, until the
+		//!        matching `popOwner()`.
+		//!
+		//! Owners are per thread, and nest: the innermost one wins.
+		//!
+		//! @param [in] tag e.g. `G-buffer`, which must outlive the call
+		//!             to `popOwner()`
+		void pushOwner(char const* tag);
+
+		//! \brief Restore the owner tag preceding the last `pushOwner()`.
+		void popOwner();
+
+		//! \brief Tags the resources created while alive, e.g.
+		//!        `scoped_owner owner("G-buffer");`.
+		class scoped_owner
+		{
+		public:
+			explicit scoped_owner(char const* tag) { pushOwner(tag); }
+			~scoped_owner() { popOwner(); }
+
+			scoped_owner(scoped_owner const&) = delete;
+			scoped_owner& operator=(scoped_owner const&) = delete;
+		};
+
+		//! \brief Record a resource, replacing any previous record of
+		//!        the same kind and id.
+		//!
+		//! @param [in] site where the resource is created, see
+		//!             `RESOURCE_SITE`; must be a string literal
+		void track(kind type, u64 id, u64 bytes, std::string const& format, std::string const& label, char const* site);
+
+		//! \brief Update the size of a recorded resource, e.g. once more
+		//!        of its levels are streamed in; unknown ones are ignored.
+		void resize(kind type, u64 id, u64 bytes);
+
+		//! \brief Forget a resource, once deleted; unknown ones are
+		//!        ignored.
+		void untrack(kind type, u64 id);
+
+		//! \brief Set the memory budgets; 0 means unlimited. Default to
+		//!        1 GiB of GPU memory, and unlimited host memory.
+		void setBudgets(u64 gpu_bytes, u64 host_bytes);
+
+		//! \brief Get the current totals.
+		statistics getStatistics();
+
+		//! \brief Get a copy of all records, largest first.
+		std::vector<record> getRecords();
+
+		//! \brief Write all records and totals to a JSON file.
+		//!
+		//! @return whether the file could be written
+		bool dumpJson(std::string const& path);
+
+		//! \brief Name of a kind of resource, e.g. `texture`.
+		char const* getKindName(kind type);
+
+		//! \brief Log the current totals.
+		void logStatistics();
+
+		//! \brief Show the registry in an ImGui window.
+		//!
+		//! @param [in,out] opened whether the window is shown, optional
+		void renderView(bool* opened = nullptr);
+	}
+}
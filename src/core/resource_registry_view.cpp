@@ -0,0 +1,93 @@
+#include "resource_registry.hpp"
+
+#include "core/Log.h"
+
+#include <imgui.h>
+
+#include <functional>
+#include <map>
+#include <string>
+
+namespace
+{
+	double toMiB(u64 bytes)
+	{
+		return bytes / (1024.0 * 1024.0);
+	}
+
+	void showUsage(char const* name, u64 bytes, u64 peak_bytes, u64 budget)
+	{
+		if (budget == 0u) {
+			ImGui::Text("%s: %.2f MiB (peak %.2f MiB), no budget", name, toMiB(bytes), toMiB(peak_bytes));
+			return;
+		}
+		ImGui::Text("%s: %.2f / %.2f MiB (peak %.2f MiB)", name, toMiB(bytes), toMiB(budget), toMiB(peak_bytes));
+		auto const fraction = static_cast<float>(static_cast<double>(bytes) / static_cast<double>(budget));
+		ImGui::ProgressBar(fraction < 1.0f ? fraction : 1.0f, ImVec2(-1.0f, 0.0f), fraction > 1.0f ? "over budget" : nullptr);
+	}
+}
+
+void
+bonobo::resource_registry::renderView(bool* opened)
+{
+	static char const* const dump_path = "resources.json";
+
+	if (!ImGui::Begin("Resources", opened, ImVec2(600, 400), -1.0f, 0)) {
+		ImGui::End();
+		return;
+	}
+
+	auto const stats = getStatistics();
+	showUsage("GPU", stats.gpu_bytes, stats.peak_gpu_bytes, stats.gpu_budget);
+	showUsage("Host", stats.host_bytes, stats.peak_host_bytes, stats.host_budget);
+	for (size_t i = 0u; i < static_cast<size_t>(kind::count); ++i)
+		ImGui::Text("\t%u %s%s: %.2f MiB", static_cast<unsigned int>(stats.counts[i]), getKindName(static_cast<kind>(i)),
+		            stats.counts[i] == 1u ? "" : "s", toMiB(stats.bytes[i]));
+	if (ImGui::SmallButton("Dump to JSON")) {
+		if (dumpJson(dump_path))
+			LogInfo("Resources dumped to \"%s\"", dump_path);
+		else
+			LogError("Failed to dump the resources to \"%s\"", dump_path);
+	}
+	ImGui::Separator();
+
+	auto const records = getRecords();
+
+	// GPU memory per owner, largest first.
+	std::map<std::string, u64> owners;
+	for (auto const& resource : records)
+		if (resource.type != kind::host)
+			owners[resource.owner.empty() ? "(untagged)" : resource.owner] += resource.bytes;
+	std::multimap<u64, std::string, std::greater<u64>> owners_by_size;
+	for (auto const& owner : owners)
+		owners_by_size.emplace(owner.second, owner.first);
+	for (auto const& owner : owners_by_size)
+		ImGui::Text("%s: %.2f MiB", owner.second.c_str(), toMiB(owner.first));
+	ImGui::Separator();
+
+	ImGui::BeginChild("resources");
+	ImGui::Columns(6, "resources");
+	for (auto const header : { "Kind", "Size", "Format", "Label", "Owner", "Site" }) {
+		ImGui::Text("%s", header);
+		ImGui::NextColumn();
+	}
+	ImGui::Separator();
+	for (auto const& resource : records) {
+		ImGui::Text("%s %llu", getKindName(resource.type), static_cast<unsigned long long>(resource.id));
+		ImGui::NextColumn();
+		ImGui::Text("%.1f KiB", resource.bytes / 1024.0);
+		ImGui::NextColumn();
+		ImGui::Text("%s", resource.format.c_str());
+		ImGui::NextColumn();
+		ImGui::Text("%s", resource.label.c_str());
+		ImGui::NextColumn();
+		ImGui::Text("%s", resource.owner.c_str());
+		ImGui::NextColumn();
+		ImGui::Text("%s", resource.site != nullptr ? resource.site : "");
+		ImGui::NextColumn();
+	}
+	ImGui::Columns(1);
+	ImGui::EndChild();
+
+	ImGui::End();
+}
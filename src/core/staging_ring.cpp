@@ -0,0 +1,287 @@
+#include "staging_ring.hpp"
+
+#include "core/Log.h"
+#include "core/Misc.h"
+#include "core/resource_registry.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+	// Keeps ranges suitably aligned for any vertex attribute, index or
+	// texel type.
+	size_t const range_alignment = 16u;
+}
+
+bonobo::staging_ring::staging_ring(size_t capacity) : _capacity(capacity), _buffer(0u), _head(0u), _tail(0u), _fenced_end(0u), _fences(), _stats()
+{
+	_stats.capacity = capacity;
+}
+
+bonobo::staging_ring::~staging_ring()
+{
+	release();
+}
+
+bonobo::staging_ring&
+bonobo::staging_ring::shared()
+{
+	static staging_ring ring;
+	return ring;
+}
+
+void
+bonobo::staging_ring::release()
+{
+	if (_buffer == 0u)
+		return;
+
+	for (auto const& range : _fences) {
+		glClientWaitSync(range.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000u);
+		glDeleteSync(range.fence);
+	}
+	_fences.clear();
+	glDeleteBuffers(1, &_buffer);
+	resource_registry::untrack(resource_registry::kind::buffer, _buffer);
+	_buffer = 0u;
+	_head = _tail = _fenced_end = 0u;
+	_stats.bytes_in_flight = 0u;
+}
+
+GLuint
+bonobo::staging_ring::get_buffer()
+{
+	if (_buffer == 0u) {
+		glGenBuffers(1, &_buffer);
+		assert(_buffer != 0u);
+		glBindBuffer(GL_COPY_READ_BUFFER, _buffer);
+		glBufferData(GL_COPY_READ_BUFFER, static_cast<GLsizeiptr>(_capacity), nullptr, GL_STREAM_DRAW);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0u);
+		resource_registry::track(resource_registry::kind::buffer, _buffer, _capacity, "staging", "staging ring", RESOURCE_SITE);
+	}
+	return _buffer;
+}
+
+void
+bonobo::staging_ring::reclaim()
+{
+	while (!_fences.empty()) {
+		auto const& oldest = _fences.front();
+		auto const status = glClientWaitSync(oldest.fence, 0, 0u);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+			break;
+		glDeleteSync(oldest.fence);
+		_tail = oldest.end;
+		_fences.pop_front();
+	}
+	_stats.bytes_in_flight = _head - _tail;
+}
+
+void
+bonobo::staging_ring::wait_oldest()
+{
+	auto const& oldest = _fences.front();
+	auto const start_time = StartTimer();
+	for (;;) {
+		auto const status = glClientWaitSync(oldest.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000u);
+		if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+			break;
+		if (status == GL_WAIT_FAILED) {
+			LogError("Failed to wait on a staging fence: finishing all commands instead");
+			glFinish();
+			break;
+		}
+	}
+	auto const wait_ms = EndTimerSeconds(start_time) * 1000.0;
+	++_stats.waits_nb;
+	_stats.total_wait_ms += wait_ms;
+	_stats.max_wait_ms = std::max(_stats.max_wait_ms, wait_ms);
+
+	glDeleteSync(oldest.fence);
+	_tail = oldest.end;
+	_fences.pop_front();
+}
+
+bool
+bonobo::staging_ring::reserve(size_t size, u64& position)
+{
+	if (size > _capacity)
+		return false;
+
+	position = (_head + range_alignment - 1u) / range_alignment * range_alignment;
+	auto const offset = position % _capacity;
+	if (offset + size > _capacity)
+		position += _capacity - offset; // skip the end of the ring, as ranges do not wrap around
+
+	reclaim();
+	while (position + size - _tail > _capacity) {
+		if (_tail == _head) {
+			// Everything was reclaimed, and the bytes skipped hold
+			// nothing.
+			_tail = position;
+			break;
+		}
+		if (_fences.empty()) {
+			fence();
+			if (_fences.empty())
+				continue; // fencing failed and finished all commands
+		}
+		wait_oldest();
+	}
+
+	_head = position + size;
+	_stats.bytes_in_flight = _head - _tail;
+	_stats.peak_bytes_in_flight = std::max(_stats.peak_bytes_in_flight, _stats.bytes_in_flight);
+	return true;
+}
+
+// Without GL_ARB_buffer_storage, which is core only since OpenGL 4.4, the
+// ring can not stay mapped while the GPU reads from it: each range is
+// mapped on its own instead, without synchronisation as the fences
+// already guarantee that the GPU is done with it.
+bool
+bonobo::staging_ring::stage(size_t size, fill_function const& fill, GLintptr& offset)
+{
+	if (size == 0u)
+		return false;
+
+	u64 position = 0u;
+	if (!reserve(size, position)) {
+		++_stats.fallbacks_nb;
+		return false;
+	}
+
+	offset = static_cast<GLintptr>(position % _capacity);
+	glBindBuffer(GL_COPY_READ_BUFFER, get_buffer());
+	auto const mapped = static_cast<u8*>(glMapBufferRange(GL_COPY_READ_BUFFER, offset, static_cast<GLsizeiptr>(size),
+	                                                      GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
+	bool filled = false;
+	if (mapped != nullptr) {
+		fill(mapped);
+		filled = glUnmapBuffer(GL_COPY_READ_BUFFER) == GL_TRUE;
+	}
+	glBindBuffer(GL_COPY_READ_BUFFER, 0u);
+	if (!filled) {
+		++_stats.fallbacks_nb;
+		return false;
+	}
+
+	++_stats.allocations_nb;
+	_stats.total_bytes += size;
+	return true;
+}
+
+bool
+bonobo::staging_ring::stage(void const* data, size_t size, GLintptr& offset)
+{
+	return stage(size, [data, size](u8* destination){ std::memcpy(destination, data, size); }, offset);
+}
+
+void
+bonobo::staging_ring::upload_buffer(GLenum target, GLintptr offset, size_t size, fill_function const& fill)
+{
+	assert(target != GL_COPY_READ_BUFFER);
+	GLintptr staged_offset = 0;
+	if (!stage(size, fill, staged_offset)) {
+		if (size == 0u)
+			return;
+		auto data = std::vector<u8>(size);
+		fill(data.data());
+		glBufferSubData(target, offset, static_cast<GLsizeiptr>(size), static_cast<GLvoid const*>(data.data()));
+		return;
+	}
+
+	glBindBuffer(GL_COPY_READ_BUFFER, _buffer);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, target, staged_offset, offset, static_cast<GLsizeiptr>(size));
+	glBindBuffer(GL_COPY_READ_BUFFER, 0u);
+}
+
+void
+bonobo::staging_ring::upload_buffer(GLenum target, GLintptr offset, void const* data, size_t size)
+{
+	assert(target != GL_COPY_READ_BUFFER);
+	GLintptr staged_offset = 0;
+	if (!stage(data, size, staged_offset)) {
+		if (size != 0u)
+			glBufferSubData(target, offset, static_cast<GLsizeiptr>(size), data);
+		return;
+	}
+
+	glBindBuffer(GL_COPY_READ_BUFFER, _buffer);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, target, staged_offset, offset, static_cast<GLsizeiptr>(size));
+	glBindBuffer(GL_COPY_READ_BUFFER, 0u);
+}
+
+void
+bonobo::staging_ring::upload_pixels(size_t size, fill_function const& fill, std::function<void (GLvoid const* pixels)> const& upload)
+{
+	GLintptr staged_offset = 0;
+	if (!stage(size, fill, staged_offset)) {
+		auto data = std::vector<u8>(size);
+		if (size != 0u)
+			fill(data.data());
+		upload(static_cast<GLvoid const*>(data.data()));
+		return;
+	}
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _buffer);
+	upload(reinterpret_cast<GLvoid const*>(staged_offset));
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0u);
+}
+
+void
+bonobo::staging_ring::upload_pixels(void const* data, size_t size, std::function<void (GLvoid const* pixels)> const& upload)
+{
+	GLintptr staged_offset = 0;
+	if (!stage(data, size, staged_offset)) {
+		upload(data);
+		return;
+	}
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _buffer);
+	upload(reinterpret_cast<GLvoid const*>(staged_offset));
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0u);
+}
+
+void
+bonobo::staging_ring::fence()
+{
+	if (_fenced_end == _head) {
+		reclaim();
+		return;
+	}
+
+	auto const sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0u);
+	if (sync == nullptr) {
+		LogError("Failed to create a staging fence: finishing all commands instead");
+		glFinish();
+		for (auto const& range : _fences)
+			glDeleteSync(range.fence);
+		_fences.clear();
+		_tail = _fenced_end = _head;
+		_stats.bytes_in_flight = 0u;
+		return;
+	}
+	_fences.push_back({ sync, _head });
+	_fenced_end = _head;
+	++_stats.fences_nb;
+	reclaim();
+}
+
+bonobo::staging_ring::statistics
+bonobo::staging_ring::get_statistics() const
+{
+	return _stats;
+}
+
+void
+bonobo::staging_ring::log_statistics() const
+{
+	LogInfo("Staging ring: %.2f MiB, %.2f MiB in flight (%.2f MiB peak), %.2f MiB staged in %u ranges, %u fences, %u waits (%.2f ms total, %.2f ms max), %u fallbacks",
+	        _stats.capacity / (1024.0 * 1024.0), _stats.bytes_in_flight / (1024.0 * 1024.0), _stats.peak_bytes_in_flight / (1024.0 * 1024.0),
+	        _stats.total_bytes / (1024.0 * 1024.0), static_cast<unsigned int>(_stats.allocations_nb), static_cast<unsigned int>(_stats.fences_nb),
+	        static_cast<unsigned int>(_stats.waits_nb), _stats.total_wait_ms, _stats.max_wait_ms, static_cast<unsigned int>(_stats.fallbacks_nb));
+}
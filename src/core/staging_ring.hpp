@@ -0,0 +1,143 @@
+#pragma once
+
+#include "external/glad/glad.h"
+
+#include "core/Types.h"
+
+#include <deque>
+#include <functional>
+
+namespace bonobo
+{
+	//! \brief Ring buffer through which data is staged on its way to
+	//!        buffer objects and textures.
+	//!
+	//! Uploads write into a range of one large buffer object, mapped
+	//! without synchronisation, and are then carried out on the GPU side:
+	//! buffer objects get their content copied from the ring, while
+	//! textures are filled in from it bound as the pixel unpack buffer.
+	//! This avoids both the copy of the data made by the driver when
+	//! uploading straight from client memory, and the implicit
+	//! synchronisation of mapping a buffer object still in use.
+	//!
+	//! Staged ranges are reclaimed through fences: `fence()`, called once
+	//! per frame by `Window::Swap()`, marks the end of a batch of ranges,
+	//! which are then recycled as soon as the GPU is done with them. An
+	//! allocation waits on the oldest fence whenever the ring is full.
+	//!
+	//! Data larger than the ring, or whose range could not be mapped, is
+	//! uploaded from client memory instead.
+	class staging_ring
+	{
+	public:
+		//! \brief Usage of the ring.
+		struct statistics {
+			u64 capacity;             //!< size of the ring in bytes
+			u64 bytes_in_flight;      //!< staged and not known to be consumed by the GPU yet
+			u64 peak_bytes_in_flight; //!< highest `bytes_in_flight` seen
+			u64 total_bytes;          //!< staged since creation
+			size_t allocations_nb;    //!< ranges staged since creation
+			size_t fences_nb;         //!< fences inserted since creation
+			size_t waits_nb;          //!< allocations which had to wait for the GPU
+			double total_wait_ms;     //!< time spent waiting for the GPU
+			double max_wait_ms;       //!< longest single wait
+			size_t fallbacks_nb;      //!< uploads done from client memory instead
+		};
+
+		//! \brief Callback filling in a staged range.
+		using fill_function = std::function<void (u8* destination)>;
+
+		//! \brief Set the size of the ring; its buffer object is only
+		//!        created on first use.
+		explicit staging_ring(size_t capacity = 32u * 1024u * 1024u);
+
+		//! \brief Delete the buffer object; see `release()`.
+		~staging_ring();
+
+		staging_ring(staging_ring const&) = delete;
+		staging_ring& operator=(staging_ring const&) = delete;
+
+		//! \brief Ring shared by the whole process, to be used from the
+		//!        thread owning the GL context only.
+		static staging_ring& shared();
+
+		//! \brief Wait for the GPU to be done with the ring, and delete
+		//!        its buffer object and fences; they are created again if
+		//!        the ring gets used afterwards.
+		//!
+		//! Called by `bonobo::deinit()`, while the context still exists.
+		void release();
+
+		//! \brief Copy data into a range of the ring.
+		//!
+		//! The range stays valid until the next call to `stage()` or one
+		//! of the upload functions, which may reclaim it: the commands
+		//! reading it must be issued before then.
+		//!
+		//! @param [in] size how many bytes to stage
+		//! @param [in] fill writes the `size` bytes to stage
+		//! @param [out] offset where the range starts in `get_buffer()`
+		//! @return whether the data could be staged; if not, `fill` was
+		//!         not called
+		bool stage(size_t size, fill_function const& fill, GLintptr& offset);
+		bool stage(void const* data, size_t size, GLintptr& offset);
+
+		//! \brief OpenGL name of the ring buffer object.
+		GLuint get_buffer();
+
+		//! \brief Fill in part of the buffer object bound to `target`,
+		//!        whose storage must already be allocated.
+		//!
+		//! @param [in] target binding point of the destination, other than
+		//!             GL_COPY_READ_BUFFER which is used for the ring
+		//! @param [in] offset in bytes into the destination
+		//! @param [in] size how many bytes to write
+		//! @param [in] fill writes the `size` bytes to upload
+		void upload_buffer(GLenum target, GLintptr offset, size_t size, fill_function const& fill);
+		void upload_buffer(GLenum target, GLintptr offset, void const* data, size_t size);
+
+		//! \brief Run a `glTex*Image*()` call sourcing its texels from the
+		//!        ring.
+		//!
+		//! @param [in] size how many bytes of texels to stage
+		//! @param [in] fill writes the `size` bytes of texels
+		//! @param [in] upload issues the actual call, using the given
+		//!             pointer as its data argument: an offset into the
+		//!             ring, bound as the pixel unpack buffer, or client
+		//!             memory on fallbacks
+		void upload_pixels(size_t size, fill_function const& fill, std::function<void (GLvoid const* pixels)> const& upload);
+		void upload_pixels(void const* data, size_t size, std::function<void (GLvoid const* pixels)> const& upload);
+
+		//! \brief Mark the end of a batch of staged ranges, which will be
+		//!        recycled once the GPU has executed all commands issued
+		//!        so far.
+		void fence();
+
+		//! \brief Get the current usage of the ring.
+		statistics get_statistics() const;
+
+		//! \brief Log the current usage of the ring.
+		void log_statistics() const;
+
+	private:
+		struct fenced_range {
+			GLsync fence;
+			u64 end; //!< position right after the last byte covered by the fence
+		};
+
+		bool reserve(size_t size, u64& position);
+		void reclaim();
+		void wait_oldest();
+
+		size_t _capacity;
+		GLuint _buffer;
+		// Positions grow monotonically, a position p lying at offset
+		// p % _capacity in the ring; [_tail, _head) is in flight, of
+		// which [_tail, _fenced_end) is covered by `_fences`.
+		u64 _head;
+		u64 _tail;
+		u64 _fenced_end;
+		std::deque<fenced_range> _fences;
+		statistics _stats;
+	};
+}
@@ -0,0 +1,195 @@
+#include "texture_arrays.hpp"
+
+#include "core/Log.h"
+#include "core/resource_registry.hpp"
+
+#include <algorithm>
+#include <set>
+
+namespace
+{
+	//! \brief Size in bytes of one level of the bound 2D-texture, as
+	//!        copied into an array.
+	GLint getLevelSize(GLint level, GLboolean compressed, GLsizei width, GLsizei height)
+	{
+		if (compressed == GL_FALSE)
+			return 4 * width * height;
+		GLint size = 0;
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+		return size;
+	}
+}
+
+bonobo::texture_arrays::~texture_arrays()
+{
+	clear();
+}
+
+std::vector<bonobo::texture_arrays::material_layers>
+bonobo::texture_arrays::pack(std::vector<mesh_data> const& objects)
+{
+	auto names = std::set<std::string>();
+	auto textures = std::set<GLuint>();
+	for (auto const& object : objects) {
+		for (auto const& binding : object.bindings) {
+			names.insert(binding.first);
+			if (binding.second != 0u && _locations.find(binding.second) == _locations.end())
+				textures.insert(binding.second);
+		}
+	}
+
+	// Group the new textures by format; textures still streaming in, i.e.
+	// whose base level is not 0 yet, are left out until a later call.
+	auto groups = std::map<texture_format, std::vector<GLuint>>();
+	size_t streaming_nb = 0u;
+	for (auto const texture : textures) {
+		glBindTexture(GL_TEXTURE_2D, texture);
+		GLint base_level = 0, max_level = 0, width = 0, height = 0, internal_format = 0, compressed = GL_FALSE;
+		glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, &base_level);
+		glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, &max_level);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &internal_format);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED, &compressed);
+		auto const supported = compressed == GL_TRUE || internal_format == GL_RGBA8 || internal_format == GL_RGBA;
+		if (base_level != 0) {
+			++streaming_nb;
+			continue;
+		}
+		if (width == 0 || height == 0 || !supported) {
+			_locations.emplace(texture, location{ 0u, -1 });
+			++_stats.skipped_nb;
+			continue;
+		}
+
+		GLint levels_nb = 1;
+		while (levels_nb <= max_level) {
+			GLint level_width = 0;
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, levels_nb, GL_TEXTURE_WIDTH, &level_width);
+			if (level_width == 0)
+				break;
+			++levels_nb;
+		}
+		auto const format = compressed == GL_TRUE ? static_cast<GLenum>(internal_format) : GL_RGBA8;
+		groups[texture_format(width, height, format, levels_nb)].push_back(texture);
+	}
+
+	GLuint pixel_buffer = 0u;
+	GLsizeiptr pixel_buffer_size = 0;
+	glGenBuffers(1, &pixel_buffer);
+
+	for (auto const& group : groups) {
+		auto const width = std::get<0>(group.first), height = std::get<1>(group.first);
+		auto const format = std::get<2>(group.first);
+		auto const levels_nb = std::get<3>(group.first);
+		auto const compressed = format != GL_RGBA8 ? GL_TRUE : GL_FALSE;
+		auto const layers_nb = static_cast<GLsizei>(group.second.size());
+
+		// Allocate all levels, with the sizes of the first texture as the
+		// whole group shares them.
+		GLuint array = 0u;
+		glGenTextures(1, &array);
+		glBindTexture(GL_TEXTURE_2D, group.second.front());
+		glBindTexture(GL_TEXTURE_2D_ARRAY, array);
+		u64 array_bytes = 0u;
+		for (GLint level = 0; level < levels_nb; ++level) {
+			auto const level_width = std::max(width >> level, 1), level_height = std::max(height >> level, 1);
+			auto const size = getLevelSize(level, compressed, level_width, level_height);
+			if (compressed == GL_TRUE)
+				glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, format, level_width, level_height, layers_nb, 0,
+				                       size * layers_nb, nullptr);
+			else
+				glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, level_width, level_height, layers_nb, 0,
+				             GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+			array_bytes += static_cast<u64>(size) * static_cast<u64>(layers_nb);
+		}
+		resource_registry::track(resource_registry::kind::texture, array, array_bytes,
+		                         (compressed == GL_TRUE ? "compressed array" : "RGBA8 array"),
+		                         std::to_string(layers_nb) + " layers", RESOURCE_SITE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels_nb - 1);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, levels_nb > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+		// Copy each level through the pixel buffer, without a round trip
+		// to the CPU.
+		for (GLsizei layer = 0; layer < layers_nb; ++layer) {
+			auto const texture = group.second[static_cast<size_t>(layer)];
+			glBindTexture(GL_TEXTURE_2D, texture);
+			for (GLint level = 0; level < levels_nb; ++level) {
+				auto const level_width = std::max(width >> level, 1), level_height = std::max(height >> level, 1);
+				auto const size = getLevelSize(level, compressed, level_width, level_height);
+				glBindBuffer(GL_PIXEL_PACK_BUFFER, pixel_buffer);
+				if (size > pixel_buffer_size) {
+					pixel_buffer_size = size;
+					glBufferData(GL_PIXEL_PACK_BUFFER, pixel_buffer_size, nullptr, GL_STREAM_COPY);
+				}
+				if (compressed == GL_TRUE)
+					glGetCompressedTexImage(GL_TEXTURE_2D, level, nullptr);
+				else
+					glGetTexImage(GL_TEXTURE_2D, level, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+				glBindBuffer(GL_PIXEL_PACK_BUFFER, 0u);
+
+				glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixel_buffer);
+				if (compressed == GL_TRUE)
+					glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, level_width, level_height, 1,
+					                          format, size, nullptr);
+				else
+					glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, level_width, level_height, 1,
+					                GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+				glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0u);
+			}
+			_locations.emplace(texture, location{ array, static_cast<GLint>(layer) });
+		}
+
+		_arrays.push_back(array);
+		_stats.bytes += array_bytes;
+		++_stats.arrays_nb;
+		_stats.layers_nb += group.second.size();
+	}
+
+	glDeleteBuffers(1, &pixel_buffer);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0u);
+	glBindTexture(GL_TEXTURE_2D, 0u);
+
+	auto layers = std::vector<material_layers>(objects.size());
+	for (size_t i = 0u; i < objects.size(); ++i) {
+		layers[i].reserve(names.size());
+		for (auto const& name : names) {
+			auto const binding = objects[i].bindings.find(name);
+			auto const found = binding != objects[i].bindings.end() ? _locations.find(binding->second) : _locations.end();
+			if (found != _locations.end())
+				layers[i].push_back(layer_binding{ name, found->second.texture, found->second.layer });
+			else
+				layers[i].push_back(layer_binding{ name, 0u, -1 });
+		}
+	}
+
+	if (!textures.empty())
+		log_statistics();
+	if (streaming_nb != 0u)
+		LogWarning("Texture arrays: %u textures left out, as not fully streamed in yet", static_cast<unsigned int>(streaming_nb));
+	return layers;
+}
+
+void
+bonobo::texture_arrays::clear()
+{
+	if (!_arrays.empty())
+		glDeleteTextures(static_cast<GLsizei>(_arrays.size()), _arrays.data());
+	for (auto const array : _arrays)
+		resource_registry::untrack(resource_registry::kind::texture, array);
+	_arrays.clear();
+	_locations.clear();
+	_stats = {};
+}
+
+void
+bonobo::texture_arrays::log_statistics() const
+{
+	LogInfo("Texture arrays: %u textures packed into %u arrays, %.2f MiB",
+	        static_cast<unsigned int>(_stats.layers_nb), static_cast<unsigned int>(_stats.arrays_nb),
+	        _stats.bytes / (1024.0 * 1024.0));
+	if (_stats.skipped_nb != 0u)
+		LogWarning("Texture arrays: %u textures left out, as of an unsupported format",
+		           static_cast<unsigned int>(_stats.skipped_nb));
+}
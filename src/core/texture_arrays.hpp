@@ -0,0 +1,91 @@
+#pragma once
+
+#include "core/helpers.hpp"
+#include "core/Types.h"
+
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace bonobo
+{
+	//! \brief Packs the textures of many materials into a few
+	//!        GL_TEXTURE_2D_ARRAY textures.
+	//!
+	//! Textures sharing the same dimensions, internal format and number of
+	//! mipmap levels become layers of the same array, so that materials
+	//! only differ by the layers they sample: draws grouped by array can
+	//! then run without rebinding any texture, see
+	//! `Node::begin_texture_batch()`. Shaders sample a `sampler2DArray`
+	//! per binding, along with an `int` uniform holding the layer, named
+	//! after the binding with a `_layer` suffix.
+	//!
+	//! Layers are copied on the GPU, through a pixel buffer, from the
+	//! original textures, which stay untouched; these must be fully
+	//! streamed in beforehand. Only RGBA8 and block-compressed textures
+	//! are packed.
+	class texture_arrays
+	{
+	public:
+		//! \brief Where a material finds one of its textures.
+		struct layer_binding {
+			std::string name; //!< sampler name used in GLSL, e.g. `diffuse_texture`
+			GLuint texture;   //!< array texture, or 0 if the material has no such texture
+			GLint layer;      //!< -1 if the material has no such texture
+		};
+
+		//! \brief All the bindings of a material, sorted by name, with
+		//!        one entry per binding name found in the packed objects,
+		//!        so that every material uses the same texture units.
+		using material_layers = std::vector<layer_binding>;
+
+		//! \brief Usage of the arrays.
+		struct statistics {
+			size_t arrays_nb;   //!< array textures created
+			size_t layers_nb;   //!< textures packed into them
+			size_t skipped_nb;  //!< textures left out, as of an unsupported format
+			u64 bytes;          //!< memory used by the arrays
+		};
+
+		texture_arrays() = default;
+
+		//! \brief Delete all arrays.
+		~texture_arrays();
+
+		texture_arrays(texture_arrays const&) = delete;
+		texture_arrays& operator=(texture_arrays const&) = delete;
+
+		//! \brief Pack the textures bound to a set of objects.
+		//!
+		//! Textures packed by a previous call are reused as is; the
+		//! others go into new arrays. Textures not fully streamed in yet
+		//! are left out, and get packed by a later call.
+		//!
+		//! @param [in] objects whose `bindings` to pack
+		//! @return the layers of each object, in the same order
+		std::vector<material_layers> pack(std::vector<mesh_data> const& objects);
+
+		//! \brief Delete all arrays; layers handed out become invalid.
+		void clear();
+
+		//! \brief Get the current usage of the arrays.
+		statistics get_statistics() const { return _stats; }
+
+		//! \brief Log the current usage of the arrays.
+		void log_statistics() const;
+
+	private:
+		//! \brief Dimensions, internal format and number of levels.
+		using texture_format = std::tuple<GLsizei, GLsizei, GLenum, GLint>;
+
+		struct location {
+			GLuint texture;
+			GLint layer;
+		};
+
+		std::vector<GLuint> _arrays;
+		std::map<GLuint, location> _locations; // original texture -> layer
+		statistics _stats = {};
+	};
+}
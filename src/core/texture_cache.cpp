@@ -0,0 +1,293 @@
+#include "texture_cache.hpp"
+
+#include "core/mesh_cache.hpp"
+#include "core/Misc.h"
+#include "core/thread_pool.hpp"
+#include "core/vfs.hpp"
+#include "external/lodepng.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <future>
+
+namespace
+{
+	u32 const magic = 0x58544342u; // "BCTX" when read as little-endian bytes
+	u32 const version = 2u; // 2: levels generated by `mipmaps`, RGBA8 chains
+	size_t const data_alignment = 16u;
+	u32 const max_levels_nb = 32u;
+
+	// Part of the key of the caches: changing it re-bakes them.
+	bonobo::mipmaps::options const mipmap_options = { bonobo::mipmaps::filter::kaiser, false };
+
+	u32 const flag_flipped = 1u << 0;
+	u32 const flag_kaiser  = 1u << 1;
+	u32 const flag_srgb    = 1u << 2;
+
+	struct header {
+		u32 magic;
+		u32 version;
+		u64 source_hash;
+		u32 format;
+		u32 flags;
+		u32 width;
+		u32 height;
+		u32 levels_nb;
+		u32 reserved;
+		u64 file_size;
+	};
+
+	struct level_entry {
+		u32 width;
+		u32 height;
+		u64 offset;
+		u64 size;
+	};
+
+	u32 makeFlags(bool flipped, bonobo::mipmaps::options const& mip_options)
+	{
+		return (flipped ? flag_flipped : 0u)
+		     | (mip_options.kernel == bonobo::mipmaps::filter::kaiser ? flag_kaiser : 0u)
+		     | (mip_options.srgb ? flag_srgb : 0u);
+	}
+
+	size_t align(size_t offset)
+	{
+		return (offset + data_alignment - 1u) & ~(data_alignment - 1u);
+	}
+
+	std::string getFaceCachePath(std::string const& image_path, u32 face)
+	{
+		static char const* const face_names[bonobo::cubemaps::faces_nb] = { "posx", "negx", "posy", "negy", "posz", "negz" };
+		return bonobo::texture_cache::getCachePath(image_path + "." + face_names[face]);
+	}
+}
+
+std::string
+bonobo::texture_cache::getCachePath(std::string const& image_path)
+{
+	return image_path + ".bctex";
+}
+
+bool
+bonobo::texture_cache::reader::open(std::string const& cache_path, u64 source_hash, bool flipped,
+                                    mipmaps::options const& mip_options)
+{
+	_levels.clear();
+	if (!_file.open(cache_path))
+		return false;
+
+	auto const data = _file.data();
+	auto const size = _file.size();
+
+	header file_header;
+	if (size < sizeof(file_header)) {
+		_file.close();
+		return false;
+	}
+	std::memcpy(&file_header, data, sizeof(file_header));
+	if (file_header.magic != magic
+	 || file_header.version != version
+	 || file_header.source_hash != source_hash
+	 || file_header.flags != makeFlags(flipped, mip_options)
+	 || file_header.format > static_cast<u32>(block_compression::format::rgba8)
+	 || file_header.levels_nb == 0u || file_header.levels_nb > max_levels_nb
+	 || file_header.file_size != size
+	 || sizeof(file_header) + file_header.levels_nb * sizeof(level_entry) > size) {
+		_file.close();
+		return false;
+	}
+	_format = static_cast<block_compression::format>(file_header.format);
+
+	for (u32 i = 0u; i < file_header.levels_nb; ++i) {
+		level_entry entry;
+		std::memcpy(&entry, data + sizeof(file_header) + i * sizeof(level_entry), sizeof(entry));
+		if (entry.offset % 4u != 0u || entry.offset > size || entry.size > size - entry.offset
+		 || entry.size != block_compression::getLevelSize(_format, entry.width, entry.height)) {
+			_file.close();
+			_levels.clear();
+			return false;
+		}
+		block_compression::level_layout const level = { entry.width, entry.height,
+		                                                 static_cast<size_t>(entry.offset), static_cast<size_t>(entry.size) };
+		_levels.push_back(level);
+	}
+	if (_levels.front().width != file_header.width || _levels.front().height != file_header.height) {
+		_file.close();
+		_levels.clear();
+		return false;
+	}
+
+	return true;
+}
+
+bool
+bonobo::texture_cache::write(std::string const& cache_path, u64 source_hash, bool flipped,
+                             mipmaps::options const& mip_options, block_compression::compressed_image const& image)
+{
+	if (image.levels.empty() || image.levels.size() > max_levels_nb)
+		return false;
+
+	auto const data_offset = align(sizeof(header) + image.levels.size() * sizeof(level_entry));
+
+	header file_header;
+	file_header.magic = magic;
+	file_header.version = version;
+	file_header.source_hash = source_hash;
+	file_header.format = static_cast<u32>(image.fmt);
+	file_header.flags = makeFlags(flipped, mip_options);
+	file_header.width = image.width;
+	file_header.height = image.height;
+	file_header.levels_nb = static_cast<u32>(image.levels.size());
+	file_header.reserved = 0u;
+	file_header.file_size = data_offset + image.data.size();
+
+	auto const temporary_path = cache_path + ".tmp";
+	{
+		std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+			return false;
+
+		file.write(reinterpret_cast<char const*>(&file_header), sizeof(file_header));
+		for (auto const& level : image.levels) {
+			// Levels are stored back to back, so they are only aligned on
+			// 4 bytes, the smallest level size.
+			level_entry const entry = { level.width, level.height, data_offset + level.offset, level.size };
+			file.write(reinterpret_cast<char const*>(&entry), sizeof(entry));
+		}
+		static char const zeroes[data_alignment] = {};
+		file.write(zeroes, static_cast<std::streamsize>(data_offset - sizeof(file_header) - image.levels.size() * sizeof(level_entry)));
+		file.write(reinterpret_cast<char const*>(image.data.data()), static_cast<std::streamsize>(image.data.size()));
+
+		if (!file.good()) {
+			file.close();
+			std::remove(temporary_path.c_str());
+			return false;
+		}
+	}
+
+	// std::rename() does not replace existing files on every platform.
+	std::remove(cache_path.c_str());
+	if (std::rename(temporary_path.c_str(), cache_path.c_str()) != 0) {
+		std::remove(temporary_path.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+// The cache file is keyed by the content of the image file, which has to
+// be read anyway on cold starts, and is cheap to hash compared to
+// decoding it.
+unsigned int
+bonobo::texture_cache::load(std::string const& path, bool flip, bool compress, thread_pool* pool, loaded_image& image)
+{
+	mapped_file file;
+	if (!file.open(path))
+		return 78u; // lodepng's "failed to open file for reading"
+
+	auto const source_hash = mesh_cache::hash(file.data(), file.size());
+	auto const cache_path = getCachePath(path);
+	if (image.cached.open(cache_path, source_hash, flip, mipmap_options)) {
+		auto const is_compressed = image.cached.format() != block_compression::format::rgba8;
+		if (is_compressed == compress) {
+			image.from_cache = true;
+			image.width = image.cached.width();
+			image.height = image.cached.height();
+			return 0u;
+		}
+	}
+
+	auto const decode_start = StartTimer();
+	unsigned char* pixels = nullptr;
+	unsigned int width = 0u, height = 0u;
+	auto const error = lodepng_decode_memory(&pixels, &width, &height, file.data(), file.size(), LCT_RGBA, 8u);
+	image.decode_ns = EndTimerNanoseconds(decode_start);
+	if (error != 0u) {
+		std::free(pixels);
+		return error;
+	}
+	image.width = width;
+	image.height = height;
+
+	// Rows are read bottom-up rather than flipped into another buffer.
+	auto const row_size = static_cast<std::ptrdiff_t>(width) * 4;
+	auto const first_row = pixels + (flip ? (height - 1u) * row_size : 0);
+	auto const encode_start = StartTimer();
+	auto const fmt = compress ? block_compression::chooseFormat(pixels, width, height) : block_compression::format::rgba8;
+	image.baked = block_compression::compress(first_row, width, height, flip ? -row_size : row_size,
+	                                          fmt, mipmap_options, pool, compress ? &image.psnr : nullptr);
+	image.encode_ns = EndTimerNanoseconds(encode_start);
+	std::free(pixels);
+	image.cache_writable = !vfs::isPacked(path);
+	image.cache_written = image.cache_writable && write(cache_path, source_hash, flip, mipmap_options, image.baked);
+
+	return 0u;
+}
+
+unsigned int
+bonobo::texture_cache::loadCubeMapFaces(std::string const& path, bool compress, thread_pool* pool,
+                                        std::array<loaded_image, cubemaps::faces_nb>& faces)
+{
+	mapped_file file;
+	if (!file.open(path))
+		return 78u; // lodepng's "failed to open file for reading"
+
+	auto const source_hash = mesh_cache::hash(file.data(), file.size());
+	bool all_cached = true;
+	for (u32 i = 0u; i < cubemaps::faces_nb && all_cached; ++i) {
+		auto& face = faces[i];
+		all_cached = face.cached.open(getFaceCachePath(path, i), source_hash, false, mipmap_options)
+		          && (face.cached.format() != block_compression::format::rgba8) == compress;
+		face.width = face.cached.width();
+		face.height = face.cached.height();
+	}
+	for (auto& face : faces)
+		face.from_cache = all_cached;
+	if (all_cached)
+		return 0u;
+
+	auto const decode_start = StartTimer();
+	unsigned char* pixels = nullptr;
+	unsigned int width = 0u, height = 0u;
+	auto const error = lodepng_decode_memory(&pixels, &width, &height, file.data(), file.size(), LCT_RGBA, 8u);
+	faces[0].decode_ns = EndTimerNanoseconds(decode_start);
+	if (error != 0u) {
+		std::free(pixels);
+		return error;
+	}
+
+	// Faces are independent from one another, so each one is resampled
+	// and encoded on its own worker.
+	auto const face_size = cubemaps::getFaceSize(width);
+	auto const writable = !vfs::isPacked(path);
+	auto const bake_face = [&](u32 i){
+		auto& face = faces[i];
+		auto const encode_start = StartTimer();
+		auto rgba = std::vector<u8>(static_cast<size_t>(face_size) * face_size * 4u);
+		cubemaps::generateFace(pixels, width, height, static_cast<std::ptrdiff_t>(width) * 4, i, face_size, rgba.data());
+		auto const fmt = compress ? block_compression::chooseFormat(rgba.data(), face_size, face_size) : block_compression::format::rgba8;
+		face.baked = block_compression::compress(rgba.data(), face_size, face_size, static_cast<std::ptrdiff_t>(face_size) * 4,
+		                                         fmt, mipmap_options, nullptr, compress ? &face.psnr : nullptr);
+		face.encode_ns = EndTimerNanoseconds(encode_start);
+		face.width = face.height = face_size;
+		face.cache_writable = writable;
+		face.cache_written = writable && write(getFaceCachePath(path, i), source_hash, false, mipmap_options, face.baked);
+	};
+	if (pool != nullptr) {
+		std::vector<std::future<void>> tasks;
+		tasks.reserve(cubemaps::faces_nb);
+		for (u32 i = 0u; i < cubemaps::faces_nb; ++i)
+			tasks.push_back(pool->submit([&bake_face, i](){ bake_face(i); }));
+		for (auto& task : tasks)
+			task.wait();
+	} else {
+		for (u32 i = 0u; i < cubemaps::faces_nb; ++i)
+			bake_face(i);
+	}
+	std::free(pixels);
+
+	return 0u;
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include "core/block_compression.hpp"
+#include "core/cubemap_generator.hpp"
+#include "core/mapped_file.hpp"
+#include "core/Types.h"
+
+#include <array>
+#include <string>
+#include <vector>
+
+namespace bonobo
+{
+	class thread_pool;
+
+	//! \brief On-disk cache of textures along with their mipmap chain.
+	//!
+	//! A cache file sits next to its source image and stores, KTX-like,
+	//! a header followed by the whole mipmap chain of the image as
+	//! produced by `block_compression::compress()`, block-compressed or
+	//! not, so that warm starts can upload it straight from a memory
+	//! mapping without decoding, filtering nor encoding anything. It is
+	//! keyed by a hash of the source image content, by whether the rows
+	//! were flipped and by the mipmap filter, and carries a format
+	//! version: a mismatch on any of those makes the cache stale.
+	namespace texture_cache
+	{
+		//! \brief Path of the cache file associated to an image file.
+		std::string getCachePath(std::string const& image_path);
+
+		//! \brief A cache file opened for reading.
+		//!
+		//! The pointer returned by `data()` points inside the memory
+		//! mapping of the cache file, and is only valid as long as the
+		//! reader is alive.
+		class reader
+		{
+		public:
+			//! \brief Map a cache file and validate it.
+			//!
+			//! @param [in] cache_path path to the cache file
+			//! @param [in] source_hash hash of the image file content, see
+			//!             `mesh_cache::hash()`
+			//! @param [in] flipped whether the rows are expected bottom-up
+			//! @param [in] mip_options how the levels are expected to have
+			//!             been generated
+			//! @return whether the cache exists, is well-formed and
+			//!         matches the current version, hash, orientation and
+			//!         filter
+			bool open(std::string const& cache_path, u64 source_hash, bool flipped, mipmaps::options const& mip_options);
+
+			block_compression::format format() const { return _format; }
+			u32 width() const { return _levels.empty() ? 0u : _levels.front().width; }
+			u32 height() const { return _levels.empty() ? 0u : _levels.front().height; }
+
+			//! \brief Mipmap levels, from the base level down; offsets
+			//!        are relative to the start of the file.
+			std::vector<block_compression::level_layout> const& levels() const { return _levels; }
+
+			//! \brief Start of the cache file.
+			u8 const* data() const { return _file.data(); }
+
+		private:
+			mapped_file _file;
+			block_compression::format _format;
+			std::vector<block_compression::level_layout> _levels;
+		};
+
+		//! \brief An image file along with its mipmap chain, read from its
+		//!        cache file or baked right away.
+		struct loaded_image {
+			reader cached;                              //!< valid if `from_cache`
+			block_compression::compressed_image baked;  //!< valid otherwise
+			bool from_cache = false;
+			bool cache_writable = true; //!< false if the image is read from a pack, whose caches have to be baked before packing
+			bool cache_written = false; //!< whether the freshly baked chain could be written to the cache
+			u32 width = 0u;
+			u32 height = 0u;
+			u64 decode_ns = 0u;         //!< time spent decoding the image file
+			u64 encode_ns = 0u;         //!< time spent generating and encoding the mipmap chain
+			double psnr = 0.0;          //!< of the base level, if baked and block-compressed
+
+			block_compression::format format() const { return from_cache ? cached.format() : baked.fmt; }
+			std::vector<block_compression::level_layout> const& levels() const { return from_cache ? cached.levels() : baked.levels; }
+			//! \brief Start of the data the level offsets are relative to.
+			u8 const* data() const { return from_cache ? cached.data() : baked.data.data(); }
+		};
+
+		//! \brief Load a PNG file through its cache.
+		//!
+		//! The mipmap chain is baked, and the cache written, when the
+		//! cache is missing, stale, or compressed differently than
+		//! requested. Caches of images read from a pack are never
+		//! written, see `vfs::isPacked()`. Safe to call from worker
+		//! threads.
+		//!
+		//! @param [in] path path to the PNG file
+		//! @param [in] flip whether to store the rows bottom-up, as
+		//!             expected by OpenGL
+		//! @param [in] compress whether to block-compress the chain, or
+		//!             store it as RGBA8
+		//! @param [in] pool see `block_compression::compress()`
+		//! @param [out] image the loaded image
+		//! @return 0 on success, a lodepng error code otherwise
+		unsigned int load(std::string const& path, bool flip, bool compress, thread_pool* pool, loaded_image& image);
+
+		//! \brief Load an equirectangular PNG file as the six faces of a
+		//!        cube map, through one cache file per face.
+		//!
+		//! The faces are resampled by `cubemaps::generateFace()` and baked,
+		//! and their caches written, when any of those caches is missing,
+		//! stale, or compressed differently than requested. The time spent
+		//! decoding the image is reported by the first face only.
+		//!
+		//! @param [in] path path to the PNG file
+		//! @param [in] compress whether to block-compress the faces
+		//! @param [in] pool if not nullptr, the faces are baked in
+		//!             parallel on its workers; must then not be called
+		//!             from one of those workers
+		//! @param [out] faces the loaded faces, in the order of the
+		//!              GL_TEXTURE_CUBE_MAP_* targets: +x, -x, +y, -y, +z, -z
+		//! @return 0 on success, a lodepng error code otherwise
+		unsigned int loadCubeMapFaces(std::string const& path, bool compress, thread_pool* pool,
+		                              std::array<loaded_image, cubemaps::faces_nb>& faces);
+
+		//! \brief Write a cache file.
+		//!
+		//! The file is first written under a temporary name and then
+		//! renamed, so that readers never see a partially written cache.
+		//!
+		//! @param [in] cache_path path to the cache file
+		//! @param [in] source_hash hash of the image file content
+		//! @param [in] flipped whether the rows were stored bottom-up
+		//! @param [in] mip_options how the levels were generated
+		//! @param [in] image mipmap chain to store
+		//! @return whether the cache file could be written
+		bool write(std::string const& cache_path, u64 source_hash, bool flipped,
+		           mipmaps::options const& mip_options, block_compression::compressed_image const& image);
+	}
+}
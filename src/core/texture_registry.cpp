@@ -0,0 +1,198 @@
+#include "texture_registry.hpp"
+
+#include "core/Log.h"
+#include "core/resource_registry.hpp"
+
+#include <list>
+#include <unordered_map>
+
+namespace
+{
+	struct entry {
+		GLuint texture;
+		u64 bytes;
+		size_t references_nb;
+		std::list<std::string>::iterator unused_position; // only valid when references_nb == 0
+	};
+
+	struct registry {
+		std::unordered_map<std::string, entry> entries;
+		std::unordered_map<GLuint, std::string> keys;
+		std::list<std::string> unused; // least recently released first
+		u64 unused_budget = 64ull * 1024ull * 1024ull;
+		bonobo::texture_registry::statistics stats = {};
+	};
+
+	// The registry is only ever accessed from the thread owning the GL
+	// context, so it does not need any locking.
+	registry& get()
+	{
+		static registry instance;
+		return instance;
+	}
+
+	void evict(registry& r, std::string const& key)
+	{
+		auto const it = r.entries.find(key);
+		if (it == r.entries.end())
+			return;
+		auto const& e = it->second;
+		glDeleteTextures(1, &e.texture);
+		bonobo::resource_registry::untrack(bonobo::resource_registry::kind::texture, e.texture);
+		r.unused.erase(e.unused_position);
+		r.keys.erase(e.texture);
+		r.stats.resident_bytes -= e.bytes;
+		r.stats.unused_bytes -= e.bytes;
+		--r.stats.unused_nb;
+		--r.stats.textures_nb;
+		++r.stats.evictions;
+		r.entries.erase(it);
+	}
+
+	void enforce_budget(registry& r)
+	{
+		while (r.stats.unused_bytes > r.unused_budget && !r.unused.empty()) {
+			auto const oldest = r.unused.front();
+			evict(r, oldest);
+		}
+	}
+}
+
+std::string
+bonobo::texture_registry::makeKey(GLenum target, std::string const& paths, bool generate_mipmap)
+{
+	return std::to_string(target) + (generate_mipmap ? ":mipmap:" : ":") + paths;
+}
+
+GLuint
+bonobo::texture_registry::acquire(std::string const& key)
+{
+	auto& r = get();
+	auto const it = r.entries.find(key);
+	if (it == r.entries.end()) {
+		++r.stats.misses;
+		return 0u;
+	}
+
+	auto& e = it->second;
+	if (e.references_nb == 0u) {
+		r.unused.erase(e.unused_position);
+		r.stats.unused_bytes -= e.bytes;
+		--r.stats.unused_nb;
+	}
+	++e.references_nb;
+	++r.stats.hits;
+	r.stats.saved_bytes += e.bytes;
+	return e.texture;
+}
+
+void
+bonobo::texture_registry::insert(std::string const& key, GLuint texture, u64 bytes)
+{
+	auto& r = get();
+	if (texture == 0u || r.entries.find(key) != r.entries.end() || r.keys.find(texture) != r.keys.end()) {
+		LogError("Texture %u can not be registered under \"%s\"", texture, key.c_str());
+		return;
+	}
+
+	entry e;
+	e.texture = texture;
+	e.bytes = bytes;
+	e.references_nb = 1u;
+	e.unused_position = r.unused.end();
+	r.entries.emplace(key, e);
+	r.keys.emplace(texture, key);
+	++r.stats.textures_nb;
+	r.stats.resident_bytes += bytes;
+}
+
+void
+bonobo::texture_registry::updateBytes(GLuint texture, u64 bytes)
+{
+	auto& r = get();
+	auto const key_it = r.keys.find(texture);
+	if (key_it == r.keys.end())
+		return;
+
+	resource_registry::resize(resource_registry::kind::texture, texture, bytes);
+	auto& e = r.entries.at(key_it->second);
+	r.stats.resident_bytes = r.stats.resident_bytes - e.bytes + bytes;
+	if (e.references_nb == 0u) {
+		r.stats.unused_bytes = r.stats.unused_bytes - e.bytes + bytes;
+		e.bytes = bytes;
+		enforce_budget(r);
+		return;
+	}
+	e.bytes = bytes;
+}
+
+bool
+bonobo::texture_registry::release(GLuint texture)
+{
+	auto& r = get();
+	auto const key_it = r.keys.find(texture);
+	if (key_it == r.keys.end())
+		return false;
+
+	auto& e = r.entries.at(key_it->second);
+	if (e.references_nb == 0u) {
+		LogWarning("Texture %u released more times than it was acquired", texture);
+		return true;
+	}
+	if (--e.references_nb == 0u) {
+		e.unused_position = r.unused.insert(r.unused.end(), key_it->second);
+		r.stats.unused_bytes += e.bytes;
+		++r.stats.unused_nb;
+		enforce_budget(r);
+	}
+	return true;
+}
+
+void
+bonobo::texture_registry::setUnusedBudget(u64 bytes)
+{
+	auto& r = get();
+	r.unused_budget = bytes;
+	enforce_budget(r);
+}
+
+void
+bonobo::texture_registry::evictUnused()
+{
+	auto& r = get();
+	while (!r.unused.empty()) {
+		auto const oldest = r.unused.front();
+		evict(r, oldest);
+	}
+}
+
+void
+bonobo::texture_registry::clear()
+{
+	auto& r = get();
+	for (auto const& e : r.entries) {
+		glDeleteTextures(1, &e.second.texture);
+		resource_registry::untrack(resource_registry::kind::texture, e.second.texture);
+	}
+	r.entries.clear();
+	r.keys.clear();
+	r.unused.clear();
+	r.stats = statistics();
+}
+
+bonobo::texture_registry::statistics
+bonobo::texture_registry::getStatistics()
+{
+	return get().stats;
+}
+
+void
+bonobo::texture_registry::logStatistics()
+{
+	auto const stats = getStatistics();
+	LogInfo("Texture registry: %u textures (%u unused) using %.2f MiB, %u hits, %u misses, %u evictions, %.2f MiB saved",
+	        static_cast<unsigned int>(stats.textures_nb), static_cast<unsigned int>(stats.unused_nb),
+	        stats.resident_bytes / (1024.0 * 1024.0),
+	        static_cast<unsigned int>(stats.hits), static_cast<unsigned int>(stats.misses),
+	        static_cast<unsigned int>(stats.evictions), stats.saved_bytes / (1024.0 * 1024.0));
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "external/glad/glad.h"
+
+#include "core/Types.h"
+
+#include <string>
+
+namespace bonobo
+{
+	//! \brief Process-wide registry of the textures loaded from files.
+	//!
+	//! Textures are keyed by their path(s) and load options, so that
+	//! loading the same file twice with the same options returns the
+	//! same OpenGL texture instead of decoding and uploading it again.
+	//! Each texture is reference counted: a texture whose count drops to
+	//! zero is kept around as unused, so that it can be picked up again
+	//! cheaply, until the unused textures exceed their memory budget; the
+	//! least recently released ones are then evicted.
+	namespace texture_registry
+	{
+		//! \brief Counters describing the registry activity.
+		struct statistics {
+			size_t hits;          //!< lookups served by an existing texture
+			size_t misses;        //!< lookups that required a load
+			size_t evictions;     //!< textures deleted after becoming unused
+			size_t textures_nb;   //!< textures currently in the registry
+			size_t unused_nb;     //!< of which are not referenced anymore
+			u64 resident_bytes;   //!< estimated memory of all registered textures
+			u64 unused_bytes;     //!< of which is used by unused textures
+			u64 saved_bytes;      //!< memory not allocated thanks to hits
+		};
+
+		//! \brief Build the key identifying a texture.
+		//!
+		//! @param [in] target OpenGL texture target, e.g. GL_TEXTURE_2D
+		//! @param [in] paths path(s) of the file(s) the texture is built
+		//!             from, separated by `|` if more than one
+		//! @param [in] generate_mipmap whether a mipmap hierarchy is built
+		std::string makeKey(GLenum target, std::string const& paths, bool generate_mipmap);
+
+		//! \brief Look up a texture and take a reference to it.
+		//!
+		//! @param [in] key as returned by `makeKey()`
+		//! @return the OpenGL name of the texture, or 0 if the registry
+		//!         does not know that key (a miss is then recorded)
+		GLuint acquire(std::string const& key);
+
+		//! \brief Register a newly loaded texture, with one reference.
+		//!
+		//! @param [in] key as returned by `makeKey()`
+		//! @param [in] texture OpenGL name of the texture
+		//! @param [in] bytes estimated memory used by the texture
+		void insert(std::string const& key, GLuint texture, u64 bytes);
+
+		//! \brief Update the memory estimate of a registered texture, e.g.
+		//!        as more of its levels get streamed in.
+		//!
+		//! @param [in] texture OpenGL name of the texture
+		//! @param [in] bytes new estimated memory used by the texture
+		void updateBytes(GLuint texture, u64 bytes);
+
+		//! \brief Drop a reference to a texture.
+		//!
+		//! @param [in] texture OpenGL name of the texture
+		//! @return whether the texture is managed by the registry
+		bool release(GLuint texture);
+
+		//! \brief Set how much memory unused textures may keep before
+		//!        being evicted; defaults to 64 MiB.
+		void setUnusedBudget(u64 bytes);
+
+		//! \brief Delete all unused textures.
+		void evictUnused();
+
+		//! \brief Delete all textures, referenced or not, and reset the
+		//!        statistics.
+		void clear();
+
+		//! \brief Get the current statistics.
+		statistics getStatistics();
+
+		//! \brief Log the current statistics.
+		void logStatistics();
+	}
+}
@@ -0,0 +1,48 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+
+bonobo::thread_pool::thread_pool(size_t threads_nb) : _workers(), _tasks(), _mutex(), _wake_up(), _stopping(false)
+{
+	if (threads_nb == 0u)
+		threads_nb = std::max(std::thread::hardware_concurrency(), 1u);
+
+	_workers.reserve(threads_nb);
+	for (size_t i = 0u; i < threads_nb; ++i)
+		_workers.emplace_back(&thread_pool::work, this);
+}
+
+bonobo::thread_pool::~thread_pool()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stopping = true;
+	}
+	_wake_up.notify_all();
+	for (auto& worker : _workers)
+		worker.join();
+}
+
+bonobo::thread_pool&
+bonobo::thread_pool::shared()
+{
+	static thread_pool pool;
+	return pool;
+}
+
+void
+bonobo::thread_pool::work()
+{
+	for (;;) {
+		std::function<void ()> task;
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_wake_up.wait(lock, [this](){ return _stopping || !_tasks.empty(); });
+			if (_tasks.empty())
+				return;
+			task = std::move(_tasks.front());
+			_tasks.pop_front();
+		}
+		task();
+	}
+}
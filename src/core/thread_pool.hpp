@@ -0,0 +1,124 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace bonobo
+{
+	//! \brief Fixed-size pool of worker threads executing submitted tasks
+	//!        in submission order.
+	//!
+	//! Tasks must not issue any OpenGL call, as the context is only
+	//! current on the main thread, nor use the `Log*()` macros, which are
+	//! not thread-safe; they should instead return their results, errors
+	//! included, to the main thread.
+	class thread_pool
+	{
+	public:
+		//! \brief Start the worker threads.
+		//!
+		//! @param [in] threads_nb how many workers to start; 0 means one
+		//!             per hardware thread
+		explicit thread_pool(size_t threads_nb = 0u);
+
+		//! \brief Finish all pending tasks and join the workers.
+		~thread_pool();
+
+		thread_pool(thread_pool const&) = delete;
+		thread_pool& operator=(thread_pool const&) = delete;
+
+		//! \brief Pool shared by the whole process, created on first use.
+		static thread_pool& shared();
+
+		//! \brief Number of worker threads.
+		size_t size() const { return _workers.size(); }
+
+		//! \brief Queue a task for execution on one of the workers.
+		//!
+		//! @param [in] task callable taking no argument
+		//! @return a future holding the value returned by the task
+		template<typename F>
+		std::future<typename std::result_of<F()>::type> submit(F&& task)
+		{
+			using result_t = typename std::result_of<F()>::type;
+			auto packaged = std::make_shared<std::packaged_task<result_t()>>(std::forward<F>(task));
+			auto future = packaged->get_future();
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_tasks.emplace_back([packaged](){ (*packaged)(); });
+			}
+			_wake_up.notify_one();
+			return future;
+		}
+
+	private:
+		void work();
+
+		std::vector<std::thread> _workers;
+		std::deque<std::function<void ()>> _tasks;
+		std::mutex _mutex;
+		std::condition_variable _wake_up;
+		bool _stopping;
+	};
+
+	//! \brief Thread-safe queue through which workers hand back results in
+	//!        the order they complete.
+	template<typename T>
+	class completion_queue
+	{
+	public:
+		//! \brief Add a result, waking up one waiting consumer.
+		void push(T value)
+		{
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_values.push_back(std::move(value));
+			}
+			_ready.notify_one();
+		}
+
+		//! \brief Remove the oldest result, waiting for one if needed.
+		T pop()
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_ready.wait(lock, [this](){ return !_values.empty(); });
+			auto value = std::move(_values.front());
+			_values.pop_front();
+			return value;
+		}
+
+		//! \brief Remove the oldest result if there is one, without
+		//!        waiting.
+		//!
+		//! @param [out] value where to move the result
+		//! @return whether a result was available
+		bool try_pop(T& value)
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (_values.empty())
+				return false;
+			value = std::move(_values.front());
+			_values.pop_front();
+			return true;
+		}
+
+		//! \brief Number of results waiting to be consumed.
+		size_t size() const
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			return _values.size();
+		}
+
+	private:
+		std::deque<T> _values;
+		mutable std::mutex _mutex;
+		std::condition_variable _ready;
+	};
+}
@@ -1,5 +1,7 @@
 #include "various.hpp"
 
+#include "core/mapped_file.hpp"
+
 #include <fstream>
 #include <iostream>
 #include <memory>
@@ -8,6 +10,13 @@
 std::string
 utils::slurp_file(std::string const& path)
 {
+  // Files are mapped rather than read, which also covers those stored in
+  // asset packs; empty files cannot be mapped though, so they fall back
+  // to a plain read.
+  bonobo::mapped_file mapping;
+  if (mapping.open(path))
+    return std::string(reinterpret_cast<char const*>(mapping.data()), mapping.size());
+
   std::ifstream file = std::ifstream(path);
   if (!file.is_open()) {
     std::cerr << "Failed to open \"" << path << "\"" << std::endl;
@@ -0,0 +1,302 @@
+#include "vfs.hpp"
+
+#include "config.hpp"
+#include "core/asset_pack.hpp"
+#include "core/Log.h"
+#include "core/Misc.h"
+
+#ifdef _WIN32
+#	include <Windows.h>
+#	include <cstdlib>
+#else
+#	include <climits>
+#	include <cstdlib>
+#	include <dirent.h>
+#	include <sys/stat.h>
+#endif
+
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace
+{
+	char const* const pack_name = "assets.pack";
+
+	//! \brief (relative path, path on disk) of the files of a directory.
+	using file_list = std::vector<std::pair<std::string, std::string>>;
+
+	//! \brief A mounted pack, along with the prefix of the paths of its
+	//!        files, i.e. the path of the pack followed by a separator.
+	struct mounted_pack {
+		std::string prefix;
+		std::shared_ptr<bonobo::asset_pack::reader const> pack;
+	};
+
+	struct file_system {
+		std::mutex mutex;
+		std::unordered_map<std::string, std::string> index; // virtual path -> path on disk
+		std::vector<mounted_pack> packs;
+		bonobo::vfs::statistics stats = {};
+		std::mutex defaults_mutex;
+		std::atomic<bool> defaults_mounted{ false };
+	};
+
+	file_system& getFileSystem()
+	{
+		static file_system instance;
+		return instance;
+	}
+
+	//! \brief List all files below a directory, recursively.
+	void listDirectory(std::string const& directory, std::string const& relative, file_list& files)
+	{
+#ifdef _WIN32
+		WIN32_FIND_DATAA entry;
+		auto const handle = FindFirstFileA((directory + "\\*").c_str(), &entry);
+		if (handle == INVALID_HANDLE_VALUE)
+			return;
+		do {
+			auto const name = std::string(entry.cFileName);
+			if (name == "." || name == "..")
+				continue;
+			auto const path = directory + "/" + name;
+			if ((entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0)
+				listDirectory(path, relative + name + "/", files);
+			else
+				files.emplace_back(relative + name, path);
+		} while (FindNextFileA(handle, &entry));
+		FindClose(handle);
+#else
+		auto const dir = opendir(directory.c_str());
+		if (dir == nullptr)
+			return;
+		while (auto const entry = readdir(dir)) {
+			auto const name = std::string(entry->d_name);
+			if (name == "." || name == "..")
+				continue;
+			auto const path = directory + "/" + name;
+			struct stat info;
+			if (stat(path.c_str(), &info) != 0)
+				continue;
+			if (S_ISDIR(info.st_mode))
+				listDirectory(path, relative + name + "/", files);
+			else if (S_ISREG(info.st_mode))
+				files.emplace_back(relative + name, path);
+		}
+		closedir(dir);
+#endif
+	}
+
+	//! \brief Absolute path of an existing directory, or an empty string.
+	std::string getAbsolutePath(std::string const& directory)
+	{
+#ifdef _WIN32
+		char buffer[MAX_PATH];
+		return _fullpath(buffer, directory.c_str(), MAX_PATH) != nullptr ? std::string(buffer) : std::string();
+#else
+		char buffer[PATH_MAX];
+		return realpath(directory.c_str(), buffer) != nullptr ? std::string(buffer) : std::string();
+#endif
+	}
+}
+
+void
+bonobo::vfs::mountDefaults()
+{
+	auto& fs = getFileSystem();
+	std::lock_guard<std::mutex> lock(fs.defaults_mutex);
+	if (fs.defaults_mounted)
+		return;
+
+	// The working directory, when different from the source tree, comes
+	// on top of it: this keeps the precedence of the former lookups,
+	// which first tried the working directory.
+	std::string const root = config::root_dir;
+	auto const overlay = getAbsolutePath(".") != getAbsolutePath(root);
+	mountPack(root + "/" + pack_name);
+	if (overlay)
+		mountPack(std::string("./") + pack_name);
+	for (auto const folder : { "shaders", "res" }) {
+		mountDirectory(root + "/" + folder, folder);
+		if (overlay)
+			mountDirectory(std::string("./") + folder, folder);
+	}
+	fs.defaults_mounted = true;
+}
+
+size_t
+bonobo::vfs::mountDirectory(std::string const& directory, std::string const& prefix)
+{
+	// Scan without holding the lock, so that lookups can go on meanwhile.
+	auto const scan_start = StartTimer();
+	file_list files;
+	listDirectory(directory, "", files);
+	auto const scan_ms = EndTimerSeconds(scan_start) * 1000.0;
+
+	auto const base = prefix.empty() ? std::string() : normalise(prefix) + "/";
+	auto& fs = getFileSystem();
+	std::lock_guard<std::mutex> lock(fs.mutex);
+	for (auto& file : files) {
+		auto const inserted = fs.index.emplace(base + file.first, std::string());
+		if (!inserted.second)
+			++fs.stats.shadowed_nb;
+		inserted.first->second = std::move(file.second);
+	}
+	++fs.stats.mounts_nb;
+	fs.stats.files_nb = fs.index.size();
+	fs.stats.scan_ms += scan_ms;
+	return files.size();
+}
+
+size_t
+bonobo::vfs::mountPack(std::string const& pack_path)
+{
+	// Opening the pack maps it through `mapped_file`, which looks the
+	// mounted packs up: this has to happen without holding the lock.
+	auto const scan_start = StartTimer();
+	auto pack = std::make_shared<asset_pack::reader>();
+	if (!pack->open(pack_path))
+		return 0u;
+	auto const paths = pack->get_paths();
+	auto const scan_ms = EndTimerSeconds(scan_start) * 1000.0;
+
+	auto const prefix = pack_path + "/";
+	auto& fs = getFileSystem();
+	std::lock_guard<std::mutex> lock(fs.mutex);
+	for (auto const& path : paths) {
+		auto const inserted = fs.index.emplace(path, std::string());
+		if (!inserted.second)
+			++fs.stats.shadowed_nb;
+		inserted.first->second = prefix + path;
+	}
+	fs.packs.push_back({ prefix, std::move(pack) });
+	++fs.stats.mounts_nb;
+	++fs.stats.packs_nb;
+	fs.stats.files_nb = fs.index.size();
+	fs.stats.scan_ms += scan_ms;
+	return paths.size();
+}
+
+std::shared_ptr<bonobo::asset_pack::reader const>
+bonobo::vfs::findPack(std::string const& real_path, std::string& entry_path)
+{
+	auto& fs = getFileSystem();
+	std::lock_guard<std::mutex> lock(fs.mutex);
+	for (auto it = fs.packs.rbegin(); it != fs.packs.rend(); ++it) {
+		if (real_path.compare(0u, it->prefix.size(), it->prefix) != 0)
+			continue;
+		entry_path = normalise(real_path.substr(it->prefix.size()));
+		return it->pack;
+	}
+	return nullptr;
+}
+
+bool
+bonobo::vfs::isPacked(std::string const& real_path)
+{
+	std::string entry_path;
+	return findPack(real_path, entry_path) != nullptr;
+}
+
+std::vector<std::string>
+bonobo::vfs::listFiles(std::string const& directory)
+{
+	file_list files;
+	listDirectory(directory, "", files);
+	std::vector<std::string> paths;
+	paths.reserve(files.size());
+	for (auto& file : files)
+		paths.push_back(std::move(file.first));
+	return paths;
+}
+
+std::string
+bonobo::vfs::normalise(std::string const& virtual_path)
+{
+	std::vector<std::string> components;
+	size_t start = 0u;
+	while (start <= virtual_path.size()) {
+		auto end = virtual_path.find_first_of("/\\", start);
+		if (end == std::string::npos)
+			end = virtual_path.size();
+		auto const component = virtual_path.substr(start, end - start);
+		if (component == "..") {
+			if (!components.empty() && components.back() != "..")
+				components.pop_back();
+			else
+				components.push_back(component);
+		} else if (!component.empty() && component != ".") {
+			components.push_back(component);
+		}
+		start = end + 1u;
+	}
+
+	std::string path;
+	for (auto const& component : components) {
+		if (!path.empty())
+			path += '/';
+		path += component;
+	}
+	return path;
+}
+
+bool
+bonobo::vfs::resolve(std::string const& virtual_path, std::string& real_path)
+{
+	auto& fs = getFileSystem();
+	if (!fs.defaults_mounted)
+		mountDefaults();
+
+	auto const key = normalise(virtual_path);
+	std::lock_guard<std::mutex> lock(fs.mutex);
+	++fs.stats.lookups_nb;
+	auto const it = fs.index.find(key);
+	if (it == fs.index.end()) {
+		++fs.stats.misses_nb;
+		return false;
+	}
+	real_path = it->second;
+	return true;
+}
+
+std::string
+bonobo::vfs::resolve(std::string const& virtual_path)
+{
+	std::string real_path;
+	if (resolve(virtual_path, real_path))
+		return real_path;
+	return std::string(config::root_dir) + "/" + virtual_path;
+}
+
+void
+bonobo::vfs::clear()
+{
+	auto& fs = getFileSystem();
+	std::lock_guard<std::mutex> defaults_lock(fs.defaults_mutex);
+	std::lock_guard<std::mutex> lock(fs.mutex);
+	fs.index.clear();
+	fs.packs.clear();
+	fs.stats = {};
+	fs.defaults_mounted = false;
+}
+
+bonobo::vfs::statistics
+bonobo::vfs::getStatistics()
+{
+	auto& fs = getFileSystem();
+	std::lock_guard<std::mutex> lock(fs.mutex);
+	return fs.stats;
+}
+
+void
+bonobo::vfs::logStatistics()
+{
+	auto const stats = getStatistics();
+	LogInfo("Virtual file system: %u files (%u shadowed) from %u mount points (%u packs), scanned in %.2f ms; %u lookups, %u misses",
+	        static_cast<unsigned int>(stats.files_nb), static_cast<unsigned int>(stats.shadowed_nb),
+	        static_cast<unsigned int>(stats.mounts_nb), static_cast<unsigned int>(stats.packs_nb), stats.scan_ms,
+	        static_cast<unsigned int>(stats.lookups_nb), static_cast<unsigned int>(stats.misses_nb));
+}
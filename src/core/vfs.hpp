@@ -0,0 +1,120 @@
+#pragma once
+
+#include "core/Types.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace bonobo
+{
+	namespace asset_pack { class reader; }
+
+	//! \brief Virtual file system resolving the paths of shaders and
+	//!        resources.
+	//!
+	//! Mount points are scanned once, when mounted, into an in-memory
+	//! index mapping virtual paths, e.g. `res/textures/waves.png`, to
+	//! files on disk; resolving a path is then a hash table lookup,
+	//! without any filesystem access. Mount points stack: a file found
+	//! under several of them resolves to the most recently mounted one,
+	//! so that an overlay directory can shadow some of the files of the
+	//! ones below.
+	//!
+	//! Asset packs can be mounted as well: their files resolve to paths
+	//! made of the path of the pack followed by their virtual path, which
+	//! `bonobo::mapped_file` recognises to read them from the pack.
+	//!
+	//! By default, an `assets.pack` found in the source tree or in the
+	//! working directory is mounted first, then the `shaders` and `res`
+	//! folders of the source tree, overlaid by those of the working
+	//! directory if any: loose files thus take precedence over packed ones,
+	//! so that edited shaders can still be reloaded. This happens on first
+	//! use, or from `bonobo::init()`. All functions can be called from any
+	//! thread, but only `logStatistics()` logs.
+	namespace vfs
+	{
+		//! \brief Counters describing the file system activity.
+		struct statistics {
+			size_t mounts_nb;   //!< mount points
+			size_t packs_nb;    //!< of which asset packs
+			size_t files_nb;    //!< distinct virtual paths in the index
+			size_t shadowed_nb; //!< files hidden by a later mount point
+			size_t lookups_nb;  //!< calls to `resolve()`
+			size_t misses_nb;   //!< of which found no file in the index
+			double scan_ms;     //!< time spent scanning mount points
+		};
+
+		//! \brief Mount the default directories, unless already done.
+		void mountDefaults();
+
+		//! \brief Mount a directory.
+		//!
+		//! @param [in] directory path to the directory on disk, whose
+		//!             subdirectories get scanned as well
+		//! @param [in] prefix virtual path of the directory, e.g. `res`
+		//! @return how many files were found, 0 if the directory does
+		//!         not exist
+		size_t mountDirectory(std::string const& directory, std::string const& prefix);
+
+		//! \brief Mount an asset pack.
+		//!
+		//! @param [in] pack_path path to the pack on disk
+		//! @return how many files the pack holds, 0 if it does not
+		//!         exist or is not a valid pack
+		size_t mountPack(std::string const& pack_path);
+
+		//! \brief Find the mounted pack holding a file.
+		//!
+		//! @param [in] real_path path as returned by `resolve()`
+		//! @param [out] entry_path virtual path of the file within the
+		//!              pack, if found
+		//! @return the pack, or nullptr if the path does not point into
+		//!         any mounted pack; the pack stays valid as long as
+		//!         the pointer is held, even once unmounted
+		std::shared_ptr<asset_pack::reader const> findPack(std::string const& real_path, std::string& entry_path);
+
+		//! \brief Whether a file is read from a mounted pack rather than
+		//!        from disk; files derived from it, such as caches, cannot
+		//!        be written next to it.
+		//!
+		//! @param [in] real_path path as returned by `resolve()`
+		bool isPacked(std::string const& real_path);
+
+		//! \brief List the files of a directory, recursively.
+		//!
+		//! @param [in] directory path to the directory on disk
+		//! @return paths of the files relative to `directory`, using
+		//!         `/` as separator
+		std::vector<std::string> listFiles(std::string const& directory);
+
+		//! \brief Normalise a virtual path: collapse `.` and `..`
+		//!        components and repeated separators.
+		std::string normalise(std::string const& virtual_path);
+
+		//! \brief Resolve a virtual path.
+		//!
+		//! @param [in] virtual_path e.g. `shaders/EDAF80/phong.vert`
+		//! @param [out] real_path path to the file on disk, if found
+		//! @return whether the path is in the index
+		bool resolve(std::string const& virtual_path, std::string& real_path);
+
+		//! \brief Resolve a virtual path, defaulting to the source tree.
+		//!
+		//! @param [in] virtual_path e.g. `shaders/EDAF80/phong.vert`
+		//! @return path to the file on disk if found, its expected
+		//!         location within the source tree otherwise, e.g. for
+		//!         files created after their mount point was scanned
+		std::string resolve(std::string const& virtual_path);
+
+		//! \brief Forget all mount points, default ones and packs
+		//!        included.
+		void clear();
+
+		//! \brief Get the current statistics.
+		statistics getStatistics();
+
+		//! \brief Log the current statistics.
+		void logStatistics();
+	}
+}
@@ -29,6 +29,22 @@ static int          g_ShaderHandle = 0, g_VertHandle = 0, g_FragHandle = 0;
 static int          g_AttribLocationTex = 0, g_AttribLocationProjMtx = 0;
 static int          g_AttribLocationPosition = 0, g_AttribLocationUV = 0, g_AttribLocationColor = 0;
 static unsigned int g_VboHandle = 0, g_VaoHandle = 0, g_ElementsHandle = 0;
+static ImGui_ImplGlfwGL3_StageFn g_StageFn = NULL;
+
+void ImGui_ImplGlfwGL3_SetStageFunction(ImGui_ImplGlfwGL3_StageFn stage_fn)
+{
+    g_StageFn = stage_fn;
+}
+
+// Point the attributes of g_VaoHandle at the vertices found at 'offset' in the buffer currently bound to GL_ARRAY_BUFFER.
+static void ImGui_ImplGlfwGL3_SetupVertexAttribs(size_t offset)
+{
+#define OFFSETOF(TYPE, ELEMENT) ((size_t)&(((TYPE *)0)->ELEMENT))
+    glVertexAttribPointer(g_AttribLocationPosition, 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert), (GLvoid*)(offset + OFFSETOF(ImDrawVert, pos)));
+    glVertexAttribPointer(g_AttribLocationUV, 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert), (GLvoid*)(offset + OFFSETOF(ImDrawVert, uv)));
+    glVertexAttribPointer(g_AttribLocationColor, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(ImDrawVert), (GLvoid*)(offset + OFFSETOF(ImDrawVert, col)));
+#undef OFFSETOF
+}
 
 // This is the main rendering function that you have to implement and provide to ImGui (via setting up 'RenderDrawListsFn' in the ImGuiIO structure)
 // If text or lines are blurry when integrating ImGui in your engine:
@@ -91,11 +107,26 @@ void ImGui_ImplGlfwGL3_RenderDrawLists(ImDrawData* draw_data)
         const ImDrawList* cmd_list = draw_data->CmdLists[n];
         const ImDrawIdx* idx_buffer_offset = 0;
 
-        glBindBuffer(GL_ARRAY_BUFFER, g_VboHandle);
-        glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)cmd_list->VtxBuffer.Size * sizeof(ImDrawVert), (const GLvoid*)cmd_list->VtxBuffer.Data, GL_STREAM_DRAW);
+        const size_t vtx_size = (size_t)cmd_list->VtxBuffer.Size * sizeof(ImDrawVert);
+        const size_t idx_size = (size_t)cmd_list->IdxBuffer.Size * sizeof(ImDrawIdx);
+        unsigned int staged_buffer = 0;
+        size_t vtx_offset = 0, idx_offset = 0;
+        if (g_StageFn != NULL && g_StageFn(cmd_list->VtxBuffer.Data, vtx_size, cmd_list->IdxBuffer.Data, idx_size, &staged_buffer, &vtx_offset, &idx_offset))
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, staged_buffer);
+            ImGui_ImplGlfwGL3_SetupVertexAttribs(vtx_offset);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, staged_buffer);
+            idx_buffer_offset = (const ImDrawIdx*)idx_offset;
+        }
+        else
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, g_VboHandle);
+            ImGui_ImplGlfwGL3_SetupVertexAttribs(0);
+            glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)vtx_size, (const GLvoid*)cmd_list->VtxBuffer.Data, GL_STREAM_DRAW);
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_ElementsHandle);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)cmd_list->IdxBuffer.Size * sizeof(ImDrawIdx), (const GLvoid*)cmd_list->IdxBuffer.Data, GL_STREAM_DRAW);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_ElementsHandle);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)idx_size, (const GLvoid*)cmd_list->IdxBuffer.Data, GL_STREAM_DRAW);
+        }
 
         for (int cmd_i = 0; cmd_i < cmd_list->CmdBuffer.Size; cmd_i++)
         {
@@ -261,11 +292,7 @@ bool ImGui_ImplGlfwGL3_CreateDeviceObjects()
     glEnableVertexAttribArray(g_AttribLocationUV);
     glEnableVertexAttribArray(g_AttribLocationColor);
 
-#define OFFSETOF(TYPE, ELEMENT) ((size_t)&(((TYPE *)0)->ELEMENT))
-    glVertexAttribPointer(g_AttribLocationPosition, 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert), (GLvoid*)OFFSETOF(ImDrawVert, pos));
-    glVertexAttribPointer(g_AttribLocationUV, 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert), (GLvoid*)OFFSETOF(ImDrawVert, uv));
-    glVertexAttribPointer(g_AttribLocationColor, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(ImDrawVert), (GLvoid*)OFFSETOF(ImDrawVert, col));
-#undef OFFSETOF
+    ImGui_ImplGlfwGL3_SetupVertexAttribs(0);
 
     ImGui_ImplGlfwGL3_CreateFontsTexture();
 
@@ -16,6 +16,13 @@ IMGUI_API void        ImGui_ImplGlfwGL3_NewFrame();
 IMGUI_API void        ImGui_ImplGlfwGL3_InvalidateDeviceObjects();
 IMGUI_API bool        ImGui_ImplGlfwGL3_CreateDeviceObjects();
 
+// Optional hook copying each draw list's vertices and indices into a buffer object the binding can draw straight from,
+// instead of re-specifying its own buffers with glBufferData() for every list.
+// Returns false to fall back to the binding's own buffers; the staged data must stay valid until the list is drawn.
+typedef bool        (*ImGui_ImplGlfwGL3_StageFn)(const void* vertices, size_t vertices_size, const void* indices, size_t indices_size,
+                                                 unsigned int* buffer, size_t* vertices_offset, size_t* indices_offset);
+IMGUI_API void        ImGui_ImplGlfwGL3_SetStageFunction(ImGui_ImplGlfwGL3_StageFn stage_fn);
+
 // GLFW callbacks (installed by default if you enable 'install_callbacks' during initialization)
 // Provided here if you want to chain callbacks.
 // You can also handle inputs yourself and use those as a reference.
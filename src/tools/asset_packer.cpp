@@ -0,0 +1,196 @@
+#include "core/asset_pack.hpp"
+#include "core/mapped_file.hpp"
+#include "core/Misc.h"
+#include "core/vfs.hpp"
+
+#ifndef _WIN32
+#	include <fcntl.h>
+#	include <unistd.h>
+#endif
+
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace
+{
+	void printUsage(char const* program)
+	{
+		std::printf("Usage: %s [--lz4] [--benchmark] <pack> <directory>=<prefix>...\n"
+		            "\n"
+		            "Pack all files found below each directory, under the given virtual prefix,\n"
+		            "e.g. `%s assets.pack res=res shaders=shaders`.\n"
+		            "\n"
+		            "Caches are not written for packed files, so bake the mesh and texture caches\n"
+		            "by running from loose files first; they get packed along with their sources.\n"
+		            "\n"
+		            "  --lz4        compress the files which shrink enough\n"
+		            "  --benchmark  then time reading all files, loose and from the pack\n",
+		            program, program);
+	}
+
+	bool endsWith(std::string const& value, std::string const& suffix)
+	{
+		return value.size() >= suffix.size()
+		    && value.compare(value.size() - suffix.size(), suffix.size(), suffix) == 0;
+	}
+
+	//! \brief Drop the pages of a file from the OS cache, so that the next
+	//!        read hits the disk.
+	bool evict(std::string const& path)
+	{
+#ifdef _WIN32
+		(void) path;
+		return false;
+#else
+		auto const fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+		// Dirty pages are not dropped, hence the flush first.
+		fdatasync(fd);
+		auto const evicted = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+		::close(fd);
+		return evicted;
+#endif
+	}
+
+	//! \brief Read one byte per page, which is enough to fault all of
+	//!        them in.
+	u64 touch(u8 const* data, size_t size)
+	{
+		u64 sum = 0u;
+		for (size_t i = 0u; i < size; i += 4096u)
+			sum += data[i];
+		return size != 0u ? sum + data[size - 1u] : sum;
+	}
+
+	double readLoose(std::vector<bonobo::asset_pack::source_file> const& files, u64& checksum)
+	{
+		auto const start = StartTimer();
+		for (auto const& file : files) {
+			bonobo::mapped_file mapping;
+			if (mapping.open(file.path))
+				checksum += touch(mapping.data(), mapping.size());
+		}
+		return EndTimerSeconds(start) * 1000.0;
+	}
+
+	double readPacked(std::string const& pack_path, std::vector<bonobo::asset_pack::source_file> const& files, u64& checksum)
+	{
+		auto const start = StartTimer();
+		bonobo::asset_pack::reader pack;
+		if (!pack.open(pack_path))
+			return -1.0;
+		std::vector<u8> buffer;
+		for (auto const& file : files) {
+			auto const entry = pack.find(file.virtual_path);
+			if (entry == nullptr)
+				continue;
+			if (!entry->compressed) {
+				checksum += touch(pack.data(*entry), static_cast<size_t>(entry->size));
+				continue;
+			}
+			buffer.resize(static_cast<size_t>(entry->size));
+			if (pack.extract(*entry, buffer.data()))
+				checksum += touch(buffer.data(), buffer.size());
+		}
+		return EndTimerSeconds(start) * 1000.0;
+	}
+
+	void benchmark(std::string const& pack_path, std::vector<bonobo::asset_pack::source_file> const& files)
+	{
+		u64 checksum = 0u;
+
+		bool cold = evict(pack_path);
+		for (auto const& file : files)
+			cold = evict(file.path) && cold;
+		if (cold) {
+			auto const loose_ms = readLoose(files, checksum);
+			auto const packed_ms = readPacked(pack_path, files, checksum);
+			std::printf("Cold start: %.2f ms loose, %.2f ms packed\n", loose_ms, packed_ms);
+		} else {
+			std::printf("Cold start: skipped, as files cannot be evicted from the OS cache on this platform\n");
+		}
+
+		// Both sets of files are now cached, whichever ran first.
+		readLoose(files, checksum);
+		readPacked(pack_path, files, checksum);
+		auto const loose_ms = readLoose(files, checksum);
+		auto const packed_ms = readPacked(pack_path, files, checksum);
+		std::printf("Warm start: %.2f ms loose, %.2f ms packed (checksum %llu)\n",
+		            loose_ms, packed_ms, static_cast<unsigned long long>(checksum));
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	auto compress = false;
+	auto run_benchmark = false;
+	std::string pack_path;
+	std::vector<std::pair<std::string, std::string>> directories;
+	for (int i = 1; i < argc; ++i) {
+		auto const argument = std::string(argv[i]);
+		auto const separator = argument.rfind('=');
+		if (argument == "--lz4") {
+			compress = true;
+		} else if (argument == "--benchmark") {
+			run_benchmark = true;
+		} else if (argument == "--help" || argument == "-h") {
+			printUsage(argv[0]);
+			return 0;
+		} else if (pack_path.empty()) {
+			pack_path = argument;
+		} else if (separator != std::string::npos) {
+			directories.emplace_back(argument.substr(0u, separator), argument.substr(separator + 1u));
+		} else {
+			std::fprintf(stderr, "Expected <directory>=<prefix>, got \"%s\"\n", argument.c_str());
+			return 1;
+		}
+	}
+	if (pack_path.empty() || directories.empty()) {
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	// As with mount points, files from later directories replace those
+	// with the same virtual path from earlier ones. Leftovers of
+	// interrupted writes are skipped, as is the pack itself.
+	std::map<std::string, std::string> sources; // virtual path -> path on disk
+	for (auto const& directory : directories) {
+		auto const prefix = bonobo::vfs::normalise(directory.second);
+		auto const base = prefix.empty() ? std::string() : prefix + "/";
+		auto const files = bonobo::vfs::listFiles(directory.first);
+		if (files.empty())
+			std::fprintf(stderr, "No files found in \"%s\"\n", directory.first.c_str());
+		for (auto const& file : files) {
+			auto const path = directory.first + "/" + file;
+			if (endsWith(file, ".tmp") || bonobo::vfs::normalise(path) == bonobo::vfs::normalise(pack_path))
+				continue;
+			sources[base + file] = path;
+		}
+	}
+
+	std::vector<bonobo::asset_pack::source_file> files;
+	files.reserve(sources.size());
+	for (auto const& source : sources)
+		files.push_back({ source.second, source.first });
+
+	auto const start = StartTimer();
+	bonobo::asset_pack::write_statistics stats = {};
+	if (!bonobo::asset_pack::write(pack_path, files, compress, &stats)) {
+		std::fprintf(stderr, "Failed to write \"%s\"\n", pack_path.c_str());
+		return 1;
+	}
+	std::printf("Packed %u files (%u compressed) into \"%s\" in %.2f ms: %.2f MiB -> %.2f MiB\n",
+	            static_cast<unsigned int>(stats.files_nb), static_cast<unsigned int>(stats.compressed_nb),
+	            pack_path.c_str(), EndTimerSeconds(start) * 1000.0,
+	            stats.source_bytes / (1024.0 * 1024.0), stats.pack_bytes / (1024.0 * 1024.0));
+
+	if (run_benchmark)
+		benchmark(pack_path, files);
+
+	return 0;
+}
@@ -0,0 +1,129 @@
+#include "EDAF80/parametric_shapes.hpp"
+#include "core/Misc.h"
+#include "core/mesh_optimizer.hpp"
+#include "core/thread_pool.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace
+{
+	void printUsage(char const* program)
+	{
+		std::printf("Usage: %s [--max-resolution <n>]\n"
+		            "\n"
+		            "Time the generation of parametric shapes, without any OpenGL context,\n"
+		            "at resolutions from 10x10 up to 4096x4096 vertices by default, both on a\n"
+		            "single thread and spread over the shared thread pool; then compare the\n"
+		            "index sizes and vertex cache efficiency of triangle lists and strips.\n",
+		            program);
+	}
+
+	//! \brief Generate a shape enough times to get a stable timing, and
+	//!        return the rate in millions of vertices per second.
+	double measure(std::function<parametric_shapes::cpu_mesh ()> const& generate, u64& checksum)
+	{
+		u64 const target_vertices = 4u * 1024u * 1024u;
+
+		u64 vertices_nb = 0u;
+		auto const start = StartTimer();
+		do {
+			auto const mesh = generate();
+			vertices_nb += mesh.vertices.size();
+			checksum += mesh.indices.back();
+		} while (vertices_nb < target_vertices);
+		auto const seconds = EndTimerSeconds(start);
+
+		return seconds > 0.0 ? vertices_nb / seconds / 1.0e6 : 0.0;
+	}
+
+	//! \brief Print the index size, and the ACMR and ATVR for FIFO caches
+	//!        of 16 and 32 vertices, of some indices.
+	void printIndices(char const* name, std::vector<u32> const& indices, size_t vertices_nb, bool strips)
+	{
+		auto const analyse = [&](size_t cache_size){
+			return strips ? bonobo::mesh_optimizer::analyseStripVertexCache(indices.data(), indices.size(), vertices_nb, cache_size)
+			              : bonobo::mesh_optimizer::analyseVertexCache(indices.data(), indices.size(), vertices_nb, cache_size);
+		};
+		// Indices are uploaded on 16 bits below 2^16 vertices.
+		auto const index_size = vertices_nb < 0x10000u ? 2u : 4u;
+		auto const small = analyse(16u);
+		auto const large = analyse(32u);
+		std::printf("  %-16s %10.1f KiB %7.3f %7.3f %7.3f %7.3f\n", name, indices.size() * index_size / 1024.0,
+		            small.acmr, small.atvr, large.acmr, large.atvr);
+	}
+
+	//! \brief Compare the triangle list of a shape, once optimised for
+	//!        the vertex cache, and its strips.
+	void compareTopologies(char const* name, unsigned int resolution,
+	                       std::function<parametric_shapes::cpu_mesh (GLenum)> const& generate)
+	{
+		auto const list = generate(GL_TRIANGLES);
+		auto const strips = generate(GL_TRIANGLE_STRIP);
+		auto const vertices_nb = list.vertices.size();
+		auto optimised = std::vector<u32>(list.indices.begin(), list.indices.end());
+		bonobo::mesh_optimizer::optimizeVertexCache(optimised, vertices_nb);
+
+		std::printf("%s %ux%u:\n", name, resolution, resolution);
+		printIndices("list", std::vector<u32>(list.indices.begin(), list.indices.end()), vertices_nb, false);
+		printIndices("optimised list", optimised, vertices_nb, false);
+		printIndices("strips", std::vector<u32>(strips.indices.begin(), strips.indices.end()), vertices_nb, true);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	unsigned int max_resolution = 4096u;
+	for (int i = 1; i < argc; ++i) {
+		if (std::strcmp(argv[i], "--max-resolution") == 0 && i + 1 < argc) {
+			max_resolution = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+		} else {
+			printUsage(argv[0]);
+			return std::strcmp(argv[i], "--help") == 0 || std::strcmp(argv[i], "-h") == 0 ? 0 : 1;
+		}
+	}
+
+	auto* const pool = &bonobo::thread_pool::shared();
+	u64 checksum = 0u;
+
+	std::printf("%-12s %10s %12s %16s %16s\n", "Shape", "Resolution", "Vertices", "1 thread", "Pool");
+	for (unsigned int resolution = 10u; resolution <= max_resolution;
+	     resolution = resolution < 16u ? 16u : resolution * 2u) {
+		auto const r = resolution;
+		struct shape {
+			char const* name;
+			std::function<parametric_shapes::cpu_mesh (bonobo::thread_pool*)> generate;
+		} const shapes[] = {
+			{ "quad",        [r](bonobo::thread_pool* p){ return parametric_shapes::generateQuad(r, r, 100u, 100u, GL_TRIANGLES, p); } },
+			{ "sphere",      [r](bonobo::thread_pool* p){ return parametric_shapes::generateSphere(r, r, 1.0f, GL_TRIANGLES, p); } },
+			{ "torus",       [r](bonobo::thread_pool* p){ return parametric_shapes::generateTorus(r, r, 1.0f, 2.0f, GL_TRIANGLES, p); } },
+			{ "circle ring", [r](bonobo::thread_pool* p){ return parametric_shapes::generateCircleRing(r, r, 1.0f, 2.0f, GL_TRIANGLES, p); } }
+		};
+		for (auto const& s : shapes) {
+			auto const single_rate = measure([&s](){ return s.generate(nullptr); }, checksum);
+			auto const pool_rate = measure([&s, pool](){ return s.generate(pool); }, checksum);
+			std::printf("%-12s %5ux%-4u %12llu %9.1f Mv/s %9.1f Mv/s\n", s.name, r, r,
+			            static_cast<unsigned long long>(r) * r, single_rate, pool_rate);
+		}
+	}
+	std::printf("%u worker threads (checksum %llu)\n", static_cast<unsigned int>(pool->size()),
+	            static_cast<unsigned long long>(checksum));
+
+	// Larger resolutions take a while to optimise, and behave the same.
+	std::printf("\n  %-16s %14s %15s %15s\n", "Indices", "Size", "16 ACMR ATVR", "32 ACMR ATVR");
+	for (auto const resolution : { 100u, 1000u }) {
+		if (resolution > max_resolution)
+			continue;
+		auto const r = resolution;
+		compareTopologies("quad", r, [r, pool](GLenum mode){ return parametric_shapes::generateQuad(r, r, 100u, 100u, mode, pool); });
+		compareTopologies("sphere", r, [r, pool](GLenum mode){ return parametric_shapes::generateSphere(r, r, 1.0f, mode, pool); });
+		compareTopologies("torus", r, [r, pool](GLenum mode){ return parametric_shapes::generateTorus(r, r, 1.0f, 2.0f, mode, pool); });
+		compareTopologies("circle ring", r, [r, pool](GLenum mode){ return parametric_shapes::generateCircleRing(r, r, 1.0f, 2.0f, mode, pool); });
+	}
+
+	return 0;
+}